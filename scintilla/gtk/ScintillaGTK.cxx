@@ -710,7 +710,7 @@ void ScintillaGTK::Init() {
 		caret.period = 0;
 	}
 
-	for (size_t tr = static_cast<size_t>(TickReason::caret); tr <= static_cast<size_t>(TickReason::dwell); tr++) {
+	for (size_t tr = static_cast<size_t>(TickReason::caret); tr <= static_cast<size_t>(TickReason::style); tr++) {
 		timers[tr].reason = static_cast<TickReason>(tr);
 		timers[tr].scintilla = this;
 	}
@@ -723,7 +723,7 @@ void ScintillaGTK::Init() {
 }
 
 void ScintillaGTK::Finalise() {
-	for (size_t tr = static_cast<size_t>(TickReason::caret); tr <= static_cast<size_t>(TickReason::dwell); tr++) {
+	for (size_t tr = static_cast<size_t>(TickReason::caret); tr <= static_cast<size_t>(TickReason::style); tr++) {
 		FineTickerCancel(static_cast<TickReason>(tr));
 	}
 	if (accessible) {
@@ -3318,6 +3318,29 @@ void scintilla_release_resources(void) {
 	}
 }
 
+/* Access from C to the ILoader returned by SCI_CREATELOADER.
+ * A loader may be filled from any thread, but from one thread at a time. */
+int scintilla_loader_add_data(void *loader, const char *data, gssize length) {
+	return static_cast<ILoader *>(loader)->AddData(data, length);
+}
+
+void *scintilla_loader_convert_to_document(void *loader) {
+	return static_cast<ILoader *>(loader)->ConvertToDocument();
+}
+
+int scintilla_loader_release(void *loader) {
+	return static_cast<ILoader *>(loader)->Release();
+}
+
+/* Reserves the line index for the number of lines the loader is going to be filled with.
+ * Growing it while adding the data works too, so failure to allocate is not an error. */
+void scintilla_loader_allocate_lines(void *loader, gssize lines) {
+	try {
+		static_cast<Document *>(static_cast<ILoader *>(loader))->AllocateLines(lines);
+	} catch (...) {
+	}
+}
+
 /* Define a dummy boxed type because g-ir-scanner is unable to
  * recognize gpointer-derived types. Note that SCNotificaiton
  * is always allocated on stack so copying is not appropriate. */
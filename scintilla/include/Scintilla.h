@@ -529,6 +529,8 @@ typedef sptr_t (*SciFnDirectStatus)(sptr_t ptr, unsigned int iMessage, uptr_t wP
 #define SCI_TARGETWHOLEDOCUMENT 2690
 #define SCI_REPLACETARGET 2194
 #define SCI_REPLACETARGETRE 2195
+#define SCI_REPLACERANGES 2900
+#define SCI_FINDMULTIPLE 2901
 #define SCI_SEARCHINTARGET 2197
 #define SCI_SETSEARCHFLAGS 2198
 #define SCI_GETSEARCHFLAGS 2199
@@ -1144,6 +1146,7 @@ typedef sptr_t (*SciFnDirectStatus)(sptr_t ptr, unsigned int iMessage, uptr_t wP
 #define SCI_TAGSOFSTYLE 4031
 #define SCI_DESCRIPTIONOFSTYLE 4032
 #define SCI_SETILEXER 4033
+#define SCI_SETBACKGROUNDLEXER 2902
 #define SC_MOD_NONE 0x0
 #define SC_MOD_INSERTTEXT 0x1
 #define SC_MOD_DELETETEXT 0x2
@@ -1274,6 +1277,25 @@ struct Sci_TextToFind {
 	struct Sci_CharacterRange chrgText;
 };
 
+/* Used by SCI_FINDMULTIPLE: count strings in texts are searched for between cpMin and
+ * cpMax and the start and end of up to maxMatches matches are stored in matches. */
+struct Sci_TextToFindMultiple {
+	Sci_Position cpMin;
+	Sci_Position cpMax;
+	const char *const *texts;
+	Sci_Position count;
+	Sci_Position *matches;
+	Sci_Position maxMatches;
+};
+
+/* Used by SCI_REPLACERANGES: replaces [cpMin, cpMax) with length bytes of text. */
+struct Sci_ReplaceRange {
+	Sci_Position cpMin;
+	Sci_Position cpMax;
+	const char *text;
+	Sci_Position length;
+};
+
 typedef void *Sci_SurfaceID;
 
 struct Sci_Rectangle {
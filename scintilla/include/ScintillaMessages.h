@@ -313,6 +313,8 @@ enum class Message {
 	TargetWholeDocument = 2690,
 	ReplaceTarget = 2194,
 	ReplaceTargetRE = 2195,
+	ReplaceRanges = 2900,
+	FindMultiple = 2901,
 	SearchInTarget = 2197,
 	SetSearchFlags = 2198,
 	GetSearchFlags = 2199,
@@ -782,6 +784,7 @@ enum class Message {
 	TagsOfStyle = 4031,
 	DescriptionOfStyle = 4032,
 	SetILexer = 4033,
+	SetBackgroundLexer = 2902,
 	GetBidirectional = 2708,
 	SetBidirectional = 2709,
 };
@@ -30,6 +30,22 @@ struct TextToFind {
 	CharacterRange chrgText;
 };
 
+struct TextToFindMultiple {
+	Position cpMin;
+	Position cpMax;
+	const char *const *texts;
+	Position count;
+	Position *matches;
+	Position maxMatches;
+};
+
+struct ReplaceRange {
+	Position cpMin;
+	Position cpMax;
+	const char *text;
+	Position length;
+};
+
 using SurfaceID = void *;
 
 struct Rectangle {
@@ -59,6 +59,11 @@ GtkWidget*	scintilla_new		(void);
 void		scintilla_set_id	(ScintillaObject *sci, uptr_t id);
 sptr_t		scintilla_send_message	(ScintillaObject *sci,unsigned int iMessage, uptr_t wParam, sptr_t lParam);
 void		scintilla_release_resources(void);
+
+int			scintilla_loader_add_data				(void *loader, const char *data, gssize length);
+void*		scintilla_loader_convert_to_document	(void *loader);
+int			scintilla_loader_release				(void *loader);
+void		scintilla_loader_allocate_lines			(void *loader, gssize lines);
 #endif
 
 #define SCINTILLA_NOTIFY "sci-notify"
@@ -0,0 +1,496 @@
+// Scintilla source code edit control
+/** @file BackgroundStyler.cxx
+ ** Styles a copy of a document on a worker thread.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstddef>
+#include <cstring>
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <forward_list>
+#include <optional>
+#include <algorithm>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "ScintillaTypes.h"
+#include "ILoader.h"
+#include "ILexer.h"
+
+#include "Debugging.h"
+
+#include "CharacterType.h"
+#include "CharacterCategoryMap.h"
+#include "Position.h"
+#include "SplitVector.h"
+#include "Partitioning.h"
+#include "RunStyles.h"
+#include "CellBuffer.h"
+#include "PerLine.h"
+#include "CharClassify.h"
+#include "Decoration.h"
+#include "CaseFolder.h"
+#include "Document.h"
+#include "BackgroundStyler.h"
+#include "UniConversion.h"
+#include "ElapsedPeriod.h"
+
+using namespace Scintilla;
+using namespace Scintilla::Internal;
+
+namespace Scintilla::Internal {
+
+/**
+ * Read-only copy of the text, styles, line starts, fold levels and line states of the lines
+ * [firstLine, lineEnd) of a document that a lexer can style without touching the document
+ * itself. Positions and lines are those of the document, text outside of the copy reads
+ * as NUL and the copy ends the document for the lexer. Only handles single byte and UTF-8
+ * documents with the default line ends. Lexers can not add indicators from the worker so
+ * decoration calls are ignored.
+ */
+class LexSnapshot : public IDocument {
+	std::string text;
+	std::string styles;
+	std::vector<Sci::Position> lineStarts;
+	std::vector<int> levels;
+	std::vector<int> lineStates;
+	Sci::Position base;
+	Sci::Line firstLine;
+	int codePage;
+	int tabInChars;
+	Sci::Position endStyled = 0;
+
+	Sci::Position LengthNoExcept() const noexcept {
+		return base + static_cast<Sci::Position>(text.length());
+	}
+	bool InCopy(Sci::Position position) const noexcept {
+		return position >= base && position < LengthNoExcept();
+	}
+	bool LineInCopy(Sci::Position line) const noexcept {
+		return line >= firstLine && line < LinesTotal();
+	}
+	unsigned char UCharAt(Sci::Position position) const noexcept {
+		return InCopy(position) ? text[position - base] : 0;
+	}
+	Sci::Position NextPosition(Sci::Position pos, int moveDir) const noexcept;
+public:
+	LexSnapshot(const Document *pdoc, Sci::Line firstLine_, Sci::Line lineEnd);
+
+	Sci::Line LinesTotal() const noexcept {
+		return firstLine + static_cast<Sci::Line>(lineStarts.size()) - 1;
+	}
+	void Extract(StyleBatch &batch, Sci::Line line, Sci::Line lineEnd) const;
+
+	int SCI_METHOD Version() const override {
+		return Scintilla::dvRelease4;
+	}
+	void SCI_METHOD SetErrorStatus(int) override {
+	}
+	Sci_Position SCI_METHOD Length() const override {
+		return LengthNoExcept();
+	}
+	void SCI_METHOD GetCharRange(char *buffer, Sci_Position position, Sci_Position lengthRetrieve) const override {
+		if ((position < 0) || (lengthRetrieve <= 0) || (position + lengthRetrieve > LengthNoExcept()))
+			return;
+		const Sci::Position start = std::max<Sci::Position>(position, base);
+		if (start > position) {
+			memset(buffer, 0, std::min<Sci::Position>(start - position, lengthRetrieve));
+		}
+		if (start < position + lengthRetrieve) {
+			memcpy(buffer + (start - position), text.data() + (start - base), position + lengthRetrieve - start);
+		}
+	}
+	char SCI_METHOD StyleAt(Sci_Position position) const override {
+		return InCopy(position) ? styles[position - base] : 0;
+	}
+	Sci_Position SCI_METHOD LineFromPosition(Sci_Position position) const override {
+		if (position <= base)
+			return firstLine;
+		const auto it = std::upper_bound(lineStarts.begin(), lineStarts.end() - 1, position);
+		return std::min<Sci::Line>(firstLine + (it - lineStarts.begin()) - 1, LinesTotal() - 1);
+	}
+	Sci_Position SCI_METHOD LineStart(Sci_Position line) const override {
+		if (line <= firstLine)
+			return base;
+		return lineStarts[std::min<Sci::Line>(line, LinesTotal()) - firstLine];
+	}
+	int SCI_METHOD GetLevel(Sci_Position line) const override {
+		return LineInCopy(line) ? levels[line - firstLine] : static_cast<int>(FoldLevel::Base);
+	}
+	int SCI_METHOD SetLevel(Sci_Position line, int level) override {
+		if (!LineInCopy(line))
+			return static_cast<int>(FoldLevel::Base);
+		const int prev = levels[line - firstLine];
+		levels[line - firstLine] = level;
+		return prev;
+	}
+	int SCI_METHOD GetLineState(Sci_Position line) const override {
+		return LineInCopy(line) ? lineStates[line - firstLine] : 0;
+	}
+	int SCI_METHOD SetLineState(Sci_Position line, int state) override {
+		if (!LineInCopy(line))
+			return 0;
+		const int prev = lineStates[line - firstLine];
+		lineStates[line - firstLine] = state;
+		return prev;
+	}
+	void SCI_METHOD StartStyling(Sci_Position position) override {
+		endStyled = position;
+	}
+	bool SCI_METHOD SetStyleFor(Sci_Position length, char style) override {
+		if (length < 0 || endStyled < base || endStyled + length > LengthNoExcept())
+			return false;
+		std::fill(styles.begin() + (endStyled - base), styles.begin() + (endStyled - base + length), style);
+		endStyled += length;
+		return true;
+	}
+	bool SCI_METHOD SetStyles(Sci_Position length, const char *stylesSet) override {
+		if (length < 0 || endStyled < base || endStyled + length > LengthNoExcept())
+			return false;
+		std::copy(stylesSet, stylesSet + length, styles.begin() + (endStyled - base));
+		endStyled += length;
+		return true;
+	}
+	void SCI_METHOD DecorationSetCurrentIndicator(int) override {
+	}
+	void SCI_METHOD DecorationFillRange(Sci_Position, int, Sci_Position) override {
+	}
+	void SCI_METHOD ChangeLexerState(Sci_Position, Sci_Position) override {
+	}
+	int SCI_METHOD CodePage() const override {
+		return codePage;
+	}
+	bool SCI_METHOD IsDBCSLeadByte(char) const override {
+		return false;
+	}
+	const char *SCI_METHOD BufferPointer() override {
+		// Only valid when the copy starts the document
+		return text.c_str();
+	}
+	int SCI_METHOD GetLineIndentation(Sci_Position line) override;
+	Sci_Position SCI_METHOD LineEnd(Sci_Position line) const override;
+	Sci_Position SCI_METHOD GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const override;
+	int SCI_METHOD GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const override;
+};
+
+/**
+ * A run of the worker. It is shared by the worker and the main thread so that the worker
+ * can be left to finish on its own after being cancelled.
+ */
+struct StyleJob {
+	std::shared_ptr<ILexer5> instance;
+	LexSnapshot snapshot;
+	int version;
+	Sci::Position end = 0;
+	std::atomic<bool> cancelled;
+	std::atomic<bool> finished;
+	std::atomic<bool> failed;
+	std::mutex mutexBatches;
+	std::deque<StyleBatch> batches;
+
+	StyleJob(std::shared_ptr<ILexer5> instance_, const Document *pdoc, Sci::Line firstLine, Sci::Line lineEnd) :
+		instance(std::move(instance_)), snapshot(pdoc, firstLine, lineEnd),
+		version(pdoc->ModificationVersion()), cancelled(false), finished(false), failed(false) {
+	}
+	void Work(Sci::Line line, Sci::Line lineEndJob);
+};
+
+}
+
+LexSnapshot::LexSnapshot(const Document *pdoc, Sci::Line firstLine_, Sci::Line lineEnd) :
+	base(pdoc->LineStart(firstLine_)), firstLine(firstLine_),
+	codePage(pdoc->dbcsCodePage), tabInChars(pdoc->tabInChars) {
+	const Sci::Position length = pdoc->LineStart(lineEnd) - base;
+	text.resize(length);
+	pdoc->GetCharRange(text.data(), base, length);
+	styles.resize(length);
+	pdoc->GetStyleRange(reinterpret_cast<unsigned char *>(styles.data()), base, length);
+	lineStarts.reserve(lineEnd - firstLine + 1);
+	levels.reserve(lineEnd - firstLine);
+	lineStates.reserve(lineEnd - firstLine);
+	for (Sci::Line line = firstLine; line < lineEnd; line++) {
+		lineStarts.push_back(pdoc->LineStart(line));
+		levels.push_back(pdoc->GetLevel(line));
+		lineStates.push_back(pdoc->GetLineState(line));
+	}
+	lineStarts.push_back(base + length);
+}
+
+void LexSnapshot::Extract(StyleBatch &batch, Sci::Line line, Sci::Line lineEnd) const {
+	batch.position = LineStart(line);
+	batch.line = line;
+	batch.styles.assign(styles, batch.position - base, LineStart(lineEnd) - batch.position);
+	batch.levels.assign(levels.begin() + (line - firstLine), levels.begin() + (lineEnd - firstLine));
+	batch.lineStates.assign(lineStates.begin() + (line - firstLine), lineStates.begin() + (lineEnd - firstLine));
+}
+
+Sci::Position LexSnapshot::NextPosition(Sci::Position pos, int moveDir) const noexcept {
+	if (pos + moveDir <= base)
+		return base;
+	if (pos + moveDir >= LengthNoExcept())
+		return LengthNoExcept();
+	if (codePage != CpUtf8)
+		return pos + moveDir;
+	if (moveDir > 0) {
+		const int widthCharBytes = UTF8DrawBytes(
+			reinterpret_cast<const unsigned char *>(text.data() + (pos - base)), static_cast<int>(LengthNoExcept() - pos));
+		return pos + widthCharBytes;
+	}
+	// Back up over trail bytes to a lead byte whose character ends at pos
+	for (Sci::Position start = pos - 1; start >= base && start >= pos - UTF8MaxBytes; start--) {
+		if (!UTF8IsTrailByte(UCharAt(start))) {
+			const int utf8status = UTF8Classify(
+				reinterpret_cast<const unsigned char *>(text.data() + (start - base)), pos - start);
+			if (!(utf8status & UTF8MaskInvalid) && ((utf8status & UTF8MaskWidth) == pos - start))
+				return start;
+			break;
+		}
+	}
+	return pos - 1;
+}
+
+int SCI_METHOD LexSnapshot::GetLineIndentation(Sci_Position line) {
+	int indent = 0;
+	if (LineInCopy(line)) {
+		for (Sci::Position i = LineStart(line); i < LengthNoExcept(); i++) {
+			const char ch = text[i - base];
+			if (ch == ' ')
+				indent++;
+			else if (ch == '\t')
+				indent = (indent / tabInChars + 1) * tabInChars;
+			else
+				return indent;
+		}
+	}
+	return indent;
+}
+
+Sci_Position SCI_METHOD LexSnapshot::LineEnd(Sci_Position line) const {
+	if (line >= LinesTotal() - 1)
+		return LineStart(line + 1);
+	Sci::Position position = LineStart(line + 1);
+	if ((position > base + 1) && (UCharAt(position - 2) == '\r') && (UCharAt(position - 1) == '\n'))
+		return position - 2;
+	return position - 1;
+}
+
+Sci_Position SCI_METHOD LexSnapshot::GetRelativePosition(Sci_Position positionStart, Sci_Position characterOffset) const {
+	Sci::Position pos = positionStart;
+	const int increment = (characterOffset > 0) ? 1 : -1;
+	while (characterOffset != 0) {
+		const Sci::Position posNext = NextPosition(pos, increment);
+		if (posNext == pos)
+			return Sci::invalidPosition;
+		pos = posNext;
+		characterOffset -= increment;
+	}
+	return pos;
+}
+
+int SCI_METHOD LexSnapshot::GetCharacterAndWidth(Sci_Position position, Sci_Position *pWidth) const {
+	int bytesInCharacter = 1;
+	const unsigned char leadByte = UCharAt(position);
+	int character = leadByte;
+	if ((codePage == CpUtf8) && !UTF8IsAscii(leadByte)) {
+		const int widthCharBytes = UTF8BytesOfLead[leadByte];
+		unsigned char charBytes[UTF8MaxBytes] = {leadByte,0,0,0};
+		for (int b=1; b<widthCharBytes; b++)
+			charBytes[b] = UCharAt(position+b);
+		const int utf8status = UTF8Classify(charBytes, widthCharBytes);
+		if (utf8status & UTF8MaskInvalid) {
+			// Report as singleton surrogate values which are invalid Unicode
+			character =  0xDC80 + leadByte;
+		} else {
+			bytesInCharacter = utf8status & UTF8MaskWidth;
+			character = UnicodeFromUTF8(charBytes);
+		}
+	}
+	if (pWidth) {
+		*pWidth = bytesInCharacter;
+	}
+	return character;
+}
+
+namespace {
+
+// Amount of text styled before handing a batch to the main thread
+constexpr Sci::Position batchBytes = 0x40000;
+// Amount of text styled by one job, only this part of the document is copied for it
+constexpr Sci::Position jobBytes = 0x200000;
+// Text copied before and after the part to style for lexers looking around
+constexpr Sci::Position contextBytes = 0x4000;
+constexpr Sci::Line contextLines = 16;
+
+}
+
+void StyleJob::Work(Sci::Line line, Sci::Line lineEndJob) {
+	try {
+		LexSnapshot &doc = snapshot;
+		while ((line < lineEndJob) && !cancelled) {
+			const Sci::Position pos = doc.LineStart(line);
+			const Sci::Line lineEnd = std::min(
+				doc.LineFromPosition(std::min(pos + batchBytes, doc.Length())) + 1, lineEndJob);
+			const Sci::Position end = doc.LineStart(lineEnd);
+			// Same initial style as LexInterface::Colourise
+			const int styleStart = (pos > 0) ? doc.StyleAt(pos - 1) : 0;
+			instance->Lex(pos, end - pos, styleStart, &doc);
+			instance->Fold(pos, end - pos, styleStart, &doc);
+			StyleBatch batch;
+			doc.Extract(batch, line, lineEnd);
+			{
+				std::lock_guard<std::mutex> guard(mutexBatches);
+				if (!cancelled)
+					batches.push_back(std::move(batch));
+			}
+			line = lineEnd;
+		}
+	} catch (...) {
+		// Leave the rest of the document to be styled on the main thread
+		failed = true;
+	}
+	finished = true;
+}
+
+BackgroundStyler::BackgroundStyler(ILexer5 *instance_) :
+	instance(instance_, [](ILexer5 *lexer) noexcept { lexer->Release(); }), lexedTo(0), failed(false) {
+}
+
+BackgroundStyler::~BackgroundStyler() {
+	// A running worker keeps the lexer and its job alive until it stops
+	Cancel();
+}
+
+// Whether a worker still uses the lexer
+bool BackgroundStyler::Busy() const noexcept {
+	return job && !job->finished;
+}
+
+// Forget the stopped worker and apply the lexer settings changed while it ran
+void BackgroundStyler::EndJob() {
+	failed = failed || job->failed;
+	if (!job->cancelled && !job->failed) {
+		lexedTo = job->end;
+	}
+	job.reset();
+	for (const auto &change : pendingChanges) {
+		change(instance.get());
+	}
+	pendingChanges.clear();
+}
+
+// Change a setting of the lexer, now or once the worker stopped.
+void BackgroundStyler::Configure(std::function<void(ILexer5 *)> change) {
+	Cancel();
+	lexedTo = 0;
+	if (Busy()) {
+		pendingChanges.push_back(std::move(change));
+	} else {
+		change(instance.get());
+	}
+}
+
+// Style up to about jobBytes of text from the line starting at start, or from where the
+// lexer stopped if that is before.
+void BackgroundStyler::Start(const Document *pdoc, Sci::Position start) {
+	if (job) {
+		return;
+	}
+	const Sci::Position length = pdoc->Length();
+	const Sci::Line lines = pdoc->LinesTotal();
+	const Sci::Line line = pdoc->SciLineFromPosition(std::min(start, lexedTo));
+	start = pdoc->LineStart(line);
+	const Sci::Line firstLine = std::max(line - contextLines,
+		pdoc->SciLineFromPosition(std::max<Sci::Position>(start - contextBytes, 0)));
+	const Sci::Line lineEnd = std::min(pdoc->SciLineFromPosition(std::min(start + jobBytes, length)) + 1, lines);
+	const Sci::Position end = pdoc->LineStart(lineEnd);
+	const Sci::Line lineContextEnd = std::min(std::min(lineEnd + contextLines,
+		pdoc->SciLineFromPosition(std::min(end + contextBytes, length)) + 1), lines);
+	job = std::make_shared<StyleJob>(instance, pdoc, firstLine, lineContextEnd);
+	job->end = end;
+	std::thread worker([runningJob = job, line, lineEnd]() {
+		runningJob->Work(line, lineEnd);
+	});
+	worker.detach();
+}
+
+// Stop the worker without waiting for it and drop its results.
+void BackgroundStyler::Cancel() noexcept {
+	if (job) {
+		job->cancelled = true;
+		std::lock_guard<std::mutex> guard(job->mutexBatches);
+		job->batches.clear();
+	}
+}
+
+// The document changed at position so the state of the lexer after it is stale.
+void BackgroundStyler::Invalidate(Sci::Position position) noexcept {
+	lexedTo = std::min(lexedTo, position);
+}
+
+// Apply queued batches to the document for up to secondsAllowed.
+// Returns false once there is nothing more to publish, either because the job is done or
+// because the document changed and a cancelled worker has stopped.
+bool BackgroundStyler::Publish(Document *pdoc, double secondsAllowed) {
+	if (!job) {
+		return false;
+	}
+	if (pdoc->ModificationVersion() != job->version) {
+		Cancel();
+	}
+	ElapsedPeriod epPublish;
+	bool published = false;
+	while (!job->cancelled && epPublish.Duration() < secondsAllowed) {
+		StyleBatch batch;
+		{
+			std::lock_guard<std::mutex> guard(job->mutexBatches);
+			if (job->batches.empty())
+				break;
+			batch = std::move(job->batches.front());
+			job->batches.pop_front();
+		}
+		const Sci::Position endBatch = batch.position + batch.styles.length();
+		if (pdoc->GetEndStyled() >= endBatch) {
+			// Already styled on the main thread when it became visible
+			continue;
+		}
+		const Sci::Line lineStyled = pdoc->SciLineFromPosition(pdoc->GetEndStyled());
+		if (lineStyled < batch.line) {
+			Cancel();
+			break;
+		}
+		const Sci::Position position = pdoc->LineStart(lineStyled);
+		pdoc->StartStyling(position);
+		pdoc->SetStyles(endBatch - position, batch.styles.data() + (position - batch.position));
+		const Sci::Line lineEnd = batch.line + static_cast<Sci::Line>(batch.levels.size());
+		for (Sci::Line line = lineStyled; line < lineEnd; line++) {
+			pdoc->SetLineState(line, batch.lineStates[line - batch.line]);
+			pdoc->SetLevel(line, batch.levels[line - batch.line]);
+		}
+		published = true;
+	}
+	if (published) {
+		pdoc->IncrementStyleClock();
+	}
+	// A cancelled worker is left to stop on its own, this is checked again on the next tick
+	if (job->finished) {
+		bool done;
+		{
+			std::lock_guard<std::mutex> guard(job->mutexBatches);
+			done = job->batches.empty() || job->cancelled;
+		}
+		if (done) {
+			EndJob();
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,71 @@
+// Scintilla source code edit control
+/** @file BackgroundStyler.h
+ ** Styles a copy of a document on a worker thread.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef BACKGROUNDSTYLER_H
+#define BACKGROUNDSTYLER_H
+
+namespace Scintilla::Internal {
+
+struct StyleJob;
+
+/**
+ * Styles, fold levels and line states produced by the worker for whole lines
+ * [line, lineEnd) which start at position.
+ */
+struct StyleBatch {
+	Sci::Position position = 0;
+	Sci::Line line = 0;
+	std::string styles;
+	std::vector<int> levels;
+	std::vector<int> lineStates;
+};
+
+/**
+ * Runs a second instance of the document's lexer on a worker thread over a snapshot of
+ * the part of the document to style next. Results are queued in line aligned batches which
+ * the main thread applies to the document with Publish. Each job is tied to the document's
+ * modification version so any change to the document discards the batches not yet
+ * published.
+ * The main thread never waits for the worker: a cancelled job stops after its current batch
+ * and its results are dropped. Lexer settings changed meanwhile are applied once it stopped.
+ * Lexers may keep state between calls, such as the preprocessor state of the C++ lexer, so
+ * jobs continue from where the background lexer last stopped even when the main thread has
+ * styled further meanwhile.
+ */
+class BackgroundStyler {
+	std::shared_ptr<ILexer5> instance;
+	std::shared_ptr<StyleJob> job;
+	std::vector<std::function<void(ILexer5 *)>> pendingChanges;
+	Sci::Position lexedTo;	///< The state of the lexer is valid up to here
+	bool failed;
+
+	bool Busy() const noexcept;
+	void EndJob();
+public:
+	explicit BackgroundStyler(ILexer5 *instance_);
+	// Deleted so BackgroundStyler objects can not be copied.
+	BackgroundStyler(const BackgroundStyler &) = delete;
+	BackgroundStyler(BackgroundStyler &&) = delete;
+	BackgroundStyler &operator=(const BackgroundStyler &) = delete;
+	BackgroundStyler &operator=(BackgroundStyler &&) = delete;
+	~BackgroundStyler();
+
+	bool Running() const noexcept {
+		return job != nullptr;
+	}
+	bool Failed() const noexcept {
+		return failed;
+	}
+	void Configure(std::function<void(ILexer5 *)> change);
+	void Start(const Document *pdoc, Sci::Position start);
+	void Cancel() noexcept;
+	void Invalidate(Sci::Position position) noexcept;
+	bool Publish(Document *pdoc, double secondsAllowed);
+};
+
+}
+
+#endif
@@ -0,0 +1,139 @@
+// Scintilla source code edit control
+/** @file ByteSearch.cxx
+ ** Vectorised scanning for the positions where a literal search may match.
+ ** Uses SSE2 or AVX2 (selected at run time) on x86 with g++ or clang and a scalar
+ ** loop elsewhere.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstddef>
+
+#include "ByteSearch.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+#define BYTESEARCH_SSE2
+#include <emmintrin.h>
+#if defined(__x86_64__) || defined(__i386__)
+#define BYTESEARCH_AVX2
+#include <immintrin.h>
+#endif
+#endif
+
+using namespace Scintilla::Internal;
+
+namespace {
+
+constexpr bool IsASCIILetter(unsigned char ch) noexcept {
+	return ((ch >= 'a') && (ch <= 'z')) || ((ch >= 'A') && (ch <= 'Z'));
+}
+
+constexpr unsigned char FoldFor(unsigned char ch, bool asciiCaseInsensitive) noexcept {
+	return (asciiCaseInsensitive && IsASCIILetter(ch)) ? 0x20 : 0;
+}
+
+ptrdiff_t FindCandidateScalar(const CandidateFilter &filter, const char *data, size_t start, size_t length) noexcept {
+	const unsigned char *bytes = reinterpret_cast<const unsigned char *>(data);
+	for (size_t i = start; i < length; i++) {
+		if (filter.Matches(bytes[i], bytes[i + filter.lastOffset])) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+#ifdef BYTESEARCH_SSE2
+
+ptrdiff_t FindCandidateSSE2(const CandidateFilter &filter, const char *data, size_t length) noexcept {
+	const __m128i first = _mm_set1_epi8(static_cast<char>(filter.first));
+	const __m128i firstFold = _mm_set1_epi8(static_cast<char>(filter.firstFold));
+	const __m128i last = _mm_set1_epi8(static_cast<char>(filter.last));
+	const __m128i lastFold = _mm_set1_epi8(static_cast<char>(filter.lastFold));
+	// UTF-8 lead bytes 0xC2..0xFF are -62..-1 as signed bytes
+	const __m128i beforeLead = _mm_set1_epi8(-63);
+	const __m128i zero = _mm_setzero_si128();
+	size_t i = 0;
+	for (; i + 16 <= length; i += 16) {
+		const __m128i blockFirst = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+		__m128i eq = _mm_cmpeq_epi8(_mm_or_si128(blockFirst, firstFold), first);
+		if (filter.lastOffset) {
+			const __m128i blockLast = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + filter.lastOffset));
+			eq = _mm_and_si128(eq, _mm_cmpeq_epi8(_mm_or_si128(blockLast, lastFold), last));
+		}
+		if (filter.utf8Leads) {
+			eq = _mm_or_si128(eq, _mm_and_si128(_mm_cmpgt_epi8(blockFirst, beforeLead),
+				_mm_cmplt_epi8(blockFirst, zero)));
+		}
+		const unsigned int mask = _mm_movemask_epi8(eq);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	return FindCandidateScalar(filter, data, i, length);
+}
+
+#endif
+
+#ifdef BYTESEARCH_AVX2
+
+__attribute__((target("avx2")))
+ptrdiff_t FindCandidateAVX2(const CandidateFilter &filter, const char *data, size_t length) noexcept {
+	const __m256i first = _mm256_set1_epi8(static_cast<char>(filter.first));
+	const __m256i firstFold = _mm256_set1_epi8(static_cast<char>(filter.firstFold));
+	const __m256i last = _mm256_set1_epi8(static_cast<char>(filter.last));
+	const __m256i lastFold = _mm256_set1_epi8(static_cast<char>(filter.lastFold));
+	const __m256i beforeLead = _mm256_set1_epi8(-63);
+	const __m256i zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for (; i + 32 <= length; i += 32) {
+		const __m256i blockFirst = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+		__m256i eq = _mm256_cmpeq_epi8(_mm256_or_si256(blockFirst, firstFold), first);
+		if (filter.lastOffset) {
+			const __m256i blockLast = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + filter.lastOffset));
+			eq = _mm256_and_si256(eq, _mm256_cmpeq_epi8(_mm256_or_si256(blockLast, lastFold), last));
+		}
+		if (filter.utf8Leads) {
+			eq = _mm256_or_si256(eq, _mm256_and_si256(_mm256_cmpgt_epi8(blockFirst, beforeLead),
+				_mm256_cmpgt_epi8(zero, blockFirst)));
+		}
+		const unsigned int mask = _mm256_movemask_epi8(eq);
+		if (mask) {
+			return i + __builtin_ctz(mask);
+		}
+	}
+	const ptrdiff_t found = FindCandidateSSE2(filter, data + i, length - i);
+	return (found < 0) ? found : static_cast<ptrdiff_t>(i) + found;
+}
+
+bool HaveAVX2() noexcept {
+	static const bool haveAVX2 = __builtin_cpu_supports("avx2");
+	return haveAVX2;
+}
+
+#endif
+
+}
+
+CandidateFilter::CandidateFilter(const char *search, size_t length, bool asciiCaseInsensitive, bool utf8Leads_) noexcept :
+	utf8Leads(utf8Leads_) {
+	if (length == 0) {
+		return;
+	}
+	firstFold = FoldFor(search[0], asciiCaseInsensitive);
+	first = search[0] | firstFold;
+	lastOffset = length - 1;
+	lastFold = FoldFor(search[lastOffset], asciiCaseInsensitive);
+	last = search[lastOffset] | lastFold;
+}
+
+ptrdiff_t Scintilla::Internal::FindCandidate(const CandidateFilter &filter, const char *data, size_t length) noexcept {
+#if defined(BYTESEARCH_AVX2)
+	if (HaveAVX2()) {
+		return FindCandidateAVX2(filter, data, length);
+	}
+#endif
+#if defined(BYTESEARCH_SSE2)
+	return FindCandidateSSE2(filter, data, length);
+#else
+	return FindCandidateScalar(filter, data, 0, length);
+#endif
+}
@@ -0,0 +1,43 @@
+// Scintilla source code edit control
+/** @file ByteSearch.h
+ ** Vectorised scanning for the positions where a literal search may match.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef BYTESEARCH_H
+#define BYTESEARCH_H
+
+namespace Scintilla::Internal {
+
+/**
+ * Describes the bytes that can start a match: a candidate position has a byte that equals
+ * first after or-ing firstFold and, when lastOffset is not 0, a byte lastOffset further on
+ * that equals last after or-ing lastFold. Folding with 0x20 lower-cases ASCII letters so it
+ * is only set for letters. When utf8Leads is set, any UTF-8 lead byte of a multi-byte
+ * character is also a candidate as it may case-fold to the search text.
+ */
+struct CandidateFilter {
+	unsigned char first = 0;
+	unsigned char firstFold = 0;
+	unsigned char last = 0;
+	unsigned char lastFold = 0;
+	size_t lastOffset = 0;
+	bool utf8Leads = false;
+
+	CandidateFilter(const char *search, size_t length, bool asciiCaseInsensitive, bool utf8Leads_) noexcept;
+
+	bool Matches(unsigned char chFirst, unsigned char chLast) const noexcept {
+		return (((chFirst | firstFold) == first) && ((chLast | lastFold) == last)) ||
+			(utf8Leads && chFirst >= 0xC2);
+	}
+};
+
+/**
+ * Returns the index of the first candidate in data[0, length) or -1 when there is none.
+ * Bytes up to data[length - 1 + filter.lastOffset] must be readable.
+ */
+ptrdiff_t FindCandidate(const CandidateFilter &filter, const char *data, size_t length) noexcept;
+
+}
+
+#endif
@@ -20,7 +20,12 @@
 #include <optional>
 #include <algorithm>
 #include <memory>
+#include <functional>
 #include <chrono>
+#include <deque>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #ifndef NO_CXX11_REGEX
 #include <regex>
@@ -43,7 +48,10 @@
 #include "CharClassify.h"
 #include "Decoration.h"
 #include "CaseFolder.h"
+#include "ByteSearch.h"
+#include "MultiFind.h"
 #include "Document.h"
+#include "BackgroundStyler.h"
 #include "RESearch.h"
 #include "UniConversion.h"
 #include "ElapsedPeriod.h"
@@ -57,6 +65,8 @@ LexInterface::LexInterface(Document *pdoc_) noexcept : pdoc(pdoc_), performingSt
 LexInterface::~LexInterface() noexcept = default;
 
 void LexInterface::SetInstance(ILexer5 *instance_) {
+	// The background lexer has to be of the same language so is set after this
+	background.reset();
 	instance.reset(instance_);
 	pdoc->LexerChanged();
 }
@@ -89,6 +99,65 @@ void LexInterface::Colourise(Sci::Position start, Sci::Position end) {
 	}
 }
 
+// The background lexer is given a copy of the properties of the main lexer and is kept in
+// step with it by the LexState methods that change lexer settings.
+void LexInterface::SetBackgroundInstance(ILexer5 *instance_) {
+	background.reset();
+	if (instance_) {
+		background = std::make_unique<BackgroundStyler>(instance_);
+		if (instance) {
+			std::string_view names = instance->PropertyNames();
+			while (!names.empty()) {
+				const size_t endName = names.find('\n');
+				const std::string name(names.substr(0, endName));
+				const char *value = instance->PropertyGet(name.c_str());
+				if (!name.empty() && value && *value) {
+					instance_->PropertySet(name.c_str(), value);
+				}
+				names.remove_prefix((endName == std::string_view::npos) ? names.length() : endName + 1);
+			}
+		}
+	}
+}
+
+// Start styling the rest of the document on the worker thread if that is possible.
+// Returns true when the background styler is working and PublishBackground should be
+// called periodically.
+bool LexInterface::StyleInBackground() {
+	if (!background || !instance || performingStyle) {
+		return false;
+	}
+	if (background->Failed()) {
+		background.reset();
+		return false;
+	}
+	if ((pdoc->dbcsCodePage && (pdoc->dbcsCodePage != CpUtf8)) ||
+		(pdoc->GetLineEndTypesActive() != LineEndType::Default)) {
+		return false;
+	}
+	if (!background->Running()) {
+		const Sci::Position start = pdoc->LineStart(pdoc->SciLineFromPosition(pdoc->GetEndStyled()));
+		if (start >= pdoc->Length()) {
+			return false;
+		}
+		background->Start(pdoc, start);
+	}
+	return true;
+}
+
+bool LexInterface::PublishBackground(double secondsAllowed) {
+	if (!background || performingStyle) {
+		return false;
+	}
+	return background->Publish(pdoc, secondsAllowed);
+}
+
+void LexInterface::InvalidateBackground(Sci::Position position) noexcept {
+	if (background) {
+		background->Invalidate(position);
+	}
+}
+
 LineEndType LexInterface::LineEndTypesSupported() {
 	if (instance) {
 		return static_cast<LineEndType>(instance->LineEndTypesSupported());
@@ -139,6 +208,7 @@ Document::Document(DocumentOption options) :
 	lineEndBitSet = LineEndType::Default;
 	endStyled = 0;
 	styleClock = 0;
+	modificationVersion = 0;
 	enteredModification = 0;
 	enteredStyling = 0;
 	enteredReadOnlyCount = 0;
@@ -1207,8 +1277,12 @@ EncodingFamily Document::CodePageFamily() const noexcept {
 }
 
 void Document::ModifiedAt(Sci::Position pos) noexcept {
+	// Styling performed in the background for the previous text is now stale
+	modificationVersion++;
 	if (endStyled > pos)
 		endStyled = pos;
+	if (pli)
+		pli->InvalidateBackground(pos);
 }
 
 void Document::CheckReadOnly() {
@@ -1318,6 +1392,81 @@ void Document::ChangeInsertion(const char *s, Sci::Position length) {
 	insertion.assign(s, length);
 }
 
+/**
+ * Apply a sorted list of non-overlapping replacements as a single undo action.
+ * The buffer is modified front to back so the gap only moves forward and watchers
+ * are notified once for the whole span covered by the replacements instead of once
+ * per edit. Returns the length of that span after replacement or -1 on failure.
+ */
+Sci::Position Document::ReplaceRanges(const TextReplacement *replacements, size_t count) {
+	if (count == 0) {
+		return 0;
+	}
+	Sci::Position previousEnd = 0;
+	for (size_t i = 0; i < count; i++) {
+		const TextReplacement &tr = replacements[i];
+		if ((tr.position < previousEnd) || (tr.lengthDeleted < 0) || (tr.lengthInserted < 0) ||
+			(tr.lengthInserted > 0 && !tr.text))
+			return -1;
+		previousEnd = tr.position + tr.lengthDeleted;
+	}
+	if (previousEnd > LengthNoExcept())
+		return -1;
+	CheckReadOnly();
+	if (cb.IsReadOnly() || (enteredModification != 0)) {
+		return -1;
+	}
+	enteredModification++;
+	const Sci::Position spanStart = replacements[0].position;
+	const Sci::Position spanLengthBefore = previousEnd - spanStart;
+	const Sci::Line spanLinesBefore = SciLineFromPosition(previousEnd) - SciLineFromPosition(spanStart);
+	NotifyModified(
+		DocModification(
+			ModificationFlags::BeforeDelete | ModificationFlags::User,
+			spanStart, spanLengthBefore,
+			0, nullptr));
+	const bool startSavePoint = cb.IsSavePoint();
+	bool startSequence = false;
+	Sci::Position offset = 0;
+	BeginUndoAction();
+	for (size_t i = 0; i < count; i++) {
+		const TextReplacement &tr = replacements[i];
+		const Sci::Position position = tr.position + offset;
+		bool startSequenceEdit = false;
+		if (tr.lengthDeleted > 0) {
+			cb.DeleteChars(position, tr.lengthDeleted, startSequenceEdit);
+			decorations->DeleteRange(position, tr.lengthDeleted);
+			startSequence = startSequence || startSequenceEdit;
+		}
+		if (tr.lengthInserted > 0) {
+			cb.InsertString(position, tr.text, tr.lengthInserted, startSequenceEdit);
+			decorations->InsertSpace(position, tr.lengthInserted);
+			startSequence = startSequence || startSequenceEdit;
+		}
+		offset += tr.lengthInserted - tr.lengthDeleted;
+	}
+	EndUndoAction();
+	if (startSavePoint && cb.IsCollectingUndo())
+		NotifySavePoint(false);
+	const Sci::Position spanLengthAfter = spanLengthBefore + offset;
+	const Sci::Line spanLinesAfter = SciLineFromPosition(spanStart + spanLengthAfter) - SciLineFromPosition(spanStart);
+	ModifiedAt(spanStart);
+	// Decorations were already moved per edit so only tell watchers about the whole span
+	NotifyWatchers(
+		DocModification(
+			ModificationFlags::DeleteText | ModificationFlags::User |
+			(startSequence ? ModificationFlags::StartAction : ModificationFlags::None),
+			spanStart, spanLengthBefore,
+			-spanLinesBefore, nullptr));
+	NotifyWatchers(
+		DocModification(
+			ModificationFlags::InsertText | ModificationFlags::User,
+			spanStart, spanLengthAfter,
+			spanLinesAfter, nullptr));
+	enteredModification--;
+	return spanLengthAfter;
+}
+
 int SCI_METHOD Document::AddData(const char *data, Sci_Position length) {
 	try {
 		const Sci::Position position = Length();
@@ -2028,20 +2177,29 @@ Document::CharacterExtracted Document::ExtractCharacter(Sci::Position position)
 
 namespace {
 
-// Equivalent of memchr over the split view
-ptrdiff_t SplitFindChar(const SplitView &view, size_t start, size_t length, int ch) noexcept {
-	size_t range1Length = 0;
-	if (start < view.length1) {
-		range1Length = std::min(length, view.length1 - start);
-		const char *match = static_cast<const char *>(memchr(view.segment1 + start, ch, range1Length));
-		if (match) {
-			return match - view.segment1;
+// Find the first position in [start, end) accepted by filter, using the vectorised
+// scanner over each contiguous segment and checking positions straddling the gap singly.
+ptrdiff_t SplitFindCandidate(const SplitView &view, size_t start, size_t end, const CandidateFilter &filter) noexcept {
+	end = std::min(end, view.length - std::min(view.length, filter.lastOffset));
+	const size_t end1 = std::min(end, view.length1 - std::min(view.length1, filter.lastOffset));
+	if (start < end1) {
+		const ptrdiff_t found = FindCandidate(filter, view.segment1 + start, end1 - start);
+		if (found >= 0) {
+			return start + found;
 		}
-		start += range1Length;
+		start = end1;
 	}
-	const char *match2 = static_cast<const char *>(memchr(view.segment2 + start, ch, length - range1Length));
-	if (match2) {
-		return match2 - view.segment2;
+	const size_t endStraddle = std::min(end, view.length1);
+	for (; start < endStraddle; start++) {
+		if (filter.Matches(view.CharAt(start), view.CharAt(start + filter.lastOffset))) {
+			return start;
+		}
+	}
+	if (start < end) {
+		const ptrdiff_t found = FindCandidate(filter, view.segment2 + start, end - start);
+		if (found >= 0) {
+			return start + found;
+		}
 	}
 	return -1;
 }
@@ -2060,6 +2218,61 @@ bool SplitMatch(const SplitView &view, size_t start, std::string_view text) noex
 
 }
 
+/**
+ * Find all occurrences of any of searches between minPos and maxPos in one pass.
+ * Only ASCII letters are folded when not matching case and regular expressions are not
+ * supported. Start and end of each match are appended to matches ordered by start and
+ * then by decreasing length. Overlapping matches are all reported.
+ * Returns the number of matches.
+ */
+Sci::Position Document::FindMultiple(Sci::Position minPos, Sci::Position maxPos, const std::vector<std::string_view> &searches,
+		FindOption flags, std::vector<Sci::Position> &matches) {
+	const bool caseSensitive = FlagSet(flags, FindOption::MatchCase);
+	const bool word = FlagSet(flags, FindOption::WholeWord);
+	const bool wordStart = FlagSet(flags, FindOption::WordStart);
+	const MultiStringMatcher matcher(searches, !caseSensitive);
+	minPos = std::clamp<Sci::Position>(minPos, 0, LengthNoExcept());
+	maxPos = std::clamp<Sci::Position>(maxPos, minPos, LengthNoExcept());
+	if (matcher.Empty()) {
+		return 0;
+	}
+	const bool checkCharacterStart = dbcsCodePage && (CpUtf8 != dbcsCodePage);
+	std::vector<Sci::Position> found;
+	const SplitView cbView = cb.AllView();
+	int state = MultiStringMatcher::start;
+	for (Sci::Position pos = minPos; pos < maxPos; pos++) {
+		state = matcher.Next(state, cbView.CharAt(pos));
+		for (int output = matcher.FirstOutput(state); output >= 0; output = matcher.NextOutput(output)) {
+			const Sci::Position length = matcher.PatternLength(output);
+			const Sci::Position start = pos + 1 - length;
+			if (start >= minPos &&
+				(!checkCharacterStart || MovePositionOutsideChar(start, 1, false) == start) &&
+				MatchesWordOptions(word, wordStart, start, length)) {
+				found.push_back(start);
+				found.push_back(pos + 1);
+			}
+		}
+	}
+
+	// Matches were found in order of their end, sort them by start
+	const size_t count = found.size() / 2;
+	std::vector<size_t> order(count);
+	for (size_t i = 0; i < count; i++) {
+		order[i] = i;
+	}
+	std::stable_sort(order.begin(), order.end(), [&found](size_t a, size_t b) noexcept {
+		if (found[a * 2] != found[b * 2])
+			return found[a * 2] < found[b * 2];
+		return found[a * 2 + 1] > found[b * 2 + 1];
+	});
+	matches.reserve(matches.size() + found.size());
+	for (const size_t i : order) {
+		matches.push_back(found[i * 2]);
+		matches.push_back(found[i * 2 + 1]);
+	}
+	return count;
+}
+
 /**
  * Find text in document, supporting both forward and backward
  * searches (just pass minPos > maxPos to do a backward search)
@@ -2102,11 +2315,13 @@ Sci::Position Document::FindText(Sci::Position minPos, Sci::Position maxPos, con
 			const unsigned char charStartSearch =  search[0];
 			if (forward && ((0 == dbcsCodePage) || (CpUtf8 == dbcsCodePage && !UTF8IsTrailByte(charStartSearch)))) {
 				// This is a fast case where there is no need to test byte values to iterate
-				// so becomes the equivalent of a memchr+memcmp loop.
+				// so candidates with matching first and last bytes are found by a vectorised
+				// scan and then compared fully.
 				// UTF-8 search will not be self-synchronizing when starts with trail byte
 				const std::string_view suffix(search + 1, lengthFind - 1);
+				const CandidateFilter filter(search, lengthFind, false, false);
 				while (pos < endSearch) {
-					pos = SplitFindChar(cbView, pos, limitPos - pos, charStartSearch);
+					pos = SplitFindCandidate(cbView, pos, endSearch, filter);
 					if (pos < 0) {
 						break;
 					}
@@ -2146,7 +2361,18 @@ Sci::Position Document::FindText(Sci::Position minPos, Sci::Position maxPos, con
 			std::vector<char> searchThing((lengthFind+1) * UTF8MaxBytes * maxFoldingExpansion + 1);
 			const size_t lenSearch =
 				pcf->Fold(&searchThing[0], searchThing.size(), search, lengthFind);
+			// When the folded search starts with an ASCII character, a match can only start at
+			// that character in either case or at a multi-byte character that folds to it, so
+			// skip to those positions before comparing character by character.
+			const bool skipToCandidates = forward && UTF8IsAscii(searchThing[0]);
+			const CandidateFilter filter(&searchThing[0], 1, true, true);
 			while (forward ? (pos < endPos) : (pos >= endPos)) {
+				if (skipToCandidates) {
+					pos = SplitFindCandidate(cbView, pos, endPos, filter);
+					if (pos < 0) {
+						break;
+					}
+				}
 				int widthFirstCharacter = 0;
 				Sci::Position posIndexDocument = pos;
 				size_t indexSearch = 0;
@@ -2616,6 +2842,10 @@ void Document::NotifyModified(DocModification mh) {
 	} else if (FlagSet(mh.modificationType, ModificationFlags::DeleteText)) {
 		decorations->DeleteRange(mh.position, mh.length);
 	}
+	NotifyWatchers(mh);
+}
+
+void Document::NotifyWatchers(DocModification mh) {
 	for (const WatcherWithUserData &watcher : watchers) {
 		watcher.watcher->NotifyModified(this, mh, watcher.userData);
 	}
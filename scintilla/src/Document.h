@@ -13,6 +13,7 @@ namespace Scintilla::Internal {
 class DocWatcher;
 class DocModification;
 class Document;
+class BackgroundStyler;
 class LineMarkers;
 class LineLevels;
 class LineState;
@@ -187,6 +188,7 @@ protected:
 	Document *pdoc;
 	LexerInstance instance;
 	bool performingStyle;	///< Prevent reentrance
+	std::unique_ptr<BackgroundStyler> background;	///< Optional second lexer on a worker thread
 public:
 	explicit LexInterface(Document *pdoc_) noexcept;
 	// Deleted so LexInterface objects can not be copied.
@@ -197,6 +199,10 @@ public:
 	virtual ~LexInterface() noexcept;
 	void SetInstance(ILexer5 *instance_);
 	void Colourise(Sci::Position start, Sci::Position end);
+	void SetBackgroundInstance(ILexer5 *instance_);
+	bool StyleInBackground();
+	bool PublishBackground(double secondsAllowed);
+	void InvalidateBackground(Sci::Position position) noexcept;
 	virtual Scintilla::LineEndType LineEndTypesSupported();
 	bool UseContainerLexing() const noexcept;
 };
@@ -205,6 +211,18 @@ struct RegexError : public std::runtime_error {
 	RegexError() : std::runtime_error("regex failure") {}
 };
 
+/**
+ * One edit of a bulk replacement: lengthDeleted bytes at position are replaced by
+ * lengthInserted bytes of text. Positions refer to the document before any of the
+ * edits of the same batch are applied.
+ */
+struct TextReplacement {
+	Sci::Position position;
+	Sci::Position lengthDeleted;
+	const char *text;
+	Sci::Position lengthInserted;
+};
+
 /**
  * The ActionDuration class stores the average time taken for some action such as styling or
  * wrapping a line. It is used to decide how many repetitions of that action can be performed
@@ -251,6 +269,7 @@ private:
 	std::unique_ptr<CaseFolder> pcf;
 	Sci::Position endStyled;
 	int styleClock;
+	int modificationVersion;
 	int enteredModification;
 	int enteredStyling;
 	int enteredReadOnlyCount;
@@ -361,6 +380,7 @@ public:
 	bool DeleteChars(Sci::Position pos, Sci::Position len);
 	Sci::Position InsertString(Sci::Position position, const char *s, Sci::Position insertLength);
 	void ChangeInsertion(const char *s, Sci::Position length);
+	Sci::Position ReplaceRanges(const TextReplacement *replacements, size_t count);
 	int SCI_METHOD AddData(const char *data, Sci_Position length) override;
 	void * SCI_METHOD ConvertToDocument() override;
 	Sci::Position Undo();
@@ -460,6 +480,8 @@ public:
 	bool HasCaseFolder() const noexcept;
 	void SetCaseFolder(std::unique_ptr<CaseFolder> pcf_) noexcept;
 	Sci::Position FindText(Sci::Position minPos, Sci::Position maxPos, const char *search, Scintilla::FindOption flags, Sci::Position *length);
+	Sci::Position FindMultiple(Sci::Position minPos, Sci::Position maxPos, const std::vector<std::string_view> &searches,
+		Scintilla::FindOption flags, std::vector<Sci::Position> &matches);
 	const char *SubstituteByPosition(const char *text, Sci::Position *length);
 	Scintilla::LineCharacterIndexType LineCharacterIndex() const noexcept;
 	void AllocateLineCharacterIndex(Scintilla::LineCharacterIndexType lineCharacterIndex);
@@ -480,6 +502,7 @@ public:
 	void StyleToAdjustingLineDuration(Sci::Position pos);
 	void LexerChanged();
 	int GetStyleClock() const noexcept { return styleClock; }
+	int ModificationVersion() const noexcept { return modificationVersion; }
 	void IncrementStyleClock() noexcept;
 	void SCI_METHOD DecorationSetCurrentIndicator(int indicator) override;
 	void SCI_METHOD DecorationFillRange(Sci_Position position, int value, Sci_Position fillLength) override;
@@ -527,6 +550,7 @@ private:
 	void NotifyModifyAttempt();
 	void NotifySavePoint(bool atSavePoint);
 	void NotifyModified(DocModification mh);
+	void NotifyWatchers(DocModification mh);
 };
 
 class UndoGroup {
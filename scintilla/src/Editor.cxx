@@ -4117,6 +4117,25 @@ Sci::Position Editor::FindText(
 	}
 }
 
+Sci::Position Editor::FindMultiple(
+    uptr_t wParam,		///< Search modes : @c FindOption::MatchCase, @c FindOption::WholeWord or @c FindOption::WordStart.
+    sptr_t lParam) {	///< @c Sci_TextToFindMultiple structure: The texts to search for and where to store matches.
+
+	TextToFindMultiple *ft = static_cast<TextToFindMultiple *>(PtrFromSPtr(lParam));
+	std::vector<std::string_view> searches;
+	for (Sci::Position i = 0; i < ft->count; i++) {
+		searches.emplace_back(ft->texts[i]);
+	}
+	std::vector<Sci::Position> matches;
+	const Sci::Position count = pdoc->FindMultiple(ft->cpMin, ft->cpMax, searches,
+		static_cast<FindOption>(wParam), matches);
+	if (ft->matches) {
+		const size_t stored = std::min<size_t>(matches.size(), std::max<Sci::Position>(ft->maxMatches, 0) * 2);
+		std::copy(matches.begin(), matches.begin() + stored, ft->matches);
+	}
+	return count;
+}
+
 /**
  * Relocatable search support : Searches relative to current selection
  * point and sets the selection to the found text range with
@@ -5062,6 +5081,13 @@ void Editor::TickFor(TickReason reason) {
 			}
 			FineTickerCancel(TickReason::dwell);
 			break;
+		case TickReason::style:
+			// Publish results of background styling until it is done or discarded
+			if (!pdoc->GetLexInterface() || !pdoc->GetLexInterface()->PublishBackground(0.01)) {
+				FineTickerCancel(TickReason::style);
+				StartIdleStyling(false);
+			}
+			break;
 		default:
 			// tickPlatform handled by subclass
 			break;
@@ -5186,6 +5212,15 @@ void Editor::IdleStyle() {
 	const Sci::Position posAfterArea = PositionAfterArea(GetClientRectangle());
 	const Sci::Position endGoal = (idleStyling >= IdleStyling::AfterVisible) ?
 		pdoc->Length() : posAfterArea;
+	LexInterface *pli = pdoc->GetLexInterface();
+	if ((endGoal > posAfterArea) && (pdoc->GetEndStyled() >= posAfterArea) && pli && pli->StyleInBackground()) {
+		// Visible area is done, leave the rest to the worker thread
+		needIdleStyling = false;
+		if (!FineTickerRunning(TickReason::style)) {
+			FineTickerStart(TickReason::style, 20, 5);
+		}
+		return;
+	}
 	const Sci::Position posAfterMax = PositionAfterMaxStyling(endGoal, false);
 	pdoc->StyleToAdjustingLineDuration(posAfterMax);
 	if (pdoc->GetEndStyled() >= endGoal) {
@@ -5668,6 +5703,23 @@ Sci::Position Editor::ReplaceTarget(bool replacePatterns, const char *text, Sci:
 	return length;
 }
 
+Sci::Position Editor::ReplaceRanges(const ReplaceRange *ranges, Sci::Position count) {
+	if (count <= 0)
+		return 0;
+	std::vector<TextReplacement> replacements;
+	replacements.reserve(count);
+	for (Sci::Position i = 0; i < count; i++) {
+		const ReplaceRange &rr = ranges[i];
+		replacements.push_back({ rr.cpMin, rr.cpMax - rr.cpMin, rr.text, rr.length });
+	}
+	const Sci::Position lengthSpan = pdoc->ReplaceRanges(replacements.data(), replacements.size());
+	if (lengthSpan >= 0) {
+		targetRange.start.SetPosition(ranges[0].cpMin);
+		targetRange.end.SetPosition(ranges[0].cpMin + lengthSpan);
+	}
+	return lengthSpan;
+}
+
 bool Editor::IsUnicodeMode() const noexcept {
 	return pdoc && (CpUtf8 == pdoc->dbcsCodePage);
 }
@@ -6135,6 +6187,9 @@ sptr_t Editor::WndProc(Message iMessage, uptr_t wParam, sptr_t lParam) {
 		PLATFORM_ASSERT(lParam);
 		return ReplaceTarget(true, ConstCharPtrFromSPtr(lParam), PositionFromUPtr(wParam));
 
+	case Message::ReplaceRanges:
+		return ReplaceRanges(static_cast<const ReplaceRange *>(PtrFromSPtr(lParam)), PositionFromUPtr(wParam));
+
 	case Message::SearchInTarget:
 		PLATFORM_ASSERT(lParam);
 		return SearchInTarget(ConstCharPtrFromSPtr(lParam), PositionFromUPtr(wParam));
@@ -6218,6 +6273,9 @@ sptr_t Editor::WndProc(Message iMessage, uptr_t wParam, sptr_t lParam) {
 	case Message::FindText:
 		return FindText(wParam, lParam);
 
+	case Message::FindMultiple:
+		return FindMultiple(wParam, lParam);
+
 	case Message::GetTextRange: {
 			if (lParam == 0)
 				return 0;
@@ -502,6 +502,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 
 	virtual std::unique_ptr<CaseFolder> CaseFolderForEncoding();
 	Sci::Position FindText(Scintilla::uptr_t wParam, Scintilla::sptr_t lParam);
+	Sci::Position FindMultiple(Scintilla::uptr_t wParam, Scintilla::sptr_t lParam);
 	void SearchAnchor();
 	Sci::Position SearchText(Scintilla::Message iMessage, Scintilla::uptr_t wParam, Scintilla::sptr_t lParam);
 	Sci::Position SearchInTarget(const char *text, Sci::Position length);
@@ -534,7 +535,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 	void ButtonUpWithModifiers(Point pt, unsigned int curTime, Scintilla::KeyMod modifiers);
 
 	bool Idle();
-	enum class TickReason { caret, scroll, widen, dwell, platform };
+	enum class TickReason { caret, scroll, widen, dwell, style, platform };
 	virtual void TickFor(TickReason reason);
 	virtual bool FineTickerRunning(TickReason reason);
 	virtual void FineTickerStart(TickReason reason, int millis, int tolerance);
@@ -581,6 +582,7 @@ protected:	// ScintillaBase subclass needs access to much of Editor
 
 	Sci::Position GetTag(char *tagValue, int tagNumber);
 	Sci::Position ReplaceTarget(bool replacePatterns, const char *text, Sci::Position length=-1);
+	Sci::Position ReplaceRanges(const Scintilla::ReplaceRange *ranges, Sci::Position count);
 
 	bool PositionIsHotspot(Sci::Position position) const;
 	bool PointIsHotspot(Point pt);
@@ -0,0 +1,96 @@
+// Scintilla source code edit control
+/** @file MultiFind.cxx
+ ** Aho-Corasick automaton to find several literal strings in one pass.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#include <cstddef>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+
+#include "CharacterType.h"
+#include "MultiFind.h"
+
+using namespace Scintilla::Internal;
+
+MultiStringMatcher::MultiStringMatcher(const std::vector<std::string_view> &patterns_, bool caseInsensitive) :
+	classOfByte{}, classes(1) {
+	for (const std::string_view pattern : patterns_) {
+		if (pattern.empty())
+			continue;
+		std::string folded(pattern);
+		if (caseInsensitive) {
+			for (char &ch : folded) {
+				ch = MakeLowerCase(ch);
+			}
+		}
+		patterns.push_back(folded);
+	}
+
+	// Bytes occurring in patterns get their own column, all others share column 0
+	for (const std::string &pattern : patterns) {
+		for (const char ch : pattern) {
+			const unsigned char uch = ch;
+			if (!classOfByte[uch]) {
+				classOfByte[uch] = static_cast<unsigned char>(classes++);
+			}
+		}
+	}
+	if (caseInsensitive) {
+		for (int ch = 'A'; ch <= 'Z'; ch++) {
+			classOfByte[ch] = classOfByte[MakeLowerCase(ch)];
+		}
+	}
+
+	// Build the trie
+	transitions.assign(classes, -1);
+	patternOfState.push_back(-1);
+	for (size_t index = 0; index < patterns.size(); index++) {
+		int state = start;
+		for (const char ch : patterns[index]) {
+			const size_t cell = state * classes + classOfByte[static_cast<unsigned char>(ch)];
+			if (transitions[cell] < 0) {
+				transitions[cell] = static_cast<int>(patternOfState.size());
+				transitions.resize(transitions.size() + classes, -1);
+				patternOfState.push_back(-1);
+			}
+			state = transitions[cell];
+		}
+		if (patternOfState[state] < 0) {
+			patternOfState[state] = static_cast<int>(index);
+		}
+	}
+
+	// Breadth first computation of failure links, completing the transition table and
+	// linking each state to the nearest proper suffix state that ends a pattern.
+	std::vector<int> failure(patternOfState.size(), start);
+	outputLink.assign(patternOfState.size(), -1);
+	std::deque<int> queue;
+	for (size_t cls = 0; cls < classes; cls++) {
+		int &next = transitions[cls];
+		if (next < 0) {
+			next = start;
+		} else {
+			queue.push_back(next);
+		}
+	}
+	while (!queue.empty()) {
+		const int state = queue.front();
+		queue.pop_front();
+		const int fail = failure[state];
+		outputLink[state] = (patternOfState[fail] >= 0) ? fail : outputLink[fail];
+		for (size_t cls = 0; cls < classes; cls++) {
+			int &next = transitions[state * classes + cls];
+			const int nextOfFail = transitions[fail * classes + cls];
+			if (next < 0) {
+				next = nextOfFail;
+			} else {
+				failure[next] = nextOfFail;
+				queue.push_back(next);
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+// Scintilla source code edit control
+/** @file MultiFind.h
+ ** Aho-Corasick automaton to find several literal strings in one pass.
+ **/
+// The License.txt file describes the conditions under which this software may be distributed.
+
+#ifndef MULTIFIND_H
+#define MULTIFIND_H
+
+namespace Scintilla::Internal {
+
+/**
+ * Matches a set of byte strings at once. The automaton is complete so Next() is a single
+ * table lookup, with the bytes that do not occur in any pattern sharing one column.
+ * Case insensitive matching folds ASCII letters only.
+ */
+class MultiStringMatcher {
+	std::vector<std::string> patterns;
+	unsigned char classOfByte[256];
+	size_t classes;
+	std::vector<int> transitions;	// states * classes
+	std::vector<int> patternOfState;	// pattern ending at state or -1
+	std::vector<int> outputLink;	// next state on suffix chain with a pattern or -1
+public:
+	MultiStringMatcher(const std::vector<std::string_view> &patterns_, bool caseInsensitive);
+
+	static constexpr int start = 0;
+
+	int Next(int state, unsigned char ch) const noexcept {
+		return transitions[state * classes + classOfByte[ch]];
+	}
+	// First pattern ending at state or -1; further ones are found with NextOutput.
+	int FirstOutput(int state) const noexcept {
+		return (patternOfState[state] >= 0) ? state : outputLink[state];
+	}
+	int NextOutput(int outputState) const noexcept {
+		return outputLink[outputState];
+	}
+	size_t PatternLength(int outputState) const noexcept {
+		return patterns[patternOfState[outputState]].length();
+	}
+	bool Empty() const noexcept {
+		return patterns.empty();
+	}
+};
+
+}
+
+#endif
@@ -20,6 +20,7 @@
 #include <optional>
 #include <algorithm>
 #include <memory>
+#include <functional>
 
 #include "ScintillaTypes.h"
 #include "ScintillaMessages.h"
@@ -50,6 +51,7 @@
 #include "Decoration.h"
 #include "CaseFolder.h"
 #include "Document.h"
+#include "BackgroundStyler.h"
 #include "Selection.h"
 #include "PositionCache.h"
 #include "EditModel.h"
@@ -605,6 +607,11 @@ const char *LexState::DescribeWordListSets() {
 
 void LexState::SetWordList(int n, const char *wl) {
 	if (instance) {
+		if (background) {
+			background->Configure([n, words = std::string(wl)](ILexer5 *lexer) {
+				lexer->WordListSet(n, words.c_str());
+			});
+		}
 		const Sci_Position firstModification = instance->WordListSet(n, wl);
 		if (firstModification >= 0) {
 			pdoc->ModifiedAt(firstModification);
@@ -660,6 +667,11 @@ const char *LexState::DescribeProperty(const char *name) {
 
 void LexState::PropSet(const char *key, const char *val) {
 	if (instance) {
+		if (background) {
+			background->Configure([name = std::string(key), value = std::string(val)](ILexer5 *lexer) {
+				lexer->PropertySet(name.c_str(), value.c_str());
+			});
+		}
 		const Sci_Position firstModification = instance->PropertySet(key, val);
 		if (firstModification >= 0) {
 			pdoc->ModifiedAt(firstModification);
@@ -707,6 +719,11 @@ LineEndType LexState::LineEndTypesSupported() {
 
 int LexState::AllocateSubStyles(int styleBase, int numberStyles) {
 	if (instance) {
+		if (background) {
+			background->Configure([styleBase, numberStyles](ILexer5 *lexer) {
+				lexer->AllocateSubStyles(styleBase, numberStyles);
+			});
+		}
 		return instance->AllocateSubStyles(styleBase, numberStyles);
 	}
 	return -1;
@@ -742,12 +759,22 @@ int LexState::PrimaryStyleFromStyle(int style) {
 
 void LexState::FreeSubStyles() {
 	if (instance) {
+		if (background) {
+			background->Configure([](ILexer5 *lexer) {
+				lexer->FreeSubStyles();
+			});
+		}
 		instance->FreeSubStyles();
 	}
 }
 
 void LexState::SetIdentifiers(int style, const char *identifiers) {
 	if (instance) {
+		if (background) {
+			background->Configure([style, words = std::string(identifiers)](ILexer5 *lexer) {
+				lexer->SetIdentifiers(style, words.c_str());
+			});
+		}
 		instance->SetIdentifiers(style, identifiers);
 		pdoc->ModifiedAt(0);
 	}
@@ -1024,6 +1051,10 @@ sptr_t ScintillaBase::WndProc(Message iMessage, uptr_t wParam, sptr_t lParam) {
 		DocumentLexState()->SetInstance(static_cast<ILexer5 *>(PtrFromSPtr(lParam)));
 		return 0;
 
+	case Message::SetBackgroundLexer:
+		DocumentLexState()->SetBackgroundInstance(static_cast<ILexer5 *>(PtrFromSPtr(lParam)));
+		return 0;
+
 	case Message::Colourise:
 		if (DocumentLexState()->UseContainerLexing()) {
 			pdoc->ModifiedAt(PositionFromUPtr(wParam));
@@ -66,7 +66,85 @@
 
 GeanyBuildInfo build_info = {GEANY_GBG_FT, 0, 0, NULL, GEANY_FILETYPES_NONE, NULL, 0};
 
-static gchar *current_dir_entered = NULL;
+typedef struct BuildJob BuildJob;
+
+/* Build output is parsed on a worker thread, which passes the parsed lines back to the
+ * main loop in batches */
+typedef struct BuildOutput
+{
+	BuildJob *job;
+	GThreadPool *pool;		/* a single thread, so the lines stay in order */
+	GRegex *error_regex;	/* NULL if there is none */
+	gint file_type_id;
+	gchar *dir;				/* UTF-8 build directory */
+	/* worker only */
+	gchar *dir_entered;		/* directory entered by make */
+	GHashTable *real_paths;	/* UTF-8 file name -> locale real path, NULL if not on disk */
+	/* protected by lock */
+	GMutex lock;
+	GPtrArray *lines;		/* parsed BuildOutputLine's */
+	guint flush_source;
+}
+BuildOutput;
+
+typedef struct BuildOutputLine
+{
+	gchar *msg;
+	gint color;
+	gchar *filename;		/* UTF-8, NULL if no error was parsed */
+	gchar *real_path;
+	gint line;				/* -1 if no error was parsed */
+}
+BuildOutputLine;
+
+/* output of the build command */
+typedef struct BuildOutputChunk
+{
+	gchar *text;			/* lines ending with '\n' */
+	gint color;
+}
+BuildOutputChunk;
+
+/* A build command. Build commands run concurrently, but their output is shown one command
+ * after the other in the order they were started, like make --output-sync does. */
+struct BuildJob
+{
+	gchar *cmd;				/* UTF-8 */
+	gchar *dir;				/* UTF-8 working directory */
+	gint file_type_id;
+	GeanyBuildGroup grp;
+	guint cmd_index;
+	GPid pid;
+	BuildOutput *output;	/* NULL unless running */
+	GPtrArray *held_lines;	/* output lines waiting for the output of earlier jobs */
+	gboolean started;
+	gboolean finished;
+	gboolean failed;
+};
+
+/* The rows of the Compiler tab showing the output of a job */
+typedef struct BuildBlock
+{
+	guint first_row;
+	gchar *dir;				/* UTF-8 working directory */
+	gint file_type_id;
+	GeanyBuildGroup grp;
+}
+BuildBlock;
+
+/* The build commands started since the Compiler tab was last cleared for a build */
+static struct
+{
+	GQueue jobs;			/* unfinished jobs, and finished ones whose output is still held */
+	guint n_running;
+	guint n_jobs;
+	guint n_failed;
+	GArray *blocks;			/* BuildBlock's, ordered by first_row */
+}
+build_session = { G_QUEUE_INIT, 0, 0, 0, NULL };
+
+/* 0 for the number of processors */
+static gint build_max_jobs = 0;
 
 typedef struct RunInfo
 {
@@ -158,7 +236,8 @@ static guint build_groups_count[GEANY_GBG_COUNT] = { 3, 4, 2 };
 static guint build_items_count = 9;
 
 static void build_exit_cb(GPid pid, gint status, gpointer user_data);
-static void build_iofunc(GString *string, GIOCondition condition, gpointer data);
+static void build_stdout_func(GString *string, GIOCondition condition, gpointer data);
+static void build_stderr_func(GString *string, GIOCondition condition, gpointer data);
 #ifndef G_OS_WIN32
 static gchar *build_create_shellscript(const gchar *working_dir, const gchar *cmd, gboolean autoclose, GError **error);
 #endif
@@ -170,12 +249,27 @@ static void on_build_next_error(GtkWidget *menuitem, gpointer user_data);
 static void on_build_previous_error(GtkWidget *menuitem, gpointer user_data);
 static void kill_process(GPid *pid);
 static void show_build_result_message(gboolean failure);
-static void process_build_output_line(gchar *msg, gint color);
+static void process_build_output_line(BuildOutputLine *line);
+static BuildOutput *build_output_new(BuildJob *job);
+static void build_output_free(BuildOutput *output, gboolean flush);
+static void build_output_line_free(gpointer data);
+static void build_jobs_update(void);
+static void build_job_free(BuildJob *job);
 static void show_build_commands_dialog(void);
 static void on_build_menu_item(GtkWidget *w, gpointer user_data);
 
 void build_finalize(void)
 {
+	BuildJob *job;
+
+	while ((job = g_queue_pop_head(&build_session.jobs)) != NULL)
+	{
+		if (job->output != NULL)
+			build_output_free(job->output, FALSE);
+		build_job_free(job);
+	}
+	if (build_session.blocks != NULL)
+		g_array_free(build_session.blocks, TRUE);
 	g_free(build_info.dir);
 	g_free(build_info.custom_target);
 
@@ -703,7 +797,8 @@ static void clear_all_errors(void)
 
 	foreach_document(i)
 	{
-		editor_indicator_clear_errors(documents[i]->editor);
+		document_clear_diagnostics(documents[i], "build");
+		sci_marker_delete_all(documents[i]->editor->sci, 0);	/* remove the yellow error line marker */
 	}
 }
 
@@ -766,43 +861,70 @@ static gchar *build_replace_placeholder(const GeanyDocument *doc, const gchar *s
 }
 
 
-/* dir is the UTF-8 working directory to run cmd in. It can be NULL to use the
- * idx document directory */
-static void build_spawn_cmd(GeanyDocument *doc, const gchar *cmd, const gchar *dir)
+static void build_block_clear(gpointer data)
 {
-	GError *error = NULL;
-	gchar *argv[] = { "/bin/sh", "-c", NULL, NULL };
-	gchar *working_dir;
-	gchar *utf8_working_dir;
-	gchar *cmd_string;
+	BuildBlock *block = data;
 
-	g_return_if_fail(doc == NULL || doc->is_valid);
+	g_free(block->dir);
+}
 
-	if ((doc == NULL || EMPTY(doc->file_name)) && EMPTY(dir))
-	{
-		geany_debug("Failed to run command with no working directory");
-		ui_set_statusbar(TRUE, _("Process failed, no working directory"));
-		return;
-	}
 
-	clear_all_errors();
-	SETPTR(current_dir_entered, NULL);
+static void build_job_free(BuildJob *job)
+{
+	g_free(job->cmd);
+	g_free(job->dir);
+	g_ptr_array_free(job->held_lines, TRUE);
+	g_free(job);
+}
 
-	utf8_working_dir = !EMPTY(dir) ? g_strdup(dir) : g_path_get_dirname(doc->file_name);
-	working_dir = utils_get_locale_from_utf8(utf8_working_dir);
 
-	gtk_list_store_clear(msgwindow.store_compiler);
-	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_COMPILER);
-	msgwin_compiler_add(COLOR_BLUE, _("%s (in directory: %s)"), cmd, utf8_working_dir);
-	g_free(utf8_working_dir);
+static guint get_max_build_jobs(void)
+{
+	if (build_max_jobs > 0)
+		return build_max_jobs;
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	return MAX(g_get_num_processors(), 1);
+#else
+	return 4;
+#endif
+}
+
 
+/* Adds the header of job to the Compiler tab, and the output it printed so far */
+static void build_job_show(BuildJob *job)
+{
+	BuildBlock block;
+	guint i;
+
+	block.first_row = msgwin_get_n_rows(MSG_COMPILER);
+	block.dir = g_strdup(job->dir);
+	block.file_type_id = job->file_type_id;
+	block.grp = job->grp;
+	g_array_append_val(build_session.blocks, block);
+
+	msgwin_compiler_add(COLOR_BLUE, _("%s (in directory: %s)"), job->cmd, job->dir);
+	for (i = 0; i < job->held_lines->len; i++)
+		process_build_output_line(job->held_lines->pdata[i]);
+	g_ptr_array_set_size(job->held_lines, 0);
+}
+
+
+static void build_job_spawn(BuildJob *job)
+{
+	GError *error = NULL;
+	gchar *argv[] = { "/bin/sh", "-c", NULL, NULL };
+	const gchar *cmd;
+	gchar *working_dir;
+	gchar *cmd_string;
+
+	working_dir = utils_get_locale_from_utf8(job->dir);
 #ifdef G_OS_UNIX
-	cmd_string = utils_get_locale_from_utf8(cmd);
+	cmd_string = utils_get_locale_from_utf8(job->cmd);
 	argv[2] = cmd_string;
 	cmd = NULL;  /* under Unix, use argv to start cmd via sh for compatibility */
 #else
 	/* Expand environment variables like %blah%. */
-	cmd_string = win32_expand_environment_variables(cmd);
+	cmd_string = win32_expand_environment_variables(job->cmd);
 	argv[0] = NULL;  /* under Windows, run cmd directly */
 	cmd = cmd_string;
 #endif
@@ -810,16 +932,29 @@ static void build_spawn_cmd(GeanyDocument *doc, const gchar *cmd, const gchar *d
 	/* set the build info for the message window */
 	g_free(build_info.dir);
 	build_info.dir = g_strdup(working_dir);
-	build_info.file_type_id = (doc == NULL) ? GEANY_FILETYPES_NONE : doc->file_type->id;
-	build_info.message_count = 0;
+	build_info.file_type_id = job->file_type_id;
+	build_info.grp = job->grp;
+	build_info.cmd = job->cmd_index;
 
-	if (!spawn_with_callbacks(working_dir, cmd, argv, NULL, 0, NULL, NULL, build_iofunc,
-		GINT_TO_POINTER(0), 0, build_iofunc, GINT_TO_POINTER(1), 0, build_exit_cb, NULL,
-		&build_info.pid, &error))
+	job->started = TRUE;
+	job->output = build_output_new(job);
+	if (spawn_with_callbacks(working_dir, cmd, argv, NULL, SPAWN_LINE_BATCHED, NULL, NULL,
+		build_stdout_func, job, 0, build_stderr_func, job, 0, build_exit_cb, job,
+		&job->pid, &error))
+	{
+		build_info.pid = job->pid;
+		build_session.n_running++;
+	}
+	else
 	{
 		geany_debug("build command spawning failed: %s", error->message);
 		ui_set_statusbar(TRUE, _("Process failed (%s)"), error->message);
 		g_error_free(error);
+		build_output_free(job->output, FALSE);
+		job->output = NULL;
+		job->finished = TRUE;
+		job->failed = TRUE;
+		build_session.n_failed++;
 	}
 
 	g_free(working_dir);
@@ -827,6 +962,136 @@ static void build_spawn_cmd(GeanyDocument *doc, const gchar *cmd, const gchar *d
 }
 
 
+static void build_session_start(void)
+{
+	clear_all_errors();
+	msgwin_clear_tab(MSG_COMPILER);
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_COMPILER);
+
+	if (build_session.blocks == NULL)
+	{
+		build_session.blocks = g_array_new(FALSE, FALSE, sizeof(BuildBlock));
+		g_array_set_clear_func(build_session.blocks, build_block_clear);
+	}
+	g_array_set_size(build_session.blocks, 0);
+	build_session.n_jobs = 0;
+	build_session.n_failed = 0;
+	build_info.message_count = 0;
+	ui_progress_bar_start(NULL);
+}
+
+
+static void build_session_end(void)
+{
+	if (build_session.n_jobs > 1)
+	{
+		if (build_session.n_failed > 0)
+			msgwin_compiler_add(COLOR_BLUE, _("%u of %u build commands failed."),
+				build_session.n_failed, build_session.n_jobs);
+		else
+			msgwin_compiler_add(COLOR_BLUE, _("All %u build commands finished successfully."),
+				build_session.n_jobs);
+	}
+	utils_beep();
+
+	build_info.pid = 0;
+	ui_progress_bar_stop();
+}
+
+
+/* Starts waiting jobs while there are free job slots, and shows the output of finished
+ * jobs */
+static void build_jobs_update(void)
+{
+	guint max_jobs = get_max_build_jobs();
+	BuildJob *job;
+	GList *node;
+
+	for (node = build_session.jobs.head; node != NULL; node = node->next)
+	{
+		if (build_session.n_running >= max_jobs)
+			break;
+		job = node->data;
+		if (!job->started)
+			build_job_spawn(job);
+	}
+
+	while ((job = g_queue_peek_head(&build_session.jobs)) != NULL && job->finished)
+	{
+		show_build_result_message(job->failed);
+		g_queue_pop_head(&build_session.jobs);
+		build_job_free(job);
+
+		job = g_queue_peek_head(&build_session.jobs);
+		if (job != NULL)
+			build_job_show(job);
+	}
+
+	if (g_queue_is_empty(&build_session.jobs))
+		build_session_end();
+}
+
+
+static gboolean build_job_is_queued(const gchar *cmd, const gchar *dir)
+{
+	GList *node;
+
+	for (node = build_session.jobs.head; node != NULL; node = node->next)
+	{
+		BuildJob *job = node->data;
+
+		if (!job->finished && utils_str_equal(job->cmd, cmd) && utils_str_equal(job->dir, dir))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+/* dir is the UTF-8 working directory to run cmd in. It can be NULL to use the
+ * idx document directory.
+ * The command is run next to the build commands which are already running, up to the
+ * number of processors. */
+static void build_spawn_cmd(GeanyDocument *doc, const gchar *cmd, const gchar *dir)
+{
+	gchar *utf8_working_dir;
+	BuildJob *job;
+
+	g_return_if_fail(doc == NULL || doc->is_valid);
+
+	if ((doc == NULL || EMPTY(doc->file_name)) && EMPTY(dir))
+	{
+		geany_debug("Failed to run command with no working directory");
+		ui_set_statusbar(TRUE, _("Process failed, no working directory"));
+		return;
+	}
+
+	utf8_working_dir = !EMPTY(dir) ? g_strdup(dir) : g_path_get_dirname(doc->file_name);
+	if (build_job_is_queued(cmd, utf8_working_dir))
+	{
+		ui_set_statusbar(FALSE, _("The build command is already running (%s)."), cmd);
+		g_free(utf8_working_dir);
+		return;
+	}
+
+	if (g_queue_is_empty(&build_session.jobs))
+		build_session_start();
+
+	job = g_new0(BuildJob, 1);
+	job->cmd = g_strdup(cmd);
+	job->dir = utf8_working_dir;
+	job->file_type_id = (doc == NULL) ? GEANY_FILETYPES_NONE : doc->file_type->id;
+	job->grp = build_info.grp;
+	job->cmd_index = build_info.cmd;
+	job->held_lines = g_ptr_array_new_with_free_func(build_output_line_free);
+	g_queue_push_tail(&build_session.jobs, job);
+	build_session.n_jobs++;
+
+	if (g_queue_peek_head(&build_session.jobs) == job)
+		build_job_show(job);
+	build_jobs_update();
+}
+
+
 /* Returns: NULL if there was an error, or the command to be executed. If Geany is
  * set to use a run script, the returned value is a path to the script that runs
  * the command; otherwise the command itself is returned. working_dir is a pointer
@@ -994,34 +1259,35 @@ static void build_run_cmd(GeanyDocument *doc, guint cmdindex)
 }
 
 
-static void process_build_output_line(gchar *msg, gint color)
+static void process_build_output_line(BuildOutputLine *line)
 {
-	gchar *tmp;
-	gchar *filename;
-	gint line;
+	gint color = line->color;
 
-	g_strchomp(msg);
-
-	if (EMPTY(msg))
-		return;
-
-	if (build_parse_make_dir(msg, &tmp))
+	if (line->line != -1 && line->filename == NULL)
 	{
-		SETPTR(current_dir_entered, tmp);
+		/* the error message has no filename, so take the current one and hope it's correct */
+		GeanyDocument *doc = document_get_current();
+
+		if (doc != NULL && doc->file_name != NULL)
+		{
+			line->filename = g_strdup(doc->file_name);
+			line->real_path = g_strdup(doc->real_path);
+		}
 	}
-	msgwin_parse_compiler_error_line(msg, current_dir_entered, &filename, &line);
 
-	if (line != -1 && filename != NULL)
+	if (line->line != -1 && line->filename != NULL)
 	{
-		GeanyDocument *doc = document_find_by_filename(filename);
+		GeanyDocument *doc = line->real_path != NULL ?
+			document_find_by_real_path(line->real_path) : document_find_by_filename(line->filename);
 
 		/* limit number of indicators */
-		if (doc && editor_prefs.use_indicators &&
-			build_info.message_count < GEANY_BUILD_ERR_HIGHLIGHT_MAX)
+		if (doc != NULL && build_info.message_count < GEANY_BUILD_ERR_HIGHLIGHT_MAX)
 		{
-			if (line > 0) /* some compilers, like pdflatex report errors on line 0 */
-				line--;   /* so only adjust the line number if it is greater than 0 */
-			editor_indicator_set_on_line(doc->editor, GEANY_INDICATOR_ERROR, line);
+			gint line_num = line->line;
+
+			if (line_num > 0) /* some compilers, like pdflatex report errors on line 0 */
+				line_num--;   /* so only adjust the line number if it is greater than 0 */
+			document_add_diagnostic(doc, "build", line_num, line->msg);
 		}
 		build_info.message_count++;
 		color = COLOR_RED;	/* error message parsed on the line */
@@ -1032,22 +1298,179 @@ static void process_build_output_line(gchar *msg, gint color)
 			gtk_widget_set_sensitive(build_get_menu_items(-1)->menu_item[GBG_FIXED][GBF_PREV_ERROR], TRUE);
 		}
 	}
-	g_free(filename);
 
-	msgwin_compiler_add_string(color, msg);
+	msgwin_compiler_queue_string(color, line->msg);
+}
+
+
+static void build_output_line_free(gpointer data)
+{
+	BuildOutputLine *line = data;
+
+	g_free(line->msg);
+	g_free(line->filename);
+	g_free(line->real_path);
+	g_free(line);
+}
+
+
+static gboolean build_output_flush(gpointer data)
+{
+	BuildOutput *output = data;
+	GPtrArray *lines;
+	guint i;
+
+	g_mutex_lock(&output->lock);
+	lines = output->lines;
+	output->lines = g_ptr_array_new_with_free_func(build_output_line_free);
+	output->flush_source = 0;
+	g_mutex_unlock(&output->lock);
+
+	if (g_queue_peek_head(&build_session.jobs) == output->job)
+	{
+		for (i = 0; i < lines->len; i++)
+			process_build_output_line(lines->pdata[i]);
+		g_ptr_array_free(lines, TRUE);
+	}
+	else
+	{
+		/* hold the lines until the output of the earlier jobs has been shown */
+		for (i = 0; i < lines->len; i++)
+			g_ptr_array_add(output->job->held_lines, lines->pdata[i]);
+		g_ptr_array_set_free_func(lines, NULL);
+		g_ptr_array_free(lines, TRUE);
+	}
+	return FALSE;
+}
+
+
+/* Returns: the locale real path of utf8_filename, or NULL if it is not on disk.
+ * Build output names the same files over and over, so the paths are cached per build. */
+static gchar *build_output_get_real_path(BuildOutput *output, const gchar *utf8_filename)
+{
+	gpointer real_path;
+
+	if (!g_hash_table_lookup_extended(output->real_paths, utf8_filename, NULL, &real_path))
+	{
+		gchar *locale_filename = utils_get_locale_from_utf8(utf8_filename);
+
+		real_path = utils_get_real_path(locale_filename);
+		g_free(locale_filename);
+		g_hash_table_insert(output->real_paths, g_strdup(utf8_filename), real_path);
+	}
+	return g_strdup(real_path);
+}
+
+
+/* Runs on the worker thread */
+static void build_output_parse(gpointer data, gpointer user_data)
+{
+	BuildOutputChunk *chunk = data;
+	BuildOutput *output = user_data;
+	GPtrArray *lines = g_ptr_array_new();
+	gchar *msg, *end;
+	guint i;
+
+	for (msg = chunk->text; (end = strchr(msg, '\n')) != NULL; msg = end + 1)
+	{
+		BuildOutputLine *line;
+		gchar *dir;
+
+		*end = '\0';
+		g_strchomp(msg);
+
+		if (EMPTY(msg))
+			continue;
+
+		if (build_parse_make_dir(msg, &dir))
+			SETPTR(output->dir_entered, dir);
+
+		line = g_new0(BuildOutputLine, 1);
+		line->msg = g_strdup(msg);
+		line->color = chunk->color;
+		msgwin_parse_compiler_error(msg, output->error_regex, output->file_type_id,
+			output->dir_entered != NULL ? output->dir_entered : output->dir,
+			&line->filename, &line->line);
+		if (line->line != -1 && line->filename != NULL)
+			line->real_path = build_output_get_real_path(output, line->filename);
+		g_ptr_array_add(lines, line);
+	}
+	g_free(chunk->text);
+	g_free(chunk);
+
+	g_mutex_lock(&output->lock);
+	for (i = 0; i < lines->len; i++)
+		g_ptr_array_add(output->lines, lines->pdata[i]);
+	if (output->lines->len > 0 && output->flush_source == 0)
+		output->flush_source = g_idle_add(build_output_flush, output);
+	g_mutex_unlock(&output->lock);
+	g_ptr_array_free(lines, TRUE);
+}
+
+
+static BuildOutput *build_output_new(BuildJob *job)
+{
+	BuildOutput *output = g_new0(BuildOutput, 1);
+
+	output->job = job;
+	output->pool = g_thread_pool_new(build_output_parse, output, 1, FALSE, NULL);
+	output->error_regex = filetypes_get_error_regex(filetypes[job->file_type_id], job->grp);
+	output->file_type_id = job->file_type_id;
+	output->dir = g_strdup(job->dir);
+	output->real_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	g_mutex_init(&output->lock);
+	output->lines = g_ptr_array_new_with_free_func(build_output_line_free);
+	return output;
+}
+
+
+/* Waits until the worker has parsed all output, and passes the remaining lines on to the
+ * job if flush is set */
+static void build_output_free(BuildOutput *output, gboolean flush)
+{
+	g_thread_pool_free(output->pool, FALSE, TRUE);
+	if (output->flush_source != 0)
+		g_source_remove(output->flush_source);
+	if (flush)
+		build_output_flush(output);
+
+	g_ptr_array_free(output->lines, TRUE);
+	g_hash_table_destroy(output->real_paths);
+	if (output->error_regex != NULL)
+		g_regex_unref(output->error_regex);
+	g_free(output->dir);
+	g_free(output->dir_entered);
+	g_mutex_clear(&output->lock);
+	g_free(output);
 }
 
 
-static void build_iofunc(GString *string, GIOCondition condition, gpointer data)
+static void build_iofunc(BuildJob *job, GString *string, GIOCondition condition, gint color)
 {
-	if (condition & (G_IO_IN | G_IO_PRI))
+	if ((condition & (G_IO_IN | G_IO_PRI)) && job->output != NULL)
 	{
-		process_build_output_line(string->str,
-			(GPOINTER_TO_INT(data)) ? COLOR_DARK_RED : COLOR_BLACK);
+		BuildOutputChunk *chunk = g_new(BuildOutputChunk, 1);
+
+		/* the lines are batched, each ending with '\n' */
+		chunk->text = g_strndup(string->str, string->len);
+		chunk->color = color;
+		g_thread_pool_push(job->output->pool, chunk, NULL);
 	}
 }
 
 
+static void build_stdout_func(GString *string, GIOCondition condition, gpointer data)
+{
+	build_iofunc(data, string, condition, COLOR_BLACK);
+}
+
+
+static void build_stderr_func(GString *string, GIOCondition condition, gpointer data)
+{
+	build_iofunc(data, string, condition, COLOR_DARK_RED);
+}
+
+
 gboolean build_parse_make_dir(const gchar *string, gchar **prefix)
 {
 	const gchar *pos;
@@ -1089,6 +1512,84 @@ gboolean build_parse_make_dir(const gchar *string, gchar **prefix)
 }
 
 
+/* Returns: the block of the build command which printed row of the Compiler tab, or NULL */
+static BuildBlock *get_row_block(guint row)
+{
+	guint i;
+
+	if (build_session.blocks == NULL)
+		return NULL;
+
+	for (i = build_session.blocks->len; i-- > 0;)
+	{
+		BuildBlock *block = &g_array_index(build_session.blocks, BuildBlock, i);
+
+		if (block->first_row <= row)
+			return block;
+	}
+	return NULL;
+}
+
+
+/* Returns: the first row of the Compiler tab showing the output of the build command which
+ * printed row */
+guint build_get_output_first_row(guint row)
+{
+	BuildBlock *block = get_row_block(row);
+
+	return block != NULL ? block->first_row : 0;
+}
+
+
+/* Parses string, which is shown in row of the Compiler tab, for the file and line number
+ * where an error occurred, with the settings of the build command which printed it.
+ * dir is the UTF-8 directory entered by make before row or NULL.
+ * *line will be -1 if no error was found in string.
+ * *filename must be freed unless it is NULL. */
+void build_parse_compiler_row(guint row, const gchar *string, const gchar *dir,
+		gchar **filename, gint *line)
+{
+	BuildBlock *block = get_row_block(row);
+	GeanyBuildGroup grp = build_info.grp;
+	gint file_type_id = build_info.file_type_id;
+	GRegex *error_regex;
+	gchar *utf8_dir;
+
+	*filename = NULL;
+	*line = -1;
+
+	if (G_UNLIKELY(string == NULL))
+		return;
+
+	if (block != NULL)
+	{
+		grp = block->grp;
+		file_type_id = block->file_type_id;
+	}
+	if (dir != NULL)
+		utf8_dir = g_strdup(dir);
+	else if (block != NULL)
+		utf8_dir = g_strdup(block->dir);
+	else
+		utf8_dir = utils_get_utf8_from_locale(build_info.dir);
+	g_return_if_fail(utf8_dir != NULL);
+
+	error_regex = filetypes_get_error_regex(filetypes[file_type_id], grp);
+	msgwin_parse_compiler_error(string, error_regex, file_type_id, utf8_dir, filename, line);
+	if (*line != -1 && *filename == NULL)
+	{
+		/* we have no filename in the error message, so take the current one */
+		GeanyDocument *doc = document_get_current();
+
+		if (doc != NULL)
+			*filename = g_strdup(doc->file_name);
+	}
+	if (error_regex != NULL)
+		g_regex_unref(error_regex);
+	g_free(utf8_dir);
+}
+
+
 static void show_build_result_message(gboolean failure)
 {
 	gchar *msg;
@@ -1120,13 +1621,19 @@ static void show_build_result_message(gboolean failure)
 
 static void build_exit_cb(GPid child_pid, gint status, gpointer user_data)
 {
-	show_build_result_message(!SPAWN_WIFEXITED(status) || SPAWN_WEXITSTATUS(status) != EXIT_SUCCESS);
-	utils_beep();
+	BuildJob *job = user_data;
 
-	build_info.pid = 0;
-	/* enable build items again */
+	build_output_free(job->output, TRUE);
+	job->output = NULL;
+	job->pid = 0;
+	job->finished = TRUE;
+	job->failed = !SPAWN_WIFEXITED(status) || SPAWN_WEXITSTATUS(status) != EXIT_SUCCESS;
+	if (job->failed)
+		build_session.n_failed++;
+	build_session.n_running--;
+
+	build_jobs_update();
 	build_menu_update(NULL);
-	ui_progress_bar_stop();
 }
 
 
@@ -1229,8 +1736,6 @@ static void build_command(GeanyDocument *doc, GeanyBuildGroup grp, guint cmd, gc
 	if (cmd_cat != NULL)
 		g_free(full_command);
 	build_menu_update(doc);
-	if (build_info.pid)
-		ui_progress_bar_start(NULL);
 }
 
 
@@ -1458,7 +1963,7 @@ void build_menu_update(GeanyDocument *doc)
 {
 	guint i, cmdcount, cmd, grp;
 	gboolean vis = FALSE;
-	gboolean have_path, build_running, exec_running, have_errors, cmd_sensitivity;
+	gboolean have_path, exec_running, have_errors, cmd_sensitivity;
 	gboolean can_compile, can_build, can_make, run_sensitivity = FALSE, run_running = FALSE;
 	GeanyBuildCommand *bc;
 
@@ -1469,10 +1974,9 @@ void build_menu_update(GeanyDocument *doc)
 	if (doc == NULL)
 		doc = document_get_current();
 	have_path = doc != NULL && doc->file_name != NULL;
-	build_running =  build_info.pid > (GPid) 1;
 	// note: compiler list store may have been cleared since last build
 	have_errors = build_info.message_count > 0 &&
-		gtk_tree_model_iter_n_children(GTK_TREE_MODEL(msgwindow.store_compiler), NULL) > 0;
+		msgwin_get_n_rows(MSG_COMPILER) > 0;
 	for (i = 0; build_menu_specs[i].build_grp != MENU_DONE; ++i)
 	{
 		struct BuildMenuItemSpec *bs = &(build_menu_specs[i]);
@@ -1519,8 +2023,8 @@ void build_menu_update(GeanyDocument *doc)
 					if (grp < GEANY_GBG_EXEC)
 					{
 						cmd_sensitivity =
-							(grp == GEANY_GBG_FT && bc != NULL && have_path && ! build_running) ||
-							(grp == GEANY_GBG_NON_FT && bc != NULL && ! build_running);
+							(grp == GEANY_GBG_FT && bc != NULL && have_path) ||
+							(grp == GEANY_GBG_NON_FT && bc != NULL);
 						gtk_widget_set_sensitive(menu_item, cmd_sensitivity);
 						if (bc != NULL && !EMPTY(label))
 						{
@@ -1565,27 +2069,24 @@ void build_menu_update(GeanyDocument *doc)
 
 	run_sensitivity &= (doc != NULL);
 	can_build = get_build_cmd(doc, GEANY_GBG_FT, GBO_TO_CMD(GEANY_GBO_BUILD), NULL) != NULL
-					&& have_path && ! build_running;
+					&& have_path;
 	if (widgets.toolitem_build != NULL)
 		gtk_widget_set_sensitive(widgets.toolitem_build, can_build);
 	can_make = FALSE;
 	if (widgets.toolitem_make_all != NULL)
 		gtk_widget_set_sensitive(widgets.toolitem_make_all,
-			(can_make |= get_build_cmd(doc, GEANY_GBG_FT, GBO_TO_CMD(GEANY_GBO_MAKE_ALL), NULL) != NULL
-							&& ! build_running));
+			(can_make |= get_build_cmd(doc, GEANY_GBG_FT, GBO_TO_CMD(GEANY_GBO_MAKE_ALL), NULL) != NULL));
 	if (widgets.toolitem_make_custom != NULL)
 		gtk_widget_set_sensitive(widgets.toolitem_make_custom,
-			(can_make |= get_build_cmd(doc, GEANY_GBG_FT, GBO_TO_CMD(GEANY_GBO_CUSTOM), NULL) != NULL
-							&& ! build_running));
+			(can_make |= get_build_cmd(doc, GEANY_GBG_FT, GBO_TO_CMD(GEANY_GBO_CUSTOM), NULL) != NULL));
 	if (widgets.toolitem_make_object != NULL)
 		gtk_widget_set_sensitive(widgets.toolitem_make_object,
-			(can_make |= get_build_cmd(doc, GEANY_GBG_FT, GBO_TO_CMD(GEANY_GBO_MAKE_OBJECT), NULL) != NULL
-							&& ! build_running));
+			(can_make |= get_build_cmd(doc, GEANY_GBG_FT, GBO_TO_CMD(GEANY_GBO_MAKE_OBJECT), NULL) != NULL));
 	if (widgets.toolitem_set_args != NULL)
 		gtk_widget_set_sensitive(widgets.toolitem_set_args, TRUE);
 
 	can_compile = get_build_cmd(doc, GEANY_GBG_FT, GBO_TO_CMD(GEANY_GBO_COMPILE), NULL) != NULL
-					&& have_path && ! build_running;
+					&& have_path;
 	gtk_action_set_sensitive(widgets.compile_action, can_compile);
 	gtk_action_set_sensitive(widgets.build_action, can_make);
 	gtk_action_set_sensitive(widgets.run_action, run_sensitivity);
@@ -2647,6 +3148,14 @@ void build_set_group_count(GeanyBuildGroup grp, gint count)
 }
 
 
+void build_set_max_jobs(gint max_jobs)
+{
+	g_return_if_fail(max_jobs >= 0);
+
+	build_max_jobs = max_jobs;
+}
+
+
 /** Get the count of commands for the group
  *
  * Get the number of commands in the group specified by @a grp.
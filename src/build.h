@@ -148,6 +148,11 @@ void build_free_fields(BuildTableData data);
 /* build response decode assistance function */
 gboolean build_parse_make_dir(const gchar *string, gchar **prefix);
 
+guint build_get_output_first_row(guint row);
+
+void build_parse_compiler_row(guint row, const gchar *string, const gchar *dir,
+		gchar **filename, gint *line);
+
 /* build menu functions */
 
 void build_menu_update(GeanyDocument *doc);
@@ -165,6 +170,8 @@ void build_save_menu(GKeyFile *config, gpointer ptr, GeanyBuildSource src);
 
 void build_set_group_count(GeanyBuildGroup grp, gint count);
 
+void build_set_max_jobs(gint max_jobs);
+
 gchar **build_get_regex(GeanyBuildGroup grp, GeanyFiletype *ft, guint *from);
 
 gboolean build_keybinding(guint key_id);
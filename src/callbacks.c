@@ -111,7 +111,7 @@ void on_save1_activate(GtkMenuItem *menuitem, gpointer user_data)
 
 	if (doc != NULL)
 	{
-		document_save_file(doc, ui_prefs.allow_always_save);
+		document_save_file_async(doc, ui_prefs.allow_always_save);
 	}
 }
 
@@ -124,29 +124,11 @@ void on_save_as1_activate(GtkMenuItem *menuitem, gpointer user_data)
 
 void on_save_all1_activate(GtkMenuItem *menuitem, gpointer user_data)
 {
-	guint i, max = (guint) gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook));
 	GeanyDocument *cur_doc = document_get_current();
-	guint count = 0;
 
-	/* iterate over documents in tabs order */
-	for (i = 0; i < max; i++)
-	{
-		GeanyDocument *doc = document_get_from_page(i);
-
-		if (! doc->changed)
-			continue;
-
-		if (document_save_file(doc, FALSE))
-			count++;
-	}
-	if (!count)
-		return;
-
-	ui_set_statusbar(FALSE, ngettext("%d file saved.", "%d files saved.", count), count);
-	/* saving may have changed window title, sidebar for another doc, so update */
-	document_show_tab(cur_doc);
-	sidebar_update_tag_list(cur_doc, TRUE);
-	ui_set_window_title(cur_doc);
+	/* the files are written in the background, see document_save_all_async() for the rest */
+	if (document_save_all_async())
+		document_show_tab(cur_doc);
 }
 
 
@@ -539,6 +521,10 @@ static void on_notebook1_switch_page_after(GtkNotebook *notebook, gpointer page,
 		ui_update_popup_reundo_items(doc);
 		ui_document_show_hide(doc); /* update the document menu */
 		build_menu_update(doc);
+		/* a session file shown for the first time may not be parsed yet, files opened in a
+		 * batch are parsed together at its end */
+		if (doc->priv->tags_pending && ! document_open_batch_active())
+			document_update_tags(doc);
 		if (g_strcmp0(entry_text, doc->priv->tag_filter) != 0)
 		{
 			/* calls sidebar_update_tag_list() in on_entry_tagfilter_changed() */
@@ -1236,6 +1222,7 @@ void on_menu_remove_indicators1_activate(GtkMenuItem *menuitem, gpointer user_da
 	g_return_if_fail(doc != NULL);
 
 	editor_indicator_clear(doc->editor, GEANY_INDICATOR_ERROR);
+	document_clear_diagnostics(doc, NULL);
 }
 
 
@@ -1506,7 +1493,7 @@ void on_remove_markers1_activate(GtkMenuItem *menuitem, gpointer user_data)
 
 	sci_marker_delete_all(doc->editor->sci, 0);	/* delete the yellow tag marker */
 	sci_marker_delete_all(doc->editor->sci, 1);	/* delete user markers */
-	editor_indicator_clear(doc->editor, GEANY_INDICATOR_SEARCH);
+	search_mark_all(doc, NULL, 0);	/* delete search markers */
 }
 
 
@@ -1745,8 +1732,7 @@ static void on_search1_activate(GtkMenuItem *menuitem, gpointer user_data)
 	gboolean have_messages;
 
 	/* enable commands if the messages window has any items */
-	have_messages = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(msgwindow.store_msg),
-		NULL) > 0;
+	have_messages = msgwin_get_n_rows(MSG_MESSAGE) > 0;
 
 	gtk_widget_set_sensitive(next_message, have_messages);
 	gtk_widget_set_sensitive(previous_message, have_messages);
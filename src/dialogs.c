@@ -160,9 +160,7 @@ static gboolean open_file_dialog_handle_response(GtkWidget *dialog, gint respons
 				ret = FALSE;
 			}
 			else
-			{
-				document_open_files(filelist, ro, ft, charset);
-			}
+				document_open_files_async(filelist, ro, ft, charset);
 			g_slist_foreach(filelist, (GFunc) g_free, NULL);	/* free filenames */
 		}
 		g_slist_free(filelist);
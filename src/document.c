@@ -35,6 +35,7 @@
 #include "documentprivate.h"
 #include "encodings.h"
 #include "encodingsprivate.h"
+#include "filewatch.h"
 #include "filetypesprivate.h"
 #include "geany.h" /* FIXME: why is this needed for DOC_FILENAME()? should come from documentprivate.h/document.h */
 #include "geanyobject.h"
@@ -62,6 +63,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #ifdef HAVE_SYS_TYPES_H
 # include <sys/types.h>
@@ -72,8 +74,6 @@
 /* gstdio.h also includes sys/stat.h */
 #include <glib/gstdio.h>
 
-/* uncomment to use GIO based file monitoring, though it is not completely stable yet */
-/*#define USE_GIO_FILEMON 1*/
 #include <gio/gio.h>
 
 #include <gtk/gtk.h>
@@ -82,6 +82,21 @@
 
 #define USE_GIO_FILE_OPERATIONS (!file_prefs.use_safe_file_saving && file_prefs.use_gio_unsafe_file_saving)
 
+/* files from this size on are read on a worker thread by document_open_file_async() */
+#define ASYNC_OPEN_MIN_SIZE (8 * 1024 * 1024)
+#define ASYNC_OPEN_CHUNK_SIZE (1024 * 1024)
+/* files written in parallel by document_save_all_async() */
+#define ASYNC_SAVE_THREADS 4
+/* size of the chunks converted when saving in another encoding than UTF-8 */
+#define SAVE_CHUNK_SIZE (64 * 1024)
+
+/* delay to collect diagnostics before updating the indicators, in milliseconds */
+#define DIAGNOSTICS_DELAY 100
+
+#ifndef O_BINARY
+# define O_BINARY 0
+#endif
+
 
 GeanyFilePrefs file_prefs;
 GPtrArray *documents_array = NULL;
@@ -105,13 +120,30 @@ enum
 
 
 static guint doc_id_counter = 0;
+static guint pending_tags_source = 0;
+static guint open_batch = 0;
+static GPtrArray *open_batch_docs = NULL;	/* documents whose symbols the batch parses */
+/* open documents by GeanyDocument::file_name and GeanyDocument::real_path, the keys compare
+ * like utils_filenamecmp() */
+static GHashTable *doc_file_names = NULL;
+static GHashTable *doc_real_paths = NULL;
+static guint diagnostics_source = 0;
+static GSList *async_opens = NULL;	/* AsyncOpen */
 
 
 static void document_undo_clear_stack(GTrashStack **stack);
+static void async_open_cancel_all(void);
+static void async_progress_hide(void);
+static void async_save_wait(GeanyDocument *doc);
+static void async_save_wait_all(void);
+static void async_save_free_pool(void);
+static gboolean check_disk_status(GeanyDocument *doc, gboolean force, gboolean sync);
+static void disk_check_free_pool(void);
 static void document_undo_clear(GeanyDocument *doc);
 static void document_undo_add_internal(GeanyDocument *doc, guint type, gpointer data);
 static void document_redo_add(GeanyDocument *doc, guint type, gpointer data);
 static gboolean remove_page(guint page_num);
+static void update_batch_tags(GPtrArray *docs);
 static GtkWidget* document_show_message(GeanyDocument *doc, GtkMessageType msgtype,
 	void (*response_cb)(GtkWidget *info_bar, gint response_id, GeanyDocument *doc),
 	const gchar *btn_1, GtkResponseType response_1,
@@ -120,6 +152,77 @@ static GtkWidget* document_show_message(GeanyDocument *doc, GtkMessageType msgty
 	const gchar *extra_text, const gchar *format, ...) G_GNUC_PRINTF(11, 12);
 
 
+static gchar *get_index_key(const gchar *filename)
+{
+#ifdef G_OS_WIN32
+	/* like utils_str_casecmp() */
+	gchar *key = utils_utf8_strdown(filename);
+
+	return key != NULL ? key : g_strdup(filename);
+#else
+	return g_strdup(filename);
+#endif
+}
+
+
+static GeanyDocument *index_lookup(GHashTable *index, const gchar *filename)
+{
+	gchar *key = get_index_key(filename);
+	GeanyDocument *doc = g_hash_table_lookup(index, key);
+
+	g_free(key);
+	return doc;
+}
+
+
+static void index_remove(GHashTable *index, const gchar *filename, GeanyDocument *doc,
+		gboolean real_path)
+{
+	gchar *key;
+	guint i;
+
+	if (filename == NULL)
+		return;
+
+	key = get_index_key(filename);
+	if (g_hash_table_lookup(index, key) == doc)
+	{
+		g_hash_table_remove(index, key);
+		/* another document may have the same name */
+		foreach_document(i)
+		{
+			const gchar *name = real_path ? documents[i]->real_path : documents[i]->file_name;
+
+			if (documents[i] != doc && name != NULL && utils_filenamecmp(filename, name) == 0)
+			{
+				g_hash_table_insert(index, g_strdup(key), documents[i]);
+				break;
+			}
+		}
+	}
+	g_free(key);
+}
+
+
+/* Call before the file name or the real path of doc are changed or doc is closed */
+static void document_index_remove(GeanyDocument *doc)
+{
+	index_remove(doc_file_names, doc->file_name, doc, FALSE);
+	index_remove(doc_real_paths, doc->real_path, doc, TRUE);
+}
+
+
+/* Call after the file name or the real path of doc are set */
+static void document_index_add(GeanyDocument *doc)
+{
+	/* keep the document which had the name first */
+	if (doc->file_name != NULL && index_lookup(doc_file_names, doc->file_name) == NULL)
+		g_hash_table_insert(doc_file_names, get_index_key(doc->file_name), doc);
+	if (doc->real_path != NULL && index_lookup(doc_real_paths, doc->real_path) == NULL)
+		g_hash_table_insert(doc_real_paths, get_index_key(doc->real_path), doc);
+}
+
+
 /**
  * Finds a document whose @c real_path field matches the given filename.
  *
@@ -136,24 +239,10 @@ static GtkWidget* document_show_message(GeanyDocument *doc, GtkMessageType msgty
 GEANY_API_SYMBOL
 GeanyDocument* document_find_by_real_path(const gchar *realname)
 {
-	guint i;
-
 	if (! realname)
 		return NULL;	/* file doesn't exist on disk */
 
-	for (i = 0; i < documents_array->len; i++)
-	{
-		GeanyDocument *doc = documents[i];
-
-		if (! doc->is_valid || ! doc->real_path)
-			continue;
-
-		if (utils_filenamecmp(realname, doc->real_path) == 0)
-		{
-			return doc;
-		}
-	}
-	return NULL;
+	return index_lookup(doc_real_paths, realname);
 }
 
 
@@ -182,7 +271,6 @@ static gchar *get_real_path_from_utf8(const gchar *utf8_filename)
 GEANY_API_SYMBOL
 GeanyDocument *document_find_by_filename(const gchar *utf8_filename)
 {
-	guint i;
 	GeanyDocument *doc;
 	gchar *realname;
 
@@ -190,18 +278,10 @@ GeanyDocument *document_find_by_filename(const gchar *utf8_filename)
 
 	/* First search GeanyDocument::file_name, so we can find documents with a
 	 * filename set but not saved on disk, like vcdiff produces */
-	for (i = 0; i < documents_array->len; i++)
-	{
-		doc = documents[i];
-
-		if (! doc->is_valid || doc->file_name == NULL)
-			continue;
+	doc = index_lookup(doc_file_names, utf8_filename);
+	if (doc != NULL)
+		return doc;
 
-		if (utils_filenamecmp(utf8_filename, doc->file_name) == 0)
-		{
-			return doc;
-		}
-	}
 	/* Now try matching based on the realpath(), which is unique per file on disk */
 	realname = get_real_path_from_utf8(utf8_filename);
 	doc = document_find_by_real_path(realname);
@@ -382,6 +462,8 @@ GeanyDocument *document_get_current(void)
 void document_init_doclist(void)
 {
 	documents_array = g_ptr_array_new();
+	doc_file_names = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	doc_real_paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
 }
 
 
@@ -389,9 +471,18 @@ void document_finalize(void)
 {
 	guint i;
 
+	async_open_cancel_all();
+	async_save_free_pool();
+	disk_check_free_pool();
+
 	for (i = 0; i < documents_array->len; i++)
 		g_free(documents[i]);
 	g_ptr_array_free(documents_array, TRUE);
+	if (diagnostics_source != 0)
+		g_source_remove(diagnostics_source);
+	diagnostics_source = 0;
+	g_hash_table_destroy(doc_file_names);
+	g_hash_table_destroy(doc_real_paths);
 }
 
 
@@ -506,55 +597,33 @@ static void queue_colourise(GeanyDocument *doc)
 }
 
 
-#ifdef USE_GIO_FILEMON
-static void monitor_file_changed_cb(G_GNUC_UNUSED GFileMonitor *monitor, G_GNUC_UNUSED GFile *file,
-									G_GNUC_UNUSED GFile *other_file, GFileMonitorEvent event,
-									GeanyDocument *doc)
+/* Called by the file watch after the file of doc was changed on disk */
+static void on_file_changed(gpointer data)
 {
-	g_return_if_fail(doc != NULL);
+	GeanyDocument *doc = data;
 
-	if (file_prefs.disk_check_timeout == 0)
-		return;
+	geany_debug("%s: previous file status: %d", G_STRFUNC, doc->priv->file_disk_status);
 
-	geany_debug("%s: event: %d previous file status: %d",
-		G_STRFUNC, event, doc->priv->file_disk_status);
-	switch (event)
-	{
-		case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
-		{
-			if (doc->priv->file_disk_status == FILE_IGNORE)
-				doc->priv->file_disk_status = FILE_OK;
-			else
-				doc->priv->file_disk_status = FILE_CHANGED;
-			g_message("%s: FILE_CHANGED", G_STRFUNC);
-			break;
-		}
-		case G_FILE_MONITOR_EVENT_DELETED:
-		{
-			doc->priv->file_disk_status = FILE_CHANGED;
-			g_message("%s: FILE_MISSING", G_STRFUNC);
-			break;
-		}
-		default:
-			break;
-	}
-	if (doc->priv->file_disk_status != FILE_OK)
+	/* the change is the document being written */
+	if (doc->priv->file_disk_status == FILE_IGNORE)
 	{
-		ui_update_tab_status(doc);
+		doc->priv->file_disk_status = FILE_OK;
+		return;
 	}
+	doc->priv->file_disk_status = FILE_CHANGED;
+
+	/* other documents are checked when they are switched to */
+	if (doc == document_get_current())
+		document_check_disk_status(doc, TRUE);
 }
-#endif
 
 
 static void document_stop_file_monitoring(GeanyDocument *doc)
 {
 	g_return_if_fail(doc != NULL);
 
-	if (doc->priv->monitor != NULL)
-	{
-		g_object_unref(doc->priv->monitor);
-		doc->priv->monitor = NULL;
-	}
+	filewatch_remove(doc->priv->file_watch);
+	doc->priv->file_watch = 0;
 }
 
 
@@ -565,28 +634,17 @@ static void monitor_file_setup(GeanyDocument *doc)
 	 * doesn't work at all for remote files and legacy polling is too slow. */
 	if (! doc->priv->is_remote)
 	{
-#ifdef USE_GIO_FILEMON
 		gchar *locale_filename;
 
 		/* stop any previous monitoring */
 		document_stop_file_monitoring(doc);
 
-		locale_filename = utils_get_locale_from_utf8(doc->file_name);
-		if (locale_filename != NULL && g_file_test(locale_filename, G_FILE_TEST_EXISTS))
-		{
-			/* get a file monitor and connect to the 'changed' signal */
-			GFile *file = g_file_new_for_path(locale_filename);
-			doc->priv->monitor = g_file_monitor_file(file, G_FILE_MONITOR_NONE, NULL, NULL);
-			g_signal_connect(doc->priv->monitor, "changed",
-				G_CALLBACK(monitor_file_changed_cb), doc);
-
-			/* we set the rate limit according to the GUI pref but it's most probably not used */
-			g_file_monitor_set_rate_limit(doc->priv->monitor, file_prefs.disk_check_timeout * 1000);
-
-			g_object_unref(file);
-		}
+		/* watch the file a link points to, as the link itself does not change */
+		locale_filename = (doc->real_path != NULL) ? g_strdup(doc->real_path) :
+			utils_get_locale_from_utf8(doc->file_name);
+		if (locale_filename != NULL && g_path_is_absolute(locale_filename))
+			doc->priv->file_watch = filewatch_add(locale_filename, on_file_changed, doc);
 		g_free(locale_filename);
-#endif
 	}
 	doc->priv->file_disk_status = FILE_OK;
 }
@@ -652,10 +710,9 @@ static GeanyDocument *document_create(const gchar *utf8_filename)
 	doc->id = ++doc_id_counter;
 	doc->index = new_idx;
 	doc->file_name = g_strdup(utf8_filename);
+	document_index_add(doc);
 	doc->editor = editor_create(doc);
-#ifndef USE_GIO_FILEMON
 	doc->priv->last_check = time(NULL);
-#endif
 
 	g_datalist_init(&doc->priv->data);
 
@@ -704,6 +761,9 @@ static gboolean remove_page(guint page_num)
 
 	g_return_val_if_fail(doc != NULL, FALSE);
 
+	/* doc can only be freed once it has been written */
+	async_save_wait(doc);
+
 	/* if we're closing all, document_account_for_unsaved() has been called already, no need to ask again. */
 	if (! main_status.closing_all && doc->changed && ! dialogs_show_unsaved_file(doc))
 		return FALSE;
@@ -717,6 +777,7 @@ static gboolean remove_page(guint page_num)
 
 	g_datalist_clear(&doc->priv->data);
 
+	document_index_remove(doc);
 	doc->is_valid = FALSE;
 	doc->id = 0;
 
@@ -737,6 +798,13 @@ static gboolean remove_page(guint page_num)
 	g_free(doc->encoding);
 	g_free(doc->priv->saved_encoding.encoding);
 	g_free(doc->priv->tag_filter);
+	g_free(doc->priv->disk_checksum);
+	if (doc->priv->diagnostics)
+		g_array_free(doc->priv->diagnostics, TRUE);
+	if (doc->priv->new_diagnostics)
+		g_array_free(doc->priv->new_diagnostics, TRUE);
+	if (doc->priv->unmarked_diagnostic_lines)
+		g_array_free(doc->priv->unmarked_diagnostic_lines, TRUE);
 	g_free(doc->file_name);
 	g_free(doc->real_path);
 	if (doc->tm_file)
@@ -802,10 +870,10 @@ static void store_saved_encoding(GeanyDocument *doc)
 }
 
 
-/* Opens a new empty document only if there are no other documents open */
+/* Opens a new empty document only if there are no other documents open nor being opened */
 GeanyDocument *document_new_file_if_non_open(void)
 {
-	if (gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook)) == 0)
+	if (gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook)) == 0 && async_opens == NULL)
 		return document_new_file(NULL, NULL, NULL);
 
 	return NULL;
@@ -878,11 +946,7 @@ GeanyDocument *document_new_file(const gchar *utf8_filename, GeanyFiletype *ft,
 	editor_goto_pos(doc->editor, 0, FALSE);
 	document_try_focus(doc, NULL);
 
-#ifdef USE_GIO_FILEMON
-	monitor_file_setup(doc);
-#else
 	doc->priv->mtime = 0;
-#endif
 
 	/* "the" SCI signal (connect after initial setup(i.e. adding text)) */
 	g_signal_connect(doc->editor->sci, "sci-notify", G_CALLBACK(editor_sci_notify_cb), doc->editor);
@@ -923,18 +987,26 @@ typedef struct
 	gboolean	 bom;
 	time_t		 mtime;	/* modification time, read by stat::st_mtime */
 	gboolean	 readonly;
+	gint		 eol_mode;	/* the line endings mostly used */
+	gsize		 lines;		/* number of lines, 0 if not counted */
+	gchar		*checksum;	/* MD5 checksum of the file as read, or NULL */
+	gpointer	 sci_doc;	/* Scintilla loader holding the text instead of data, or NULL */
+	gboolean	 viewer;	/* sci_doc holds the unconverted file for a viewer document */
 } FileData;
 
 
-static gboolean get_mtime(const gchar *locale_filename, time_t *time)
+/* Gets the modification time of a file without touching the UI.
+ * On failure error is set to the reason. */
+static gboolean query_mtime(const gchar *locale_filename, gboolean use_gio, time_t *time,
+	gchar **error)
 {
-	GError *error = NULL;
-	const gchar *err_msg = NULL;
+	GError *err = NULL;
 
-	if (USE_GIO_FILE_OPERATIONS)
+	*error = NULL;
+	if (use_gio)
 	{
 		GFile *file = g_file_new_for_path(locale_filename);
-		GFileInfo *info = g_file_query_info(file, G_FILE_ATTRIBUTE_TIME_MODIFIED, G_FILE_QUERY_INFO_NONE, NULL, &error);
+		GFileInfo *info = g_file_query_info(file, G_FILE_ATTRIBUTE_TIME_MODIFIED, G_FILE_QUERY_INFO_NONE, NULL, &err);
 
 		if (info)
 		{
@@ -944,8 +1016,11 @@ static gboolean get_mtime(const gchar *locale_filename, time_t *time)
 			g_object_unref(info);
 			*time = timeval.tv_sec;
 		}
-		else if (error)
-			err_msg = error->message;
+		else if (err)
+		{
+			*error = g_strdup(err->message);
+			g_error_free(err);
+		}
 
 		g_object_unref(file);
 	}
@@ -956,53 +1031,148 @@ static gboolean get_mtime(const gchar *locale_filename, time_t *time)
 		if (g_stat(locale_filename, &st) == 0)
 			*time = st.st_mtime;
 		else
-			err_msg = g_strerror(errno);
+			*error = g_strdup(g_strerror(errno));
 	}
 
-	if (err_msg)
+	return *error == NULL;
+}
+
+
+static gboolean get_mtime(const gchar *locale_filename, time_t *time)
+{
+	gchar *error;
+
+	if (! query_mtime(locale_filename, USE_GIO_FILE_OPERATIONS, time, &error))
 	{
 		gchar *utf8_filename = utils_get_utf8_from_locale(locale_filename);
 
 		ui_set_statusbar(TRUE, _("Could not open file %s (%s)"),
-			utf8_filename, err_msg);
+			utf8_filename, error);
 		g_free(utf8_filename);
+		g_free(error);
+		return FALSE;
 	}
-
-	if (error)
-		g_error_free(error);
-
-	return err_msg == NULL;
+	return TRUE;
 }
 
 
-/* loads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM. */
-static gboolean load_text_file(const gchar *locale_filename, const gchar *display_filename,
-	FileData *filedata, const gchar *forced_enc)
+/* Reads up to ASYNC_OPEN_CHUNK_SIZE bytes to the end of buffer from stream, or from fp if
+ * stream is NULL, and adds them to checksum.
+ * Returns: the number of bytes read, or -1 on error. */
+static gssize read_file_chunk(GInputStream *stream, FILE *fp, GString *buffer,
+	GChecksum *checksum, GError **error)
 {
-	GError *err = NULL;
+	gsize len = buffer->len;
+	gsize n_read;
 
-	filedata->data = NULL;
-	filedata->len = 0;
-	filedata->enc = NULL;
-	filedata->bom = FALSE;
-	filedata->readonly = FALSE;
+	g_string_set_size(buffer, len + ASYNC_OPEN_CHUNK_SIZE);
+	if (stream != NULL)
+	{
+		if (! g_input_stream_read_all(stream, buffer->str + len, ASYNC_OPEN_CHUNK_SIZE,
+				&n_read, NULL, error))
+			n_read = 0;
+	}
+	else
+	{
+		errno = 0;
+		n_read = fread(buffer->str + len, 1, ASYNC_OPEN_CHUNK_SIZE, fp);
+		if (ferror(fp))
+		{
+			gint err = errno;
 
-	if (!get_mtime(locale_filename, &filedata->mtime))
-		return FALSE;
+			g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err), "%s", g_strerror(err));
+		}
+	}
+	g_string_set_size(buffer, len + n_read);
+	g_checksum_update(checksum, (const guchar *) buffer->str + len, n_read);
 
-	if (USE_GIO_FILE_OPERATIONS)
+	return (error != NULL && *error != NULL) ? -1 : (gssize) n_read;
+}
+
+
+/* Reads the contents of a file and computes their MD5 checksum while reading, so that the
+ * contents are not gone through a second time. */
+static gboolean read_file_contents(const gchar *locale_filename, gboolean use_gio,
+	gchar **contents, gsize *length, gchar **checksum, GError **error)
+{
+	GInputStream *stream = NULL;
+	FILE *fp = NULL;
+	GChecksum *sum;
+	GString *buffer;
+	GStatBuf st;
+	gssize n_read;
+
+	if (use_gio)
 	{
 		GFile *file = g_file_new_for_path(locale_filename);
 
-		g_file_load_contents(file, NULL, &filedata->data, &filedata->len, NULL, &err);
+		stream = G_INPUT_STREAM(g_file_read(file, NULL, error));
 		g_object_unref(file);
+		if (stream == NULL)
+			return FALSE;
+	}
+	else if ((fp = g_fopen(locale_filename, "rb")) == NULL)
+	{
+		gint err = errno;
+		gchar *utf8_filename = utils_get_utf8_from_locale(locale_filename);
+
+		g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(err),
+			_("Could not open file %s (%s)"), utf8_filename, g_strerror(err));
+		g_free(utf8_filename);
+		return FALSE;
+	}
+
+	/* room for the whole file and the last read, so the buffer is not grown when reading */
+	buffer = g_string_sized_new((g_stat(locale_filename, &st) == 0 ? (gsize) st.st_size : 0) +
+		ASYNC_OPEN_CHUNK_SIZE);
+	sum = g_checksum_new(G_CHECKSUM_MD5);
+	do
+	{
+		n_read = read_file_chunk(stream, fp, buffer, sum, error);
 	}
+	while (n_read == ASYNC_OPEN_CHUNK_SIZE);
+
+	if (stream != NULL)
+		g_object_unref(stream);
 	else
-		g_file_get_contents(locale_filename, &filedata->data, &filedata->len, &err);
+		fclose(fp);
+
+	if (n_read < 0)
+	{
+		g_string_free(buffer, TRUE);
+		g_checksum_free(sum);
+		return FALSE;
+	}
+	*length = buffer->len;
+	*contents = g_string_free(buffer, FALSE);
+	*checksum = g_strdup(g_checksum_get_string(sum));
+	g_checksum_free(sum);
+	return TRUE;
+}
+
+
+/* reads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM.
+ * This does not touch the UI so it can run on a worker thread, on failure error is set
+ * to a message for the status bar. */
+static gboolean read_text_file(const gchar *locale_filename, const gchar *display_filename,
+	FileData *filedata, const gchar *forced_enc, gboolean use_gio, gchar **error)
+{
+	GeanyLineEndingCounts counts = { 0 };
+	GError *err = NULL;
+
+	filedata->data = NULL;
+	filedata->len = 0;
+	filedata->lines = 0;
+	filedata->checksum = NULL;
+	filedata->enc = NULL;
+	filedata->bom = FALSE;
+	filedata->readonly = FALSE;
+	filedata->sci_doc = NULL;
 
-	if (err)
+	if (! read_file_contents(locale_filename, use_gio, &filedata->data, &filedata->len,
+			&filedata->checksum, &err))
 	{
-		ui_set_statusbar(TRUE, "%s", err->message);
+		*error = g_strdup(err->message);
 		g_error_free(err);
 		return FALSE;
 	}
@@ -1012,32 +1182,201 @@ static gboolean load_text_file(const gchar *locale_filename, const gchar *displa
 	{
 		if (forced_enc)
 		{
-			ui_set_statusbar(TRUE, _("The file \"%s\" is not valid %s."),
+			*error = g_strdup_printf(_("The file \"%s\" is not valid %s."),
 				display_filename, forced_enc);
 		}
 		else
 		{
-			ui_set_statusbar(TRUE,
+			*error = g_strdup_printf(
 	_("The file \"%s\" does not look like a text file or the file encoding is not supported."),
 			display_filename);
 		}
 		g_free(filedata->data);
+		g_free(filedata->checksum);
 		return FALSE;
 	}
 
-	if (filedata->readonly)
+	utils_count_line_endings(&counts, filedata->data, filedata->len);
+	filedata->eol_mode = utils_get_line_endings_from_counts(&counts);
+	filedata->lines = counts.cr + counts.lf + counts.crlf + 1;
+	return TRUE;
+}
+
+
+static void show_truncated_file_warning(const gchar *display_filename)
+{
+	const gchar *warn_msg = _(
+		"The file \"%s\" could not be opened properly and has been truncated. " \
+		"This can occur if the file contains a NULL byte. " \
+		"Be aware that saving it can cause data loss.\nThe file was set to read-only.");
+
+	if (main_status.main_window_realized)
+		dialogs_show_msgbox(GTK_MESSAGE_WARNING, warn_msg, display_filename);
+
+	ui_set_statusbar(TRUE, warn_msg, display_filename);
+}
+
+
+/* A file read ahead of opening it, see document_prefetch_file() */
+typedef struct
+{
+	gchar		*locale_filename;
+	gchar		*forced_enc;
+	gboolean	 use_gio;
+	FileData	 filedata;
+	gboolean	 success;
+	gboolean	 done;		/* protected by prefetch_mutex */
+} PrefetchedFile;
+
+static GThreadPool *prefetch_pool = NULL;
+static GHashTable *prefetched_files = NULL;	/* locale filename -> PrefetchedFile */
+static GMutex prefetch_mutex;
+static GCond prefetch_cond;
+
+
+static void prefetched_file_free(PrefetchedFile *pf)
+{
+	if (pf->success)
+	{
+		g_free(pf->filedata.data);
+		g_free(pf->filedata.enc);
+		g_free(pf->filedata.checksum);
+	}
+	g_free(pf->locale_filename);
+	g_free(pf->forced_enc);
+	g_free(pf);
+}
+
+
+static void prefetch_file_thread(gpointer data, gpointer user_data)
+{
+	PrefetchedFile *pf = data;
+	gchar *error = NULL;
+
+	/* errors are reported when the file is read again on opening */
+	pf->success = query_mtime(pf->locale_filename, pf->use_gio, &pf->filedata.mtime, &error) &&
+		read_text_file(pf->locale_filename, pf->locale_filename, &pf->filedata, pf->forced_enc,
+			pf->use_gio, &error);
+	g_free(error);
+
+	g_mutex_lock(&prefetch_mutex);
+	pf->done = TRUE;
+	g_cond_broadcast(&prefetch_cond);
+	g_mutex_unlock(&prefetch_mutex);
+}
+
+
+/* Starts reading and converting a file on a worker thread, so that opening it soon after with
+ * document_open_file_full() only has to add its text. Used when opening many files at
+ * once, like the session files; document_prefetch_clear() drops the files not opened. */
+void document_prefetch_file(const gchar *locale_filename, const gchar *forced_enc)
+{
+	PrefetchedFile *pf;
+
+	if (prefetch_pool == NULL)
+	{
+		gint n_threads;
+
+#if GLIB_CHECK_VERSION(2, 36, 0)
+		n_threads = (gint) g_get_num_processors();
+#else
+		n_threads = 4;
+#endif
+		prefetch_pool = g_thread_pool_new(prefetch_file_thread, NULL, n_threads, FALSE, NULL);
+		prefetched_files = g_hash_table_new(g_str_hash, g_str_equal);
+	}
+
+	pf = g_new0(PrefetchedFile, 1);
+	pf->locale_filename = g_strdup(locale_filename);
+	utils_tidy_path(pf->locale_filename);
+	if (g_hash_table_lookup(prefetched_files, pf->locale_filename) != NULL)
+	{
+		prefetched_file_free(pf);
+		return;
+	}
+	pf->forced_enc = g_strdup(forced_enc);
+	pf->use_gio = USE_GIO_FILE_OPERATIONS;
+
+	g_hash_table_insert(prefetched_files, pf->locale_filename, pf);
+	g_thread_pool_push(prefetch_pool, pf, NULL);
+}
+
+
+void document_prefetch_clear(void)
+{
+	GHashTableIter iter;
+	gpointer pf;
+
+	if (prefetch_pool == NULL)
+		return;
+
+	/* skip the files not started yet and wait for the others */
+	g_thread_pool_free(prefetch_pool, TRUE, TRUE);
+	prefetch_pool = NULL;
+
+	g_hash_table_iter_init(&iter, prefetched_files);
+	while (g_hash_table_iter_next(&iter, NULL, &pf))
+		prefetched_file_free(pf);
+	g_hash_table_destroy(prefetched_files);
+	prefetched_files = NULL;
+}
+
+
+/* Takes the data of a file passed to document_prefetch_file(), waiting for it if needed.
+ * Returns: FALSE if there is none or reading the file failed. */
+static gboolean take_prefetched_file(const gchar *locale_filename, const gchar *forced_enc,
+	FileData *filedata)
+{
+	PrefetchedFile *pf;
+	gboolean success;
+
+	if (prefetched_files == NULL)
+		return FALSE;
+
+	pf = g_hash_table_lookup(prefetched_files, locale_filename);
+	if (pf == NULL || ! utils_str_equal(pf->forced_enc, forced_enc))
+		return FALSE;
+
+	g_mutex_lock(&prefetch_mutex);
+	while (! pf->done)
+		g_cond_wait(&prefetch_cond, &prefetch_mutex);
+	g_mutex_unlock(&prefetch_mutex);
+
+	g_hash_table_remove(prefetched_files, locale_filename);
+	success = pf->success;
+	if (success)
 	{
-		const gchar *warn_msg = _(
-			"The file \"%s\" could not be opened properly and has been truncated. " \
-			"This can occur if the file contains a NULL byte. " \
-			"Be aware that saving it can cause data loss.\nThe file was set to read-only.");
+		*filedata = pf->filedata;
+		pf->success = FALSE;	/* filedata owns the data now */
+	}
+	prefetched_file_free(pf);
+	return success;
+}
+
+
+/* loads textfile data, verifies and converts to forced_enc or UTF-8. Also handles BOM. */
+static gboolean load_text_file(const gchar *locale_filename, const gchar *display_filename,
+	FileData *filedata, const gchar *forced_enc)
+{
+	gchar *error = NULL;
 
-		if (main_status.main_window_realized)
-			dialogs_show_msgbox(GTK_MESSAGE_WARNING, warn_msg, display_filename);
+	if (! take_prefetched_file(locale_filename, forced_enc, filedata))
+	{
+		if (!get_mtime(locale_filename, &filedata->mtime))
+			return FALSE;
 
-		ui_set_statusbar(TRUE, warn_msg, display_filename);
+		if (! read_text_file(locale_filename, display_filename, filedata, forced_enc,
+				USE_GIO_FILE_OPERATIONS, &error))
+		{
+			ui_set_statusbar(TRUE, "%s", error);
+			g_free(error);
+			return FALSE;
+		}
 	}
 
+	if (filedata->readonly)
+		show_truncated_file_warning(display_filename);
+
 	return TRUE;
 }
 
@@ -1280,35 +1619,276 @@ void document_show_tab(GeanyDocument *doc)
 }
 
 
-/* To open a new file, set doc to NULL; filename should be locale encoded.
- * To reload a file, set the doc for the document to be reloaded; filename should be NULL.
- * pos is the cursor position, which can be overridden by --line and --column.
- * forced_enc can be NULL to detect the file encoding.
- * Returns: doc of the opened file or NULL if an error occurred. */
-GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
-		gboolean readonly, GeanyFiletype *ft, const gchar *forced_enc)
+/* Replaces the text of sci with text, changing only the range in which they differ, so
+ * that markers, folding and styles outside of it are kept and undo only records the actual
+ * change. */
+static void replace_changed_text(ScintillaObject *sci, const gchar *text, gsize len)
 {
-	gint editor_mode;
-	gboolean reload = (doc == NULL) ? FALSE : TRUE;
-	gchar *utf8_filename = NULL;
-	gchar *display_filename = NULL;
-	gchar *locale_filename = NULL;
-	GeanyFiletype *use_ft;
-	FileData filedata;
-	UndoReloadData *undo_reload_data;
-	gboolean add_undo_reload_action;
+	struct Sci_ReplaceRange range;
+	const gchar *part1, *part2;
+	gsize len1, len2, old_len, prefix = 0, suffix = 0, max;
 
-	g_return_val_if_fail(doc == NULL || doc->is_valid, NULL);
+	sci_get_text_parts(sci, &part1, &len1, &part2, &len2);
+	old_len = len1 + len2;
 
-	if (reload)
+	while (prefix < len1 && prefix < len && part1[prefix] == text[prefix])
+		prefix++;
+	if (prefix == len1)
 	{
-		utf8_filename = g_strdup(doc->file_name);
-		locale_filename = utils_get_locale_from_utf8(utf8_filename);
+		while (prefix < old_len && prefix < len && part2[prefix - len1] == text[prefix])
+			prefix++;
 	}
-	else
+	/* the common suffix must not overlap the common prefix */
+	max = MIN(old_len, len) - prefix;
+	while (suffix < max)
 	{
-		/* filename must not be NULL when opening a file */
-		g_return_val_if_fail(filename, NULL);
+		gsize pos = old_len - suffix - 1;
+
+		if ((pos < len1 ? part1[pos] : part2[pos - len1]) != text[len - suffix - 1])
+			break;
+		suffix++;
+	}
+	if (prefix == len && len == old_len)
+		return;
+
+	/* don't split UTF-8 characters, text is null-terminated */
+	while (prefix > 0 && (text[prefix] & 0xc0) == 0x80)
+		prefix--;
+	while (suffix > 0 && (text[len - suffix] & 0xc0) == 0x80)
+		suffix--;
+
+	range.cpMin = prefix;
+	range.cpMax = old_len - suffix;
+	range.text = text + prefix;
+	range.length = len - prefix - suffix;
+	sci_replace_ranges(sci, &range, 1);
+}
+
+
+/* Adds the text of filedata to doc, or to a new document if doc is NULL, and finishes
+ * opening or reloading it.
+ * Returns: the document opened or reloaded. */
+static GeanyDocument *open_loaded_file(GeanyDocument *doc, const gchar *utf8_filename,
+		const gchar *locale_filename, const gchar *display_filename, FileData *filedata,
+		gboolean readonly, GeanyFiletype *ft)
+{
+	gint editor_mode;
+	gboolean reload = (doc == NULL) ? FALSE : TRUE;
+	GeanyFiletype *use_ft;
+	UndoReloadData *undo_reload_data;
+	gboolean add_undo_reload_action;
+
+	if (! reload)
+	{
+		doc = document_create(utf8_filename);
+		g_return_val_if_fail(doc != NULL, NULL); /* really should not happen */
+
+		/* file exists on disk, set real_path */
+		SETPTR(doc->real_path, utils_get_real_path(locale_filename));
+		document_index_add(doc);
+
+		doc->priv->is_remote = utils_is_remote_path(locale_filename);
+		monitor_file_setup(doc);
+	}
+
+	if (! reload || ! file_prefs.keep_edit_history_on_reload)
+	{
+		sci_set_undo_collection(doc->editor->sci, FALSE); /* avoid creation of an undo action */
+		sci_empty_undo_buffer(doc->editor->sci);
+		undo_reload_data = NULL;
+	}
+	else
+	{
+		undo_reload_data = (UndoReloadData*) g_malloc(sizeof(UndoReloadData));
+
+		/* We will be adding a UNDO_RELOAD action to the undo stack that undoes
+		 * this reload. To do that, we keep collecting undo actions during
+		 * reloading, and at the end add an UNDO_RELOAD action that performs
+		 * all these actions in bulk. To keep track of how many undo actions
+		 * were added during this time, we compare the current undo-stack height
+		 * with its height at the end of the process. Note that g_trash_stack_height()
+		 * is O(N), which is a little ugly, but this seems like the most maintainable
+		 * option. */
+		undo_reload_data->actions_count = g_trash_stack_height(&doc->priv->undo_actions);
+
+		/* We use add_undo_reload_action to track any changes to the document that
+		 * require adding an undo action to revert the reload, but that do not
+		 * generate an undo action themselves. */
+		add_undo_reload_action = FALSE;
+	}
+
+	/* add the text to the ScintillaObject */
+	sci_set_readonly(doc->editor->sci, FALSE);	/* to allow replacing text */
+	if (filedata->sci_doc != NULL)
+	{
+		/* the text has been read into a Scintilla document already */
+		sci_set_loaded_document(doc->editor->sci, filedata->sci_doc);
+		sci_set_codepage(doc->editor->sci, SC_CP_UTF8);
+		editor_apply_update_prefs(doc->editor);
+	}
+	else if (reload)
+		replace_changed_text(doc->editor->sci, filedata->data, filedata->len);
+	else
+	{
+		if (filedata->lines > 1)
+			sci_allocate_lines(doc->editor->sci, filedata->lines);
+		sci_set_text(doc->editor->sci, filedata->data);	/* NULL terminated data */
+	}
+	queue_colourise(doc);	/* Ensure the document gets colourised. */
+
+	/* detect & set line endings */
+	editor_mode = filedata->eol_mode;
+	if (undo_reload_data)
+	{
+		undo_reload_data->eol_mode = editor_get_eol_char_mode(doc->editor);
+		/* Force adding an undo-reload action if the EOL mode changed. */
+		if (editor_mode != undo_reload_data->eol_mode)
+			add_undo_reload_action = TRUE;
+	}
+	sci_set_eol_mode(doc->editor->sci, editor_mode);
+	g_free(filedata->data);
+
+	sci_set_undo_collection(doc->editor->sci, TRUE);
+
+	/* If reloading and the current and new encodings or BOM states differ,
+	 * add appropriate undo actions. */
+	if (undo_reload_data)
+	{
+		if (! utils_str_equal(doc->encoding, filedata->enc))
+			document_undo_add(doc, UNDO_ENCODING, g_strdup(doc->encoding));
+		if (doc->has_bom != filedata->bom)
+			document_undo_add(doc, UNDO_BOM, GINT_TO_POINTER(doc->has_bom));
+	}
+
+	doc->priv->mtime = filedata->mtime; /* get the modification time from file and keep it */
+	SETPTR(doc->priv->disk_checksum, filedata->checksum);
+	g_free(doc->encoding);	/* if reloading, free old encoding */
+	doc->encoding = filedata->enc;
+	doc->has_bom = filedata->bom;
+	store_saved_encoding(doc);	/* store the opened encoding for undo/redo */
+
+	doc->readonly = readonly || filedata->readonly || filedata->viewer;
+	sci_set_readonly(doc->editor->sci, doc->readonly);
+	if (! reload)
+		doc->priv->viewer = filedata->viewer;
+	doc->priv->protected = 0;
+
+	/* update line number margin width */
+	doc->priv->line_count = sci_get_line_count(doc->editor->sci);
+	sci_set_line_numbers(doc->editor->sci, editor_prefs.show_linenumber_margin);
+
+	if (! reload)
+	{
+
+		/* "the" SCI signal (connect after initial setup(i.e. adding text)) */
+		g_signal_connect(doc->editor->sci, "sci-notify", G_CALLBACK(editor_sci_notify_cb),
+			doc->editor);
+
+		use_ft = (ft != NULL) ? ft : filetypes_detect_from_document(doc);
+	}
+	else
+	{	/* reloading */
+		if (undo_reload_data)
+		{
+			/* Calculate the number of undo actions that are part of the reloading
+			 * process, and add the UNDO_RELOAD action. */
+			undo_reload_data->actions_count =
+				g_trash_stack_height(&doc->priv->undo_actions) - undo_reload_data->actions_count;
+
+			/* We only add an undo-reload action if the document has actually changed.
+			 * Only the range of the text that differs from the file is replaced, so
+			 * actions_count is zero if the text hasn't really changed.
+			 * It's arguable whether we should add an undo-reload action unconditionally,
+			 * especially since it's possible (if unlikely) that there had only
+			 * been "invisible" changes to the document, such as changes in encoding and
+			 * EOL mode, but for the time being that's how we roll. */
+			if (undo_reload_data->actions_count > 0 || add_undo_reload_action)
+				document_undo_add(doc, UNDO_RELOAD, undo_reload_data);
+			else
+				g_free(undo_reload_data);
+
+			/* We didn't save the document per-se, but its contents are now
+			 * synchronized with the file on disk, hence set a save point here.
+			 * We need to do this in this case only, because we don't clear
+			 * Scintilla's undo stack. */
+			sci_set_savepoint(doc->editor->sci);
+		}
+		else
+			document_undo_clear(doc);
+
+		use_ft = ft;
+	}
+	/* update taglist, typedef keywords and build menu if necessary */
+	document_set_filetype(doc, use_ft);
+
+	/* set indentation settings after setting the filetype */
+	if (reload)
+		editor_set_indent(doc->editor, doc->editor->indent_type, doc->editor->indent_width); /* resetup sci */
+	else if (doc->priv->viewer)
+	{
+		/* detecting the indentation would scan the whole file */
+		const GeanyIndentPrefs *iprefs = editor_get_indent_prefs(NULL);
+
+		editor_set_indent(doc->editor, iprefs->type, iprefs->width);
+	}
+	else
+		document_apply_indent_settings(doc);
+
+	document_set_text_changed(doc, FALSE);	/* also updates tab state */
+	ui_document_show_hide(doc);	/* update the document menu */
+
+	/* finally add current file to recent files menu, but not the files from the last session */
+	if (! main_status.opening_session_files)
+		ui_add_recent_document(doc);
+
+	if (reload)
+	{
+		g_signal_emit_by_name(geany_object, "document-reload", doc);
+		ui_set_statusbar(TRUE, _("File %s reloaded."), display_filename);
+	}
+	else
+	{
+		g_signal_emit_by_name(geany_object, "document-open", doc);
+		/* For translators: this is the status window message for opening a file. %d is the number
+		 * of the newly opened file, %s indicates whether the file is opened read-only
+		 * (it is replaced with the string ", read-only"). */
+		msgwin_status_add(_("File %s opened (%d%s)."),
+			display_filename, gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook)),
+			(readonly) ? _(", read-only") : "");
+	}
+
+	/* now the document is fully ready, display it (see notebook_new_tab()) */
+	gtk_widget_show(document_get_notebook_child(doc));
+
+	return doc;
+}
+
+
+/* To open a new file, set doc to NULL; filename should be locale encoded.
+ * To reload a file, set the doc for the document to be reloaded; filename should be NULL.
+ * pos is the cursor position, which can be overridden by --line and --column.
+ * forced_enc can be NULL to detect the file encoding.
+ * Returns: doc of the opened file or NULL if an error occurred. */
+GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
+		gboolean readonly, GeanyFiletype *ft, const gchar *forced_enc)
+{
+	gboolean reload = (doc == NULL) ? FALSE : TRUE;
+	gchar *utf8_filename = NULL;
+	gchar *display_filename = NULL;
+	gchar *locale_filename = NULL;
+	FileData filedata;
+
+	g_return_val_if_fail(doc == NULL || doc->is_valid, NULL);
+
+	if (reload)
+	{
+		utf8_filename = g_strdup(doc->file_name);
+		locale_filename = utils_get_locale_from_utf8(utf8_filename);
+	}
+	else
+	{
+		/* filename must not be NULL when opening a file */
+		g_return_val_if_fail(filename, NULL);
 
 #ifdef G_OS_WIN32
 		/* if filename is a shortcut, try to resolve it */
@@ -1344,178 +1924,514 @@ GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename
 			return NULL;
 		}
 
-		if (! reload)
-		{
-			doc = document_create(utf8_filename);
-			g_return_val_if_fail(doc != NULL, NULL); /* really should not happen */
+		doc = open_loaded_file(doc, utf8_filename, locale_filename, display_filename,
+			&filedata, readonly, ft);
+	}
+
+	g_free(display_filename);
+	g_free(utf8_filename);
+	g_free(locale_filename);
+
+	/* set the cursor position according to pos, cl_options.goto_line and cl_options.goto_column */
+	pos = set_cursor_position(doc->editor, pos);
+	/* now bring the file in front */
+	editor_goto_pos(doc->editor, pos, FALSE);
+
+	/* finally, let the editor widget grab the focus so you can start coding
+	 * right away */
+	g_idle_add(on_idle_focus, doc);
+	return doc;
+}
+
+
+/* A file being read on a worker thread for document_open_file_async() */
+typedef struct
+{
+	gchar			*locale_filename;
+	gchar			*utf8_filename;
+	gchar			*display_filename;
+	gchar			*forced_enc;
+	GeanyFiletype	*ft;
+	gboolean		 readonly;
+	gboolean		 use_gio;
+	gsize			 size;			/* file size when opening started */
+	gboolean		 viewer;		/* whether it's opened as a viewer, see large_file_viewer_size */
+	gint			 goto_line;		/* cl_options.goto_line when opening started */
+	gint			 goto_column;
+	volatile gint	 read_kib;		/* progress of the worker */
+	FileData		 filedata;		/* filedata.sci_doc is the loader while streaming */
+	gboolean		 success;
+	gchar			*error;		/* status bar message on failure */
+	GCancellable	*cancellable;
+	GThread			*thread;
+} AsyncOpen;
+
+static guint async_progress_id = 0;
+static GtkWidget *async_cancel_button = NULL;
+
+
+static void async_open_free(AsyncOpen *op)
+{
+	if (op->filedata.sci_doc != NULL)
+		scintilla_loader_release(op->filedata.sci_doc);
+	g_free(op->filedata.data);
+	g_free(op->filedata.enc);
+	g_free(op->filedata.checksum);
+	g_free(op->locale_filename);
+	g_free(op->utf8_filename);
+	g_free(op->display_filename);
+	g_free(op->forced_enc);
+	g_free(op->error);
+	g_object_unref(op->cancellable);
+	g_free(op);
+}
+
+
+/* Stops reading the files not opened yet, used on quit when their documents can not be
+ * added anymore */
+static void async_open_cancel_all(void)
+{
+	GSList *node;
+
+	foreach_slist(node, async_opens)
+	{
+		AsyncOpen *op = node->data;
+
+		g_cancellable_cancel(op->cancellable);
+		g_thread_join(op->thread);
+		g_idle_remove_by_data(op);
+		async_open_free(op);
+	}
+	g_slist_free(async_opens);
+	async_opens = NULL;
+
+	if (async_progress_id != 0)
+		async_progress_hide();
+}
+
+
+/* Reserves the line index of a loader for a text of size bytes, extrapolating the lines
+ * counted in its first counted bytes, so that it is not grown over and over while adding
+ * the text of a large file. */
+static void allocate_loader_lines(gpointer loader, const GeanyLineEndingCounts *counts,
+	gsize counted, gsize size)
+{
+	gsize lines = counts->cr + counts->lf + counts->crlf;
+
+	if (counted > 0 && counted < size && lines > 0)
+		scintilla_loader_allocate_lines(loader, (gssize) ((gdouble) lines * size / counted) + 1);
+}
 
-			/* file exists on disk, set real_path */
-			SETPTR(doc->real_path, utils_get_real_path(locale_filename));
 
-			doc->priv->is_remote = utils_is_remote_path(locale_filename);
-			monitor_file_setup(doc);
+/* Reads a file into the Scintilla loader in op->filedata.sci_doc chunk by chunk, as long
+ * as it is valid UTF-8 without null bytes.
+ * Returns: FALSE if the file needs encoding detection on its whole contents instead,
+ * otherwise op->success tells whether it could be read. */
+static gboolean async_open_stream_utf8(AsyncOpen *op)
+{
+	FileData *filedata = &op->filedata;
+	GeanyLineEndingCounts counts = { 0 };
+	GFile *file = g_file_new_for_path(op->locale_filename);
+	GChecksum *checksum;
+	GInputStream *stream;
+	GError *err = NULL;
+	gchar *buffer;
+	gsize carry = 0;	/* bytes of a character split by the end of the previous chunk */
+	gsize total = 0;
+	gboolean first = TRUE;
+	gboolean streamed = TRUE;
+
+	stream = G_INPUT_STREAM(g_file_read(file, op->cancellable, &err));
+	g_object_unref(file);
+	if (stream == NULL)
+	{
+		op->error = g_strdup(err->message);
+		g_error_free(err);
+		return TRUE;
+	}
+
+	checksum = g_checksum_new(G_CHECKSUM_MD5);
+	buffer = g_malloc(ASYNC_OPEN_CHUNK_SIZE);
+	while (TRUE)
+	{
+		gchar *chunk = buffer;
+		const gchar *end;
+		gsize n_read, len, valid;
+
+		if (! g_input_stream_read_all(stream, buffer + carry, ASYNC_OPEN_CHUNK_SIZE - carry,
+				&n_read, op->cancellable, &err))
+		{
+			op->error = g_strdup(err->message);
+			g_error_free(err);
+			break;
+		}
+		g_checksum_update(checksum, (const guchar *) buffer + carry, n_read);
+		len = carry + n_read;
+		total += n_read;
+
+		if (first)
+		{
+			first = FALSE;
+			if (! encodings_check_utf8_head(buffer, len, op->forced_enc, &filedata->bom))
+			{
+				streamed = FALSE;
+				break;
+			}
+			if (filedata->bom)
+			{
+				chunk += 3;
+				len -= 3;
+			}
+		}
+		if (len == 0)
+		{
+			op->success = TRUE;
+			break;
 		}
 
-		if (! reload || ! file_prefs.keep_edit_history_on_reload)
+		/* g_utf8_validate() also stops at null bytes */
+		if (! g_utf8_validate(chunk, len, &end) && (n_read == 0 ||
+			g_utf8_get_char_validated(end, chunk + len - end) != (gunichar) -2))
 		{
-			sci_set_undo_collection(doc->editor->sci, FALSE); /* avoid creation of an undo action */
-			sci_empty_undo_buffer(doc->editor->sci);
-			undo_reload_data = NULL;
+			streamed = FALSE;
+			break;
 		}
-		else
+		valid = end - chunk;
+		utils_count_line_endings(&counts, chunk, valid);
+		if (total == n_read)
+			allocate_loader_lines(filedata->sci_doc, &counts, valid, op->size);
+		if (scintilla_loader_add_data(filedata->sci_doc, chunk, valid) != SC_STATUS_OK)
 		{
-			undo_reload_data = (UndoReloadData*) g_malloc(sizeof(UndoReloadData));
+			op->error = g_strdup_printf(_("The file \"%s\" is too large to be opened."),
+				op->display_filename);
+			break;
+		}
+		carry = len - valid;
+		memmove(buffer, chunk + valid, carry);
+		g_atomic_int_set(&op->read_kib, (gint) (total / 1024));
+	}
+	g_free(buffer);
+	g_object_unref(stream);
 
-			/* We will be adding a UNDO_RELOAD action to the undo stack that undoes
-			 * this reload. To do that, we keep collecting undo actions during
-			 * reloading, and at the end add an UNDO_RELOAD action that performs
-			 * all these actions in bulk. To keep track of how many undo actions
-			 * were added during this time, we compare the current undo-stack height
-			 * with its height at the end of the process. Note that g_trash_stack_height()
-			 * is O(N), which is a little ugly, but this seems like the most maintainable
-			 * option. */
-			undo_reload_data->actions_count = g_trash_stack_height(&doc->priv->undo_actions);
+	if (op->success)
+	{
+		filedata->enc = g_strdup("UTF-8");
+		filedata->eol_mode = utils_get_line_endings_from_counts(&counts);
+		filedata->checksum = g_strdup(g_checksum_get_string(checksum));
+	}
+	g_checksum_free(checksum);
+	return streamed;
+}
 
-			/* We use add_undo_reload_action to track any changes to the document that
-			 * require adding an undo action to revert the reload, but that do not
-			 * generate an undo action themselves. */
-			add_undo_reload_action = FALSE;
-		}
 
-		/* add the text to the ScintillaObject */
-		sci_set_readonly(doc->editor->sci, FALSE);	/* to allow replacing text */
-		sci_set_text(doc->editor->sci, filedata.data);	/* NULL terminated data */
-		queue_colourise(doc);	/* Ensure the document gets colourised. */
+/* Feeds a file unconverted to the loader in op->filedata.sci_doc straight from a mapping of
+ * the file, for a viewer document. The encoding is only guessed from the start of the file
+ * as the viewer can not be saved anyway. */
+static void async_open_map(AsyncOpen *op)
+{
+	FileData *filedata = &op->filedata;
+	GeanyLineEndingCounts counts = { 0 };
+	GMappedFile *map;
+	GError *err = NULL;
+	const gchar *contents;
+	const gchar *end;
+	gsize size, head, offset = 0;
 
-		/* detect & set line endings */
-		editor_mode = utils_get_line_endings(filedata.data, filedata.len);
-		if (undo_reload_data)
-		{
-			undo_reload_data->eol_mode = editor_get_eol_char_mode(doc->editor);
-			/* Force adding an undo-reload action if the EOL mode changed. */
-			if (editor_mode != undo_reload_data->eol_mode)
-				add_undo_reload_action = TRUE;
-		}
-		sci_set_eol_mode(doc->editor->sci, editor_mode);
-		g_free(filedata.data);
+	map = g_mapped_file_new(op->locale_filename, FALSE, &err);
+	if (map == NULL)
+	{
+		op->error = g_strdup(err->message);
+		g_error_free(err);
+		return;
+	}
+	contents = g_mapped_file_get_contents(map);
+	size = g_mapped_file_get_length(map);
+
+	head = MIN(size, ASYNC_OPEN_CHUNK_SIZE);
+	if (encodings_check_utf8_head(contents, head, op->forced_enc, &filedata->bom) &&
+		(g_utf8_validate(contents, head, &end) ||
+			(head < size && g_utf8_get_char_validated(end, contents + head - end) == (gunichar) -2)))
+	{
+		filedata->enc = g_strdup("UTF-8");
+		if (filedata->bom)
+			offset = 3;
+	}
+	else
+	{
+		filedata->enc = g_strdup(encodings[GEANY_ENCODING_NONE].charset);
+		filedata->bom = FALSE;
+	}
 
-		sci_set_undo_collection(doc->editor->sci, TRUE);
+	while (offset < size)
+	{
+		gsize len = MIN(size - offset, ASYNC_OPEN_CHUNK_SIZE);
 
-		/* If reloading and the current and new encodings or BOM states differ,
-		 * add appropriate undo actions. */
-		if (undo_reload_data)
+		if (g_cancellable_set_error_if_cancelled(op->cancellable, &err))
 		{
-			if (! utils_str_equal(doc->encoding, filedata.enc))
-				document_undo_add(doc, UNDO_ENCODING, g_strdup(doc->encoding));
-			if (doc->has_bom != filedata.bom)
-				document_undo_add(doc, UNDO_BOM, GINT_TO_POINTER(doc->has_bom));
+			op->error = g_strdup(err->message);
+			g_error_free(err);
+			break;
 		}
+		utils_count_line_endings(&counts, contents + offset, len);
+		if (offset < ASYNC_OPEN_CHUNK_SIZE)
+			allocate_loader_lines(filedata->sci_doc, &counts, len, size - offset);
+		if (scintilla_loader_add_data(filedata->sci_doc, contents + offset, len) != SC_STATUS_OK)
+		{
+			op->error = g_strdup_printf(_("The file \"%s\" is too large to be opened."),
+				op->display_filename);
+			break;
+		}
+		offset += len;
+		g_atomic_int_set(&op->read_kib, (gint) (offset / 1024));
+	}
+	g_mapped_file_unref(map);
 
-		doc->priv->mtime = filedata.mtime; /* get the modification time from file and keep it */
-		g_free(doc->encoding);	/* if reloading, free old encoding */
-		doc->encoding = filedata.enc;
-		doc->has_bom = filedata.bom;
-		store_saved_encoding(doc);	/* store the opened encoding for undo/redo */
+	op->success = (op->error == NULL);
+	filedata->eol_mode = utils_get_line_endings_from_counts(&counts);
+	filedata->viewer = TRUE;
+}
 
-		doc->readonly = readonly || filedata.readonly;
-		sci_set_readonly(doc->editor->sci, doc->readonly);
-		doc->priv->protected = 0;
 
-		/* update line number margin width */
-		doc->priv->line_count = sci_get_line_count(doc->editor->sci);
-		sci_set_line_numbers(doc->editor->sci, editor_prefs.show_linenumber_margin);
+static gboolean async_progress_update(gpointer data)
+{
+	GSList *node;
+	gdouble size = 0, done = 0;
 
-		if (! reload)
-		{
+	foreach_slist(node, async_opens)
+	{
+		AsyncOpen *op = node->data;
 
-			/* "the" SCI signal (connect after initial setup(i.e. adding text)) */
-			g_signal_connect(doc->editor->sci, "sci-notify", G_CALLBACK(editor_sci_notify_cb),
-				doc->editor);
+		size += op->size;
+		done += g_atomic_int_get(&op->read_kib) * 1024.0;
+	}
+	if (size > 0)
+		gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(main_widgets.progressbar), MIN(done / size, 1.0));
+	return TRUE;
+}
 
-			use_ft = (ft != NULL) ? ft : filetypes_detect_from_document(doc);
-		}
-		else
-		{	/* reloading */
-			if (undo_reload_data)
-			{
-				/* Calculate the number of undo actions that are part of the reloading
-				 * process, and add the UNDO_RELOAD action. */
-				undo_reload_data->actions_count =
-					g_trash_stack_height(&doc->priv->undo_actions) - undo_reload_data->actions_count;
-
-				/* We only add an undo-reload action if the document has actually changed.
-				 * At the time of writing, this condition is moot because sci_set_text
-				 * generates an undo action even when the text hasn't really changed, so
-				 * actions_count is always greater than zero. In the future this might change.
-				 * It's arguable whether we should add an undo-reload action unconditionally,
-				 * especially since it's possible (if unlikely) that there had only
-				 * been "invisible" changes to the document, such as changes in encoding and
-				 * EOL mode, but for the time being that's how we roll. */
-				if (undo_reload_data->actions_count > 0 || add_undo_reload_action)
-					document_undo_add(doc, UNDO_RELOAD, undo_reload_data);
-				else
-					g_free(undo_reload_data);
-
-				/* We didn't save the document per-se, but its contents are now
-				 * synchronized with the file on disk, hence set a save point here.
-				 * We need to do this in this case only, because we don't clear
-				 * Scintilla's undo stack. */
-				sci_set_savepoint(doc->editor->sci);
-			}
-			else
-				document_undo_clear(doc);
 
-			use_ft = ft;
+/* Stops reading all files being opened, without waiting for the workers. Their documents are
+ * not added once they have stopped. */
+static void on_async_open_cancel_clicked(GtkButton *button, gpointer data)
+{
+	GSList *node;
+
+	foreach_slist(node, async_opens)
+		g_cancellable_cancel(((AsyncOpen *) node->data)->cancellable);
+	gtk_widget_set_sensitive(async_cancel_button, FALSE);
+	ui_set_statusbar(FALSE, _("Stopped opening files."));
+}
+
+
+/* Shows the progress of the files being opened next to a button to stop opening them */
+static void async_progress_show(void)
+{
+	if (async_cancel_button == NULL)
+	{
+		GtkWidget *image = gtk_image_new_from_stock(GTK_STOCK_STOP, GTK_ICON_SIZE_MENU);
+
+		async_cancel_button = gtk_button_new();
+		gtk_button_set_relief(GTK_BUTTON(async_cancel_button), GTK_RELIEF_NONE);
+		gtk_button_set_focus_on_click(GTK_BUTTON(async_cancel_button), FALSE);
+		gtk_container_add(GTK_CONTAINER(async_cancel_button), image);
+		gtk_widget_show(image);
+		gtk_widget_set_tooltip_text(async_cancel_button, _("Stop opening files"));
+		gtk_box_pack_start(GTK_BOX(ui_widgets.statusbar), async_cancel_button, FALSE, FALSE, 0);
+		g_signal_connect(async_cancel_button, "clicked",
+			G_CALLBACK(on_async_open_cancel_clicked), NULL);
+	}
+	gtk_widget_set_sensitive(async_cancel_button, TRUE);
+	gtk_widget_show(async_cancel_button);
+
+	gtk_progress_bar_set_fraction(GTK_PROGRESS_BAR(main_widgets.progressbar), 0.0);
+	gtk_widget_show(main_widgets.progressbar);
+	async_progress_id = g_timeout_add(100, async_progress_update, NULL);
+}
+
+
+static void async_progress_hide(void)
+{
+	g_source_remove(async_progress_id);
+	async_progress_id = 0;
+	gtk_widget_hide(main_widgets.progressbar);
+	if (async_cancel_button != NULL)
+		gtk_widget_hide(async_cancel_button);
+}
+
+
+static gboolean async_open_done(gpointer data)
+{
+	AsyncOpen *op = data;
+	gboolean cancelled;
+
+	g_thread_join(op->thread);
+	async_opens = g_slist_remove(async_opens, op);
+	if (async_opens == NULL && async_progress_id != 0)
+		async_progress_hide();
+
+	/* the user may have stopped opening it */
+	cancelled = g_cancellable_is_cancelled(op->cancellable);
+	if (! op->success)
+	{
+		if (! cancelled)
+			ui_set_statusbar(TRUE, "%s", op->error);
+	}
+	/* the file might have been opened by other means in the meantime */
+	else if (! cancelled && document_find_by_filename(op->utf8_filename) == NULL)
+	{
+		GeanyDocument *doc;
+
+		if (op->filedata.readonly)
+			show_truncated_file_warning(op->display_filename);
+
+		/* a viewer has neither highlighting nor symbols */
+		doc = open_loaded_file(NULL, op->utf8_filename, op->locale_filename,
+			op->display_filename, &op->filedata, op->readonly || op->viewer,
+			op->viewer ? filetypes[GEANY_FILETYPES_NONE] : op->ft);
+		/* the document owns these now */
+		op->filedata.sci_doc = NULL;
+		op->filedata.data = NULL;
+		op->filedata.enc = NULL;
+		op->filedata.checksum = NULL;
+
+		/* the position given on the command line is for this document */
+		cl_options.goto_line = op->goto_line;
+		cl_options.goto_column = op->goto_column;
+		editor_goto_pos(doc->editor, set_cursor_position(doc->editor, 0), FALSE);
+		g_idle_add(on_idle_focus, doc);
+	}
+	async_open_free(op);
+
+	/* nothing might have been opened, like on startup when only opening a large file */
+	if (async_opens == NULL)
+		document_new_file_if_non_open();
+	return FALSE;
+}
+
+
+static gpointer async_open_thread(gpointer data)
+{
+	AsyncOpen *op = data;
+
+	if (op->viewer)
+		async_open_map(op);
+	else if (! async_open_stream_utf8(op))
+	{
+		/* fall back to reading and converting the whole file at once */
+		scintilla_loader_release(op->filedata.sci_doc);
+		g_free(op->filedata.checksum);
+		op->success = read_text_file(op->locale_filename, op->display_filename, &op->filedata,
+			op->forced_enc, op->use_gio, &op->error);
+	}
+	g_idle_add(async_open_done, op);
+	return NULL;
+}
+
+
+/* Opens a file like document_open_file(), except that a large file is read on a worker
+ * thread while the UI keeps running. The document is added once the file has been read.
+ * Files larger than file_prefs.large_file_viewer_size are opened read-only as a viewer,
+ * without conversion, styling or symbols.
+ * Returns: the document if the file was opened right away, otherwise NULL. */
+GeanyDocument *document_open_file_async(const gchar *locale_filename, gboolean readonly,
+		GeanyFiletype *ft, const gchar *forced_enc)
+{
+	AsyncOpen *op;
+	GStatBuf st;
+	GSList *node;
+	gchar *utf8_filename;
+	gchar *tidy_filename;
+
+	g_return_val_if_fail(locale_filename != NULL, NULL);
+
+	if (g_stat(locale_filename, &st) != 0 || ! S_ISREG(st.st_mode) ||
+		st.st_size < ASYNC_OPEN_MIN_SIZE)
+		return document_open_file(locale_filename, readonly, ft, forced_enc);
+
+	tidy_filename = g_strdup(locale_filename);
+	utils_tidy_path(tidy_filename);
+	utf8_filename = utils_get_utf8_from_locale(tidy_filename);
+
+	if (document_find_by_filename(utf8_filename) != NULL)
+	{
+		/* let document_open_file() switch to it */
+		g_free(utf8_filename);
+		g_free(tidy_filename);
+		return document_open_file(locale_filename, readonly, ft, forced_enc);
+	}
+	foreach_slist(node, async_opens)
+	{
+		AsyncOpen *other = node->data;
+
+		if (utils_str_equal(other->utf8_filename, utf8_filename) &&
+			! g_cancellable_is_cancelled(other->cancellable))
+		{
+			/* already being read */
+			g_free(utf8_filename);
+			g_free(tidy_filename);
+			return NULL;
 		}
-		/* update taglist, typedef keywords and build menu if necessary */
-		document_set_filetype(doc, use_ft);
+	}
 
-		/* set indentation settings after setting the filetype */
-		if (reload)
-			editor_set_indent(doc->editor, doc->editor->indent_type, doc->editor->indent_width); /* resetup sci */
-		else
-			document_apply_indent_settings(doc);
+	op = g_new0(AsyncOpen, 1);
+	op->locale_filename = tidy_filename;
+	op->utf8_filename = utf8_filename;
+	op->display_filename = utils_str_middle_truncate(utf8_filename, 100);
+	op->forced_enc = g_strdup(forced_enc);
+	op->ft = ft;
+	op->readonly = readonly;
+	op->use_gio = USE_GIO_FILE_OPERATIONS;
+	op->size = st.st_size;
+	op->cancellable = g_cancellable_new();
+	op->viewer = file_prefs.large_file_viewer_size > 0 &&
+		op->size / (1024 * 1024) >= (gsize) file_prefs.large_file_viewer_size;
+
+	if (! get_mtime(op->locale_filename, &op->filedata.mtime) ||
+		(op->filedata.sci_doc = sci_create_loader(op->size, op->viewer ?
+			SC_DOCUMENTOPTION_STYLES_NONE | SC_DOCUMENTOPTION_TEXT_LARGE :
+			SC_DOCUMENTOPTION_DEFAULT)) == NULL)
+	{
+		async_open_free(op);
+		return NULL;
+	}
 
-		document_set_text_changed(doc, FALSE);	/* also updates tab state */
-		ui_document_show_hide(doc);	/* update the document menu */
+	/* other files opened meanwhile must not take the position given on the command line */
+	op->goto_line = cl_options.goto_line;
+	op->goto_column = cl_options.goto_column;
+	cl_options.goto_line = -1;
+	cl_options.goto_column = -1;
 
-		/* finally add current file to recent files menu, but not the files from the last session */
-		if (! main_status.opening_session_files)
-			ui_add_recent_document(doc);
+	op->thread = g_thread_new("document-open", async_open_thread, op);
+	async_opens = g_slist_prepend(async_opens, op);
 
-		if (reload)
-		{
-			g_signal_emit_by_name(geany_object, "document-reload", doc);
-			ui_set_statusbar(TRUE, _("File %s reloaded."), display_filename);
-		}
-		else
-		{
-			g_signal_emit_by_name(geany_object, "document-open", doc);
-			/* For translators: this is the status window message for opening a file. %d is the number
-			 * of the newly opened file, %s indicates whether the file is opened read-only
-			 * (it is replaced with the string ", read-only"). */
-			msgwin_status_add(_("File %s opened (%d%s)."),
-				display_filename, gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook)),
-				(readonly) ? _(", read-only") : "");
-		}
+	if (async_progress_id == 0 && interface_prefs.statusbar_visible)
+		async_progress_show();
+	gtk_progress_bar_set_text(GTK_PROGRESS_BAR(main_widgets.progressbar), op->display_filename);
+	return NULL;
+}
 
-		/* now the document is fully ready, display it (see notebook_new_tab()) */
-		gtk_widget_show(document_get_notebook_child(doc));
-	}
 
-	g_free(display_filename);
-	g_free(utf8_filename);
-	g_free(locale_filename);
+/* Opens the files of filenames like document_open_files(), except that the large ones are
+ * read on worker threads by document_open_file_async(). */
+void document_open_files_async(const GSList *filenames, gboolean readonly,
+		GeanyFiletype *ft, const gchar *forced_enc)
+{
+	const GSList *item;
+	GSList *others = NULL;
 
-	/* set the cursor position according to pos, cl_options.goto_line and cl_options.goto_column */
-	pos = set_cursor_position(doc->editor, pos);
-	/* now bring the file in front */
-	editor_goto_pos(doc->editor, pos, FALSE);
+	for (item = filenames; item != NULL; item = g_slist_next(item))
+	{
+		GStatBuf st;
 
-	/* finally, let the editor widget grab the focus so you can start coding
-	 * right away */
-	g_idle_add(on_idle_focus, doc);
-	return doc;
+		if (g_stat(item->data, &st) == 0 && S_ISREG(st.st_mode) &&
+			st.st_size >= ASYNC_OPEN_MIN_SIZE)
+			document_open_file_async(item->data, readonly, ft, forced_enc);
+		else
+			others = g_slist_prepend(others, item->data);
+	}
+	others = g_slist_reverse(others);
+	document_open_files(others, readonly, ft, forced_enc);
+	g_slist_free(others);
 }
 
 
@@ -1525,6 +2441,7 @@ void document_open_file_list(const gchar *data, gsize length)
 {
 	guint i;
 	gchar **list;
+	GSList *filenames = NULL;
 
 	g_return_if_fail(data != NULL);
 
@@ -1535,19 +2452,62 @@ void document_open_file_list(const gchar *data, gsize length)
 	{
 		gchar *filename = utils_get_path_from_uri(list[i]);
 
-		if (filename == NULL)
-			continue;
-		document_open_file(filename, FALSE, NULL, NULL);
-		g_free(filename);
+		if (filename != NULL)
+			filenames = g_slist_prepend(filenames, filename);
 	}
+	filenames = g_slist_reverse(filenames);
+	document_open_files_async(filenames, FALSE, NULL, NULL);
 
+	g_slist_free_full(filenames, g_free);
 	g_strfreev(list);
 }
 
 
+/* Starts opening several files at once. Until document_open_batch_end(), the open files list
+ * is not updated and the symbols of the opened files are not parsed, so that both happen once
+ * for the whole batch. Batches can be nested. */
+void document_open_batch_begin(void)
+{
+	if (open_batch++ > 0)
+		return;
+
+	open_batch_docs = g_ptr_array_new();
+	sidebar_openfiles_freeze();
+}
+
+
+void document_open_batch_end(void)
+{
+	GPtrArray *docs;
+	GeanyDocument *doc;
+
+	g_return_if_fail(open_batch > 0);
+
+	if (--open_batch > 0)
+		return;
+
+	docs = open_batch_docs;
+	open_batch_docs = NULL;
+	sidebar_openfiles_thaw();
+	update_batch_tags(docs);
+	g_ptr_array_free(docs, TRUE);
+
+	doc = document_get_current();
+	if (doc != NULL)
+		sidebar_select_openfiles_item(doc);
+}
+
+
+gboolean document_open_batch_active(void)
+{
+	return open_batch > 0;
+}
+
+
 /**
  *  Opens each file in the list @a filenames.
- *  Internally, document_open_file() is called for every list item.
+ *  The files are read ahead in parallel and opened as one batch, so that their symbols are
+ *  parsed together and the open files list is updated once.
  *
  *  @param filenames @elementtype{filename} A list of filenames to load, in locale encoding.
  *  @param readonly Whether to open the document in read-only mode.
@@ -1560,10 +2520,16 @@ void document_open_files(const GSList *filenames, gboolean readonly, GeanyFilety
 {
 	const GSList *item;
 
+	for (item = filenames; item != NULL; item = g_slist_next(item))
+		document_prefetch_file(item->data, forced_enc);
+
+	document_open_batch_begin();
 	for (item = filenames; item != NULL; item = g_slist_next(item))
 	{
 		document_open_file(item->data, readonly, ft, forced_enc);
 	}
+	document_open_batch_end();
+	document_prefetch_clear();
 }
 
 
@@ -1603,6 +2569,16 @@ gboolean document_reload_force(GeanyDocument *doc, const gchar *forced_enc)
 
 	g_return_val_if_fail(doc != NULL, FALSE);
 
+	async_save_wait(doc);
+
+	if (doc->priv->viewer)
+	{
+		/* reading it synchronously and converting it would defeat the viewer */
+		ui_set_statusbar(TRUE, _("The file \"%s\" is opened as a viewer and can not be reloaded. "
+			"Close it and open it again instead."), DOC_FILENAME(doc));
+		return FALSE;
+	}
+
 	/* Cancel resave bar if still open from previous file deletion */
 	if (doc->priv->info_bars[MSG_TYPE_RESAVE] != NULL)
 		gtk_info_bar_response(GTK_INFO_BAR(doc->priv->info_bars[MSG_TYPE_RESAVE]), GTK_RESPONSE_CANCEL);
@@ -1670,11 +2646,9 @@ gboolean document_reload_prompt(GeanyDocument *doc, const gchar *forced_enc)
 
 static void document_update_timestamp(GeanyDocument *doc, const gchar *locale_filename)
 {
-#ifndef USE_GIO_FILEMON
 	g_return_if_fail(doc != NULL);
 
 	get_mtime(locale_filename, &doc->priv->mtime); /* get the modification time from file and keep it */
-#endif
 }
 
 
@@ -1791,253 +2765,591 @@ static void unprotect_document(GeanyDocument *doc)
 }
 
 
-/* Return TRUE if the document doesn't have a full filename set.
- * This makes filenames without a path show the save as dialog, e.g. for file templates.
- * Otherwise just use the set filename instead of asking the user - e.g. for command-line
- * new files. */
-gboolean document_need_save_as(GeanyDocument *doc)
+/* Return TRUE if the document doesn't have a full filename set.
+ * This makes filenames without a path show the save as dialog, e.g. for file templates.
+ * Otherwise just use the set filename instead of asking the user - e.g. for command-line
+ * new files. */
+gboolean document_need_save_as(GeanyDocument *doc)
+{
+	g_return_val_if_fail(doc != NULL, FALSE);
+
+	return (doc->file_name == NULL || !g_path_is_absolute(doc->file_name));
+}
+
+
+/**
+ * Saves the document, detecting the filetype.
+ *
+ * @param doc The document for the file to save.
+ * @param utf8_fname @nullable The new name for the document, in UTF-8, or @c NULL.
+ * @return @c TRUE if the file was saved or @c FALSE if the file could not be saved.
+ *
+ * @see document_save_file().
+ *
+ *  @since 0.16
+ **/
+GEANY_API_SYMBOL
+gboolean document_save_file_as(GeanyDocument *doc, const gchar *utf8_fname)
+{
+	gboolean ret;
+	gboolean new_file;
+
+	g_return_val_if_fail(doc != NULL, FALSE);
+
+	new_file = document_need_save_as(doc) || (utf8_fname != NULL && strcmp(doc->file_name, utf8_fname) != 0);
+	document_index_remove(doc);
+	if (utf8_fname != NULL)
+		SETPTR(doc->file_name, g_strdup(utf8_fname));
+
+	/* reset real path, it's retrieved again in document_save() */
+	SETPTR(doc->real_path, NULL);
+	document_index_add(doc);
+
+	/* detect filetype */
+	if (doc->file_type->id == GEANY_FILETYPES_NONE)
+	{
+		GeanyFiletype *ft = filetypes_detect_from_document(doc);
+
+		document_set_filetype(doc, ft);
+		if (document_get_current() == doc)
+		{
+			ignore_callback = TRUE;
+			filetypes_select_radio_item(doc->file_type);
+			ignore_callback = FALSE;
+		}
+	}
+
+	if (new_file)
+	{
+		// assume user wants to throw away read-only setting
+		sci_set_readonly(doc->editor->sci, FALSE);
+		doc->readonly = FALSE;
+		if (doc->priv->protected > 0)
+			unprotect_document(doc);
+	}
+
+	replace_header_filename(doc);
+
+	ret = document_save_file(doc, TRUE);
+
+	/* file monitoring support, add file monitoring after the file has been saved
+	 * to ignore any earlier events */
+	monitor_file_setup(doc);
+	doc->priv->file_disk_status = FILE_IGNORE;
+	return ret;
+}
+
+
+/* How files are written, from the file saving prefs */
+typedef enum
+{
+	SAVE_MODE_SAFE,			/* write a temporary file and rename it over the file */
+	SAVE_MODE_GIO,
+	SAVE_MODE_GIO_BACKUP,	/* GIO, keeping the previous file as a backup */
+	SAVE_MODE_POSIX
+}
+SaveMode;
+
+/* A file written by document_save_file() chunk by chunk */
+typedef struct
+{
+	gchar			*locale_filename;
+	gchar			*display_name;
+	gchar			*tmp_filename;	/* safe saving writes this file and renames it at the end */
+	gint			 fd;
+	GOutputStream	*stream;		/* GIO saving */
+	FILE			*fp;			/* POSIX saving */
+	GChecksum		*checksum;		/* of the data written */
+}
+SaveWriter;
+
+
+static void set_file_error_from_errno(GError **error, gint save_errno, const gchar *format,
+		const gchar *display_name)
+{
+	g_set_error(error, G_FILE_ERROR, g_file_error_from_errno(save_errno), format,
+		display_name, g_strerror(save_errno));
+}
+
+
+static SaveMode get_save_mode(void)
+{
+	if (file_prefs.use_safe_file_saving)
+		return SAVE_MODE_SAFE;
+	if (USE_GIO_FILE_OPERATIONS)
+		return file_prefs.gio_unsafe_save_backup ? SAVE_MODE_GIO_BACKUP : SAVE_MODE_GIO;
+	return SAVE_MODE_POSIX;
+}
+
+
+static void save_writer_free_names(SaveWriter *writer)
+{
+	g_free(writer->tmp_filename);
+	g_free(writer->display_name);
+	g_free(writer->locale_filename);
+}
+
+
+/* Opens the file to write. On failure writer is left cleared. */
+static gboolean save_writer_open(SaveWriter *writer, const gchar *locale_filename,
+		SaveMode mode, GError **error)
+{
+	memset(writer, 0, sizeof *writer);
+	writer->fd = -1;
+	writer->locale_filename = g_strdup(locale_filename);
+	writer->display_name = g_filename_display_name(locale_filename);
+
+	if (mode == SAVE_MODE_SAFE)
+	{
+		/* Like g_file_set_contents() (GVFS-safe, but alters ownership and permissons), write a
+		 * temporary file next to the file and rename it over the file once it is complete.
+		 * This is the only option that handles disk space exhaustion. */
+		writer->tmp_filename = g_strconcat(locale_filename, ".XXXXXX", NULL);
+		errno = 0;
+		writer->fd = g_mkstemp_full(writer->tmp_filename, O_RDWR | O_BINARY, 0666);
+		if (writer->fd == -1)
+		{
+			set_file_error_from_errno(error, errno,
+				_("Failed to create file '%s': %s"), writer->display_name);
+			save_writer_free_names(writer);
+			return FALSE;
+		}
+	}
+	else if (mode == SAVE_MODE_GIO || mode == SAVE_MODE_GIO_BACKUP)
+	{
+		GFile *fp;
+
+		/* Use GIO API to save file (GVFS-safe)
+		 * It is best in most GVFS setups but don't seem to work correctly on some more complex
+		 * setups (saving from some VM to their host, over some SMB shares, etc.) */
+		fp = g_file_new_for_path(locale_filename);
+		writer->stream = G_OUTPUT_STREAM(g_file_replace(fp, NULL,
+			mode == SAVE_MODE_GIO_BACKUP, G_FILE_CREATE_NONE, NULL, error));
+		g_object_unref(fp);
+		if (writer->stream == NULL)
+		{
+			save_writer_free_names(writer);
+			return FALSE;
+		}
+	}
+	else
+	{
+		/* Use POSIX API for unsafe saving (GVFS-unsafe) */
+		/* The error handling is taken from glib-2.26.0 gfileutils.c */
+		errno = 0;
+		writer->fp = g_fopen(locale_filename, "wb");
+		if (writer->fp == NULL)
+		{
+			set_file_error_from_errno(error, errno,
+				_("Failed to open file '%s' for writing: fopen() failed: %s"), writer->display_name);
+			save_writer_free_names(writer);
+			return FALSE;
+		}
+	}
+	writer->checksum = g_checksum_new(G_CHECKSUM_MD5);
+	return TRUE;
+}
+
+
+static gboolean save_writer_write(SaveWriter *writer, const gchar *data, gsize len,
+		GError **error)
+{
+	if (len == 0)
+		return TRUE;
+
+	g_checksum_update(writer->checksum, (const guchar *) data, len);
+	if (writer->fd != -1)
+	{
+		while (len > 0)
+		{
+			gssize written;
+
+			errno = 0;
+			written = write(writer->fd, data, len);
+			if (written == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				set_file_error_from_errno(error, errno,
+					_("Failed to write file '%s': write() failed: %s"), writer->display_name);
+				return FALSE;
+			}
+			data += written;
+			len -= written;
+		}
+		return TRUE;
+	}
+	else if (writer->stream != NULL)
+		return g_output_stream_write_all(writer->stream, data, len, NULL, NULL, error);
+	else
+	{
+		errno = 0;
+		if (fwrite(data, sizeof(gchar), len, writer->fp) != len)
+		{
+			set_file_error_from_errno(error, errno,
+				_("Failed to write file '%s': fwrite() failed: %s"), writer->display_name);
+			return FALSE;
+		}
+		return TRUE;
+	}
+}
+
+
+/* Closes the file and, for safe saving, replaces the file with what has been written if
+ * commit is set or discards it otherwise. Reports an error only if none is set yet. */
+static gboolean save_writer_close(SaveWriter *writer, gboolean commit, GError **error)
+{
+	gboolean success = TRUE;
+
+	if (writer->fd != -1)
+	{
+		errno = 0;
+#ifndef G_OS_WIN32
+		/* make sure the data is on disk before it replaces the file */
+		if (commit && fsync(writer->fd) != 0)
+		{
+			set_file_error_from_errno(error, errno,
+				_("Failed to write file '%s': fsync() failed: %s"), writer->display_name);
+			commit = success = FALSE;
+		}
+#endif
+		if (close(writer->fd) != 0 && commit)
+		{
+			set_file_error_from_errno(error, errno,
+				_("Failed to close file '%s': close() failed: %s"), writer->display_name);
+			commit = success = FALSE;
+		}
+		if (commit)
+		{
+			errno = 0;
+			if (g_rename(writer->tmp_filename, writer->locale_filename) != 0)
+			{
+				gint save_errno = errno;
+#ifdef G_OS_WIN32
+				/* renaming over an existing file fails on Windows */
+				if (g_unlink(writer->locale_filename) == 0 &&
+					g_rename(writer->tmp_filename, writer->locale_filename) == 0)
+					save_errno = 0;
+#endif
+				if (save_errno != 0)
+				{
+					set_file_error_from_errno(error, save_errno,
+						_("Failed to rename the temporary file to '%s': %s"), writer->display_name);
+					commit = success = FALSE;
+				}
+			}
+		}
+		if (! commit)
+			g_unlink(writer->tmp_filename);
+	}
+	else if (writer->stream != NULL)
+	{
+		success = g_output_stream_close(writer->stream, NULL, (error && *error) ? NULL : error);
+		g_object_unref(writer->stream);
+	}
+	else if (writer->fp != NULL)
+	{
+		errno = 0;
+		/* preserve the fwrite() error if any */
+		if (fclose(writer->fp) != 0)
+		{
+			if (error == NULL || *error == NULL)
+			{
+				set_file_error_from_errno(error, errno,
+					_("Failed to close file '%s': fclose() failed: %s"), writer->display_name);
+			}
+			success = FALSE;
+		}
+	}
+
+	g_checksum_free(writer->checksum);
+	save_writer_free_names(writer);
+	return success;
+}
+
+
+/* Replaces the contents of a file with data through a temporary file which is renamed over
+ * the file once complete, so that a failed write leaves the file untouched. Unlike safe
+ * saving of documents, the permissions of the file are kept. Can be used from any thread. */
+gboolean document_replace_file_contents(const gchar *locale_filename, const gchar *data,
+		gsize len, GError **error)
+{
+	SaveWriter writer;
+	GStatBuf st;
+	gboolean success;
+
+	if (! save_writer_open(&writer, locale_filename, SAVE_MODE_SAFE, error))
+		return FALSE;
+	if (g_stat(locale_filename, &st) == 0)
+		g_chmod(writer.tmp_filename, st.st_mode & 0777);
+
+	success = save_writer_write(&writer, data, len, error);
+	return save_writer_close(&writer, success, error) && success;
+}
+
+
+/* Converts the text of a document being saved from UTF-8 chunk by chunk */
+typedef struct
 {
-	g_return_val_if_fail(doc != NULL, FALSE);
-
-	return (doc->file_name == NULL || !g_path_is_absolute(doc->file_name));
+	GIConv		 cd;
+	SaveWriter	*writer;	/* NULL to only check the conversion */
+	gchar		*out;
+	gsize		 out_len;
+	gchar		 carry[8];	/* the start of a character split between two parts of the text */
+	gsize		 carry_len;
+	gssize		 pos;		/* position of the next input byte in the document */
 }
+SaveConverter;
 
 
-/**
- * Saves the document, detecting the filetype.
- *
- * @param doc The document for the file to save.
- * @param utf8_fname @nullable The new name for the document, in UTF-8, or @c NULL.
- * @return @c TRUE if the file was saved or @c FALSE if the file could not be saved.
- *
- * @see document_save_file().
- *
- *  @since 0.16
- **/
-GEANY_API_SYMBOL
-gboolean document_save_file_as(GeanyDocument *doc, const gchar *utf8_fname)
+static gboolean save_converter_flush(SaveConverter *conv, GError **error)
 {
-	gboolean ret;
-	gboolean new_file;
+	gboolean success = TRUE;
 
-	g_return_val_if_fail(doc != NULL, FALSE);
-
-	new_file = document_need_save_as(doc) || (utf8_fname != NULL && strcmp(doc->file_name, utf8_fname) != 0);
-	if (utf8_fname != NULL)
-		SETPTR(doc->file_name, g_strdup(utf8_fname));
+	if (conv->writer != NULL)
+		success = save_writer_write(conv->writer, conv->out, conv->out_len, error);
+	conv->out_len = 0;
+	return success;
+}
 
-	/* reset real path, it's retrieved again in document_save() */
-	SETPTR(doc->real_path, NULL);
 
-	/* detect filetype */
-	if (doc->file_type->id == GEANY_FILETYPES_NONE)
+/* Converts *in up to an incomplete character at its end, if any */
+static gboolean save_converter_convert(SaveConverter *conv, gchar **in, gsize *in_left,
+		GError **error)
+{
+	while (in == NULL || *in_left > 0)
 	{
-		GeanyFiletype *ft = filetypes_detect_from_document(doc);
+		gchar *out = conv->out + conv->out_len;
+		gsize out_left = SAVE_CHUNK_SIZE - conv->out_len;
+		gsize before = in ? *in_left : 0;
+		gsize ret;
+		gint save_errno;
 
-		document_set_filetype(doc, ft);
-		if (document_get_current() == doc)
+		errno = 0;
+		ret = g_iconv(conv->cd, in, in_left, &out, &out_left);
+		save_errno = errno;
+		conv->pos += before - (in ? *in_left : 0);
+		conv->out_len = out - conv->out;
+
+		if (ret != (gsize) -1 || save_errno == EINVAL)
+			break;
+		else if (save_errno == E2BIG)
 		{
-			ignore_callback = TRUE;
-			filetypes_select_radio_item(doc->file_type);
-			ignore_callback = FALSE;
+			if (! save_converter_flush(conv, error))
+				return FALSE;
+		}
+		else if (save_errno == EILSEQ)
+		{
+			g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+				_("Invalid byte sequence in conversion input"));
+			return FALSE;
+		}
+		else
+		{
+			g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_FAILED,
+				_("Error during conversion: %s"), g_strerror(save_errno));
+			return FALSE;
 		}
 	}
-
-	if (new_file)
-	{
-		// assume user wants to throw away read-only setting
-		sci_set_readonly(doc->editor->sci, FALSE);
-		doc->readonly = FALSE;
-		if (doc->priv->protected > 0)
-			unprotect_document(doc);
-	}
-
-	replace_header_filename(doc);
-
-	ret = document_save_file(doc, TRUE);
-
-	/* file monitoring support, add file monitoring after the file has been saved
-	 * to ignore any earlier events */
-	monitor_file_setup(doc);
-	doc->priv->file_disk_status = FILE_IGNORE;
-	return ret;
+	return TRUE;
 }
 
 
-static gsize save_convert_to_encoding(GeanyDocument *doc, gchar **data, gsize *len)
+static gboolean save_converter_feed(SaveConverter *conv, const gchar *data, gsize len,
+		GError **error)
 {
-	GError *conv_error = NULL;
-	gchar* conv_file_contents = NULL;
-	gsize bytes_read;
-	gsize conv_len;
+	gchar *in = (gchar *) data;
 
-	g_return_val_if_fail(data != NULL && *data != NULL, FALSE);
-	g_return_val_if_fail(len != NULL, FALSE);
-
-	/* try to convert it from UTF-8 to original encoding */
-	conv_file_contents = g_convert(*data, *len - 1, doc->encoding, "UTF-8",
-												&bytes_read, &conv_len, &conv_error);
+	if (len == 0)
+		return TRUE;
 
-	if (conv_error != NULL)
+	/* first complete a character split by the end of the previous part */
+	while (conv->carry_len > 0 && len > 0)
 	{
-		gchar *text = g_strdup_printf(
-_("An error occurred while converting the file from UTF-8 in \"%s\". The file remains unsaved."),
-			doc->encoding);
-		gchar *error_text;
+		gchar *carry = conv->carry;
+		gsize carry_left;
 
-		if (conv_error->code == G_CONVERT_ERROR_ILLEGAL_SEQUENCE)
-		{
-			gint line, column;
-			gint context_len;
-			gunichar unic;
-			/* don't read over the doc length */
-			gint max_len = MIN((gint)bytes_read + 6, (gint)*len - 1);
-			gchar context[7]; /* read 6 bytes from Sci + '\0' */
-			sci_get_text_range(doc->editor->sci, bytes_read, max_len, context);
+		conv->carry[conv->carry_len++] = *in++;
+		len--;
+		carry_left = conv->carry_len;
+		if (! save_converter_convert(conv, &carry, &carry_left, error))
+			return FALSE;
+		memmove(conv->carry, carry, carry_left);
+		conv->carry_len = carry_left;
+	}
 
-			/* take only one valid Unicode character from the context and discard the leftover */
-			unic = g_utf8_get_char_validated(context, -1);
-			context_len = g_unichar_to_utf8(unic, context);
-			context[context_len] = '\0';
-			get_line_column_from_pos(doc, bytes_read, &line, &column);
+	if (! save_converter_convert(conv, &in, &len, error))
+		return FALSE;
+	g_return_val_if_fail(conv->carry_len + len <= sizeof conv->carry, FALSE);
+	memcpy(conv->carry + conv->carry_len, in, len);
+	conv->carry_len += len;
+	return TRUE;
+}
 
-			error_text = g_strdup_printf(
-				_("Error message: %s\nThe error occurred at \"%s\" (line: %d, column: %d)."),
-				conv_error->message, context, line + 1, column);
-		}
-		else
-			error_text = g_strdup_printf(_("Error message: %s."), conv_error->message);
 
-		geany_debug("encoding error: %s", conv_error->message);
-		dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, text, error_text);
-		g_error_free(conv_error);
-		g_free(text);
-		g_free(error_text);
-		return FALSE;
-	}
-	else
+static gboolean save_converter_finish(SaveConverter *conv, GError **error)
+{
+	if (conv->carry_len > 0)
 	{
-		g_free(*data);
-		*data = conv_file_contents;
-		*len = conv_len;
+		g_set_error(error, G_CONVERT_ERROR, G_CONVERT_ERROR_PARTIAL_INPUT,
+			_("Partial character sequence at end of input"));
+		return FALSE;
 	}
-	return TRUE;
+	/* write the sequence returning to the initial state of a stateful encoding */
+	return save_converter_convert(conv, NULL, NULL, error) && save_converter_flush(conv, error);
 }
 
 
-static gchar *write_data_to_disk(const gchar *locale_filename,
-								 const gchar *data, gsize len)
+/* The text of a document to write and how to write it. The text is either in Scintilla's
+ * buffer or a copy of it, which does not change while it is written. */
+typedef struct
 {
-	GError *error = NULL;
+	const gchar	*part1;
+	gsize		 len1;
+	const gchar	*part2;
+	gsize		 len2;
+	gboolean	 bom;	/* whether to write a UTF-8 BOM first, converted like the text */
+	GIConv		 cd;	/* converter to the encoding of the file, or (GIConv) -1 */
+	SaveMode	 mode;
+}
+SaveText;
 
-	if (file_prefs.use_safe_file_saving)
+
+/* Writes text to writer, as it is or converted chunk by chunk, without copying it whole.
+ * writer can be NULL to only check the conversion, on failure of which error_pos is set to
+ * the position in the text of the character that could not be converted. */
+static gboolean save_write_text(const SaveText *text, SaveWriter *writer, gint *error_pos,
+		GError **error)
+{
+	static const gchar utf8_bom[] = { (gchar) 0xef, (gchar) 0xbb, (gchar) 0xbf };
+	gsize bom_len = text->bom ? sizeof utf8_bom : 0;
+	SaveConverter conv = { text->cd, writer, NULL, 0, { 0 }, 0, 0 };
+	gboolean success;
+
+	if (text->cd == (GIConv) -1)
 	{
-		/* Use old GLib API for safe saving (GVFS-safe, but alters ownership and permissons).
-		 * This is the only option that handles disk space exhaustion. */
-		if (g_file_set_contents(locale_filename, data, len, &error))
-			geany_debug("Wrote %s with g_file_set_contents().", locale_filename);
+		return save_writer_write(writer, utf8_bom, bom_len, error) &&
+			save_writer_write(writer, text->part1, text->len1, error) &&
+			save_writer_write(writer, text->part2, text->len2, error);
 	}
-	else if (USE_GIO_FILE_OPERATIONS)
-	{
-		GFile *fp;
 
-		/* Use GIO API to save file (GVFS-safe)
-		 * It is best in most GVFS setups but don't seem to work correctly on some more complex
-		 * setups (saving from some VM to their host, over some SMB shares, etc.) */
-		fp = g_file_new_for_path(locale_filename);
-		g_file_replace_contents(fp, data, len, NULL, file_prefs.gio_unsafe_save_backup,
-			G_FILE_CREATE_NONE, NULL, NULL, &error);
-		g_object_unref(fp);
+	conv.out = g_malloc(SAVE_CHUNK_SIZE);
+	conv.pos = -(gssize) bom_len;
+	success = save_converter_feed(&conv, utf8_bom, bom_len, error) &&
+		save_converter_feed(&conv, text->part1, text->len1, error) &&
+		save_converter_feed(&conv, text->part2, text->len2, error) &&
+		save_converter_finish(&conv, error);
+	g_free(conv.out);
+	if (! success)
+		*error_pos = (gint) MAX(conv.pos, 0);
+	/* back to the initial state for the next pass */
+	g_iconv(text->cd, NULL, NULL, NULL, NULL);
+	return success;
+}
+
+
+static void show_save_encoding_error(GeanyDocument *doc, GError *conv_error, gint pos)
+{
+	gchar *text = g_strdup_printf(
+_("An error occurred while converting the file from UTF-8 in \"%s\". The file remains unsaved."),
+		doc->encoding);
+	gchar *error_text;
+
+	if (conv_error->code == G_CONVERT_ERROR_ILLEGAL_SEQUENCE)
+	{
+		gint line, column;
+		gint context_len;
+		gunichar unic;
+		/* don't read over the doc length */
+		gint max_len = MIN(pos + 6, sci_get_length(doc->editor->sci));
+		gchar context[7]; /* read 6 bytes from Sci + '\0' */
+		sci_get_text_range(doc->editor->sci, pos, max_len, context);
+
+		/* take only one valid Unicode character from the context and discard the leftover */
+		unic = g_utf8_get_char_validated(context, -1);
+		context_len = g_unichar_to_utf8(unic, context);
+		context[context_len] = '\0';
+		get_line_column_from_pos(doc, pos, &line, &column);
+
+		error_text = g_strdup_printf(
+			_("Error message: %s\nThe error occurred at \"%s\" (line: %d, column: %d)."),
+			conv_error->message, context, line + 1, column);
 	}
 	else
-	{
-		FILE *fp;
-		int save_errno;
-		gchar *display_name = g_filename_display_name(locale_filename);
+		error_text = g_strdup_printf(_("Error message: %s."), conv_error->message);
 
-		/* Use POSIX API for unsafe saving (GVFS-unsafe) */
-		/* The error handling is taken from glib-2.26.0 gfileutils.c */
-		errno = 0;
-		fp = g_fopen(locale_filename, "wb");
-		if (fp == NULL)
-		{
-			save_errno = errno;
+	geany_debug("encoding error: %s", conv_error->message);
+	dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, text, error_text);
+	g_free(text);
+	g_free(error_text);
+}
 
-			g_set_error(&error,
-				G_FILE_ERROR,
-				g_file_error_from_errno(save_errno),
-				_("Failed to open file '%s' for writing: fopen() failed: %s"),
-				display_name,
-				g_strerror(save_errno));
-		}
-		else
-		{
-			gsize bytes_written;
 
-			errno = 0;
-			bytes_written = fwrite(data, sizeof(gchar), len, fp);
+/* Sets up text for writing doc, except for the text itself. Returns FALSE if the document
+ * can not be converted to its encoding. */
+static gboolean save_text_init(GeanyDocument *doc, SaveText *text)
+{
+	memset(text, 0, sizeof *text);
+	text->cd = (GIConv) -1;
+	text->mode = get_save_mode();
+	/* always write a UTF-8 BOM because the text itself is in UTF-8, the conversion to
+	 * doc->encoding also converts the BOM */
+	text->bom = doc->has_bom && encodings_is_unicode_charset(doc->encoding);
 
-			if (len != bytes_written)
-			{
-				save_errno = errno;
-
-				g_set_error(&error,
-					G_FILE_ERROR,
-					g_file_error_from_errno(save_errno),
-					_("Failed to write file '%s': fwrite() failed: %s"),
-					display_name,
-					g_strerror(save_errno));
-			}
+	/* save in original encoding, skip when it is already UTF-8 or has the encoding "None" */
+	if (doc->encoding != NULL && ! utils_str_equal(doc->encoding, "UTF-8") &&
+		! utils_str_equal(doc->encoding, encodings[GEANY_ENCODING_NONE].charset))
+	{
+		text->cd = g_iconv_open(doc->encoding, "UTF-8");
+		if (text->cd == (GIConv) -1)
+		{
+			GError *error = g_error_new(G_CONVERT_ERROR, G_CONVERT_ERROR_NO_CONVERSION,
+				_("Conversion from character set \"%s\" to \"%s\" is not supported"),
+				"UTF-8", doc->encoding);
 
-			errno = 0;
-			/* preserve the fwrite() error if any */
-			if (fclose(fp) != 0 && error == NULL)
-			{
-				save_errno = errno;
-
-				g_set_error(&error,
-					G_FILE_ERROR,
-					g_file_error_from_errno(save_errno),
-					_("Failed to close file '%s': fclose() failed: %s"),
-					display_name,
-					g_strerror(save_errno));
-			}
+			show_save_encoding_error(doc, error, 0);
+			g_error_free(error);
+			return FALSE;
 		}
-
-		g_free(display_name);
-	}
-	if (error != NULL)
-	{
-		gchar *msg = g_strdup(error->message);
-		g_error_free(error);
-		/* geany will warn about file truncation for unsafe saving below */
-		return msg;
 	}
-	return NULL;
+	return TRUE;
 }
 
 
-static gchar *save_doc(GeanyDocument *doc, const gchar *locale_filename,
-								 const gchar *data, gsize len)
+/* Writes text to locale_filename. Doesn't touch the UI so it can run on a worker thread.
+ * On success checksum is set to the checksum of the file written.
+ * A conversion error is in the G_CONVERT_ERROR domain, sets error_pos and leaves the file
+ * untouched. */
+static gboolean write_data_to_disk(const SaveText *text, const gchar *locale_filename,
+		gchar **checksum, gint *error_pos, GError **error)
 {
-	gchar *err;
+	SaveWriter writer;
+	gboolean written;
+	gchar *digest = NULL;
 
-	g_return_val_if_fail(doc != NULL, g_strdup(g_strerror(EINVAL)));
-	g_return_val_if_fail(data != NULL, g_strdup(g_strerror(EINVAL)));
+	*checksum = NULL;
 
-	err = write_data_to_disk(locale_filename, data, len);
-	if (err)
-		return err;
+	/* unsafe saving truncates the file before writing it, so first check that the whole
+	 * text can be converted */
+	if (text->cd != (GIConv) -1 && text->mode != SAVE_MODE_SAFE &&
+		! save_write_text(text, NULL, error_pos, error))
+		return FALSE;
 
-	/* now the file is on disk, set real_path */
-	if (doc->real_path == NULL)
+	if (! save_writer_open(&writer, locale_filename, text->mode, error))
+		return FALSE;
+
+	written = save_write_text(text, &writer, error_pos, error);
+	if (written)
+		digest = g_strdup(g_checksum_get_string(writer.checksum));
+	if (! save_writer_close(&writer, written, error) || ! written)
 	{
-		doc->real_path = utils_get_real_path(locale_filename);
-		doc->priv->is_remote = utils_is_remote_path(locale_filename);
-		monitor_file_setup(doc);
-		ui_add_recent_document(doc);
+		g_free(digest);
+		return FALSE;
 	}
-	return NULL;
+
+	geany_debug("Wrote %s.", locale_filename);
+	*checksum = digest;
+	return TRUE;
 }
 
 
@@ -2075,6 +3387,147 @@ static gboolean save_file_handle_infobars(GeanyDocument *doc, gboolean force)
 }
 
 
+/* Checks whether all line endings of sci are those of its EOL mode already, which is much
+ * faster than letting Scintilla convert them character by character. */
+static gboolean eols_match_mode(ScintillaObject *sci)
+{
+	GeanyLineEndingCounts counts = { 0 };
+	const gchar *part1, *part2;
+	gsize len1, len2;
+
+	sci_get_text_parts(sci, &part1, &len1, &part2, &len2);
+	utils_count_line_endings(&counts, part1, len1);
+	utils_count_line_endings(&counts, part2, len2);
+	return utils_line_endings_match(&counts, sci_get_eol_mode(sci));
+}
+
+
+/* Does what has to be done before doc is written. Returns FALSE if it should not be written,
+ * with result set to what document_save_file() returns then. */
+static gboolean save_file_prepare(GeanyDocument *doc, gboolean force, gboolean *result)
+{
+	const GeanyFilePrefs *fp;
+
+	*result = FALSE;
+	if (document_need_save_as(doc))
+	{
+		/* ensure doc is the current tab before showing the dialog */
+		document_show_tab(doc);
+		*result = dialogs_show_save_as();
+		return FALSE;
+	}
+
+	if (!force && !doc->changed)
+		return FALSE;
+	if (doc->readonly)
+	{
+		ui_set_statusbar(TRUE,
+			_("Cannot save read-only document '%s'!"), DOC_FILENAME(doc));
+		return FALSE;
+	}
+	/* the user must be asked before overwriting changes on disk, so don't defer the check */
+	check_disk_status(doc, TRUE, TRUE);
+	if (doc->priv->protected)
+	{
+		*result = save_file_handle_infobars(doc, force);
+		return FALSE;
+	}
+
+	fp = project_get_file_prefs();
+	/* replaces tabs with spaces but only if the current file is not a Makefile */
+	if (fp->replace_tabs && doc->file_type->id != GEANY_FILETYPES_MAKE)
+		editor_replace_tabs(doc->editor, TRUE);
+	/* strip trailing spaces */
+	if (fp->strip_trailing_spaces)
+		editor_strip_trailing_spaces(doc->editor, TRUE);
+	/* ensure the file has a newline at the end */
+	if (fp->final_new_line)
+		editor_ensure_final_newline(doc->editor);
+	/* ensure newlines are consistent */
+	if (fp->ensure_convert_new_lines && ! eols_match_mode(doc->editor->sci))
+		sci_convert_eols(doc->editor->sci, sci_get_eol_mode(doc->editor->sci));
+
+	/* notify plugins which may wish to modify the document before it's saved */
+	g_signal_emit_by_name(geany_object, "document-before-save", doc);
+	return TRUE;
+}
+
+
+/* Updates doc once it has been written to locale_filename, or reports error if it could not.
+ * checksum is that of the file written, unchanged tells whether the document still has the
+ * text which has been written.
+ * Returns whether the file was saved. */
+static gboolean save_file_finish(GeanyDocument *doc, const gchar *locale_filename,
+		SaveMode mode, const gchar *checksum, GError *error, gint error_pos, gboolean unchanged)
+{
+	if (error != NULL && error->domain == G_CONVERT_ERROR)
+	{
+		/* the file has been left untouched */
+		show_save_encoding_error(doc, error, error_pos);
+		doc->priv->file_disk_status = FILE_OK;
+		return FALSE;
+	}
+	else if (error != NULL)
+	{
+		gchar *errmsg = g_strdup(error->message);
+
+		ui_set_statusbar(TRUE, _("Error saving file (%s)."), errmsg);
+
+		if (mode != SAVE_MODE_SAFE)
+		{
+			SETPTR(errmsg,
+				g_strdup_printf(_("%s\n\nThe file on disk may now be truncated!"), errmsg));
+		}
+		dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, _("Error saving file."), errmsg);
+		doc->priv->file_disk_status = FILE_OK;
+		utils_beep();
+		g_free(errmsg);
+		return FALSE;
+	}
+
+	SETPTR(doc->priv->disk_checksum, g_strdup(checksum));
+
+	/* now the file is on disk, set real_path */
+	if (doc->real_path == NULL)
+	{
+		doc->real_path = utils_get_real_path(locale_filename);
+		document_index_add(doc);
+		doc->priv->is_remote = utils_is_remote_path(locale_filename);
+		monitor_file_setup(doc);
+		ui_add_recent_document(doc);
+	}
+
+	/* store the opened encoding for undo/redo */
+	if (unchanged)
+		store_saved_encoding(doc);
+
+	/* ignore the following things if we are quitting */
+	if (! main_status.quitting)
+	{
+		if (unchanged)
+			sci_set_savepoint(doc->editor->sci);
+
+		if (file_prefs.disk_check_timeout > 0)
+			document_update_timestamp(doc, locale_filename);
+
+		/* update filetype-related things */
+		document_set_filetype(doc, doc->file_type);
+
+		document_update_tab_label(doc);
+
+		msgwin_status_add(_("File %s saved."), doc->file_name);
+		ui_update_statusbar(doc, -1);
+#ifdef HAVE_VTE
+		vte_cwd((doc->real_path != NULL) ? doc->real_path : doc->file_name, FALSE);
+#endif
+	}
+
+	g_signal_emit_by_name(geany_object, "document-save", doc);
+
+	return TRUE;
+}
+
+
 /**
  *  Saves the document.
  *  Also shows the Save As dialog if necessary.
@@ -2103,136 +3556,268 @@ static gboolean save_file_handle_infobars(GeanyDocument *doc, gboolean force)
 GEANY_API_SYMBOL
 gboolean document_save_file(GeanyDocument *doc, gboolean force)
 {
-	gchar *errmsg;
-	gchar *data;
-	gsize len;
+	GError *error = NULL;
+	SaveText text;
+	gint error_pos = 0;
+	gboolean saved;
 	gchar *locale_filename;
-	const GeanyFilePrefs *fp;
+	gchar *checksum;
 
 	g_return_val_if_fail(doc != NULL, FALSE);
 
-	if (document_need_save_as(doc))
-	{
-		/* ensure doc is the current tab before showing the dialog */
-		document_show_tab(doc);
-		return dialogs_show_save_as();
-	}
+	/* let a save still running on the worker thread finish first */
+	async_save_wait(doc);
 
-	if (!force && !doc->changed)
-		return FALSE;
-	if (doc->readonly)
-	{
-		ui_set_statusbar(TRUE,
-			_("Cannot save read-only document '%s'!"), DOC_FILENAME(doc));
+	if (! save_file_prepare(doc, force, &saved))
+		return saved;
+	if (! save_text_init(doc, &text))
 		return FALSE;
-	}
-	document_check_disk_status(doc, TRUE);
-	if (doc->priv->protected)
-		return save_file_handle_infobars(doc, force);
+	sci_get_text_parts(doc->editor->sci, &text.part1, &text.len1, &text.part2, &text.len2);
 
-	fp = project_get_file_prefs();
-	/* replaces tabs with spaces but only if the current file is not a Makefile */
-	if (fp->replace_tabs && doc->file_type->id != GEANY_FILETYPES_MAKE)
-		editor_replace_tabs(doc->editor, TRUE);
-	/* strip trailing spaces */
-	if (fp->strip_trailing_spaces)
-		editor_strip_trailing_spaces(doc->editor, TRUE);
-	/* ensure the file has a newline at the end */
-	if (fp->final_new_line)
-		editor_ensure_final_newline(doc->editor);
-	/* ensure newlines are consistent */
-	if (fp->ensure_convert_new_lines)
-		sci_convert_eols(doc->editor->sci, sci_get_eol_mode(doc->editor->sci));
+	locale_filename = utils_get_locale_from_utf8(doc->file_name);
 
-	/* notify plugins which may wish to modify the document before it's saved */
-	g_signal_emit_by_name(geany_object, "document-before-save", doc);
+	/* ignore file changed notification when the file is written */
+	doc->priv->file_disk_status = FILE_IGNORE;
 
-	len = sci_get_length(doc->editor->sci) + 1;
-	if (doc->has_bom && encodings_is_unicode_charset(doc->encoding))
-	{	/* always write a UTF-8 BOM because in this moment the text itself is still in UTF-8
-		 * encoding, it will be converted to doc->encoding below and this conversion
-		 * also changes the BOM */
-		data = (gchar*) g_malloc(len + 3);	/* 3 chars for BOM */
-		data[0] = (gchar) 0xef;
-		data[1] = (gchar) 0xbb;
-		data[2] = (gchar) 0xbf;
-		sci_get_text(doc->editor->sci, len, data + 3);
-		len += 3;
-	}
-	else
+	/* actually write the text to the file on disk, straight from Scintilla's buffer */
+	write_data_to_disk(&text, locale_filename, &checksum, &error_pos, &error);
+	if (text.cd != (GIConv) -1)
+		g_iconv_close(text.cd);
+
+	saved = save_file_finish(doc, locale_filename, text.mode, checksum, error, error_pos, TRUE);
+	if (error != NULL)
+		g_error_free(error);
+	g_free(checksum);
+	g_free(locale_filename);
+	return saved;
+}
+
+
+/* A document being written on a worker thread by document_save_file_async() */
+typedef struct
+{
+	GeanyDocument	*doc;
+	gchar			*locale_filename;
+	gchar			*snapshot;		/* copy of the text when saving started */
+	SaveText		 text;			/* refers to snapshot */
+	guint			 text_version;	/* doc->priv->text_version when saving started */
+	gboolean		 in_batch;		/* started by document_save_all_async() */
+	gboolean		 done;			/* set by the worker, protected by async_save_mutex */
+	gchar			*checksum;		/* of the file written, set by the worker */
+	GError			*error;
+	gint			 error_pos;
+} AsyncSave;
+
+static GThreadPool *async_save_pool = NULL;
+static GSList *async_saves = NULL;
+static GMutex async_save_mutex;
+static GCond async_save_cond;
+static guint batch_pending = 0;	/* saves of document_save_all_async() not finished yet */
+static guint batch_saved = 0;
+
+
+static AsyncSave *find_async_save(GeanyDocument *doc)
+{
+	GSList *node;
+
+	foreach_slist(node, async_saves)
 	{
-		data = (gchar*) g_malloc(len);
-		sci_get_text(doc->editor->sci, len, data);
+		AsyncSave *job = node->data;
+
+		if (job->doc == doc)
+			return job;
 	}
+	return NULL;
+}
 
-	/* save in original encoding, skip when it is already UTF-8 or has the encoding "None" */
-	if (doc->encoding != NULL && ! utils_str_equal(doc->encoding, "UTF-8") &&
-		! utils_str_equal(doc->encoding, encodings[GEANY_ENCODING_NONE].charset))
+
+/* Finishes a save once the worker is done with it */
+static void async_save_complete(AsyncSave *job)
+{
+	GeanyDocument *doc = job->doc;
+	gboolean saved;
+
+	async_saves = g_slist_remove(async_saves, job);
+
+	saved = save_file_finish(doc, job->locale_filename, job->text.mode, job->checksum,
+		job->error, job->error_pos, doc->priv->text_version == job->text_version);
+
+	if (job->in_batch)
 	{
-		if (! save_convert_to_encoding(doc, &data, &len))
+		batch_pending--;
+		if (saved)
+			batch_saved++;
+		if (batch_pending == 0 && batch_saved > 0)
 		{
-			g_free(data);
-			return FALSE;
+			GeanyDocument *cur_doc = document_get_current();
+
+			ui_set_statusbar(FALSE, ngettext("%d file saved.", "%d files saved.", batch_saved),
+				batch_saved);
+			/* saving may have changed window title, sidebar for another doc, so update */
+			if (cur_doc != NULL)
+			{
+				sidebar_update_tag_list(cur_doc, TRUE);
+				ui_set_window_title(cur_doc);
+			}
 		}
 	}
-	else
+
+	if (job->text.cd != (GIConv) -1)
+		g_iconv_close(job->text.cd);
+	if (job->error != NULL)
+		g_error_free(job->error);
+	g_free(job->checksum);
+	g_free(job->snapshot);
+	g_free(job->locale_filename);
+	g_free(job);
+}
+
+
+static void async_save_wait_done(AsyncSave *job)
+{
+	g_mutex_lock(&async_save_mutex);
+	while (! job->done)
+		g_cond_wait(&async_save_cond, &async_save_mutex);
+	g_mutex_unlock(&async_save_mutex);
+}
+
+
+static gboolean async_save_done(gpointer data)
+{
+	AsyncSave *job = data;
+
+	/* the worker might not have released job yet */
+	async_save_wait_done(job);
+	async_save_complete(job);
+	return FALSE;
+}
+
+
+static void async_save_thread(gpointer data, gpointer user_data)
+{
+	AsyncSave *job = data;
+
+	write_data_to_disk(&job->text, job->locale_filename, &job->checksum, &job->error_pos,
+		&job->error);
+
+	/* added before setting done so that async_save_wait() can remove it */
+	g_idle_add(async_save_done, job);
+	g_mutex_lock(&async_save_mutex);
+	job->done = TRUE;
+	g_cond_broadcast(&async_save_cond);
+	g_mutex_unlock(&async_save_mutex);
+}
+
+
+/* Blocks until a save of doc running on the worker thread, if any, has finished */
+static void async_save_wait(GeanyDocument *doc)
+{
+	AsyncSave *job = find_async_save(doc);
+
+	if (job != NULL)
 	{
-		len = strlen(data);
+		async_save_wait_done(job);
+		g_idle_remove_by_data(job);
+		async_save_complete(job);
 	}
+}
 
-	locale_filename = utils_get_locale_from_utf8(doc->file_name);
 
-	/* ignore file changed notification when the file is written */
-	doc->priv->file_disk_status = FILE_IGNORE;
+static void async_save_wait_all(void)
+{
+	while (async_saves != NULL)
+		async_save_wait(((AsyncSave *) async_saves->data)->doc);
+}
 
-	/* actually write the content of data to the file on disk */
-	errmsg = save_doc(doc, locale_filename, data, len);
-	g_free(data);
 
-	if (errmsg != NULL)
-	{
-		ui_set_statusbar(TRUE, _("Error saving file (%s)."), errmsg);
+static void async_save_free_pool(void)
+{
+	/* all documents have been closed, so all saves are complete */
+	if (async_save_pool != NULL)
+		g_thread_pool_free(async_save_pool, FALSE, TRUE);
+	async_save_pool = NULL;
+}
 
-		if (!file_prefs.use_safe_file_saving)
-		{
-			SETPTR(errmsg,
-				g_strdup_printf(_("%s\n\nThe file on disk may now be truncated!"), errmsg));
-		}
-		dialogs_show_msgbox_with_secondary(GTK_MESSAGE_ERROR, _("Error saving file."), errmsg);
-		doc->priv->file_disk_status = FILE_OK;
-		utils_beep();
-		g_free(locale_filename);
-		g_free(errmsg);
+
+static gboolean save_file_async(GeanyDocument *doc, gboolean force, gboolean in_batch)
+{
+	AsyncSave *job;
+	SaveText text;
+	const gchar *part1, *part2;
+	gsize len1, len2;
+	gboolean result;
+
+	g_return_val_if_fail(doc != NULL, FALSE);
+
+	async_save_wait(doc);
+
+	if (! save_file_prepare(doc, force, &result))
+		return result;
+	if (! save_text_init(doc, &text))
 		return FALSE;
-	}
 
-	/* store the opened encoding for undo/redo */
-	store_saved_encoding(doc);
+	job = g_new0(AsyncSave, 1);
+	job->doc = doc;
+	job->locale_filename = utils_get_locale_from_utf8(doc->file_name);
+	job->text_version = doc->priv->text_version;
+	job->in_batch = in_batch;
+
+	/* the document can be edited while the copy is written */
+	sci_get_text_parts(doc->editor->sci, &part1, &len1, &part2, &len2);
+	job->snapshot = g_malloc(len1 + len2 + 1);
+	memcpy(job->snapshot, part1, len1);
+	memcpy(job->snapshot + len1, part2, len2);
+	job->text = text;
+	job->text.part1 = job->snapshot;
+	job->text.len1 = len1 + len2;
+	job->text.part2 = NULL;
+	job->text.len2 = 0;
 
-	/* ignore the following things if we are quitting */
-	if (! main_status.quitting)
-	{
-		sci_set_savepoint(doc->editor->sci);
+	/* ignore file changed notification when the file is written */
+	doc->priv->file_disk_status = FILE_IGNORE;
 
-		if (file_prefs.disk_check_timeout > 0)
-			document_update_timestamp(doc, locale_filename);
+	if (async_save_pool == NULL)
+		async_save_pool = g_thread_pool_new(async_save_thread, NULL, ASYNC_SAVE_THREADS, FALSE, NULL);
+	async_saves = g_slist_prepend(async_saves, job);
+	if (in_batch)
+		batch_pending++;
+	g_thread_pool_push(async_save_pool, job, NULL);
+	return TRUE;
+}
 
-		/* update filetype-related things */
-		document_set_filetype(doc, doc->file_type);
 
-		document_update_tab_label(doc);
+/* Saves doc like document_save_file(), except that a copy of the text is written on a worker
+ * thread so that a slow disk does not block the UI. The save point is set and the
+ * "document-save" signal is emitted once the file has been written, unless saving failed.
+ * Returns whether saving was started, or the result of the Save As dialog if it was shown. */
+gboolean document_save_file_async(GeanyDocument *doc, gboolean force)
+{
+	return save_file_async(doc, force, FALSE);
+}
 
-		msgwin_status_add(_("File %s saved."), doc->file_name);
-		ui_update_statusbar(doc, -1);
-#ifdef HAVE_VTE
-		vte_cwd((doc->real_path != NULL) ? doc->real_path : doc->file_name, FALSE);
-#endif
-	}
-	g_free(locale_filename);
 
-	g_signal_emit_by_name(geany_object, "document-save", doc);
+/* Saves all changed documents with document_save_file_async(), writing several files in
+ * parallel. Returns whether saving any of them was started. */
+gboolean document_save_all_async(void)
+{
+	guint i, max = (guint) gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook));
+	gboolean started = FALSE;
 
-	return TRUE;
+	if (batch_pending == 0)
+		batch_saved = 0;
+
+	/* iterate over documents in tabs order */
+	for (i = 0; i < max; i++)
+	{
+		GeanyDocument *doc = document_get_from_page(i);
+
+		if (! doc->changed)
+			continue;
+
+		if (save_file_async(doc, FALSE, TRUE))
+			started = TRUE;
+	}
+	return started;
 }
 
 
@@ -2639,31 +4224,13 @@ gint document_replace_all(GeanyDocument *doc, const gchar *find_text, const gcha
 }
 
 
-/*
- * Parses or re-parses the document's buffer and updates the type
- * keywords and symbol list.
- *
- * @param doc The document.
- */
-void document_update_tags(GeanyDocument *doc)
+/* Creates the TM file of doc and adds it to the workspace if there isn't one yet.
+ * Returns: FALSE if doc is a new file, doesn't support tags or no TM file could be created. */
+static gboolean create_tm_file(GeanyDocument *doc)
 {
-	guchar *buffer_ptr;
-	gsize len;
-
-	g_return_if_fail(DOC_VALID(doc));
-	g_return_if_fail(app->tm_workspace != NULL);
-
-	/* early out if it's a new file or doesn't support tags */
 	if (! doc->file_name || ! doc->file_type || !filetype_has_tags(doc->file_type))
-	{
-		/* We must call sidebar_update_tag_list() before returning,
-		 * to ensure that the symbol list is always updated properly (e.g.
-		 * when creating a new document with a partial filename set. */
-		sidebar_update_tag_list(doc, FALSE);
-		return;
-	}
+		return FALSE;
 
-	/* create a new TM file if there isn't one yet */
 	if (! doc->tm_file)
 	{
 		gchar *locale_filename = utils_get_locale_from_utf8(doc->file_name);
@@ -2677,9 +4244,28 @@ void document_update_tags(GeanyDocument *doc)
 		if (doc->tm_file)
 			tm_workspace_add_source_file_noupdate(doc->tm_file);
 	}
+	return doc->tm_file != NULL;
+}
+
+
+/*
+ * Parses or re-parses the document's buffer and updates the type
+ * keywords and symbol list.
+ *
+ * @param doc The document.
+ */
+void document_update_tags(GeanyDocument *doc)
+{
+	guchar *buffer_ptr;
+	gsize len;
+
+	g_return_if_fail(DOC_VALID(doc));
+	g_return_if_fail(app->tm_workspace != NULL);
+
+	doc->priv->tags_pending = FALSE;
 
-	/* early out if there's no tm source file and we couldn't create one */
-	if (doc->tm_file == NULL)
+	/* early out if it's a new file, doesn't support tags or we couldn't create a TM file */
+	if (! create_tm_file(doc))
 	{
 		/* We must call sidebar_update_tag_list() before returning,
 		 * to ensure that the symbol list is always updated properly (e.g.
@@ -2699,57 +4285,183 @@ void document_update_tags(GeanyDocument *doc)
 }
 
 
+static gboolean parse_pending_tags_idle(gpointer data)
+{
+	GeanyDocument *doc = document_get_current();
+	guint i;
+
+	/* the current document first, it is the most likely to be used */
+	if (doc == NULL || ! doc->priv->tags_pending)
+	{
+		doc = NULL;
+		foreach_document(i)
+		{
+			if (documents[i]->priv->tags_pending)
+			{
+				doc = documents[i];
+				break;
+			}
+		}
+	}
+	if (doc == NULL || main_status.quitting)
+	{
+		pending_tags_source = 0;
+		return FALSE;
+	}
+
+	document_update_tags(doc);
+	return TRUE;
+}
+
+
+/* Parses the symbols of the documents whose parsing was deferred when opening the session,
+ * one per idle call so that the UI stays usable. */
+void document_parse_pending_tags(void)
+{
+	if (pending_tags_source == 0)
+		pending_tags_source = g_idle_add_full(G_PRIORITY_LOW, parse_pending_tags_idle, NULL, NULL);
+}
+
+
+/* Returns: the index of the Scintilla keyword set for the type keywords of ft, or -1 if ft
+ * doesn't support them. */
+static gint get_type_keyword_index(GeanyFiletype *ft)
+{
+	/* some filetypes support type keywords (such as struct names), but not
+	 * necessarily all filetypes for a particular scintilla lexer.  this
+	 * tells us whether the filetype supports keywords, and if so
+	 * which index to use for the scintilla keywords set. */
+	switch (ft->id)
+	{
+		case GEANY_FILETYPES_C:
+		case GEANY_FILETYPES_CPP:
+		case GEANY_FILETYPES_CS:
+		case GEANY_FILETYPES_D:
+		case GEANY_FILETYPES_JAVA:
+		case GEANY_FILETYPES_OBJECTIVEC:
+		case GEANY_FILETYPES_VALA:
+		case GEANY_FILETYPES_RUST:
+		case GEANY_FILETYPES_GO:
+		{
+
+			/* index of the keyword set in the Scintilla lexer, for
+			 * example in LexCPP.cxx, see "cppWordLists" global array.
+			 * TODO: this magic number should be a member of the filetype */
+			return 3;
+		}
+		default:
+			return -1;
+	}
+}
+
+
+/* Tells scintilla about the type keywords of doc, which causes them to be colourized */
+static void set_type_keywords(GeanyDocument *doc, gint keyword_idx, const gchar *keywords)
+{
+	guint hash = g_str_hash(keywords);
+
+	if (hash != doc->priv->keyword_hash)
+	{
+		sci_set_keywords(doc->editor->sci, keyword_idx, keywords);
+		queue_colourise(doc); /* force re-highlighting the entire document */
+		doc->priv->keyword_hash = hash;
+	}
+}
+
+
 /* Re-highlights type keywords without re-parsing the whole document. */
 void document_highlight_tags(GeanyDocument *doc)
 {
-	GString *keywords_str;
-	gint keyword_idx;
+	GString *keywords_str;
+	gint keyword_idx = get_type_keyword_index(doc->file_type);
+
+	if (keyword_idx < 0)
+		return; /* early out if type keywords are not supported */
+	if (!app->tm_workspace->tags_array)
+		return;
+
+	/* get any type keywords and tell scintilla about them */
+	keywords_str = symbols_find_typenames_as_string(doc->file_type->lang, FALSE);
+	if (keywords_str)
+	{
+		set_type_keywords(doc, keyword_idx, keywords_str->str);
+		g_string_free(keywords_str, TRUE);
+	}
+}
+
+
+static gint compare_doc_filetypes(gconstpointer a, gconstpointer b)
+{
+	const GeanyDocument *doc_a = *(const GeanyDocument **) a;
+	const GeanyDocument *doc_b = *(const GeanyDocument **) b;
+
+	return doc_a->file_type->id - doc_b->file_type->id;
+}
+
+
+/* Parses the symbols of the documents opened in a batch, updating the workspace once for all
+ * of them, and looks up the type keywords once per filetype. */
+static void update_batch_tags(GPtrArray *docs)
+{
+	GeanyDocument *cur_doc = document_get_current();
+	GPtrArray *parsed = g_ptr_array_sized_new(docs->len);
+	GPtrArray *source_files = g_ptr_array_sized_new(docs->len);
+	guchar **buffers = g_new(guchar *, docs->len);
+	gsize *sizes = g_new(gsize, docs->len);
+	GeanyFiletype *ft = NULL;
+	GString *keywords_str = NULL;
+	guint i;
 
-	/* some filetypes support type keywords (such as struct names), but not
-	 * necessarily all filetypes for a particular scintilla lexer.  this
-	 * tells us whether the filetype supports keywords, and if so
-	 * which index to use for the scintilla keywords set. */
-	switch (doc->file_type->id)
+	for (i = 0; i < docs->len; i++)
 	{
-		case GEANY_FILETYPES_C:
-		case GEANY_FILETYPES_CPP:
-		case GEANY_FILETYPES_CS:
-		case GEANY_FILETYPES_D:
-		case GEANY_FILETYPES_JAVA:
-		case GEANY_FILETYPES_OBJECTIVEC:
-		case GEANY_FILETYPES_VALA:
-		case GEANY_FILETYPES_RUST:
-		case GEANY_FILETYPES_GO:
-		{
+		GeanyDocument *doc = docs->pdata[i];
 
-			/* index of the keyword set in the Scintilla lexer, for
-			 * example in LexCPP.cxx, see "cppWordLists" global array.
-			 * TODO: this magic number should be a member of the filetype */
-			keyword_idx = 3;
-			break;
+		/* it could have been closed or parsed when shown */
+		if (! DOC_VALID(doc) || ! doc->priv->tags_pending)
+			continue;
+		if (! create_tm_file(doc))
+		{
+			document_update_tags(doc);
+			continue;
 		}
-		default:
-			return; /* early out if type keywords are not supported */
+		doc->priv->tags_pending = FALSE;
+		/* Note: these buffers *MUST NOT* be modified */
+		buffers[source_files->len] = (guchar *) SSM(doc->editor->sci, SCI_GETCHARACTERPOINTER, 0, 0);
+		sizes[source_files->len] = sci_get_length(doc->editor->sci);
+		g_ptr_array_add(source_files, doc->tm_file);
+		g_ptr_array_add(parsed, doc);
 	}
-	if (!app->tm_workspace->tags_array)
-		return;
+	if (source_files->len > 0)
+		tm_workspace_update_source_file_buffers(source_files, buffers, sizes);
 
-	/* get any type keywords and tell scintilla about them
-	 * this will cause the type keywords to be colourized in scintilla */
-	keywords_str = symbols_find_typenames_as_string(doc->file_type->lang, FALSE);
-	if (keywords_str)
+	g_ptr_array_sort(parsed, compare_doc_filetypes);
+	for (i = 0; i < parsed->len; i++)
 	{
-		gchar *keywords = g_string_free(keywords_str, FALSE);
-		guint hash = g_str_hash(keywords);
+		GeanyDocument *doc = parsed->pdata[i];
+		gint keyword_idx = get_type_keyword_index(doc->file_type);
+
+		if (doc == cur_doc)
+			sidebar_update_tag_list(doc, TRUE);
+		if (keyword_idx < 0 || !app->tm_workspace->tags_array)
+			continue;
 
-		if (hash != doc->priv->keyword_hash)
+		if (doc->file_type != ft)
 		{
-			sci_set_keywords(doc->editor->sci, keyword_idx, keywords);
-			queue_colourise(doc); /* force re-highlighting the entire document */
-			doc->priv->keyword_hash = hash;
+			ft = doc->file_type;
+			if (keywords_str)
+				g_string_free(keywords_str, TRUE);
+			keywords_str = symbols_find_typenames_as_string(ft->lang, FALSE);
 		}
-		g_free(keywords);
+		if (keywords_str)
+			set_type_keywords(doc, keyword_idx, keywords_str->str);
 	}
+
+	if (keywords_str)
+		g_string_free(keywords_str, TRUE);
+	g_free(buffers);
+	g_free(sizes);
+	g_ptr_array_free(source_files, TRUE);
+	g_ptr_array_free(parsed, TRUE);
 }
 
 
@@ -2816,7 +4528,18 @@ static void document_load_config(GeanyDocument *doc, GeanyFiletype *type,
 			doc->priv->symbol_list_sort_mode = type->priv->symbol_list_sort_mode;
 	}
 
-	document_update_tags(doc);
+	/* session files are parsed once shown or in idle time, see document_parse_pending_tags(),
+	 * files opened in a batch together at its end, see document_open_batch_end() */
+	if (main_status.opening_session_files)
+		doc->priv->tags_pending = TRUE;
+	else if (open_batch_docs != NULL)
+	{
+		if (! doc->priv->tags_pending)
+			g_ptr_array_add(open_batch_docs, doc);
+		doc->priv->tags_pending = TRUE;
+	}
+	else
+		document_update_tags(doc);
 }
 
 
@@ -3231,11 +4954,7 @@ static gint document_get_status_id(GeanyDocument *doc)
 {
 	if (doc->changed)
 		return STATUS_CHANGED;
-#ifdef USE_GIO_FILEMON
-	else if (doc->priv->file_disk_status == FILE_CHANGED)
-#else
 	else if (doc->priv->protected)
-#endif
 		return STATUS_DISK_CHANGED;
 	else if (doc->readonly)
 		return STATUS_READONLY;
@@ -3362,6 +5081,9 @@ gboolean document_account_for_unsaved(void)
 {
 	guint p, page_count;
 
+	/* documents being saved are unchanged once written */
+	async_save_wait_all();
+
 	page_count = gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_widgets.notebook));
 	/* iterate over documents in tabs order */
 	for (p = 0; p < page_count; p++)
@@ -3662,47 +5384,166 @@ static void monitor_resave_missing_file(GeanyDocument *doc)
 		protect_document(doc);
 		document_set_text_changed(doc, TRUE);
 		/* don't prompt more than once */
+		document_index_remove(doc);
 		SETPTR(doc->real_path, NULL);
+		document_index_add(doc);
 		doc->priv->info_bars[MSG_TYPE_RESAVE] = bar;
 		enable_key_intercept(doc, bar);
 	}
 }
 
 
+/* A comparison of the contents of a file that has been changed on disk with those of the
+ * file as last read or written by its document, run on a worker thread */
+typedef struct
+{
+	guint		 doc_id;
+	gchar		*locale_filename;
+	gchar		*expected;	/* doc->priv->disk_checksum when the check started */
+	gchar		*checksum;	/* of the file, set by the worker, NULL if it could not be read */
+}
+DiskCheck;
+
+static GThreadPool *disk_check_pool = NULL;
+
+
+static gboolean disk_check_done(gpointer data)
+{
+	DiskCheck *check = data;
+	/* documents are gone once the pool has been freed on quit */
+	GeanyDocument *doc = disk_check_pool != NULL ? document_find_by_id(check->doc_id) : NULL;
+
+	/* the result is moot if the document has been reloaded or saved in the meantime, or if
+	 * the file has been compared again synchronously */
+	if (doc != NULL && doc->priv->disk_check_pending)
+	{
+		doc->priv->disk_check_pending = FALSE;
+		if (utils_str_equal(check->expected, doc->priv->disk_checksum))
+		{
+			if (utils_str_equal(check->checksum, check->expected))
+				geany_debug("%s: contents of %s unchanged", G_STRFUNC, doc->file_name);
+			else
+				monitor_reload_file(doc);
+		}
+	}
+	g_free(check->locale_filename);
+	g_free(check->expected);
+	g_free(check->checksum);
+	g_free(check);
+	return FALSE;
+}
+
+
+/* Returns the MD5 checksum of the contents of locale_filename, or NULL if it can not be read */
+static gchar *compute_file_checksum(const gchar *locale_filename)
+{
+	GChecksum *checksum;
+	gchar *buffer, *result = NULL;
+	gsize n_read;
+	FILE *fp = g_fopen(locale_filename, "rb");
+
+	if (fp == NULL)
+		return NULL;
+
+	checksum = g_checksum_new(G_CHECKSUM_MD5);
+	buffer = g_malloc(ASYNC_OPEN_CHUNK_SIZE);
+	while ((n_read = fread(buffer, 1, ASYNC_OPEN_CHUNK_SIZE, fp)) > 0)
+		g_checksum_update(checksum, (const guchar *) buffer, n_read);
+	if (! ferror(fp))
+		result = g_strdup(g_checksum_get_string(checksum));
+	fclose(fp);
+	g_free(buffer);
+	g_checksum_free(checksum);
+	return result;
+}
+
+
+static void disk_check_thread(gpointer data, gpointer user_data)
+{
+	DiskCheck *check = data;
+
+	check->checksum = compute_file_checksum(check->locale_filename);
+	g_idle_add(disk_check_done, check);
+}
+
+
+static void disk_check_free_pool(void)
+{
+	/* drop the files not being read yet and wait for the others, so that no worker is left
+	 * behind; disk_check_done() ignores their results once the pool is gone */
+	if (disk_check_pool != NULL)
+		g_thread_pool_free(disk_check_pool, TRUE, TRUE);
+	disk_check_pool = NULL;
+}
+
+
+/* Asks to reload doc only if the contents of its file have changed, not just its time
+ * stamp, e.g. after touching it or checking out the same revision. The file is read on a
+ * worker thread, so the question comes later. */
+static void check_disk_contents(GeanyDocument *doc, const gchar *locale_filename)
+{
+	DiskCheck *check;
+
+	if (doc->priv->disk_check_pending)
+		return;
+
+	check = g_new0(DiskCheck, 1);
+	check->doc_id = doc->id;
+	check->locale_filename = g_strdup(locale_filename);
+	check->expected = g_strdup(doc->priv->disk_checksum);
+	doc->priv->disk_check_pending = TRUE;
+
+	if (disk_check_pool == NULL)
+		disk_check_pool = g_thread_pool_new(disk_check_thread, NULL, 1, FALSE, NULL);
+	g_thread_pool_push(disk_check_pool, check, NULL);
+}
+
+
 /* Set force to force a disk check, otherwise it is ignored if there was a check
  * in the last file_prefs.disk_check_timeout seconds.
  * @return @c TRUE if the file has changed. */
 gboolean document_check_disk_status(GeanyDocument *doc, gboolean force)
+{
+	return check_disk_status(doc, force, FALSE);
+}
+
+
+/* Like document_check_disk_status(), but if sync is set the contents of a changed file are
+ * compared right away, including those of a comparison still running on the worker. */
+static gboolean check_disk_status(GeanyDocument *doc, gboolean force, gboolean sync)
 {
 	gboolean ret = FALSE;
-	gboolean use_gio_filemon;
-	time_t mtime = 0;
+	gboolean recent, pending, reported;
+	time_t cur_time, mtime = 0;
 	gchar *locale_filename;
 	FileDiskStatus old_status;
 
 	g_return_val_if_fail(doc != NULL, FALSE);
 
-	/* ignore remote files and documents that have never been saved to disk */
+	/* ignore remote files and documents that have never been saved to disk or are being
+	 * written right now */
 	if (notebook_switch_in_progress() || file_prefs.disk_check_timeout == 0
-			|| doc->real_path == NULL || doc->priv->is_remote)
+			|| doc->real_path == NULL || doc->priv->is_remote || find_async_save(doc) != NULL)
 		return FALSE;
 
-	use_gio_filemon = (doc->priv->monitor != NULL);
+	cur_time = time(NULL);
+	recent = doc->priv->last_check > (cur_time - file_prefs.disk_check_timeout);
+	/* a comparison still running on the worker is not skipped */
+	pending = sync && doc->priv->disk_check_pending;
+	/* a change reported by the watch is not rate limited */
+	reported = doc->priv->file_watch != 0 && doc->priv->file_disk_status == FILE_CHANGED;
 
-	if (use_gio_filemon)
+	if (doc->priv->file_watch != 0 && ! reported && ! pending)
 	{
-		if (doc->priv->file_disk_status != FILE_CHANGED && ! force)
+		/* the watch has not reported any change, but changes made by other hosts on network
+		 * file systems are not reported, so still check on request at the polling rate */
+		if (! force || recent)
 			return FALSE;
 	}
-	else
-	{
-		time_t cur_time = time(NULL);
-
-		if (! force && doc->priv->last_check > (cur_time - file_prefs.disk_check_timeout))
-			return FALSE;
+	else if (! force && recent && ! pending && ! reported)
+		return FALSE;
 
-		doc->priv->last_check = cur_time;
-	}
+	doc->priv->last_check = cur_time;
 
 	locale_filename = utils_get_locale_from_utf8(doc->file_name);
 	if (!get_mtime(locale_filename, &mtime))
@@ -3711,11 +5552,24 @@ gboolean document_check_disk_status(GeanyDocument *doc, gboolean force)
 		/* doc may be closed now */
 		ret = TRUE;
 	}
-	else if (doc->priv->mtime < mtime)
+	else if (doc->priv->mtime < mtime || pending)
 	{
 		/* make sure the user is not prompted again after he cancelled the "reload file?" message */
 		doc->priv->mtime = mtime;
-		monitor_reload_file(doc);
+		if (doc->priv->disk_checksum == NULL)
+			monitor_reload_file(doc);
+		else if (sync)
+		{
+			gchar *checksum = compute_file_checksum(locale_filename);
+
+			/* this supersedes a comparison still running on the worker */
+			doc->priv->disk_check_pending = FALSE;
+			if (! utils_str_equal(checksum, doc->priv->disk_checksum))
+				monitor_reload_file(doc);
+			g_free(checksum);
+		}
+		else
+			check_disk_contents(doc, locale_filename);
 		/* doc may be closed now */
 		ret = TRUE;
 	}
@@ -3847,3 +5701,352 @@ void document_set_data_full(GeanyDocument *doc, const gchar *key,
 {
 	g_datalist_set_data_full(&doc->priv->data, key, data, free_func);
 }
+
+
+static void diagnostic_clear(gpointer data)
+{
+	GeanyDiagnostic *diag = data;
+
+	g_free(diag->source);
+	g_free(diag->message);
+}
+
+
+static GArray *diagnostics_new(void)
+{
+	GArray *array = g_array_new(FALSE, FALSE, sizeof(GeanyDiagnostic));
+
+	g_array_set_clear_func(array, diagnostic_clear);
+	return array;
+}
+
+
+static gint compare_diagnostics(gconstpointer a, gconstpointer b)
+{
+	const GeanyDiagnostic *diag_a = a;
+	const GeanyDiagnostic *diag_b = b;
+	gint cmp;
+
+	if (diag_a->line != diag_b->line)
+		return diag_a->line < diag_b->line ? -1 : 1;
+	cmp = strcmp(diag_a->source, diag_b->source);
+	return cmp != 0 ? cmp : g_strcmp0(diag_a->message, diag_b->message);
+}
+
+
+/* Adds the new diagnostics of doc to the sorted ones, without duplicates. Their lines are
+ * kept for update_diagnostics() to mark. */
+static void merge_diagnostics(GeanyDocument *doc)
+{
+	GeanyDocumentPrivate *priv = doc->priv;
+	GArray *all = priv->new_diagnostics;
+	GArray *merged;
+	guint i;
+
+	if (all == NULL)
+		return;
+	priv->new_diagnostics = NULL;
+
+	if (priv->unmarked_diagnostic_lines == NULL)
+		priv->unmarked_diagnostic_lines = g_array_new(FALSE, FALSE, sizeof(gint));
+	for (i = 0; i < all->len; i++)
+	{
+		GeanyDiagnostic *diag = &g_array_index(all, GeanyDiagnostic, i);
+
+		g_array_append_val(priv->unmarked_diagnostic_lines, diag->line);
+	}
+
+	if (priv->diagnostics != NULL)
+	{
+		g_array_append_vals(all, priv->diagnostics->data, priv->diagnostics->len);
+		/* the elements are owned by all now */
+		g_array_set_clear_func(priv->diagnostics, NULL);
+		g_array_free(priv->diagnostics, TRUE);
+	}
+	g_array_sort(all, compare_diagnostics);
+
+	merged = diagnostics_new();
+	for (i = 0; i < all->len; i++)
+	{
+		GeanyDiagnostic *diag = &g_array_index(all, GeanyDiagnostic, i);
+
+		if (merged->len > 0 &&
+			compare_diagnostics(diag, &g_array_index(merged, GeanyDiagnostic, merged->len - 1)) == 0)
+			diagnostic_clear(diag);
+		else
+			g_array_append_vals(merged, diag, 1);
+	}
+	g_array_set_clear_func(all, NULL);
+	g_array_free(all, TRUE);
+	priv->diagnostics = merged;
+}
+
+
+static GArray *get_diagnostic_lines(GArray *diagnostics)
+{
+	GArray *lines = g_array_sized_new(FALSE, FALSE, sizeof(gint), diagnostics->len);
+	guint i;
+
+	for (i = 0; i < diagnostics->len; i++)
+		g_array_append_val(lines, g_array_index(diagnostics, GeanyDiagnostic, i).line);
+	return lines;
+}
+
+
+static gint compare_ints(gconstpointer a, gconstpointer b)
+{
+	return *(const gint *) a - *(const gint *) b;
+}
+
+
+/* Updates the error indicators of doc in one go */
+static void update_diagnostics(GeanyDocument *doc)
+{
+	GeanyDocumentPrivate *priv = doc->priv;
+	GArray *lines = NULL;
+
+	merge_diagnostics(doc);
+	if (priv->diagnostics_redraw)
+	{
+		editor_indicator_clear(doc->editor, GEANY_INDICATOR_ERROR);
+		if (priv->diagnostics != NULL)
+			lines = get_diagnostic_lines(priv->diagnostics);
+	}
+	else if (priv->unmarked_diagnostic_lines != NULL)
+	{
+		/* only mark the new lines */
+		lines = priv->unmarked_diagnostic_lines;
+		priv->unmarked_diagnostic_lines = NULL;
+		g_array_sort(lines, compare_ints);
+	}
+	if (priv->unmarked_diagnostic_lines != NULL)
+		g_array_free(priv->unmarked_diagnostic_lines, TRUE);
+	priv->unmarked_diagnostic_lines = NULL;
+	priv->diagnostics_redraw = FALSE;
+
+	if (lines != NULL)
+	{
+		if (editor_prefs.use_indicators)
+		{
+			editor_indicator_set_on_lines(doc->editor, GEANY_INDICATOR_ERROR,
+				(const gint *) lines->data, lines->len);
+		}
+		g_array_free(lines, TRUE);
+	}
+}
+
+
+static gboolean update_diagnostics_idle(gpointer data)
+{
+	guint i;
+
+	diagnostics_source = 0;
+	foreach_document(i)
+	{
+		GeanyDocument *doc = documents[i];
+
+		if (doc->priv->new_diagnostics != NULL || doc->priv->unmarked_diagnostic_lines != NULL ||
+			doc->priv->diagnostics_redraw)
+			update_diagnostics(doc);
+	}
+	return FALSE;
+}
+
+
+static void queue_update_diagnostics(void)
+{
+	if (diagnostics_source == 0)
+		diagnostics_source = g_timeout_add(DIAGNOSTICS_DELAY, update_diagnostics_idle, NULL);
+}
+
+
+/**
+ *  Adds a diagnostic to @a doc, like an error reported by a compiler.
+ *  The lines of the diagnostics are marked with @c GEANY_INDICATOR_ERROR shortly after they are
+ *  added, in one update per document for all diagnostics added meanwhile. Diagnostics which
+ *  the document already has are ignored.
+ *
+ *  @param doc The document.
+ *  @param source What reports the diagnostic, e.g. the name of a plugin.
+ *  @param line 0-based line number.
+ *  @param message @nullable The message, or @c NULL.
+ *
+ *  @since 1.39 (API 249)
+ **/
+GEANY_API_SYMBOL
+void document_add_diagnostic(GeanyDocument *doc, const gchar *source, gint line,
+		const gchar *message)
+{
+	GeanyDiagnostic diag;
+
+	g_return_if_fail(DOC_VALID(doc));
+	g_return_if_fail(source != NULL);
+	g_return_if_fail(line >= 0);
+
+	diag.line = line;
+	diag.source = g_strdup(source);
+	diag.message = g_strdup(message);
+
+	if (doc->priv->new_diagnostics == NULL)
+		doc->priv->new_diagnostics = diagnostics_new();
+	g_array_append_val(doc->priv->new_diagnostics, diag);
+	queue_update_diagnostics();
+}
+
+
+/**
+ *  Removes diagnostics of @a doc, and their indicators.
+ *
+ *  @param doc The document.
+ *  @param source @nullable Removes the diagnostics reported by @a source, or all of them if
+ *  @c NULL.
+ *
+ *  @since 1.39 (API 249)
+ **/
+GEANY_API_SYMBOL
+void document_clear_diagnostics(GeanyDocument *doc, const gchar *source)
+{
+	GArray *diagnostics;
+	gboolean redraw = FALSE;
+	guint i = 0;
+
+	g_return_if_fail(DOC_VALID(doc));
+
+	merge_diagnostics(doc);
+	diagnostics = doc->priv->diagnostics;
+	if (diagnostics == NULL)
+		return;
+
+	while (i < diagnostics->len)
+	{
+		GeanyDiagnostic *diag = &g_array_index(diagnostics, GeanyDiagnostic, i);
+
+		if (source == NULL || strcmp(diag->source, source) == 0)
+		{
+			g_array_remove_index(diagnostics, i);
+			redraw = TRUE;
+		}
+		else
+			i++;
+	}
+	if (redraw)
+	{
+		doc->priv->diagnostics_redraw = TRUE;
+		queue_update_diagnostics();
+	}
+}
+
+
+/* Finds the index of the first of the sorted diagnostics on line or after it */
+static guint find_diagnostic(GArray *diagnostics, gint line)
+{
+	guint lower = 0, upper = diagnostics->len;
+
+	while (lower < upper)
+	{
+		guint mid = lower + (upper - lower) / 2;
+
+		if (g_array_index(diagnostics, GeanyDiagnostic, mid).line < line)
+			lower = mid + 1;
+		else
+			upper = mid;
+	}
+	return lower;
+}
+
+
+/* Moves the lines of lines from first_line on by lines_added, dropping those of the lines
+ * [first_line, first_line - lines_added) when lines were removed. The order is kept. */
+static void shift_lines(GArray *lines, gint first_line, gint lines_added)
+{
+	guint i, n = 0;
+
+	for (i = 0; i < lines->len; i++)
+	{
+		gint line = g_array_index(lines, gint, i);
+
+		if (line >= first_line)
+		{
+			if (line < first_line - lines_added)
+				continue;
+			line += lines_added;
+		}
+		g_array_index(lines, gint, n++) = line;
+	}
+	g_array_set_size(lines, n);
+}
+
+
+/* Makes the diagnostics of doc follow an edit which added lines_added lines, or removed them
+ * if negative, at first_line. The lines from first_line on move, and the diagnostics of the
+ * removed lines are dropped. The indicators already set move with the text by themselves. */
+GEANY_EXPORT_SYMBOL
+void document_shift_diagnostics(GeanyDocument *doc, gint first_line, gint lines_added)
+{
+	GeanyDocumentPrivate *priv = doc->priv;
+	GArray *diagnostics;
+	guint i, end;
+
+	if (lines_added == 0)
+		return;
+
+	merge_diagnostics(doc);
+	if (priv->unmarked_diagnostic_lines != NULL)
+		shift_lines(priv->unmarked_diagnostic_lines, first_line, lines_added);
+
+	diagnostics = priv->diagnostics;
+	if (diagnostics == NULL)
+		return;
+
+	i = find_diagnostic(diagnostics, first_line);
+	if (lines_added < 0)
+	{
+		end = find_diagnostic(diagnostics, first_line - lines_added);
+		if (end > i)
+			g_array_remove_range(diagnostics, i, end - i);
+	}
+	for (; i < diagnostics->len; i++)
+		g_array_index(diagnostics, GeanyDiagnostic, i).line += lines_added;
+}
+
+
+/**
+ *  Gets the diagnostics of @a doc on the lines from @a first_line to @a last_line, sorted by
+ *  line. The lines of the diagnostics follow the lines added and removed since they were added,
+ *  and the diagnostics of removed lines are dropped.
+ *
+ *  @param doc The document.
+ *  @param first_line The first 0-based line.
+ *  @param last_line The last 0-based line, or -1 for the end of the document.
+ *
+ *  @return @transfer{container} @elementtype{GeanyDiagnostic} The diagnostics, which belong to
+ *  @a doc and are valid until its diagnostics change. Free the array with
+ *  @c g_ptr_array_free(array, TRUE).
+ *
+ *  @since 1.39 (API 249)
+ **/
+GEANY_API_SYMBOL
+GPtrArray *document_get_diagnostics(GeanyDocument *doc, gint first_line, gint last_line)
+{
+	GPtrArray *result = g_ptr_array_new();
+	GArray *diagnostics;
+	guint i;
+
+	g_return_val_if_fail(DOC_VALID(doc), result);
+
+	/* this only sorts the diagnostics, the lines of the new ones are still marked later */
+	merge_diagnostics(doc);
+	diagnostics = doc->priv->diagnostics;
+	if (diagnostics == NULL)
+		return result;
+
+	for (i = find_diagnostic(diagnostics, first_line); i < diagnostics->len; i++)
+	{
+		GeanyDiagnostic *diag = &g_array_index(diagnostics, GeanyDiagnostic, i);
+
+		if (last_line >= 0 && diag->line > last_line)
+			break;
+		g_ptr_array_add(result, diag);
+	}
+	return result;
+}
@@ -67,6 +67,7 @@ typedef struct GeanyFilePrefs
 	gboolean		show_keep_edit_history_on_reload_msg; /* whether to show the message introducing the above feature */
  	gboolean		reload_clean_doc_on_file_change;
  	gboolean		save_config_on_file_change;
+	gint			large_file_viewer_size;	/* hidden pref, in MiB */
 }
 GeanyFilePrefs;
 
@@ -215,6 +216,24 @@ gint document_compare_by_tab_order_reverse(gconstpointer a, gconstpointer b);
 
 GeanyDocument *document_find_by_id(guint id);
 
+/** A diagnostic of a document, like an error reported by a compiler.
+ * @see document_add_diagnostic().
+ * @since 1.39 (API 249) */
+typedef struct GeanyDiagnostic
+{
+	gint	 line;		/**< 0-based line number. */
+	gchar	*source;	/**< What reported the diagnostic, e.g. @c "build" for build commands. */
+	gchar	*message;	/**< @nullable The message, or @c NULL. */
+}
+GeanyDiagnostic;
+
+void document_add_diagnostic(GeanyDocument *doc, const gchar *source, gint line,
+		const gchar *message);
+
+void document_clear_diagnostics(GeanyDocument *doc, const gchar *source);
+
+GPtrArray *document_get_diagnostics(GeanyDocument *doc, gint first_line, gint last_line);
+
 
 #ifdef GEANY_PRIVATE
 
@@ -253,8 +272,33 @@ gboolean document_close_all(void);
 GeanyDocument *document_open_file_full(GeanyDocument *doc, const gchar *filename, gint pos,
 		gboolean readonly, GeanyFiletype *ft, const gchar *forced_enc);
 
+GeanyDocument *document_open_file_async(const gchar *locale_filename, gboolean readonly,
+		GeanyFiletype *ft, const gchar *forced_enc);
+
+void document_open_files_async(const GSList *filenames, gboolean readonly,
+		GeanyFiletype *ft, const gchar *forced_enc);
+
 void document_open_file_list(const gchar *data, gsize length);
 
+void document_prefetch_file(const gchar *locale_filename, const gchar *forced_enc);
+
+void document_prefetch_clear(void);
+
+void document_open_batch_begin(void);
+
+void document_open_batch_end(void);
+
+gboolean document_open_batch_active(void);
+
+void document_shift_diagnostics(GeanyDocument *doc, gint first_line, gint lines_added);
+
+gboolean document_save_file_async(GeanyDocument *doc, gboolean force);
+
+gboolean document_save_all_async(void);
+
+gboolean document_replace_file_contents(const gchar *locale_filename, const gchar *data,
+		gsize len, GError **error);
+
 gboolean document_search_bar_find(GeanyDocument *doc, const gchar *text, gboolean inc,
 		gboolean backwards);
 
@@ -273,6 +317,8 @@ void document_replace_sel(GeanyDocument *doc, const gchar *find_text, const gcha
 
 void document_update_tags(GeanyDocument *doc);
 
+void document_parse_pending_tags(void);
+
 void document_update_tag_list_in_idle(GeanyDocument *doc);
 
 void document_highlight_tags(GeanyDocument *doc);
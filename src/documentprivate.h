@@ -97,14 +97,26 @@ typedef struct GeanyDocumentPrivate
 	gboolean		 is_remote;
 	/* File status on disk of the document */
 	FileDiskStatus	 file_disk_status;
-	/* Reference to a GFileMonitor object, only used when GIO file monitoring is used. */
-	gpointer		 monitor;
-	/* Time of the last disk check, only used when legacy file monitoring is used. */
+	/* ID of the watch of the file on disk, see filewatch_add(), or 0 */
+	guint			 file_watch;
+	/* Time of the last disk check */
 	time_t			 last_check;
-	/* Modification time of the document on disk, only used when legacy file monitoring is used. */
+	/* Modification time of the document on disk */
 	time_t			 mtime;
+	/* MD5 checksum of the file as last read or written, to tell whether a change reported
+	 * on disk changed its contents, or NULL */
+	gchar			*disk_checksum;
+	/* Whether the file is being compared with disk_checksum, see check_disk_contents() */
+	gboolean		 disk_check_pending;
 	/* ID of the idle callback updating the tag list */
 	guint			 tag_list_update_source;
+	/* Incremented on each change of the text, to tell whether it was changed while saving */
+	guint			 text_version;
+	/* Whether parsing the symbols was deferred when opening the session */
+	gboolean		 tags_pending;
+	/* Whether it's a read-only view of a file too large to be edited, see
+	 * document_open_file_async() */
+	gboolean		 viewer;
 	/* Whether it's temporarily protected (read-only and saving needs confirmation). Does
 	 * not imply doc->readonly as writable files can be protected */
 	gint			 protected;
@@ -116,6 +128,14 @@ typedef struct GeanyDocumentPrivate
 	gchar			*tag_filter;
 	/* Group symbols in symbol tree by their type. */
 	gboolean		symbols_group_by_type;
+	/* GeanyDiagnostic's sorted by line, or NULL */
+	GArray			*diagnostics;
+	/* Diagnostics added since they were last merged into diagnostics, or NULL */
+	GArray			*new_diagnostics;
+	/* Lines of the merged diagnostics whose indicators are not set yet, or NULL */
+	GArray			*unmarked_diagnostic_lines;
+	/* Whether all error indicators have to be redrawn, e.g. after diagnostics were removed */
+	gboolean		 diagnostics_redraw;
 }
 GeanyDocumentPrivate;
 
@@ -49,6 +49,7 @@
 #include "prefs.h"
 #include "projectprivate.h"
 #include "sciwrappers.h"
+#include "search.h"
 #include "support.h"
 #include "symbols.h"
 #include "templates.h"
@@ -503,6 +504,10 @@ static void on_update_ui(GeanyEditor *editor, G_GNUC_UNUSED SCNotification *nt)
 	ScintillaObject *sci = editor->sci;
 	gint pos = sci_get_current_position(sci);
 
+	/* large documents are only marked around the visible lines */
+	if (nt->updated & (SC_UPDATE_CONTENT | SC_UPDATE_V_SCROLL))
+		search_mark_all_update(editor->document);
+
 	/* since Scintilla 2.24, SCN_UPDATEUI is also sent on scrolling though we don't need to handle
 	 * this and so ignore every SCN_UPDATEUI events except for content and selection changes */
 	if (! (nt->updated & SC_UPDATE_CONTENT) && ! (nt->updated & SC_UPDATE_SELECTION))
@@ -1134,8 +1139,18 @@ static gboolean on_editor_notify(G_GNUC_UNUSED GObject *object, GeanyEditor *edi
 			}
 			if (nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
 			{
+				doc->priv->text_version++;
 				document_update_tag_list_in_idle(doc);
 			}
+			if ((nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)) && nt->linesAdded)
+			{
+				gint line = sci_get_line_from_position(sci, nt->position);
+
+				/* the line of the edit only moves if the edit is at its start */
+				if (sci_get_position_from_line(sci, line) != nt->position)
+					line++;
+				document_shift_diagnostics(doc, line, nt->linesAdded);
+			}
 			break;
 
 		case SCN_CHARADDED:
@@ -4123,19 +4138,6 @@ void editor_display_current_line(GeanyEditor *editor, gfloat percent_of_view)
 }
 
 
- /*
- *  Deletes all currently set indicators in the @a editor window.
- *  Error indicators (red squiggly underlines) and usual line markers are removed.
- *
- *  @param editor The editor to operate on.
- */
-void editor_indicator_clear_errors(GeanyEditor *editor)
-{
-	editor_indicator_clear(editor, GEANY_INDICATOR_ERROR);
-	sci_marker_delete_all(editor->sci, 0);	/* remove the yellow error line marker */
-}
-
-
 /**
  *  Deletes all currently set indicators matching @a indic in the @a editor window.
  *
@@ -4232,6 +4234,36 @@ void editor_indicator_set_on_range(GeanyEditor *editor, gint indic, gint start,
 }
 
 
+/* Sets indicator indic on the sorted lines, like editor_indicator_set_on_line(), but selects the
+ * indicator once and reads no line text */
+void editor_indicator_set_on_lines(GeanyEditor *editor, gint indic, const gint *lines, guint n_lines)
+{
+	gint line_count;
+	guint i;
+
+	g_return_if_fail(editor != NULL);
+
+	line_count = sci_get_line_count(editor->sci);
+	sci_indicator_set(editor->sci, indic);
+	for (i = 0; i < n_lines; i++)
+	{
+		gint start, end;
+
+		if (lines[i] < 0 || lines[i] >= line_count || (i > 0 && lines[i] == lines[i - 1]))
+			continue;
+
+		/* don't set the indicator on whitespace */
+		start = sci_get_line_indent_position(editor->sci, lines[i]);
+		end = sci_get_line_end_position(editor->sci, lines[i]);
+		while (end > start && isspace(sci_get_char_at(editor->sci, end - 1)))
+			end--;
+
+		if (end > start)
+			sci_indicator_fill(editor->sci, start, end - start);
+	}
+}
+
+
 /* Inserts the given colour (format should be #...), if there is a selection starting with 0x...
  * the replacement will also start with 0x... */
 void editor_insert_color(GeanyEditor *editor, const gchar *colour)
@@ -4956,6 +4988,10 @@ static ScintillaObject *create_new_sci(GeanyEditor *editor)
 	/* input method editor's candidate window behaviour */
 	SSM(sci, SCI_SETIMEINTERACTION, editor_prefs.ime_interaction, 0);
 
+	/* style the rest of the document in idle time, on a worker thread if enabled */
+	if (editor_prefs.background_styling)
+		SSM(sci, SCI_SETIDLESTYLING, SC_IDLESTYLING_AFTERVISIBLE, 0);
+
 #ifdef GDK_WINDOWING_QUARTZ
 # if ! GTK_CHECK_VERSION(3,16,0)
 	/* "retina" (HiDPI) display support on OS X - requires disabling buffered draw
@@ -140,6 +140,7 @@ typedef struct GeanyEditorPrefs
 	gint		scroll_lines_around_cursor;
 	gint		ime_interaction; /* input method editor's candidate window behaviour */
 	gboolean	show_line_endings_only_when_differ;
+	gboolean	background_styling;	/* hidden pref */
 }
 GeanyEditorPrefs;
 
@@ -299,7 +300,7 @@ void editor_select_indent_block(GeanyEditor *editor);
 
 void editor_set_font(GeanyEditor *editor, const gchar *font);
 
-void editor_indicator_clear_errors(GeanyEditor *editor);
+void editor_indicator_set_on_lines(GeanyEditor *editor, gint indic, const gint *lines, guint n_lines);
 
 void editor_fold_all(GeanyEditor *editor);
 
@@ -44,6 +44,7 @@
 #include "utils.h"
 
 #include <string.h>
+#include <errno.h>
 
 
 /* <meta http-equiv="content-type" content="text/html; charset=UTF-8" /> */
@@ -55,6 +56,10 @@
 static GRegex *pregs[2];
 static gboolean pregs_loaded = FALSE;
 
+/* charset name -> ByteMap, filled on demand from any thread */
+static GHashTable *byte_maps = NULL;
+G_LOCK_DEFINE_STATIC(byte_maps);
+
 
 GeanyEncoding encodings[GEANY_ENCODINGS_MAX];
 
@@ -399,6 +404,11 @@ void encodings_finalize(void)
 			g_regex_unref(pregs[i]);
 		}
 	}
+	if (byte_maps != NULL)
+	{
+		g_hash_table_destroy(byte_maps);
+		byte_maps = NULL;
+	}
 }
 
 
@@ -665,6 +675,175 @@ gchar *encodings_convert_to_utf8_from_charset(const gchar *buffer, gssize size,
 }
 
 
+/* Statistics of a text gathered in a single pass by scan_text() */
+typedef struct
+{
+	gboolean	utf8;		/* whether it is valid UTF-8 without null bytes */
+	gboolean	has_nul;
+	gsize		high_bytes[128];	/* occurrences of each of the bytes 0x80 to 0xFF */
+}
+TextStats;
+
+#define HIGH_BITS G_GUINT64_CONSTANT(0x8080808080808080)
+#define LOW_BITS G_GUINT64_CONSTANT(0x0101010101010101)
+
+/* Validates text as UTF-8 and counts its non-ASCII bytes. Runs of ASCII text without null
+ * bytes are skipped eight bytes at a time. */
+static void scan_text(const gchar *text, gsize size, TextStats *stats)
+{
+	const guchar *p = (const guchar *) text;
+	const guchar *end = p + size;
+	guint pending = 0;	/* continuation bytes still expected */
+	guchar lower = 0x80, upper = 0xbf;	/* range of the next continuation byte */
+
+	memset(stats, 0, sizeof *stats);
+	stats->utf8 = TRUE;
+
+	while (p < end)
+	{
+		guchar byte;
+
+		if (pending == 0)
+		{
+			while (end - p >= 8)
+			{
+				guint64 word;
+
+				memcpy(&word, p, sizeof word);
+				/* stop at a byte with the high bit set or a null byte */
+				if ((word & HIGH_BITS) || ((word - LOW_BITS) & ~word & HIGH_BITS))
+					break;
+				p += 8;
+			}
+			if (p == end)
+				break;
+		}
+
+		byte = *p++;
+		if (byte >= 0x80)
+			stats->high_bytes[byte - 0x80]++;
+		else if (byte == 0)
+			stats->has_nul = TRUE;
+
+		if (! stats->utf8)
+			continue;
+		if (pending > 0)
+		{
+			if (byte < lower || byte > upper)
+			{
+				stats->utf8 = FALSE;
+				pending = 0;
+			}
+			else
+				pending--;
+			lower = 0x80;
+			upper = 0xbf;
+		}
+		else if (byte < 0x80)
+			continue;
+		else if (byte >= 0xc2 && byte <= 0xdf)
+			pending = 1;
+		else if (byte >= 0xe0 && byte <= 0xef)
+		{
+			pending = 2;
+			if (byte == 0xe0)
+				lower = 0xa0;	/* overlong */
+			else if (byte == 0xed)
+				upper = 0x9f;	/* surrogates */
+		}
+		else if (byte >= 0xf0 && byte <= 0xf4)
+		{
+			pending = 3;
+			if (byte == 0xf0)
+				lower = 0x90;	/* overlong */
+			else if (byte == 0xf4)
+				upper = 0x8f;	/* above U+10FFFF */
+		}
+		else
+			stats->utf8 = FALSE;
+	}
+	if (pending > 0 || stats->has_nul)
+		stats->utf8 = FALSE;
+}
+
+
+/* Which bytes a single byte charset can not convert, to rule it out without converting the
+ * text. Multibyte and stateful charsets are not usable this way, they have to be tried. */
+typedef struct
+{
+	gboolean	usable;
+	gboolean	unmapped[128];	/* for the bytes 0x80 to 0xFF */
+}
+ByteMap;
+
+
+static ByteMap *byte_map_new(const gchar *charset)
+{
+	ByteMap *map = g_new0(ByteMap, 1);
+	GIConv cd = g_iconv_open("UTF-8", charset);
+	guint byte;
+
+	if (cd == (GIConv) -1)
+		return map;
+
+	map->usable = TRUE;
+	for (byte = 1; byte < 256 && map->usable; byte++)
+	{
+		gchar in = (gchar) byte;
+		gchar out[8];
+		gchar *in_ptr = &in, *out_ptr = out;
+		gsize in_left = 1, out_left = sizeof out;
+
+		g_iconv(cd, NULL, NULL, NULL, NULL);	/* reset the conversion state */
+		if (g_iconv(cd, &in_ptr, &in_left, &out_ptr, &out_left) == (gsize) -1)
+		{
+			/* bytes which start a sequence make the charset unusable */
+			if (errno == EILSEQ && byte >= 0x80)
+				map->unmapped[byte - 0x80] = TRUE;
+			else
+				map->usable = FALSE;
+		}
+		else if (out_ptr == out)
+			map->usable = FALSE;	/* a shift sequence */
+		else if (byte < 0x80 && (out_ptr - out != 1 || out[0] != in))
+			map->usable = FALSE;	/* not ASCII compatible */
+	}
+	g_iconv_close(cd);
+	return map;
+}
+
+
+/* Whether converting text with stats from charset is known to fail. */
+static gboolean charset_rules_out(const gchar *charset, const TextStats *stats)
+{
+	const ByteMap *map;
+	guint i;
+
+	G_LOCK(byte_maps);
+	if (byte_maps == NULL)
+		byte_maps = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	map = g_hash_table_lookup(byte_maps, charset);
+	if (map == NULL)
+	{
+		map = byte_map_new(charset);
+		g_hash_table_insert(byte_maps, g_strdup(charset), (gpointer) map);
+	}
+	G_UNLOCK(byte_maps);
+
+	if (! map->usable)
+		return FALSE;
+	/* a null byte fails the validation of the converted text */
+	if (stats->has_nul)
+		return TRUE;
+	for (i = 0; i < G_N_ELEMENTS(map->unmapped); i++)
+	{
+		if (map->unmapped[i] && stats->high_bytes[i] > 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
 static gchar *encodings_check_regexes(const gchar *buffer, gsize size)
 {
 	guint i;
@@ -680,8 +859,9 @@ static gchar *encodings_check_regexes(const gchar *buffer, gsize size)
 }
 
 
+/* stats can be NULL, otherwise charsets which can not convert the text are skipped */
 static gchar *encodings_convert_to_utf8_with_suggestion(const gchar *buffer, gssize size,
-		const gchar *suggested_charset, gchar **used_encoding)
+		const gchar *suggested_charset, gchar **used_encoding, const TextStats *stats)
 {
 	const gchar *locale_charset = NULL;
 	const gchar *charset;
@@ -746,6 +926,12 @@ static gchar *encodings_convert_to_utf8_with_suggestion(const gchar *buffer, gss
 		if (G_UNLIKELY(charset == NULL))
 			continue;
 
+		if (stats != NULL && charset_rules_out(charset, stats))
+		{
+			geany_debug("Skipping %s, it can not represent the data.", charset);
+			continue;
+		}
+
 		geany_debug("Trying to convert %" G_GSIZE_FORMAT " bytes of data from %s into UTF-8.",
 			size, charset);
 		utf8_content = encodings_convert_to_utf8_from_charset(buffer, size, charset, FALSE);
@@ -785,10 +971,16 @@ gchar *encodings_convert_to_utf8(const gchar *buffer, gssize size, gchar **used_
 {
 	gchar *regex_charset;
 	gchar *utf8;
+	TextStats stats;
+
+	if (size == -1)
+		size = strlen(buffer);
 
 	/* first try to read the encoding from the file content */
 	regex_charset = encodings_check_regexes(buffer, size);
-	utf8 = encodings_convert_to_utf8_with_suggestion(buffer, size, regex_charset, used_encoding);
+	scan_text(buffer, size, &stats);
+	utf8 = encodings_convert_to_utf8_with_suggestion(buffer, size, regex_charset, used_encoding,
+		&stats);
 	g_free(regex_charset);
 
 	return utf8;
@@ -882,7 +1074,10 @@ handle_forced_encoding(BufferData *buffer, const gchar *forced_enc)
 
 	if (utils_str_equal(forced_enc, "UTF-8"))
 	{
-		if (! g_utf8_validate(buffer->data, buffer->len, NULL))
+		TextStats stats;
+
+		scan_text(buffer->data, buffer->len, &stats);
+		if (! stats.utf8)
 		{
 			return FALSE;
 		}
@@ -951,10 +1146,13 @@ handle_encoding(BufferData *buffer, GeanyEncodingIndex enc_idx)
 		{
 			/* first try to read the encoding from the file content */
 			gchar *regex_charset = encodings_check_regexes(buffer->data, buffer->size);
+			TextStats stats;
+
+			/* validate UTF-8 and gather what rules out other charsets in one pass */
+			scan_text(buffer->data, buffer->size, &stats);
 
 			/* try UTF-8 first */
-			if (encodings_get_idx_from_charset(regex_charset) == GEANY_ENCODING_UTF_8 &&
-				(buffer->size == buffer->len) && g_utf8_validate(buffer->data, buffer->len, NULL))
+			if (encodings_get_idx_from_charset(regex_charset) == GEANY_ENCODING_UTF_8 && stats.utf8)
 			{
 				buffer->enc = g_strdup("UTF-8");
 			}
@@ -962,7 +1160,7 @@ handle_encoding(BufferData *buffer, GeanyEncodingIndex enc_idx)
 			{
 				/* detect the encoding */
 				gchar *converted_text = encodings_convert_to_utf8_with_suggestion(buffer->data,
-					buffer->size, regex_charset, &buffer->enc);
+					buffer->size, regex_charset, &buffer->enc, &stats);
 
 				if (converted_text == NULL)
 				{
@@ -1083,3 +1281,36 @@ gboolean encodings_convert_to_utf8_auto(gchar **buf, gsize *size, const gchar *f
 	*buf = buffer.data;
 	return TRUE;
 }
+
+
+/*
+ * Checks whether encodings_convert_to_utf8_auto() takes a file starting with @a head as
+ * UTF-8 without further detection, provided the whole file is valid UTF-8 without null
+ * bytes. Such files can be converted piece by piece by validating each one.
+ *
+ * @param head the start of the file, at least its first 512 bytes unless it is shorter.
+ * @param size the size of @a head.
+ * @param forced_enc forced encoding to use, or @c NULL
+ * @param has_bom return location to store whether the data has a UTF-8 BOM
+ *
+ * @return @c TRUE if the file can be read as UTF-8 piece by piece, @c FALSE otherwise.
+ */
+gboolean encodings_check_utf8_head(const gchar *head, gsize size, const gchar *forced_enc,
+		gboolean *has_bom)
+{
+	GeanyEncodingIndex enc_idx = encodings_scan_unicode_bom(head, size, NULL);
+	gchar *regex_charset;
+	gboolean utf8;
+
+	*has_bom = (enc_idx == GEANY_ENCODING_UTF_8);
+
+	if (forced_enc != NULL)
+		return utils_str_equal(forced_enc, "UTF-8");
+	if (enc_idx != GEANY_ENCODING_NONE)
+		return *has_bom;
+
+	regex_charset = encodings_check_regexes(head, size);
+	utf8 = encodings_get_idx_from_charset(regex_charset) == GEANY_ENCODING_UTF_8;
+	g_free(regex_charset);
+	return utf8;
+}
@@ -1256,7 +1256,8 @@ GeanyFiletype *filetypes_lookup_by_name(const gchar *name)
 static void compile_regex(GeanyFiletype *ft, gchar *regstr)
 {
 	GError *error = NULL;
-	GRegex *regex = g_regex_new(regstr, 0, 0, &error);
+	/* error regexes are matched against every line of build output */
+	GRegex *regex = g_regex_new(regstr, G_REGEX_OPTIMIZE, 0, &error);
 
 	if (!regex)
 	{
@@ -1270,42 +1271,50 @@ static void compile_regex(GeanyFiletype *ft, gchar *regstr)
 }
 
 
-gboolean filetypes_parse_error_message(GeanyFiletype *ft, const gchar *message,
-		gchar **filename, gint *line)
+/* Returns: a new reference to the compiled error regex of ft for the build group
+ * build_grp, or NULL. GRegex is immutable, so it can be used from any thread. */
+GRegex *filetypes_get_error_regex(GeanyFiletype *ft, guint build_grp)
 {
 	gchar *regstr;
 	gchar **tmp;
-	GeanyDocument *doc;
-	GMatchInfo *minfo;
-	gint i, n_match_groups;
-	gchar *first, *second;
 
 	if (ft == NULL)
 	{
-		doc = document_get_current();
+		GeanyDocument *doc = document_get_current();
+
 		if (doc != NULL)
 			ft = doc->file_type;
 	}
-	tmp = build_get_regex(build_info.grp, ft, NULL);
+	tmp = build_get_regex(build_grp, ft, NULL);
 	if (tmp == NULL)
-		return FALSE;
+		return NULL;
 	regstr = *tmp;
 
-	*filename = NULL;
-	*line = -1;
-
 	if (G_UNLIKELY(EMPTY(regstr)))
-		return FALSE;
+		return NULL;
 
 	if (!ft->priv->error_regex || regstr != ft->priv->last_error_pattern)
 	{
 		compile_regex(ft, regstr);
 		ft->priv->last_error_pattern = regstr;
 	}
-	if (!ft->priv->error_regex)
-		return FALSE;
+	return ft->priv->error_regex ? g_regex_ref(ft->priv->error_regex) : NULL;
+}
+
+
+/* Returns: whether message matched regex, with the file name and line number of the error.
+ * Can be used from any thread. */
+gboolean filetypes_parse_error_regex(GRegex *regex, const gchar *message,
+		gchar **filename, gint *line)
+{
+	GMatchInfo *minfo;
+	gint i, n_match_groups;
+	gchar *first, *second;
+
+	*filename = NULL;
+	*line = -1;
 
-	if (!g_regex_match(ft->priv->error_regex, message, 0, &minfo))
+	if (!g_regex_match(regex, message, 0, &minfo))
 	{
 		g_match_info_free(minfo);
 		return FALSE;
@@ -222,7 +222,9 @@ GtkFileFilter *filetypes_create_file_filter_all_source(void);
 
 gboolean filetype_has_tags(GeanyFiletype *ft);
 
-gboolean filetypes_parse_error_message(GeanyFiletype *ft, const gchar *message,
+GRegex *filetypes_get_error_regex(GeanyFiletype *ft, guint build_grp);
+
+gboolean filetypes_parse_error_regex(GRegex *regex, const gchar *message,
 		gchar **filename, gint *line);
 
 gboolean filetype_get_comment_open_close(const GeanyFiletype *ft, gboolean single_first,
@@ -0,0 +1,245 @@
+/*
+ *      filewatch.c - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2024 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Watches files for changes on disk.
+ * All watched files of a directory share one monitor of the directory, and GIO serves all
+ * monitors from a single backend (one inotify instance on Linux). Changes are collected and
+ * reported to the UI in batches, at most once per file and batch.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "filewatch.h"
+
+#include <gio/gio.h>
+
+
+/* time to collect changes before reporting them */
+#define FILEWATCH_BATCH_INTERVAL 250
+
+
+typedef struct
+{
+	guint			 id;
+	gchar			*dirname;
+	gchar			*basename;
+	FileWatchFunc	 func;
+	gpointer		 user_data;
+}
+FileWatch;
+
+/* A monitored directory */
+typedef struct
+{
+	GFileMonitor	*monitor;
+	GHashTable		*watches;	/* basename -> GSList of FileWatch */
+}
+DirWatch;
+
+
+static GHashTable *watches = NULL;		/* id -> FileWatch */
+static GHashTable *dir_watches = NULL;	/* dirname -> DirWatch */
+static GHashTable *pending = NULL;		/* ids of the watches to report */
+static guint flush_source = 0;
+static guint watch_id_counter = 0;
+
+
+static gboolean flush_pending(gpointer data)
+{
+	GHashTable *ids = pending;
+	GHashTableIter iter;
+	gpointer key;
+
+	flush_source = 0;
+	/* callbacks may add or remove watches */
+	pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+	g_hash_table_iter_init(&iter, ids);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		FileWatch *watch = g_hash_table_lookup(watches, key);
+
+		/* it could have been removed by an earlier callback */
+		if (watch != NULL)
+			watch->func(watch->user_data);
+	}
+	g_hash_table_destroy(ids);
+	return FALSE;
+}
+
+
+static void on_dir_changed(G_GNUC_UNUSED GFileMonitor *monitor, GFile *file,
+		G_GNUC_UNUSED GFile *other_file, GFileMonitorEvent event, DirWatch *dir)
+{
+	gchar *basename;
+	GSList *node;
+
+	switch (event)
+	{
+		case G_FILE_MONITOR_EVENT_CHANGED:
+		case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+		case G_FILE_MONITOR_EVENT_DELETED:
+		case G_FILE_MONITOR_EVENT_CREATED:
+		case G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED:
+			break;
+		default:
+			return;
+	}
+
+	basename = g_file_get_basename(file);
+	for (node = g_hash_table_lookup(dir->watches, basename); node != NULL; node = node->next)
+	{
+		FileWatch *watch = node->data;
+
+		g_hash_table_add(pending, GUINT_TO_POINTER(watch->id));
+	}
+	g_free(basename);
+
+	if (flush_source == 0 && g_hash_table_size(pending) > 0)
+		flush_source = g_timeout_add(FILEWATCH_BATCH_INTERVAL, flush_pending, NULL);
+}
+
+
+static void dir_watch_free(gpointer data)
+{
+	DirWatch *dir = data;
+	GHashTableIter iter;
+	gpointer list;
+
+	g_hash_table_iter_init(&iter, dir->watches);
+	while (g_hash_table_iter_next(&iter, NULL, &list))
+		g_slist_free(list);
+
+	g_signal_handlers_disconnect_by_func(dir->monitor, on_dir_changed, dir);
+	g_file_monitor_cancel(dir->monitor);
+	g_object_unref(dir->monitor);
+	g_hash_table_destroy(dir->watches);
+	g_free(dir);
+}
+
+
+static void file_watch_free(gpointer data)
+{
+	FileWatch *watch = data;
+
+	g_free(watch->dirname);
+	g_free(watch->basename);
+	g_free(watch);
+}
+
+
+/* Watches locale_filename, which does not need to exist, and calls func in the main loop
+ * after it has been changed, created or deleted.
+ * Returns: the ID of the watch to pass to filewatch_remove(), or 0 if the file can not be
+ * watched. */
+guint filewatch_add(const gchar *locale_filename, FileWatchFunc func, gpointer user_data)
+{
+	FileWatch *watch;
+	DirWatch *dir;
+	GSList *list;
+
+	g_return_val_if_fail(locale_filename != NULL, 0);
+	g_return_val_if_fail(func != NULL, 0);
+
+	if (watches == NULL)
+	{
+		watches = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, file_watch_free);
+		dir_watches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, dir_watch_free);
+		pending = g_hash_table_new(g_direct_hash, g_direct_equal);
+	}
+
+	watch = g_new0(FileWatch, 1);
+	watch->dirname = g_path_get_dirname(locale_filename);
+	watch->basename = g_path_get_basename(locale_filename);
+	watch->func = func;
+	watch->user_data = user_data;
+
+	dir = g_hash_table_lookup(dir_watches, watch->dirname);
+	if (dir == NULL)
+	{
+		GFile *file = g_file_new_for_path(watch->dirname);
+		GFileMonitor *monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+
+		g_object_unref(file);
+		if (monitor == NULL)
+		{
+			file_watch_free(watch);
+			return 0;
+		}
+		dir = g_new0(DirWatch, 1);
+		dir->monitor = monitor;
+		dir->watches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+		g_signal_connect(monitor, "changed", G_CALLBACK(on_dir_changed), dir);
+		g_hash_table_insert(dir_watches, g_strdup(watch->dirname), dir);
+	}
+
+	watch->id = ++watch_id_counter;
+	list = g_hash_table_lookup(dir->watches, watch->basename);
+	g_hash_table_insert(dir->watches, g_strdup(watch->basename), g_slist_prepend(list, watch));
+	g_hash_table_insert(watches, GUINT_TO_POINTER(watch->id), watch);
+	return watch->id;
+}
+
+
+void filewatch_remove(guint id)
+{
+	FileWatch *watch;
+	DirWatch *dir;
+	GSList *list;
+
+	if (id == 0 || watches == NULL)
+		return;
+	watch = g_hash_table_lookup(watches, GUINT_TO_POINTER(id));
+	g_return_if_fail(watch != NULL);
+
+	dir = g_hash_table_lookup(dir_watches, watch->dirname);
+	list = g_hash_table_lookup(dir->watches, watch->basename);
+	list = g_slist_remove(list, watch);
+	if (list != NULL)
+		g_hash_table_insert(dir->watches, g_strdup(watch->basename), list);
+	else
+	{
+		g_hash_table_remove(dir->watches, watch->basename);
+		/* stop monitoring directories without watched files */
+		if (g_hash_table_size(dir->watches) == 0)
+			g_hash_table_remove(dir_watches, watch->dirname);
+	}
+
+	g_hash_table_remove(pending, GUINT_TO_POINTER(id));
+	g_hash_table_remove(watches, GUINT_TO_POINTER(id));
+}
+
+
+void filewatch_finalize(void)
+{
+	if (watches == NULL)
+		return;
+
+	if (flush_source != 0)
+		g_source_remove(flush_source);
+	flush_source = 0;
+	g_hash_table_destroy(pending);
+	g_hash_table_destroy(dir_watches);
+	g_hash_table_destroy(watches);
+	watches = NULL;
+}
@@ -0,0 +1,40 @@
+/*
+ *      filewatch.h - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2024 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef GEANY_FILEWATCH_H
+#define GEANY_FILEWATCH_H 1
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Called once for any number of changes of a watched file reported within a short time */
+typedef void (*FileWatchFunc)(gpointer user_data);
+
+guint filewatch_add(const gchar *locale_filename, FileWatchFunc func, gpointer user_data);
+
+void filewatch_remove(guint id);
+
+void filewatch_finalize(void);
+
+G_END_DECLS
+
+#endif /* GEANY_FILEWATCH_H */
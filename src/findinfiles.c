@@ -0,0 +1,1116 @@
+/*
+ *      findinfiles.c - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2024 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Built-in Find in Files engine.
+ * Directories are walked and files searched on a pool of worker threads, each directory and
+ * each file being one job. Files are mapped into memory and searched as a whole: plain text
+ * is found by scanning for its first byte with memchr(), regular expressions are matched
+ * line by line. The result lines of each file are queued together and handed to the main
+ * loop in batches.
+ * When replacing, the edits of each file are collected with the result lines, which are
+ * then a preview of the changed lines. The edits are applied to the files on the same
+ * threads, while the edits of buffers are handed to the main loop.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "findinfiles.h"
+
+#include "document.h"
+#include "support.h"
+#include "utils.h"
+
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+
+/* time to collect results before handing them to the main loop */
+#define FIF_FLUSH_INTERVAL 100
+/* files with a NUL byte in their beginning are skipped as binary, like grep -I does */
+#define FIF_BINARY_CHECK_SIZE 8192
+
+
+typedef struct
+{
+	GRegex		*regex;			/* NULL for a plain text search */
+	gchar		*literal;
+	gsize		 literal_len;
+	gboolean	 whole_word;	/* only used for plain text */
+}
+FifMatcher;
+
+typedef struct
+{
+	GPatternSpec	*pattern;
+	gboolean		 anchored;	/* matches the path below the ignore file instead of the name */
+	gboolean		 dir_only;
+}
+FifIgnoreRule;
+
+/* The rules of a .gitignore file, which apply to everything below its directory */
+typedef struct FifIgnore FifIgnore;
+struct FifIgnore
+{
+	gint		 ref_count;
+	FifIgnore	*parent;
+	gchar		*base;		/* displayed path of the directory */
+	GPtrArray	*rules;
+};
+
+/* The edits of a file or buffer */
+typedef struct
+{
+	gchar			*locale_path;
+	GBytes			*buffer;		/* the searched buffer, NULL for a file */
+	gint64			 size;			/* of the file when it was searched */
+	gint64			 mtime;
+	GArray			*edits;			/* FifEdit, sorted */
+}
+FifFileEdits;
+
+struct FifReplace
+{
+	gint			 ref_count;
+	gchar			*text;			/* in the encoding of the files */
+	gchar			*utf8_text;		/* for buffers */
+	gboolean		 expand;		/* whether text has references and escapes to expand */
+	GMutex			 mutex;
+	GPtrArray		*files;			/* FifFileEdits, protected by mutex */
+	/* while applying */
+	volatile gint	 pending;		/* files not written yet */
+	volatile gint	 n_changed;
+	GPtrArray		*errors;		/* protected by mutex */
+	FifApplyDoneFunc done_func;
+	gpointer		 user_data;
+};
+
+struct FifSearch
+{
+	FifMatcher		 file_matcher;
+	FifMatcher		 utf8_matcher;	/* for buffers if the files are not in UTF-8 */
+	FifMatcher		 raw_matcher;	/* for files which are not valid UTF-8 although they should be */
+	gchar			*enc;
+	GSList			*patterns;		/* GPatternSpec of the files to search */
+	gboolean		 invert;
+	gboolean		 recursive;
+	GHashTable		*buffers;		/* locale real path -> GBytes, read-only once started */
+	FifFileFilter	 file_filter;
+	gpointer		 file_filter_data;
+	GDestroyNotify	 file_filter_destroy;
+	FifReplace		*replace;		/* NULL unless replacing */
+	FifResultsFunc	 results_func;
+	FifDoneFunc		 done_func;
+	gpointer		 user_data;
+
+	volatile gint	 cancelled;
+	volatile gint	 pending;		/* jobs not finished yet */
+
+	GMutex			 mutex;
+	GPtrArray		*results;		/* protected by mutex */
+	guint			 n_matches;		/* protected by mutex */
+	guint			 flush_source;	/* protected by mutex */
+};
+
+typedef struct
+{
+	FifSearch	*search;
+	FifReplace	*replace;		/* set to write file_edits instead of searching */
+	FifFileEdits *file_edits;
+	gchar		*locale_path;
+	gchar		*display_path;	/* NULL for the directory searched without recursion */
+	FifIgnore	*ignore;		/* rules applying to the contents of a directory */
+	gboolean	 is_dir;
+}
+FifJob;
+
+
+static GThreadPool *fif_pool = NULL;
+static FifSearch *current_search = NULL;
+
+
+static gboolean matcher_init(FifMatcher *matcher, const FifQuery *query, const gchar *text,
+		gboolean raw, GError **error)
+{
+	GRegexCompileFlags flags = G_REGEX_OPTIMIZE;
+	gchar *pattern;
+
+	if (! query->regexp && query->case_sensitive && strchr(text, '\n') == NULL)
+	{
+		matcher->literal = g_strdup(text);
+		matcher->literal_len = strlen(text);
+		matcher->whole_word = query->whole_word;
+		return TRUE;
+	}
+
+	pattern = query->regexp ? g_strdup(text) : g_regex_escape_string(text, -1);
+	if (query->whole_word)
+		SETPTR(pattern, g_strconcat("\\b(?:", pattern, ")\\b", NULL));
+	if (! query->case_sensitive)
+		flags |= G_REGEX_CASELESS;
+	/* files in another encoding or with invalid UTF-8 are matched byte by byte */
+	if (raw)
+		flags |= G_REGEX_RAW;
+
+	matcher->regex = g_regex_new(pattern, flags, 0, error);
+	g_free(pattern);
+	return matcher->regex != NULL;
+}
+
+
+static void matcher_clear(FifMatcher *matcher)
+{
+	if (matcher->regex != NULL)
+		g_regex_unref(matcher->regex);
+	g_free(matcher->literal);
+}
+
+
+static const gchar *find_literal(const FifMatcher *matcher, const gchar *p, const gchar *end)
+{
+	const gsize len = matcher->literal_len;
+
+	while ((gsize) (end - p) >= len)
+	{
+		p = memchr(p, matcher->literal[0], end - p - len + 1);
+		if (p == NULL)
+			return NULL;
+		if (memcmp(p + 1, matcher->literal + 1, len - 1) == 0)
+			return p;
+		p++;
+	}
+	return NULL;
+}
+
+
+/* non-ASCII bytes are taken as parts of words so that multibyte letters don't end one */
+static gboolean is_word_byte(guchar c)
+{
+	return g_ascii_isalnum(c) || c == '_' || c >= 0x80;
+}
+
+
+static gboolean line_matches(const FifMatcher *matcher, const gchar *line, gsize len)
+{
+	const gchar *end = line + len;
+	const gchar *p = line;
+
+	if (matcher->regex != NULL)
+		return g_regex_match_full(matcher->regex, line, len, 0, 0, NULL, NULL);
+
+	while ((p = find_literal(matcher, p, end)) != NULL)
+	{
+		const gchar *after = p + matcher->literal_len;
+
+		if (! matcher->whole_word ||
+			((p == line || ! is_word_byte(p[-1])) && (after == end || ! is_word_byte(*after))))
+			return TRUE;
+		p++;
+	}
+	return FALSE;
+}
+
+
+/* prefix marks the lines of a replace preview */
+static gchar *format_result(const gchar *display_path, guint line_num, const gchar *prefix,
+		const gchar *line, gsize len, const gchar *enc)
+{
+	gchar *result = g_strdup_printf("%s:%u:%s%.*s", display_path, line_num, prefix, (gint) len,
+		line);
+
+	/* enc is NULL when encoding is set to UTF-8, so we can skip any conversion */
+	if (enc != NULL && ! g_utf8_validate(result, -1, NULL))
+	{
+		gchar *utf8_result = g_convert(result, -1, "UTF-8", enc, NULL, NULL, NULL);
+
+		if (utf8_result != NULL)
+			SETPTR(result, utf8_result);
+	}
+	return g_strchomp(result);
+}
+
+
+static void add_edit(GArray *edits, GString *new_line, const gchar *line, gsize *copied,
+		gsize start, gsize end, gsize offset, gchar *text)
+{
+	FifEdit edit;
+
+	g_string_append_len(new_line, line + *copied, start - *copied);
+	g_string_append(new_line, text);
+	*copied = end;
+
+	edit.start = offset + start;
+	edit.end = offset + end;
+	edit.text = text;
+	g_array_append_val(edits, edit);
+}
+
+
+/* Adds the edits replacing the matches in line, which starts at offset in its file, to
+ * edits.
+ * Returns: the replaced line, or NULL if nothing matched. */
+static gchar *replace_line(const FifMatcher *matcher, const gchar *replace_text, gboolean expand,
+		const gchar *line, gsize len, gsize offset, GArray *edits)
+{
+	GString *new_line = g_string_new(NULL);
+	const guint n_edits = edits->len;
+	gsize copied = 0;
+
+	if (matcher->regex != NULL)
+	{
+		GMatchInfo *info;
+
+		g_regex_match_full(matcher->regex, line, len, 0, 0, &info, NULL);
+		while (g_match_info_matches(info))
+		{
+			gchar *text = NULL;
+			gint start, end;
+
+			g_match_info_fetch_pos(info, 0, &start, &end);
+			if (expand)
+				text = g_match_info_expand_references(info, replace_text, NULL);
+			if (text == NULL)
+				text = g_strdup(replace_text);
+			add_edit(edits, new_line, line, &copied, start, end, offset, text);
+			g_match_info_next(info, NULL);
+		}
+		g_match_info_free(info);
+	}
+	else
+	{
+		const gchar *end = line + len;
+		const gchar *p = line;
+
+		while ((p = find_literal(matcher, p, end)) != NULL)
+		{
+			const gchar *after = p + matcher->literal_len;
+
+			if (! matcher->whole_word ||
+				((p == line || ! is_word_byte(p[-1])) && (after == end || ! is_word_byte(*after))))
+			{
+				add_edit(edits, new_line, line, &copied, p - line, after - line, offset,
+					g_strdup(replace_text));
+				p = after;
+			}
+			else
+				p++;
+		}
+	}
+
+	if (edits->len == n_edits)
+	{
+		g_string_free(new_line, TRUE);
+		return NULL;
+	}
+	g_string_append_len(new_line, line + copied, len - copied);
+	return g_string_free(new_line, FALSE);
+}
+
+
+/* Adds the lines of data which match, or don't match if inverted, to lines. If edits is
+ * set, the matches are replaced with replace_text instead and the replaced lines are added
+ * after the original ones.
+ * Returns: the number of matches */
+static guint search_data(FifSearch *search, const FifMatcher *matcher, const gchar *data,
+		gsize len, const gchar *enc, const gchar *display_path, const gchar *replace_text,
+		GArray *edits, GPtrArray *lines)
+{
+	const gchar *end = data + len;
+	const gchar *line = data;
+	guint line_num = 1;
+	guint n_matches = 0;
+
+	while (line < end && ! g_atomic_int_get(&search->cancelled))
+	{
+		const gchar *eol, *next;
+		gsize line_len;
+
+		/* skip right to the line of the next occurrence of plain text */
+		if (matcher->regex == NULL && ! search->invert)
+		{
+			const gchar *hit = find_literal(matcher, line, end);
+			const gchar *newline;
+
+			if (hit == NULL)
+				break;
+			while ((newline = memchr(line, '\n', hit - line)) != NULL)
+			{
+				line = newline + 1;
+				line_num++;
+			}
+		}
+
+		eol = memchr(line, '\n', end - line);
+		next = (eol != NULL) ? eol + 1 : end;
+		line_len = ((eol != NULL) ? eol : end) - line;
+		if (line_len > 0 && line[line_len - 1] == '\r')
+			line_len--;
+
+		if (edits != NULL)
+		{
+			guint n_edits = edits->len;
+			gchar *new_line = replace_line(matcher, replace_text, search->replace->expand,
+				line, line_len, line - data, edits);
+
+			if (new_line != NULL)
+			{
+				g_ptr_array_add(lines, format_result(display_path, line_num, "-", line, line_len, enc));
+				g_ptr_array_add(lines, format_result(display_path, line_num, "+", new_line,
+					strlen(new_line), enc));
+				n_matches += edits->len - n_edits;
+				g_free(new_line);
+			}
+		}
+		else if (line_matches(matcher, line, line_len) != search->invert)
+		{
+			g_ptr_array_add(lines, format_result(display_path, line_num, "", line, line_len, enc));
+			n_matches++;
+		}
+
+		line = next;
+		line_num++;
+	}
+	return n_matches;
+}
+
+
+static gboolean flush_results(gpointer data)
+{
+	FifSearch *search = data;
+	GPtrArray *results;
+
+	g_mutex_lock(&search->mutex);
+	search->flush_source = 0;
+	results = search->results;
+	search->results = g_ptr_array_new_with_free_func(g_free);
+	g_mutex_unlock(&search->mutex);
+
+	if (results->len > 0 && ! g_atomic_int_get(&search->cancelled))
+		search->results_func(results, search->user_data);
+	g_ptr_array_free(results, TRUE);
+	return FALSE;
+}
+
+
+static void add_results(FifSearch *search, GPtrArray *lines, guint n_matches)
+{
+	guint i;
+
+	g_mutex_lock(&search->mutex);
+	for (i = 0; i < lines->len; i++)
+		g_ptr_array_add(search->results, lines->pdata[i]);
+	search->n_matches += n_matches;
+	if (search->flush_source == 0)
+		search->flush_source = g_timeout_add(FIF_FLUSH_INTERVAL, flush_results, search);
+	g_mutex_unlock(&search->mutex);
+}
+
+
+static void edit_free(gpointer data)
+{
+	FifEdit *edit = data;
+
+	g_free(edit->text);
+}
+
+
+static void file_edits_free(gpointer data)
+{
+	FifFileEdits *file_edits = data;
+
+	g_free(file_edits->locale_path);
+	if (file_edits->buffer != NULL)
+		g_bytes_unref(file_edits->buffer);
+	g_array_free(file_edits->edits, TRUE);
+	g_free(file_edits);
+}
+
+
+static void search_file(FifSearch *search, const gchar *locale_path, const gchar *display_path)
+{
+	GPtrArray *lines = g_ptr_array_new();
+	GBytes *buffer = g_hash_table_lookup(search->buffers, locale_path);
+	FifReplace *replace = search->replace;
+	GArray *edits = NULL;
+	GStatBuf st;
+	guint n_matches = 0;
+
+	if (replace != NULL)
+	{
+		edits = g_array_new(FALSE, FALSE, sizeof(FifEdit));
+		g_array_set_clear_func(edits, edit_free);
+	}
+
+	/* modified documents are searched as they are in the editor */
+	if (buffer != NULL)
+	{
+		const FifMatcher *matcher = (search->enc != NULL) ? &search->utf8_matcher : &search->file_matcher;
+		gsize len;
+		const gchar *data = g_bytes_get_data(buffer, &len);
+
+		n_matches = search_data(search, matcher, data, len, NULL, display_path,
+			replace != NULL ? replace->utf8_text : NULL, edits, lines);
+	}
+	/* remember the file's state to not overwrite later changes when replacing */
+	else if (replace == NULL || g_stat(locale_path, &st) == 0)
+	{
+		GMappedFile *map = g_mapped_file_new(locale_path, FALSE, NULL);
+
+		if (map != NULL)
+		{
+			const gchar *data = g_mapped_file_get_contents(map);
+			gsize len = g_mapped_file_get_length(map);
+
+			if (len > 0 && memchr(data, '\0', MIN(len, FIF_BINARY_CHECK_SIZE)) == NULL)
+			{
+				const FifMatcher *matcher = &search->file_matcher;
+
+				/* a UTF-8 regex must not be run on invalid text, match it byte by byte */
+				if (search->enc == NULL && matcher->regex != NULL && ! g_utf8_validate(data, len, NULL))
+					matcher = &search->raw_matcher;
+				n_matches = search_data(search, matcher, data, len, search->enc,
+					display_path, replace != NULL ? replace->text : NULL, edits, lines);
+			}
+			g_mapped_file_unref(map);
+		}
+	}
+
+	if (edits != NULL && edits->len > 0)
+	{
+		FifFileEdits *file_edits = g_new0(FifFileEdits, 1);
+
+		file_edits->locale_path = g_strdup(locale_path);
+		if (buffer != NULL)
+			file_edits->buffer = g_bytes_ref(buffer);
+		else
+		{
+			file_edits->size = st.st_size;
+			file_edits->mtime = st.st_mtime;
+		}
+		file_edits->edits = edits;
+		edits = NULL;
+
+		g_mutex_lock(&replace->mutex);
+		g_ptr_array_add(replace->files, file_edits);
+		g_mutex_unlock(&replace->mutex);
+	}
+	if (edits != NULL)
+		g_array_free(edits, TRUE);
+
+	if (lines->len > 0)
+		add_results(search, lines, n_matches);
+	g_ptr_array_free(lines, TRUE);
+}
+
+
+static FifIgnore *ignore_ref(FifIgnore *ignore)
+{
+	if (ignore != NULL)
+		g_atomic_int_inc(&ignore->ref_count);
+	return ignore;
+}
+
+
+static void ignore_unref(FifIgnore *ignore)
+{
+	if (ignore != NULL && g_atomic_int_dec_and_test(&ignore->ref_count))
+	{
+		ignore_unref(ignore->parent);
+		g_ptr_array_free(ignore->rules, TRUE);
+		g_free(ignore->base);
+		g_free(ignore);
+	}
+}
+
+
+static void ignore_rule_free(gpointer data)
+{
+	FifIgnoreRule *rule = data;
+
+	g_pattern_spec_free(rule->pattern);
+	g_free(rule);
+}
+
+
+/* Returns: the rules for the contents of locale_dir, those of its .gitignore file if any
+ * followed by the parent ones. Only plain glob patterns are supported. */
+static FifIgnore *ignore_load(const gchar *locale_dir, const gchar *display_dir, FifIgnore *parent)
+{
+	gchar *filename = g_build_filename(locale_dir, ".gitignore", NULL);
+	gchar *contents;
+	gchar **lines, **line;
+	FifIgnore *ignore;
+
+	if (! g_file_get_contents(filename, &contents, NULL, NULL))
+	{
+		g_free(filename);
+		return ignore_ref(parent);
+	}
+
+	ignore = g_new0(FifIgnore, 1);
+	ignore->ref_count = 1;
+	ignore->parent = ignore_ref(parent);
+	ignore->base = g_strdup(display_dir);
+	ignore->rules = g_ptr_array_new_with_free_func(ignore_rule_free);
+
+	lines = g_strsplit(contents, "\n", -1);
+	foreach_strv(line, lines)
+	{
+		gchar *pattern = g_strchomp(*line);
+		FifIgnoreRule *rule;
+		gboolean dir_only = FALSE, anchored;
+		gsize len;
+
+		/* negations can't re-include what has been skipped already */
+		if (*pattern == 0 || *pattern == '#' || *pattern == '!')
+			continue;
+
+		len = strlen(pattern);
+		if (pattern[len - 1] == '/')
+		{
+			pattern[len - 1] = 0;
+			dir_only = TRUE;
+		}
+		anchored = strchr(pattern, '/') != NULL;
+		if (*pattern == '/')
+			pattern++;
+		if (*pattern == 0)
+			continue;
+
+		rule = g_new0(FifIgnoreRule, 1);
+		rule->pattern = g_pattern_spec_new(pattern);
+		rule->anchored = anchored;
+		rule->dir_only = dir_only;
+		g_ptr_array_add(ignore->rules, rule);
+	}
+	g_strfreev(lines);
+	g_free(contents);
+	g_free(filename);
+	return ignore;
+}
+
+
+static gboolean ignore_match(FifIgnore *ignore, const gchar *display_path, const gchar *name,
+		gboolean is_dir)
+{
+	for (; ignore != NULL; ignore = ignore->parent)
+	{
+		const gchar *relative_path = display_path + strlen(ignore->base) + 1;
+		guint i;
+
+		for (i = 0; i < ignore->rules->len; i++)
+		{
+			FifIgnoreRule *rule = ignore->rules->pdata[i];
+
+			if (rule->dir_only && ! is_dir)
+				continue;
+			if (g_pattern_match_string(rule->pattern, rule->anchored ? relative_path : name))
+				return TRUE;
+		}
+	}
+	return FALSE;
+}
+
+
+static gboolean is_vcs_dir(const gchar *name)
+{
+	static const gchar *const vcs_dirs[] = { ".git", ".hg", ".svn", ".bzr", "CVS", NULL };
+	const gchar *const *vcs_dir;
+
+	foreach_strv(vcs_dir, vcs_dirs)
+	{
+		if (strcmp(name, *vcs_dir) == 0)
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+static gboolean file_patterns_match(FifSearch *search, const gchar *name)
+{
+	GSList *node;
+
+	if (search->patterns == NULL)
+		return TRUE;
+
+	foreach_slist(node, search->patterns)
+	{
+		if (g_pattern_match_string(node->data, name))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+
+/* Returns: whether the file locale_path can contain the searched text */
+static gboolean file_filter_match(FifSearch *search, const gchar *locale_path)
+{
+	/* buffers can have any text */
+	return search->file_filter == NULL || g_hash_table_contains(search->buffers, locale_path) ||
+		search->file_filter(locale_path, search->file_filter_data);
+}
+
+
+/* Takes ownership of locale_path and display_path */
+static void push_job(FifSearch *search, gchar *locale_path, gchar *display_path,
+		FifIgnore *ignore, gboolean is_dir)
+{
+	FifJob *job = g_new0(FifJob, 1);
+
+	job->search = search;
+	job->locale_path = locale_path;
+	job->display_path = display_path;
+	job->ignore = ignore_ref(ignore);
+	job->is_dir = is_dir;
+
+	g_atomic_int_inc(&search->pending);
+	g_thread_pool_push(fif_pool, job, NULL);
+}
+
+
+static void walk_dir(FifJob *job)
+{
+	FifSearch *search = job->search;
+	FifIgnore *ignore = NULL;
+	GDir *dir = g_dir_open(job->locale_path, 0, NULL);
+	const gchar *name;
+
+	if (dir == NULL)
+		return;
+
+	if (search->recursive)
+		ignore = ignore_load(job->locale_path, job->display_path, job->ignore);
+
+	while ((name = g_dir_read_name(dir)) != NULL && ! g_atomic_int_get(&search->cancelled))
+	{
+		gchar *locale_path = g_build_filename(job->locale_path, name, NULL);
+		gchar *display_path = (job->display_path != NULL) ?
+			g_build_filename(job->display_path, name, NULL) : g_strdup(name);
+
+		/* like grep -r, don't follow symbolic links when recursing */
+		if (! search->recursive || ! g_file_test(locale_path, G_FILE_TEST_IS_SYMLINK))
+		{
+			if (g_file_test(locale_path, G_FILE_TEST_IS_DIR))
+			{
+				if (search->recursive && ! is_vcs_dir(name) &&
+					! ignore_match(ignore, display_path, name, TRUE))
+				{
+					push_job(search, locale_path, display_path, ignore, TRUE);
+					locale_path = display_path = NULL;
+				}
+			}
+			else if (g_file_test(locale_path, G_FILE_TEST_IS_REGULAR) &&
+				file_patterns_match(search, name) && ! ignore_match(ignore, display_path, name, FALSE) &&
+				file_filter_match(search, locale_path))
+			{
+				push_job(search, locale_path, display_path, NULL, FALSE);
+				locale_path = display_path = NULL;
+			}
+		}
+		g_free(locale_path);
+		g_free(display_path);
+	}
+	g_dir_close(dir);
+	ignore_unref(ignore);
+}
+
+
+static void fif_search_free(FifSearch *search)
+{
+	matcher_clear(&search->file_matcher);
+	matcher_clear(&search->utf8_matcher);
+	matcher_clear(&search->raw_matcher);
+	g_free(search->enc);
+	g_slist_free_full(search->patterns, (GDestroyNotify) g_pattern_spec_free);
+	g_hash_table_destroy(search->buffers);
+	if (search->file_filter_destroy != NULL)
+		search->file_filter_destroy(search->file_filter_data);
+	if (search->replace != NULL)
+		fif_replace_unref(search->replace);
+	g_ptr_array_free(search->results, TRUE);
+	g_mutex_clear(&search->mutex);
+	g_free(search);
+}
+
+
+static gboolean search_done(gpointer data)
+{
+	FifSearch *search = data;
+
+	g_mutex_lock(&search->mutex);
+	if (search->flush_source != 0)
+		g_source_remove(search->flush_source);
+	g_mutex_unlock(&search->mutex);
+	flush_results(search);
+
+	if (! g_atomic_int_get(&search->cancelled))
+	{
+		current_search = NULL;
+		search->done_func(search->n_matches, search->user_data);
+	}
+	fif_search_free(search);
+	return FALSE;
+}
+
+
+static gboolean apply_done(gpointer data)
+{
+	FifReplace *replace = data;
+
+	replace->done_func((guint) g_atomic_int_get(&replace->n_changed), replace->errors,
+		replace->user_data);
+	fif_replace_unref(replace);
+	return FALSE;
+}
+
+
+static void add_apply_error(FifReplace *replace, const gchar *locale_path, const gchar *message)
+{
+	gchar *utf8_path = utils_get_utf8_from_locale(locale_path);
+
+	g_mutex_lock(&replace->mutex);
+	g_ptr_array_add(replace->errors, g_strdup_printf("%s: %s", utf8_path, message));
+	g_mutex_unlock(&replace->mutex);
+	g_free(utf8_path);
+}
+
+
+/* Writes the file with its edits applied. It is replaced by a temporary file renamed over
+ * it, which keeps its permission bits but breaks its hard links and makes it owned by the
+ * user, see document_replace_file_contents(). */
+static void apply_file_edits(FifReplace *replace, FifFileEdits *file_edits)
+{
+	const gchar *path = file_edits->locale_path;
+	GError *error = NULL;
+	GString *contents;
+	FifEdit *edit;
+	GStatBuf st;
+	gchar *data;
+	gsize len, copied = 0;
+
+	if (g_stat(path, &st) != 0 || st.st_size != file_edits->size || st.st_mtime != file_edits->mtime)
+	{
+		add_apply_error(replace, path, _("The file has changed since it was searched."));
+		return;
+	}
+	if (! g_file_get_contents(path, &data, &len, &error))
+	{
+		add_apply_error(replace, path, error->message);
+		g_error_free(error);
+		return;
+	}
+
+	contents = g_string_sized_new(len);
+	foreach_array(FifEdit, edit, file_edits->edits)
+	{
+		g_string_append_len(contents, data + copied, edit->start - copied);
+		g_string_append(contents, edit->text);
+		copied = edit->end;
+	}
+	g_string_append_len(contents, data + copied, len - copied);
+	g_free(data);
+
+	/* a failed write must not leave the file truncated */
+	if (document_replace_file_contents(path, contents->str, contents->len, &error))
+		g_atomic_int_inc(&replace->n_changed);
+	else
+	{
+		add_apply_error(replace, path, error->message);
+		g_error_free(error);
+	}
+	g_string_free(contents, TRUE);
+}
+
+
+static void run_job(gpointer data, G_GNUC_UNUSED gpointer user_data)
+{
+	FifJob *job = data;
+	FifSearch *search = job->search;
+
+	if (job->replace != NULL)
+	{
+		FifReplace *replace = job->replace;
+
+		apply_file_edits(replace, job->file_edits);
+		g_free(job);
+		if (g_atomic_int_dec_and_test(&replace->pending))
+			g_idle_add(apply_done, replace);
+		return;
+	}
+
+	if (! g_atomic_int_get(&search->cancelled))
+	{
+		if (job->is_dir)
+			walk_dir(job);
+		else
+			search_file(search, job->locale_path, job->display_path);
+	}
+
+	ignore_unref(job->ignore);
+	g_free(job->locale_path);
+	g_free(job->display_path);
+	g_free(job);
+
+	if (g_atomic_int_dec_and_test(&search->pending))
+		g_idle_add(search_done, search);
+}
+
+
+static void create_pool(void)
+{
+	gint n_threads;
+
+	if (fif_pool != NULL)
+		return;
+
+#if GLIB_CHECK_VERSION(2, 36, 0)
+	n_threads = (gint) g_get_num_processors();
+#else
+	n_threads = 4;
+#endif
+	fif_pool = g_thread_pool_new(run_job, NULL, n_threads, FALSE, NULL);
+}
+
+
+/* Returns: a new search, or NULL if the regular expression of query is invalid */
+FifSearch *fif_search_new(const FifQuery *query, GError **error)
+{
+	FifSearch *search;
+	gchar *text = NULL;
+
+	g_return_val_if_fail(! EMPTY(query->text), NULL);
+
+	search = g_new0(FifSearch, 1);
+
+	/* convert the search text in the files' encoding (if the text is not valid UTF-8, assume
+	 * it is already in that encoding) */
+	if (query->enc != NULL && g_utf8_validate(query->text, -1, NULL))
+		text = g_convert(query->text, -1, query->enc, "UTF-8", NULL, NULL, NULL);
+	if (text == NULL)
+		text = g_strdup(query->text);
+
+	g_mutex_init(&search->mutex);
+	search->results = g_ptr_array_new_with_free_func(g_free);
+	search->buffers = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		(GDestroyNotify) g_bytes_unref);
+	search->enc = g_strdup(query->enc);
+	search->invert = query->invert;
+	search->recursive = query->recursive;
+
+	if (query->patterns != NULL)
+	{
+		gchar **patterns = g_strsplit(query->patterns, " ", -1);
+		gchar **pattern;
+
+		foreach_strv(pattern, patterns)
+		{
+			if (**pattern != 0)
+				search->patterns = g_slist_prepend(search->patterns, g_pattern_spec_new(*pattern));
+		}
+		g_strfreev(patterns);
+	}
+
+	if (! matcher_init(&search->file_matcher, query, text, query->enc != NULL, error) ||
+		(query->enc != NULL && ! matcher_init(&search->utf8_matcher, query, query->text, FALSE, error)) ||
+		(query->enc == NULL && ! matcher_init(&search->raw_matcher, query, text, TRUE, error)))
+	{
+		fif_search_free(search);
+		search = NULL;
+	}
+	g_free(text);
+	return search;
+}
+
+
+/* Makes search look at text instead of the contents of locale_filename, which must be the
+ * real path. Takes ownership of text, which is in UTF-8. */
+void fif_search_add_buffer(FifSearch *search, const gchar *locale_filename, gchar *text, gsize len)
+{
+	g_hash_table_insert(search->buffers, g_strdup(locale_filename), g_bytes_new_take(text, len));
+}
+
+
+/* Makes search skip the files for which filter returns FALSE, except the ones with a buffer.
+ * filter is called on the worker threads. */
+void fif_search_set_file_filter(FifSearch *search, FifFileFilter filter, gpointer user_data,
+		GDestroyNotify destroy)
+{
+	search->file_filter = filter;
+	search->file_filter_data = user_data;
+	search->file_filter_destroy = destroy;
+}
+
+
+/* Makes search replace the matches instead of only finding them. The result lines are then
+ * pairs of an original line prefixed by '-' and the replaced line prefixed by '+'.
+ * Takes ownership of replace. */
+void fif_search_set_replace(FifSearch *search, FifReplace *replace)
+{
+	g_return_if_fail(! search->invert);
+
+	search->replace = replace;
+}
+
+
+/* Returns: the edits replacing the matches of query with the UTF-8 text, or NULL if text
+ * is not a valid replacement for the regular expression of query */
+FifReplace *fif_replace_new(const FifQuery *query, const gchar *text, GError **error)
+{
+	FifReplace *replace;
+
+	if (query->regexp && ! g_regex_check_replacement(text, NULL, error))
+		return NULL;
+
+	replace = g_new0(FifReplace, 1);
+	replace->ref_count = 1;
+	replace->utf8_text = g_strdup(text);
+	if (query->enc != NULL && g_utf8_validate(text, -1, NULL))
+		replace->text = g_convert(text, -1, query->enc, "UTF-8", NULL, NULL, NULL);
+	if (replace->text == NULL)
+		replace->text = g_strdup(text);
+	replace->expand = query->regexp;
+	g_mutex_init(&replace->mutex);
+	replace->files = g_ptr_array_new_with_free_func(file_edits_free);
+	replace->errors = g_ptr_array_new_with_free_func(g_free);
+	return replace;
+}
+
+
+void fif_replace_unref(FifReplace *replace)
+{
+	if (replace == NULL || ! g_atomic_int_dec_and_test(&replace->ref_count))
+		return;
+
+	g_free(replace->text);
+	g_free(replace->utf8_text);
+	g_ptr_array_free(replace->files, TRUE);
+	g_ptr_array_free(replace->errors, TRUE);
+	g_mutex_clear(&replace->mutex);
+	g_free(replace);
+}
+
+
+/* Returns: the number of files and buffers with matches to replace */
+guint fif_replace_get_n_files(FifReplace *replace)
+{
+	guint n_files;
+
+	g_mutex_lock(&replace->mutex);
+	n_files = replace->files->len;
+	g_mutex_unlock(&replace->mutex);
+	return n_files;
+}
+
+
+/* Passes the edits of each buffer to buffer_func, and writes the files with their edits
+ * applied on the worker threads. done_func is called once all files have been written,
+ * with the number of files and buffers changed and the messages about the files which
+ * could not be changed. Must be called after the search has finished. */
+void fif_replace_apply(FifReplace *replace, FifBufferEditsFunc buffer_func,
+		FifApplyDoneFunc done_func, gpointer user_data)
+{
+	guint i;
+
+	g_return_if_fail(replace != NULL);
+	g_return_if_fail(replace->done_func == NULL);
+
+	create_pool();
+	g_atomic_int_inc(&replace->ref_count);
+	replace->done_func = done_func;
+	replace->user_data = user_data;
+	/* keep the count above 0 until all files are queued */
+	g_atomic_int_set(&replace->pending, 1);
+
+	for (i = 0; i < replace->files->len; i++)
+	{
+		FifFileEdits *file_edits = replace->files->pdata[i];
+
+		if (file_edits->buffer != NULL)
+		{
+			if (buffer_func(file_edits->locale_path, file_edits->buffer,
+					(const FifEdit *) file_edits->edits->data, file_edits->edits->len, user_data))
+				g_atomic_int_inc(&replace->n_changed);
+		}
+		else
+		{
+			FifJob *job = g_new0(FifJob, 1);
+
+			job->replace = replace;
+			job->file_edits = file_edits;
+			g_atomic_int_inc(&replace->pending);
+			g_thread_pool_push(fif_pool, job, NULL);
+		}
+	}
+
+	if (g_atomic_int_dec_and_test(&replace->pending))
+		g_idle_add(apply_done, replace);
+}
+
+
+/* Cancels any running search and starts search in locale_dir. results_func and done_func are
+ * not called anymore once the search has been cancelled. */
+void fif_search_start(FifSearch *search, const gchar *locale_dir, FifResultsFunc results_func,
+		FifDoneFunc done_func, gpointer user_data)
+{
+	gchar *real_dir;
+
+	g_return_if_fail(search != NULL);
+	g_return_if_fail(locale_dir != NULL);
+
+	fif_search_cancel();
+	create_pool();
+
+	search->results_func = results_func;
+	search->done_func = done_func;
+	search->user_data = user_data;
+	current_search = search;
+
+	/* build the paths from the real path so that they match the ones of the buffers */
+	real_dir = utils_get_real_path(locale_dir);
+	if (real_dir == NULL)
+		real_dir = g_strdup(locale_dir);
+	/* use '.' so we get relative paths in the results, like with grep -r */
+	push_job(search, real_dir, search->recursive ? g_strdup(".") : NULL, NULL, TRUE);
+}
+
+
+/* Returns: whether a search was running */
+gboolean fif_search_cancel(void)
+{
+	if (current_search == NULL)
+		return FALSE;
+
+	/* it is freed once its jobs have finished */
+	g_atomic_int_set(&current_search->cancelled, TRUE);
+	current_search = NULL;
+	return TRUE;
+}
+
+
+void fif_finalize(void)
+{
+	fif_search_cancel();
+	if (fif_pool != NULL)
+		g_thread_pool_free(fif_pool, FALSE, TRUE);
+	fif_pool = NULL;
+}
@@ -0,0 +1,102 @@
+/*
+ *      findinfiles.h - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2024 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+
+#ifndef GEANY_FINDINFILES_H
+#define GEANY_FINDINFILES_H 1
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct FifQuery
+{
+	const gchar	*text;			/* UTF-8 */
+	const gchar	*enc;			/* encoding of the files, NULL for UTF-8 */
+	const gchar	*patterns;		/* space separated glob patterns of the files, NULL for all */
+	gboolean	 regexp;
+	gboolean	 case_sensitive;
+	gboolean	 whole_word;
+	gboolean	 invert;
+	gboolean	 recursive;
+}
+FifQuery;
+
+typedef struct FifSearch FifSearch;
+
+/* The edits replacing the matches of a search */
+typedef struct FifReplace FifReplace;
+
+typedef struct FifEdit
+{
+	gsize		 start;			/* byte offsets in the file or buffer */
+	gsize		 end;
+	gchar		*text;
+}
+FifEdit;
+
+/* Called in the main loop with the next result lines, in UTF-8 and formatted like the
+ * output of grep -nH */
+typedef void (*FifResultsFunc)(GPtrArray *lines, gpointer user_data);
+
+/* Called in the main loop when the search has finished */
+typedef void (*FifDoneFunc)(guint n_matches, gpointer user_data);
+
+/* Called on the worker threads with the real path of a file, returns FALSE if the searched
+ * text can not be in the file */
+typedef gboolean (*FifFileFilter)(const gchar *locale_path, gpointer user_data);
+
+/* Called in the main loop with the sorted edits of a buffer and the text of the buffer
+ * which was searched, returns whether the edits were applied */
+typedef gboolean (*FifBufferEditsFunc)(const gchar *locale_filename, GBytes *buffer,
+		const FifEdit *edits, guint n_edits, gpointer user_data);
+
+/* Called in the main loop once the edits have been applied, with the UTF-8 messages about
+ * the files which could not be changed */
+typedef void (*FifApplyDoneFunc)(guint n_changed, GPtrArray *errors, gpointer user_data);
+
+FifSearch *fif_search_new(const FifQuery *query, GError **error);
+
+void fif_search_add_buffer(FifSearch *search, const gchar *locale_filename, gchar *text, gsize len);
+
+void fif_search_set_file_filter(FifSearch *search, FifFileFilter filter, gpointer user_data,
+		GDestroyNotify destroy);
+
+void fif_search_set_replace(FifSearch *search, FifReplace *replace);
+
+void fif_search_start(FifSearch *search, const gchar *locale_dir, FifResultsFunc results_func,
+		FifDoneFunc done_func, gpointer user_data);
+
+gboolean fif_search_cancel(void);
+
+FifReplace *fif_replace_new(const FifQuery *query, const gchar *text, GError **error);
+
+void fif_replace_unref(FifReplace *replace);
+
+guint fif_replace_get_n_files(FifReplace *replace);
+
+void fif_replace_apply(FifReplace *replace, FifBufferEditsFunc buffer_func,
+		FifApplyDoneFunc done_func, gpointer user_data);
+
+void fif_finalize(void);
+
+G_END_DECLS
+
+#endif /* GEANY_FINDINFILES_H */
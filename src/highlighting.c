@@ -865,6 +865,8 @@ static void styleset_from_mapping(ScintillaObject *sci, guint ft_id, guint lexer
 
 	/* lexer */
 	sci_set_lexer(sci, lexer);
+	if (editor_prefs.background_styling)
+		sci_set_background_lexer(sci, lexer);
 
 	/* styles */
 	styleset_common(sci, ft_id);
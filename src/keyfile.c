@@ -166,6 +166,7 @@ static struct
 	gint number_ft_menu_items;
 	gint number_non_ft_menu_items;
 	gint number_exec_menu_items;
+	gint max_jobs;
 }
 build_menu_prefs;
 
@@ -310,6 +311,8 @@ static void init_pref_groups(void)
 		"indent_hard_tab_width", 8);
 	stash_group_add_integer(group, &editor_prefs.ime_interaction,
 		"editor_ime_interaction", SC_IME_WINDOWED);
+	stash_group_add_boolean(group, &editor_prefs.background_styling,
+		"background_styling", FALSE);
 
 	group = stash_group_new(PACKAGE);
 	configuration_add_various_pref_group(group, "files");
@@ -328,6 +331,8 @@ static void init_pref_groups(void)
 		"reload_clean_doc_on_file_change", FALSE);
 	stash_group_add_boolean(group, &file_prefs.save_config_on_file_change,
 		"save_config_on_file_change", TRUE);
+	stash_group_add_integer(group, &file_prefs.large_file_viewer_size,
+		"large_file_viewer_size", 512);
 	stash_group_add_string(group, &file_prefs.extract_filetype_regex,
 		"extract_filetype_regex", GEANY_DEFAULT_FILETYPE_REGEX);
 	stash_group_add_boolean(group, &ui_prefs.allow_always_save,
@@ -340,6 +345,10 @@ static void init_pref_groups(void)
 		"find_selection_type", GEANY_FIND_SEL_CURRENT_WORD);
 	stash_group_add_boolean(group, &search_prefs.replace_and_find_by_default,
 		"replace_and_find_by_default", TRUE);
+	stash_group_add_boolean(group, &project_prefs.trigram_index,
+		"project_trigram_index", FALSE);
+	stash_group_add_integer(group, &search_prefs.lazy_mark_all_size,
+		"lazy_mark_all_size", 16);
 
 	group = stash_group_new(PACKAGE);
 	configuration_add_various_pref_group(group, "socket");
@@ -373,6 +382,8 @@ static void init_pref_groups(void)
 		"number_non_ft_menu_items", 0);
 	stash_group_add_integer(group, &build_menu_prefs.number_exec_menu_items,
 		"number_exec_menu_items", 0);
+	stash_group_add_integer(group, &build_menu_prefs.max_jobs,
+		"max_build_jobs", 0);
 }
 
 
@@ -1254,6 +1265,7 @@ static gboolean read_config_file(ConfigPayload payload)
 			build_set_group_count(GEANY_GBG_FT, build_menu_prefs.number_ft_menu_items);
 			build_set_group_count(GEANY_GBG_NON_FT, build_menu_prefs.number_non_ft_menu_items);
 			build_set_group_count(GEANY_GBG_EXEC, build_menu_prefs.number_exec_menu_items);
+			build_set_max_jobs(build_menu_prefs.max_jobs);
 			build_load_menu(config, GEANY_BCS_PREF, NULL);
 			/* this signal can be used e.g. to delay building UI elements until settings have been read */
 			g_signal_emit_by_name(geany_object, "load-settings", config);
@@ -1282,6 +1294,15 @@ gboolean configuration_load(void)
 }
 
 
+static const gchar *get_session_file_encoding(gchar **tmp)
+{
+	if (isdigit(tmp[3][0]))
+		return encodings_get_charset_from_index(atoi(tmp[3]));
+	else
+		return &(tmp[3][1]);
+}
+
+
 static gboolean open_session_file(gchar **tmp, guint len)
 {
 	guint pos;
@@ -1298,14 +1319,7 @@ static gboolean open_session_file(gchar **tmp, guint len)
 	pos = atoi(tmp[0]);
 	ft_name = tmp[1];
 	ro = atoi(tmp[2]);
-	if (isdigit(tmp[3][0]))
-	{
-		encoding = encodings_get_charset_from_index(atoi(tmp[3]));
-	}
-	else
-	{
-		encoding = &(tmp[3][1]);
-	}
+	encoding = get_session_file_encoding(tmp);
 	indent_type = atoi(tmp[4]);
 	auto_indent = atoi(tmp[5]);
 	line_wrapping = atoi(tmp[6]);
@@ -1379,6 +1393,23 @@ void configuration_open_files(GPtrArray *session_files)
 	/* necessary to set it to TRUE for project session support */
 	main_status.opening_session_files++;
 
+	/* read the files on worker threads while the documents are set up, in the same order */
+	for (i = 0; i < (gint)session_files->len; i++)
+	{
+		gint idx = file_prefs.tab_order_ltr ? i : (gint)session_files->len - 1 - i;
+		gchar **tmp = g_ptr_array_index(session_files, idx);
+
+		if (tmp != NULL && g_strv_length(tmp) >= 8)
+		{
+			gchar *unescaped_filename = g_uri_unescape_string(tmp[7], NULL);
+			gchar *locale_filename = utils_get_locale_from_utf8(unescaped_filename);
+
+			document_prefetch_file(locale_filename, get_session_file_encoding(tmp));
+			g_free(locale_filename);
+			g_free(unescaped_filename);
+		}
+	}
+
 	i = file_prefs.tab_order_ltr ? 0 : (session_files->len - 1);
 	while (TRUE)
 	{
@@ -1407,6 +1438,9 @@ void configuration_open_files(GPtrArray *session_files)
 	}
 
 	g_ptr_array_free(session_files, TRUE);
+	document_prefetch_clear();
+	/* parse the symbols skipped while opening the files */
+	document_parse_pending_tags();
 
 	if (failure)
 		ui_set_statusbar(TRUE, _("Failed to load one or more session files."));
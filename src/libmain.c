@@ -37,6 +37,7 @@
 #include "document.h"
 #include "encodingsprivate.h"
 #include "filetypes.h"
+#include "filewatch.h"
 #include "geanyobject.h"
 #include "highlighting.h"
 #include "keybindings.h"
@@ -836,7 +837,8 @@ gboolean main_handle_filename(const gchar *locale_filename)
 
 	if (g_file_test(filename, G_FILE_TEST_IS_REGULAR))
 	{
-		doc = document_open_file(filename, cl_options.readonly, NULL, NULL);
+		/* large files are read in the background, their documents are added later */
+		doc = document_open_file_async(filename, cl_options.readonly, NULL, NULL);
 		/* add recent file manually if opening_session_files is set */
 		if (doc != NULL && main_status.opening_session_files)
 			ui_add_recent_document(doc);
@@ -866,6 +868,7 @@ static void open_cl_files(gint argc, gchar **argv)
 {
 	gint i;
 
+	document_open_batch_begin();
 	for (i = 1; i < argc; i++)
 	{
 		gchar *filename = main_get_argv_filename(argv[i]);
@@ -890,6 +893,7 @@ static void open_cl_files(gint argc, gchar **argv)
 		}
 		g_free(filename);
 	}
+	document_open_batch_end();
 }
 
 
@@ -1302,6 +1306,7 @@ static gboolean do_main_quit(void)
 	search_finalize();
 	build_finalize();
 	document_finalize();
+	filewatch_finalize();
 	symbols_finalize();
 	project_finalize();
 	editor_finalize();
@@ -41,6 +41,9 @@
 
 static GString *log_buffer = NULL;
 static GtkTextBuffer *dialog_textbuffer = NULL;
+/* messages may come from worker threads, only the main thread updates the dialog */
+static GThread *main_thread = NULL;
+G_LOCK_DEFINE_STATIC(log_buffer);
 
 enum
 {
@@ -55,7 +58,9 @@ static void update_dialog(void)
 		GtkTextMark *mark;
 		GtkTextView *textview = g_object_get_data(G_OBJECT(dialog_textbuffer), "textview");
 
+		G_LOCK(log_buffer);
 		gtk_text_buffer_set_text(dialog_textbuffer, log_buffer->str, log_buffer->len);
+		G_UNLOCK(log_buffer);
 		/* scroll to the end of the messages as this might be most interesting */
 		mark = gtk_text_buffer_get_insert(dialog_textbuffer);
 		gtk_text_view_scroll_to_mark(textview, mark, 0.0, FALSE, 0.0, 0.0);
@@ -63,6 +68,26 @@ static void update_dialog(void)
 }
 
 
+static gboolean update_dialog_idle(gpointer data)
+{
+	update_dialog();
+	return FALSE;
+}
+
+
+static void append_to_log(const gchar *msg)
+{
+	G_LOCK(log_buffer);
+	g_string_append(log_buffer, msg);
+	G_UNLOCK(log_buffer);
+
+	if (g_thread_self() == main_thread)
+		update_dialog();
+	else
+		g_idle_add(update_dialog_idle, NULL);
+}
+
+
 /* Geany's main debug/log function, declared in geany.h */
 void geany_debug(gchar const *format, ...)
 {
@@ -77,10 +102,7 @@ static void handler_print(const gchar *msg)
 {
 	printf("%s", msg);
 	if (G_LIKELY(log_buffer != NULL))
-	{
-		g_string_append_printf(log_buffer, "%s", msg);
-		update_dialog();
-	}
+		append_to_log(msg);
 }
 
 
@@ -88,10 +110,7 @@ static void handler_printerr(const gchar *msg)
 {
 	fprintf(stderr, "%s", msg);
 	if (G_LIKELY(log_buffer != NULL))
-	{
-		g_string_append_printf(log_buffer, "%s", msg);
-		update_dialog();
-	}
+		append_to_log(msg);
 }
 
 
@@ -118,7 +137,7 @@ static const gchar *get_log_prefix(GLogLevelFlags log_level)
 
 static void handler_log(const gchar *domain, GLogLevelFlags level, const gchar *msg, gpointer data)
 {
-	gchar *time_str;
+	gchar *time_str, *line;
 
 	if (G_LIKELY(app != NULL && app->debug_mode) ||
 		! ((G_LOG_LEVEL_DEBUG | G_LOG_LEVEL_INFO | G_LOG_LEVEL_MESSAGE) & level))
@@ -139,18 +158,18 @@ static void handler_log(const gchar *domain, GLogLevelFlags level, const gchar *
 
 	time_str = utils_get_current_time_string(TRUE);
 
-	g_string_append_printf(log_buffer, "%s: %s %s: %s\n", time_str, domain,
-		get_log_prefix(level), msg);
+	line = g_strdup_printf("%s: %s %s: %s\n", time_str, domain, get_log_prefix(level), msg);
+	append_to_log(line);
 
+	g_free(line);
 	g_free(time_str);
-
-	update_dialog();
 }
 
 
 void log_handlers_init(void)
 {
 	log_buffer = g_string_sized_new(2048);
+	main_thread = g_thread_self();
 
 	g_set_print_handler(handler_print);
 	g_set_printerr_handler(handler_printerr);
@@ -168,7 +187,9 @@ static void on_dialog_response(GtkDialog *dialog, gint response, gpointer user_d
 		gtk_text_buffer_get_end_iter(dialog_textbuffer, &end_iter);
 		gtk_text_buffer_delete(dialog_textbuffer, &start_iter, &end_iter);
 
+		G_LOCK(log_buffer);
 		g_string_erase(log_buffer, 0, -1);
+		G_UNLOCK(log_buffer);
 	}
 	else
 	{
@@ -82,10 +82,41 @@ enum
 };
 
 
+/* time to collect new rows of the Compiler and Messages tabs before adding them */
+#define MSGWIN_FLUSH_INTERVAL 40
+
+/* A row of the Compiler or Messages tab which has not been added yet */
+typedef struct
+{
+	const gchar	*string;	/* in the queue's string chunk */
+	gint		 color;
+	gint		 line;
+	guint		 doc_id;
+}
+QueuedRow;
+
+/* The rows to add to the Compiler or Messages tab. They are added in batches, and once the
+ * tab holds ui_prefs.msgwin_max_rows rows the rest is only added on request. */
+typedef struct
+{
+	GStringChunk	*strings;
+	GArray			*rows;		/* QueuedRow */
+	guint			 next;		/* index of the first row not added yet */
+	guint			 shown;		/* rows added since the tab was cleared */
+	guint			 requested;	/* rows requested beyond ui_prefs.msgwin_max_rows */
+	guint			 source;
+	gboolean		 more_row;	/* whether the last row of the tab tells about the rest */
+}
+RowQueue;
+
+
 static GdkColor color_error = {0, 0xFFFF, 0, 0};
 static GdkColor color_context = {0, 0x7FFF, 0, 0};
 static GdkColor color_message = {0, 0, 0, 0xD000};
 
+static RowQueue compiler_queue;
+static RowQueue msg_queue;
+
 
 static void prepare_msg_tree_view(void);
 static void prepare_status_tree_view(void);
@@ -161,12 +192,33 @@ void msgwin_init(void)
 	load_color("geany-compiler-error", &color_error);
 	load_color("geany-compiler-context", &color_context);
 	load_color("geany-compiler-message", &color_message);
+
+	row_queue_init(&compiler_queue);
+	row_queue_init(&msg_queue);
+}
+
+
+static void row_queue_init(RowQueue *queue)
+{
+	queue->strings = g_string_chunk_new(4096);
+	queue->rows = g_array_new(FALSE, FALSE, sizeof(QueuedRow));
+}
+
+
+static void row_queue_free(RowQueue *queue)
+{
+	if (queue->source != 0)
+		g_source_remove(queue->source);
+	g_string_chunk_free(queue->strings);
+	g_array_free(queue->rows, TRUE);
 }
 
 
 void msgwin_finalize(void)
 {
 	g_free(msgwindow.messages_dir);
+	row_queue_free(&compiler_queue);
+	row_queue_free(&msg_queue);
 }
 
 
@@ -305,6 +357,198 @@ static const GdkColor *get_color(gint msg_color)
 }
 
 
+static GtkListStore *get_queue_store(RowQueue *queue)
+{
+	return (queue == &compiler_queue) ? msgwindow.store_compiler : msgwindow.store_msg;
+}
+
+
+/* position is -1 to append the row */
+static void insert_row(RowQueue *queue, GtkTreeIter *iter, gint position, gint msg_color,
+		gint line, guint doc_id, const gchar *string)
+{
+	const GdkColor *color = get_color(msg_color);
+
+	if (queue == &compiler_queue)
+		gtk_list_store_insert_with_values(msgwindow.store_compiler, iter, position,
+			COMPILER_COL_COLOR, color, COMPILER_COL_STRING, string, -1);
+	else
+		gtk_list_store_insert_with_values(msgwindow.store_msg, iter, position,
+			MSG_COL_LINE, line, MSG_COL_DOC_ID, doc_id, MSG_COL_COLOR, color,
+			MSG_COL_STRING, string, -1);
+}
+
+
+static void scroll_to_row(RowQueue *queue, GtkTreeModel *model, GtkTreeIter *iter)
+{
+	if (queue == &compiler_queue &&
+		ui_prefs.msgwindow_visible && interface_prefs.compiler_tab_autoscroll)
+	{
+		GtkTreePath *path = gtk_tree_model_get_path(model, iter);
+
+		gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(msgwindow.tree_compiler), path, NULL, TRUE, 0.5, 0.5);
+		gtk_tree_path_free(path);
+	}
+}
+
+
+/* Adds the queued rows to the tab, up to its limit */
+static gboolean flush_row_queue(gpointer data)
+{
+	RowQueue *queue = data;
+	GtkTreeModel *model = GTK_TREE_MODEL(get_queue_store(queue));
+	GtkTreeIter iter;
+	guint end = queue->rows->len;
+	gboolean added = FALSE;
+
+	queue->source = 0;
+
+	if (queue->more_row)
+	{
+		gint n_rows = gtk_tree_model_iter_n_children(model, NULL);
+
+		if (gtk_tree_model_iter_nth_child(model, &iter, NULL, n_rows - 1))
+			gtk_list_store_remove(GTK_LIST_STORE(model), &iter);
+		queue->more_row = FALSE;
+	}
+
+	if (ui_prefs.msgwin_max_rows > 0)
+	{
+		guint limit = ui_prefs.msgwin_max_rows + queue->requested;
+
+		end = MIN(end, queue->next + (limit > queue->shown ? limit - queue->shown : 0));
+	}
+	for (; queue->next < end; queue->next++)
+	{
+		QueuedRow *row = &g_array_index(queue->rows, QueuedRow, queue->next);
+
+		insert_row(queue, &iter, -1, row->color, row->line, row->doc_id, row->string);
+		queue->shown++;
+		added = TRUE;
+	}
+
+	/* scroll once per batch, scrolling to each row is slow */
+	if (added)
+		scroll_to_row(queue, model, &iter);
+
+	if (queue->next < queue->rows->len)
+	{
+		guint n_more = queue->rows->len - queue->next;
+		gchar *text = g_strdup_printf(ngettext(
+			"%u more line, click to show it", "%u more lines, click to show them", n_more), n_more);
+
+		insert_row(queue, &iter, -1, COLOR_BLUE, -1, 0, text);
+		queue->more_row = TRUE;
+		g_free(text);
+	}
+	else
+	{
+		/* all rows have been added, the memory can be reused */
+		g_array_set_size(queue->rows, 0);
+		g_string_chunk_clear(queue->strings);
+		queue->next = 0;
+	}
+	return FALSE;
+}
+
+
+/* Adds a row to the tab in the next batch */
+static void queue_row(RowQueue *queue, gint msg_color, gint line, guint doc_id,
+		const gchar *string)
+{
+	QueuedRow row;
+
+	row.string = g_string_chunk_insert(queue->strings, string);
+	row.color = msg_color;
+	row.line = line;
+	row.doc_id = doc_id;
+	g_array_append_val(queue->rows, row);
+
+	if (queue->source == 0)
+		queue->source = g_timeout_add(MSGWIN_FLUSH_INTERVAL, flush_row_queue, queue);
+}
+
+
+/* Adds a row to the tab right away, after the queued rows which fit in it. If some rows
+ * are left, the row goes before the one telling about them so that it is always shown. */
+static void add_row(RowQueue *queue, gint msg_color, gint line, guint doc_id,
+		const gchar *string)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(get_queue_store(queue));
+	GtkTreeIter iter;
+	gint position = -1;
+
+	if (queue->source != 0)
+	{
+		/* flush_row_queue() forgets the pending timeout */
+		g_source_remove(queue->source);
+		flush_row_queue(queue);
+	}
+	if (queue->more_row)
+		position = gtk_tree_model_iter_n_children(model, NULL) - 1;
+
+	insert_row(queue, &iter, position, msg_color, line, doc_id, string);
+	queue->shown++;
+	scroll_to_row(queue, model, &iter);
+}
+
+
+static void clear_row_queue(RowQueue *queue)
+{
+	if (queue->source != 0)
+		g_source_remove(queue->source);
+	queue->source = 0;
+	g_array_set_size(queue->rows, 0);
+	g_string_chunk_clear(queue->strings);
+	queue->next = 0;
+	queue->shown = 0;
+	queue->requested = 0;
+	queue->more_row = FALSE;
+	gtk_list_store_clear(get_queue_store(queue));
+}
+
+
+/* Adds the next rows if iter is the row telling about them */
+static gboolean show_more_rows(RowQueue *queue, GtkTreeModel *model, GtkTreeIter *iter)
+{
+	GtkTreePath *path;
+	gboolean is_more_row;
+
+	if (! queue->more_row)
+		return FALSE;
+
+	path = gtk_tree_model_get_path(model, iter);
+	is_more_row = gtk_tree_path_get_indices(path)[0] ==
+		gtk_tree_model_iter_n_children(model, NULL) - 1;
+	gtk_tree_path_free(path);
+
+	if (is_more_row)
+	{
+		queue->requested += ui_prefs.msgwin_max_rows;
+		/* flush_row_queue() forgets the pending timeout */
+		if (queue->source != 0)
+			g_source_remove(queue->source);
+		flush_row_queue(queue);
+	}
+	return is_more_row;
+}
+
+
+/* Returns: the number of rows of the Compiler or Messages tab, including those not shown yet */
+guint msgwin_get_n_rows(gint tabnum)
+{
+	RowQueue *queue = (tabnum == MSG_COMPILER) ? &compiler_queue : &msg_queue;
+	guint n_rows;
+
+	g_return_val_if_fail(tabnum == MSG_COMPILER || tabnum == MSG_MESSAGE, 0);
+
+	n_rows = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(get_queue_store(queue)), NULL);
+	if (queue->more_row)
+		n_rows--;
+	return n_rows + queue->rows->len - queue->next;
+}
+
+
 /**
  * Adds a formatted message in the compiler tab treeview in the messages window.
  *
@@ -329,6 +573,26 @@ void msgwin_compiler_add(gint msg_color, const gchar *format, ...)
 	g_free(string);
 }
 
+
+static void compiler_add_string(gint msg_color, const gchar *msg, gboolean queued)
+{
+	gchar *utf8_msg;
+
+	if (! g_utf8_validate(msg, -1, NULL))
+		utf8_msg = utils_get_utf8_from_locale(msg);
+	else
+		utf8_msg = (gchar *) msg;
+
+	if (queued)
+		queue_row(&compiler_queue, msg_color, -1, 0, utf8_msg);
+	else
+		add_row(&compiler_queue, msg_color, -1, 0, utf8_msg);
+
+	if (utf8_msg != msg)
+		g_free(utf8_msg);
+}
+
+
 /**
  * Adds a new message in the compiler tab treeview in the messages window.
  *
@@ -342,30 +606,15 @@ void msgwin_compiler_add(gint msg_color, const gchar *format, ...)
 GEANY_API_SYMBOL
 void msgwin_compiler_add_string(gint msg_color, const gchar *msg)
 {
-	GtkTreeIter iter;
-	const GdkColor *color = get_color(msg_color);
-	gchar *utf8_msg;
-
-	if (! g_utf8_validate(msg, -1, NULL))
-		utf8_msg = utils_get_utf8_from_locale(msg);
-	else
-		utf8_msg = (gchar *) msg;
-
-	gtk_list_store_append(msgwindow.store_compiler, &iter);
-	gtk_list_store_set(msgwindow.store_compiler, &iter,
-		COMPILER_COL_COLOR, color, COMPILER_COL_STRING, utf8_msg, -1);
-
-	if (ui_prefs.msgwindow_visible && interface_prefs.compiler_tab_autoscroll)
-	{
-		GtkTreePath *path = gtk_tree_model_get_path(
-			gtk_tree_view_get_model(GTK_TREE_VIEW(msgwindow.tree_compiler)), &iter);
+	compiler_add_string(msg_color, msg, FALSE);
+}
 
-		gtk_tree_view_scroll_to_cell(GTK_TREE_VIEW(msgwindow.tree_compiler), path, NULL, TRUE, 0.5, 0.5);
-		gtk_tree_path_free(path);
-	}
 
-	if (utf8_msg != msg)
-		g_free(utf8_msg);
+/* Like msgwin_compiler_add_string(), but the row is added with the next batch, for the
+ * output of the build commands */
+void msgwin_compiler_queue_string(gint msg_color, const gchar *msg)
+{
+	compiler_add_string(msg_color, msg, TRUE);
 }
 
 
@@ -414,26 +663,9 @@ void msgwin_msg_add(gint msg_color, gint line, GeanyDocument *doc, const gchar *
 }
 
 
-/**
- * Adds a new message in the messages tab treeview in the messages window.
- *
- * If @a line and @a doc are set, clicking on this line jumps into the
- * file which is specified by @a doc into the line specified with @a line.
- *
- * @param msg_color A color to be used for the text. It must be an element of #MsgColors.
- * @param line      The document's line where the message belongs to. Set to @c -1 to ignore.
- * @param doc       @nullable The document. Set to @c NULL to ignore.
- * @param string    Message to be added.
- *
- * @see msgwin_msg_add()
- *
- * @since 1.34 (API 236)
- **/
-GEANY_API_SYMBOL
-void msgwin_msg_add_string(gint msg_color, gint line, GeanyDocument *doc, const gchar *string)
+static void msg_add_string(gint msg_color, gint line, GeanyDocument *doc, const gchar *string,
+		gboolean queued)
 {
-	GtkTreeIter iter;
-	const GdkColor *color = get_color(msg_color);
 	gchar *tmp;
 	gsize len;
 	gchar *utf8_msg;
@@ -455,10 +687,10 @@ void msgwin_msg_add_string(gint msg_color, gint line, GeanyDocument *doc, const
 	else
 		utf8_msg = tmp;
 
-	gtk_list_store_append(msgwindow.store_msg, &iter);
-	gtk_list_store_set(msgwindow.store_msg, &iter,
-		MSG_COL_LINE, line, MSG_COL_DOC_ID, doc ? doc->id : 0, MSG_COL_COLOR,
-		color, MSG_COL_STRING, utf8_msg, -1);
+	if (queued)
+		queue_row(&msg_queue, msg_color, line, doc ? doc->id : 0, utf8_msg);
+	else
+		add_row(&msg_queue, msg_color, line, doc ? doc->id : 0, utf8_msg);
 
 	g_free(tmp);
 	if (utf8_msg != tmp)
@@ -466,6 +698,36 @@ void msgwin_msg_add_string(gint msg_color, gint line, GeanyDocument *doc, const
 }
 
 
+/**
+ * Adds a new message in the messages tab treeview in the messages window.
+ *
+ * If @a line and @a doc are set, clicking on this line jumps into the
+ * file which is specified by @a doc into the line specified with @a line.
+ *
+ * @param msg_color A color to be used for the text. It must be an element of #MsgColors.
+ * @param line      The document's line where the message belongs to. Set to @c -1 to ignore.
+ * @param doc       @nullable The document. Set to @c NULL to ignore.
+ * @param string    Message to be added.
+ *
+ * @see msgwin_msg_add()
+ *
+ * @since 1.34 (API 236)
+ **/
+GEANY_API_SYMBOL
+void msgwin_msg_add_string(gint msg_color, gint line, GeanyDocument *doc, const gchar *string)
+{
+	msg_add_string(msg_color, line, doc, string, FALSE);
+}
+
+
+/* Like msgwin_msg_add_string(), but the row is added with the next batch, for the many
+ * results of a search */
+void msgwin_msg_queue_string(gint msg_color, gint line, GeanyDocument *doc, const gchar *string)
+{
+	msg_add_string(msg_color, line, doc, string, TRUE);
+}
+
+
 /**
  * Logs a new status message *without* setting the status bar.
  *
@@ -585,15 +847,18 @@ on_compiler_treeview_copy_activate(GtkMenuItem *menuitem, gpointer user_data)
 static void on_compiler_treeview_copy_all_activate(GtkMenuItem *menuitem, gpointer user_data)
 {
 	GtkListStore *store = msgwindow.store_compiler;
+	RowQueue *queue = &compiler_queue;
 	GtkTreeIter iter;
 	GString *str = g_string_new("");
 	gint str_idx = COMPILER_COL_STRING;
+	gint n_rows = -1;
 	gboolean valid;
 
 	switch (GPOINTER_TO_INT(user_data))
 	{
 		case MSG_STATUS:
 		store = msgwindow.store_status;
+		queue = NULL;
 		str_idx = 0;
 		break;
 
@@ -603,13 +868,17 @@ static void on_compiler_treeview_copy_all_activate(GtkMenuItem *menuitem, gpoint
 
 		case MSG_MESSAGE:
 		store = msgwindow.store_msg;
+		queue = &msg_queue;
 		str_idx = MSG_COL_STRING;
 		break;
 	}
 
+	if (queue != NULL && queue->more_row)
+		n_rows = gtk_tree_model_iter_n_children(GTK_TREE_MODEL(store), NULL) - 1;
+
 	/* walk through the list and copy every line into a string */
 	valid = gtk_tree_model_get_iter_first(GTK_TREE_MODEL(store), &iter);
-	while (valid)
+	while (valid && n_rows-- != 0)
 	{
 		gchar *line;
 
@@ -623,6 +892,22 @@ static void on_compiler_treeview_copy_all_activate(GtkMenuItem *menuitem, gpoint
 
 		valid = gtk_tree_model_iter_next(GTK_TREE_MODEL(store), &iter);
 	}
+	/* and the lines not shown yet */
+	if (queue != NULL)
+	{
+		guint i;
+
+		for (i = queue->next; i < queue->rows->len; i++)
+		{
+			const gchar *line = g_array_index(queue->rows, QueuedRow, i).string;
+
+			if (*line != 0)
+			{
+				g_string_append(str, line);
+				g_string_append_c(str, '\n');
+			}
+		}
+	}
 
 	/* copy the string into the clipboard */
 	if (str->len > 0)
@@ -701,14 +986,16 @@ void msgwin_menu_add_common_items(GtkMenu *menu)
 }
 
 
-/* look back up from the current path and find the directory we came from */
+/* look back up from the current path and find the directory we came from, within the
+ * output of the build command which printed the row */
 static gboolean
 find_prev_build_dir(GtkTreePath *cur, GtkTreeModel *model, gchar **prefix)
 {
 	GtkTreeIter iter;
+	guint first_row = build_get_output_first_row(gtk_tree_path_get_indices(cur)[0]);
 	*prefix = NULL;
 
-	while (gtk_tree_path_prev(cur))
+	while ((guint) gtk_tree_path_get_indices(cur)[0] > first_row && gtk_tree_path_prev(cur))
 	{
 		if (gtk_tree_model_get_iter(model, &iter, cur))
 		{
@@ -804,6 +1091,9 @@ gboolean msgwin_goto_compiler_file_line(gboolean focus_editor)
 	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(msgwindow.tree_compiler));
 	if (gtk_tree_selection_get_selected(selection, &model, &iter))
 	{
+		if (show_more_rows(&compiler_queue, model, &iter))
+			return FALSE;
+
 		/* if the item is not coloured red, it's not an error line */
 		gtk_tree_model_get(model, &iter, COMPILER_COL_COLOR, &color, -1);
 		if (color == NULL || ! gdk_color_equal(color, &color_error))
@@ -820,12 +1110,14 @@ gboolean msgwin_goto_compiler_file_line(gboolean focus_editor)
 			gint line;
 			gchar *filename, *dir;
 			GtkTreePath *path;
+			guint row;
 			gboolean ret;
 
 			path = gtk_tree_model_get_path(model, &iter);
+			row = gtk_tree_path_get_indices(path)[0];
 			find_prev_build_dir(path, model, &dir);
 			gtk_tree_path_free(path);
-			msgwin_parse_compiler_error_line(string, dir, &filename, &line);
+			build_parse_compiler_row(row, string, dir, &filename, &line);
 			g_free(string);
 			g_free(dir);
 
@@ -889,13 +1181,10 @@ static void parse_file_line(ParseData *data, gchar **filename, gint *line)
 		return;
 	}
 
-	/* let's stop here if there is no filename in the error message */
+	/* let's stop here if there is no filename in the error message, the caller takes the
+	 * current one and hopes it's correct */
 	if (data->file_idx == -1)
 	{
-		/* we have no filename in the error message, so take the current one and hope it's correct */
-		GeanyDocument *doc = document_get_current();
-		if (doc != NULL)
-			*filename = g_strdup(doc->file_name);
 		g_strfreev(fields);
 		return;
 	}
@@ -905,14 +1194,14 @@ static void parse_file_line(ParseData *data, gchar **filename, gint *line)
 }
 
 
-static void parse_compiler_error_line(const gchar *string,
+static void parse_compiler_error_line(const gchar *string, gint file_type_id,
 		gchar **filename, gint *line)
 {
 	ParseData data = {NULL, NULL, 0, 0, 0};
 
 	data.string = string;
 
-	switch (build_info.file_type_id)
+	switch (file_type_id)
 	{
 		case GEANY_FILETYPES_PHP:
 		{
@@ -1034,7 +1323,7 @@ static void parse_compiler_error_line(const gchar *string,
 		case GEANY_FILETYPES_NONE:
 		default:	/* The default is a GNU gcc type error */
 		{
-			if (build_info.file_type_id == GEANY_FILETYPES_JAVA &&
+			if (file_type_id == GEANY_FILETYPES_JAVA &&
 				strncmp(string, "[javac]", 7) == 0)
 			{
 				/* Java Apache Ant.
@@ -1062,43 +1351,31 @@ static void parse_compiler_error_line(const gchar *string,
 }
 
 
-/* try to parse the file and line number where the error occurred described in string
- * and when something useful is found, it stores the line number in *line and the
- * relevant file with the error in *filename.
- * *line will be -1 if no error was found in string.
- * *filename must be freed unless it is NULL. */
-void msgwin_parse_compiler_error_line(const gchar *string, const gchar *dir,
-		gchar **filename, gint *line)
+/* Parses string like build_parse_compiler_row(), with the compiled error regex of
+ * the build (or NULL), the filetype ID of the build and the UTF-8 directory of the build.
+ * If the error message has no file name, *filename is NULL while *line is set.
+ * Can be used from any thread. */
+void msgwin_parse_compiler_error(const gchar *string, GRegex *error_regex, gint file_type_id,
+		const gchar *dir, gchar **filename, gint *line)
 {
-	GeanyFiletype *ft;
-	gchar *trimmed_string, *utf8_dir;
-
 	*filename = NULL;
 	*line = -1;
 
 	if (G_UNLIKELY(string == NULL))
 		return;
 
-	if (dir == NULL)
-		utf8_dir = utils_get_utf8_from_locale(build_info.dir);
-	else
-		utf8_dir = g_strdup(dir);
-	g_return_if_fail(utf8_dir != NULL);
-
-	trimmed_string = g_strdup(string);
-	g_strchug(trimmed_string); /* remove possible leading whitespace */
-
-	ft = filetypes[build_info.file_type_id];
+	/* skip possible leading whitespace */
+	while (g_ascii_isspace(*string))
+		string++;
 
 	/* try parsing with a custom regex */
-	if (!filetypes_parse_error_message(ft, trimmed_string, filename, line))
+	if (error_regex == NULL ||
+		!filetypes_parse_error_regex(error_regex, string, filename, line))
 	{
 		/* fallback to default old-style parsing */
-		parse_compiler_error_line(trimmed_string, filename, line);
+		parse_compiler_error_line(string, file_type_id, filename, line);
 	}
-	make_absolute(filename, utf8_dir);
-	g_free(trimmed_string);
-	g_free(utf8_dir);
+	make_absolute(filename, dir);
 }
 
 
@@ -1155,7 +1432,8 @@ gboolean msgwin_goto_messages_file_line(gboolean focus_editor)
 	gboolean ret = FALSE;
 
 	selection = gtk_tree_view_get_selection(GTK_TREE_VIEW(msgwindow.tree_msg));
-	if (gtk_tree_selection_get_selected(selection, &model, &iter))
+	if (gtk_tree_selection_get_selected(selection, &model, &iter) &&
+		! show_more_rows(&msg_queue, model, &iter))
 	{
 		gint line;
 		guint id;
@@ -1312,11 +1590,11 @@ void msgwin_clear_tab(gint tabnum)
 	switch (tabnum)
 	{
 		case MSG_MESSAGE:
-			store = msgwindow.store_msg;
-			break;
+			clear_row_queue(&msg_queue);
+			return;
 
 		case MSG_COMPILER:
-			gtk_list_store_clear(msgwindow.store_compiler);
+			clear_row_queue(&compiler_queue);
 			build_menu_update(NULL);	/* update next error items */
 			return;
 
@@ -102,11 +102,17 @@ void msgwin_menu_add_common_items(GtkMenu *menu);
 
 gboolean msgwin_goto_compiler_file_line(gboolean focus_editor);
 
-void msgwin_parse_compiler_error_line(const gchar *string, const gchar *dir,
-									  gchar **filename, gint *line);
+void msgwin_parse_compiler_error(const gchar *string, GRegex *error_regex, gint file_type_id,
+		const gchar *dir, gchar **filename, gint *line);
 
 gboolean msgwin_goto_messages_file_line(gboolean focus_editor);
 
+guint msgwin_get_n_rows(gint tabnum);
+
+void msgwin_compiler_queue_string(gint msg_color, const gchar *msg);
+
+void msgwin_msg_queue_string(gint msg_color, gint line, GeanyDocument *doc, const gchar *string);
+
 #endif /* GEANY_PRIVATE */
 
 G_END_DECLS
@@ -37,6 +37,7 @@
 #include "geanyobject.h"
 #include "keyfile.h"
 #include "main.h"
+#include "projectindex.h"
 #include "projectprivate.h"
 #include "sidebar.h"
 #include "stash.h"
@@ -437,6 +438,8 @@ static void destroy_project(gboolean open_default)
 
 	g_signal_emit_by_name(geany_object, "project-before-close");
 
+	project_index_close();
+
 	/* remove project filetypes build entries */
 	if (app->project->priv->build_filetypes_list != NULL)
 	{
@@ -1059,6 +1062,24 @@ gboolean project_load_file(const gchar *locale_file_name)
 }
 
 
+/* Opens the trigram index of the project, which is saved next to the project file */
+static void open_trigram_index(const gchar *locale_filename)
+{
+	gchar *utf8_base_path = project_get_base_path();
+
+	if (utf8_base_path != NULL)
+	{
+		gchar *locale_base_path = utils_get_locale_from_utf8(utf8_base_path);
+		gchar *index_file = g_strconcat(locale_filename, ".index", NULL);
+
+		project_index_open(locale_base_path, index_file);
+		g_free(index_file);
+		g_free(locale_base_path);
+		g_free(utf8_base_path);
+	}
+}
+
+
 /* Reads the given filename and creates a new project with the data found in the file.
  * At this point there should not be an already opened project in Geany otherwise it will just
  * return.
@@ -1106,6 +1127,9 @@ static gboolean load_config(const gchar *filename)
 	}
 	/* read session files so they can be opened with configuration_open_files() */
 	p->priv->session_files = configuration_load_session_files(config);
+
+	if (project_prefs.trigram_index)
+		open_trigram_index(filename);
 	g_signal_emit_by_name(geany_object, "project-open", config);
 	g_key_file_free(config);
 
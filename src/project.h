@@ -56,6 +56,7 @@ typedef struct ProjectPrefs
 {
 	gchar *session_file;
 	gboolean project_file_in_basedir;
+	gboolean trigram_index;
 } ProjectPrefs;
 
 extern ProjectPrefs project_prefs;
@@ -0,0 +1,668 @@
+/*
+ *      projectindex.c - this file is part of Geany, a fast and lightweight IDE
+ *
+ *      Copyright 2024 The Geany contributors
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License along
+ *      with this program; if not, write to the Free Software Foundation, Inc.,
+ *      51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+/*
+ * Trigram index of the files of the open project, which tells Find in Files the files it
+ * can not find a text in.
+ * The trigrams of each file (its sequences of three bytes, with ASCII letters folded to
+ * lower case) are kept in a Bloom filter of about ten bits per trigram. A file can only
+ * contain a text if its filter has all the trigrams of the text. The index is built on a
+ * worker thread when the project is opened and saved next to the project file, so opening
+ * the project again only indexes the files changed since. Files are indexed again after
+ * Geany saved them, or once a search finds that their size, modification or status change
+ * time or inode changed; until then they are always searched.
+ */
+
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "projectindex.h"
+
+#include "document.h"
+#include "geanyobject.h"
+#include "utils.h"
+
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include <glib/gstdio.h>
+
+
+#define INDEX_MAGIC "GEANY TRIGRAM INDEX 2\n"
+#define INDEX_BYTE_ORDER 0x01020304
+/* bigger files are not indexed, so they are always searched */
+#define INDEX_MAX_FILE_SIZE (16 * 1024 * 1024)
+/* like Find in Files, take files with a NUL byte in their beginning as binary */
+#define INDEX_BINARY_CHECK_SIZE 8192
+#define INDEX_BITS_PER_TRIGRAM 10
+#define INDEX_MIN_BITS 64
+#define INDEX_MAX_BITS (1 << 20)
+#define INDEX_N_HASHES 3
+/* files modified more recently could still change within the resolution of their
+ * modification and status change times */
+#define INDEX_SETTLE_TIME 2
+
+
+typedef struct
+{
+	gint64		 mtime;
+	gint64		 ctime;		/* tells about files replaced by copies keeping their mtime */
+	gint64		 size;
+	guint64		 inode;
+	guint32		 n_bytes;	/* 0 for files without text */
+	guint8		*bits;
+}
+IndexedFile;
+
+typedef struct
+{
+	gint			 ref_count;
+	gchar			*base_dir;		/* locale real path */
+	gchar			*index_file;
+	GThreadPool		*pool;			/* a single thread indexing the files */
+	volatile gint	 closed;
+	/* worker only */
+	guint8			*seen;			/* bitmap of all trigrams */
+	GArray			*trigrams;		/* the trigrams set in seen */
+	/* protected by lock */
+	GMutex			 lock;
+	GHashTable		*files;			/* locale real path -> IndexedFile */
+	GHashTable		*queued;		/* paths pushed to pool */
+	gboolean		 changed;		/* files changed since the index was saved */
+}
+ProjectIndex;
+
+typedef struct
+{
+	guint32 h1, h2;
+}
+TrigramHash;
+
+struct ProjectIndexQuery
+{
+	ProjectIndex	*index;
+	GArray			*hashes;		/* TrigramHash of each trigram of the text */
+};
+
+
+static ProjectIndex *current_index = NULL;
+static gulong save_handler = 0;
+
+
+static guint32 fold_case(guchar c)
+{
+	return (guchar) g_ascii_tolower(c);
+}
+
+
+/* Whether c can not be matched through the index when ignoring case. Caseless regexes use
+ * Unicode case folding, where 'k' also matches U+212A KELVIN SIGN and 's' U+017F LATIN SMALL
+ * LETTER LONG S, but the index only folds ASCII letters. */
+static gboolean is_unfolded_char(guchar c)
+{
+	return c >= 0x80 || fold_case(c) == 'k' || fold_case(c) == 's';
+}
+
+
+static void trigram_hash(guint32 trigram, TrigramHash *hash)
+{
+	guint32 h = trigram * 0x9E3779B1u;
+
+	hash->h1 = h ^ (h >> 15);
+	h = trigram * 0x85EBCA77u;
+	hash->h2 = (h ^ (h >> 13)) | 1;
+}
+
+
+static gboolean file_has_trigram(const IndexedFile *file, const TrigramHash *hash)
+{
+	const guint32 mask = file->n_bytes * 8 - 1;
+	guint32 i;
+
+	for (i = 0; i < INDEX_N_HASHES; i++)
+	{
+		guint32 bit = (hash->h1 + i * hash->h2) & mask;
+
+		if (! (file->bits[bit >> 3] & (1 << (bit & 7))))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+
+static void file_add_trigram(IndexedFile *file, const TrigramHash *hash)
+{
+	const guint32 mask = file->n_bytes * 8 - 1;
+	guint32 i;
+
+	for (i = 0; i < INDEX_N_HASHES; i++)
+	{
+		guint32 bit = (hash->h1 + i * hash->h2) & mask;
+
+		file->bits[bit >> 3] |= 1 << (bit & 7);
+	}
+}
+
+
+static void indexed_file_free(gpointer data)
+{
+	IndexedFile *file = data;
+
+	g_free(file->bits);
+	g_free(file);
+}
+
+
+static void index_unref(ProjectIndex *index)
+{
+	if (! g_atomic_int_dec_and_test(&index->ref_count))
+		return;
+
+	g_hash_table_destroy(index->files);
+	g_hash_table_destroy(index->queued);
+	g_mutex_clear(&index->lock);
+	if (index->trigrams != NULL)
+		g_array_free(index->trigrams, TRUE);
+	g_free(index->seen);
+	g_free(index->base_dir);
+	g_free(index->index_file);
+	g_free(index);
+}
+
+
+/* Makes the worker index locale_path. index->lock must be held. */
+static void queue_path(ProjectIndex *index, const gchar *locale_path)
+{
+	if (index->closed || g_hash_table_contains(index->queued, locale_path))
+		return;
+
+	g_hash_table_add(index->queued, g_strdup(locale_path));
+	g_thread_pool_push(index->pool, g_strdup(locale_path), NULL);
+}
+
+
+static gboolean is_below_base_dir(ProjectIndex *index, const gchar *locale_path)
+{
+	gsize len = strlen(index->base_dir);
+
+	return strncmp(locale_path, index->base_dir, len) == 0 && locale_path[len] == G_DIR_SEPARATOR;
+}
+
+
+/* Sets the Bloom filter of file from the trigrams of data */
+static void index_data(ProjectIndex *index, IndexedFile *file, const guchar *data, gsize len)
+{
+	guint32 trigram = 0;
+	guint n_bits = INDEX_MIN_BITS;
+	gsize i;
+
+	if (index->seen == NULL)
+	{
+		index->seen = g_malloc0((1 << 24) / 8);
+		index->trigrams = g_array_new(FALSE, FALSE, sizeof(guint32));
+	}
+
+	for (i = 0; i < len; i++)
+	{
+		trigram = ((trigram << 8) | fold_case(data[i])) & 0xFFFFFF;
+		if (i >= 2 && ! (index->seen[trigram >> 3] & (1 << (trigram & 7))))
+		{
+			index->seen[trigram >> 3] |= 1 << (trigram & 7);
+			g_array_append_val(index->trigrams, trigram);
+		}
+	}
+
+	while (n_bits < index->trigrams->len * INDEX_BITS_PER_TRIGRAM && n_bits < INDEX_MAX_BITS)
+		n_bits <<= 1;
+	file->n_bytes = n_bits / 8;
+	file->bits = g_malloc0(file->n_bytes);
+
+	for (i = 0; i < index->trigrams->len; i++)
+	{
+		TrigramHash hash;
+
+		trigram = g_array_index(index->trigrams, guint32, i);
+		index->seen[trigram >> 3] &= ~(1 << (trigram & 7));
+		trigram_hash(trigram, &hash);
+		file_add_trigram(file, &hash);
+	}
+	g_array_set_size(index->trigrams, 0);
+}
+
+
+/* Whether the file with status st is the one which was indexed as file */
+static gboolean is_indexed_file(const IndexedFile *file, const GStatBuf *st)
+{
+	return file != NULL && file->mtime == st->st_mtime && file->ctime == st->st_ctime &&
+		file->size == st->st_size && file->inode == st->st_ino;
+}
+
+
+static void index_file(ProjectIndex *index, const gchar *locale_path)
+{
+	IndexedFile *file;
+	GMappedFile *map;
+	GStatBuf st;
+	gboolean up_to_date;
+
+	g_mutex_lock(&index->lock);
+	g_hash_table_remove(index->queued, locale_path);
+	g_mutex_unlock(&index->lock);
+
+	if (g_stat(locale_path, &st) != 0 || ! S_ISREG(st.st_mode) ||
+		st.st_size > INDEX_MAX_FILE_SIZE ||
+		MAX(st.st_mtime, st.st_ctime) > time(NULL) - INDEX_SETTLE_TIME)
+	{
+		g_mutex_lock(&index->lock);
+		if (g_hash_table_remove(index->files, locale_path))
+			index->changed = TRUE;
+		g_mutex_unlock(&index->lock);
+		return;
+	}
+
+	g_mutex_lock(&index->lock);
+	file = g_hash_table_lookup(index->files, locale_path);
+	up_to_date = is_indexed_file(file, &st);
+	g_mutex_unlock(&index->lock);
+	if (up_to_date)
+		return;
+
+	map = g_mapped_file_new(locale_path, FALSE, NULL);
+	if (map == NULL)
+		return;
+
+	file = g_new0(IndexedFile, 1);
+	file->mtime = st.st_mtime;
+	file->ctime = st.st_ctime;
+	file->size = st.st_size;
+	file->inode = st.st_ino;
+	if (g_mapped_file_get_length(map) > 0)
+	{
+		const gchar *data = g_mapped_file_get_contents(map);
+		gsize len = g_mapped_file_get_length(map);
+
+		if (memchr(data, '\0', MIN(len, INDEX_BINARY_CHECK_SIZE)) == NULL)
+			index_data(index, file, (const guchar *) data, len);
+	}
+	g_mapped_file_unref(map);
+
+	g_mutex_lock(&index->lock);
+	g_hash_table_insert(index->files, g_strdup(locale_path), file);
+	index->changed = TRUE;
+	g_mutex_unlock(&index->lock);
+}
+
+
+/* Indexes the files below locale_dir and adds their paths to paths */
+static void index_dir(ProjectIndex *index, const gchar *locale_dir, GHashTable *paths)
+{
+	GDir *dir = g_dir_open(locale_dir, 0, NULL);
+	const gchar *name;
+
+	if (dir == NULL)
+		return;
+
+	while ((name = g_dir_read_name(dir)) != NULL && ! g_atomic_int_get(&index->closed))
+	{
+		gchar *locale_path;
+
+		/* skip hidden files, and the metadata directories of version control systems */
+		if (name[0] == '.')
+			continue;
+
+		locale_path = g_build_filename(locale_dir, name, NULL);
+		/* like Find in Files, don't follow symbolic links */
+		if (g_file_test(locale_path, G_FILE_TEST_IS_SYMLINK))
+			g_free(locale_path);
+		else if (g_file_test(locale_path, G_FILE_TEST_IS_DIR))
+		{
+			index_dir(index, locale_path, paths);
+			g_free(locale_path);
+		}
+		else
+		{
+			index_file(index, locale_path);
+			g_hash_table_add(paths, locale_path);
+		}
+	}
+	g_dir_close(dir);
+}
+
+
+static gboolean read_bytes(const gchar **p, const gchar *end, gpointer dest, gsize n)
+{
+	if ((gsize) (end - *p) < n)
+		return FALSE;
+	memcpy(dest, *p, n);
+	*p += n;
+	return TRUE;
+}
+
+
+/* Reads the index saved by index_save() */
+static void index_load(ProjectIndex *index)
+{
+	const gsize magic_len = strlen(INDEX_MAGIC);
+	gchar *contents;
+	const gchar *p, *end;
+	gsize len;
+	guint32 byte_order;
+
+	if (! g_file_get_contents(index->index_file, &contents, &len, NULL))
+		return;
+
+	p = contents;
+	end = contents + len;
+	if (len < magic_len || memcmp(p, INDEX_MAGIC, magic_len) != 0)
+	{
+		g_free(contents);
+		return;
+	}
+	p += magic_len;
+	if (! read_bytes(&p, end, &byte_order, sizeof byte_order) || byte_order != INDEX_BYTE_ORDER)
+	{
+		g_free(contents);
+		return;
+	}
+
+	g_mutex_lock(&index->lock);
+	while (p < end)
+	{
+		IndexedFile *file = g_new0(IndexedFile, 1);
+		guint32 path_len;
+		gchar *name;
+
+		if (! read_bytes(&p, end, &path_len, sizeof path_len) || (gsize) (end - p) < path_len)
+		{
+			g_free(file);
+			break;
+		}
+		name = g_strndup(p, path_len);
+		p += path_len;
+
+		if (! read_bytes(&p, end, &file->mtime, sizeof file->mtime) ||
+			! read_bytes(&p, end, &file->ctime, sizeof file->ctime) ||
+			! read_bytes(&p, end, &file->size, sizeof file->size) ||
+			! read_bytes(&p, end, &file->inode, sizeof file->inode) ||
+			! read_bytes(&p, end, &file->n_bytes, sizeof file->n_bytes) ||
+			(file->n_bytes & (file->n_bytes - 1)) != 0 ||
+			(gsize) (end - p) < file->n_bytes)
+		{
+			g_free(name);
+			g_free(file);
+			break;
+		}
+		if (file->n_bytes > 0)
+		{
+			file->bits = g_malloc(file->n_bytes);
+			memcpy(file->bits, p, file->n_bytes);
+		}
+		p += file->n_bytes;
+
+		g_hash_table_insert(index->files, g_build_filename(index->base_dir, name, NULL), file);
+		g_free(name);
+	}
+	g_mutex_unlock(&index->lock);
+	g_free(contents);
+}
+
+
+static void index_save(ProjectIndex *index)
+{
+	GString *contents;
+	GHashTableIter iter;
+	gpointer key, value;
+	gsize base_len = strlen(index->base_dir) + 1;
+	guint32 byte_order = INDEX_BYTE_ORDER;
+
+	g_mutex_lock(&index->lock);
+	if (! index->changed)
+	{
+		g_mutex_unlock(&index->lock);
+		return;
+	}
+	index->changed = FALSE;
+
+	contents = g_string_new(INDEX_MAGIC);
+	g_string_append_len(contents, (const gchar *) &byte_order, sizeof byte_order);
+	g_hash_table_iter_init(&iter, index->files);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		const IndexedFile *file = value;
+		/* save the paths relative to the base directory */
+		const gchar *name = (const gchar *) key + base_len;
+		guint32 path_len = strlen(name);
+
+		g_string_append_len(contents, (const gchar *) &path_len, sizeof path_len);
+		g_string_append_len(contents, name, path_len);
+		g_string_append_len(contents, (const gchar *) &file->mtime, sizeof file->mtime);
+		g_string_append_len(contents, (const gchar *) &file->ctime, sizeof file->ctime);
+		g_string_append_len(contents, (const gchar *) &file->size, sizeof file->size);
+		g_string_append_len(contents, (const gchar *) &file->inode, sizeof file->inode);
+		g_string_append_len(contents, (const gchar *) &file->n_bytes, sizeof file->n_bytes);
+		g_string_append_len(contents, (const gchar *) file->bits, file->n_bytes);
+	}
+	g_mutex_unlock(&index->lock);
+
+	if (! g_file_set_contents(index->index_file, contents->str, contents->len, NULL))
+		g_unlink(index->index_file);
+	g_string_free(contents, TRUE);
+}
+
+
+/* Indexes the file locale_path, or all files below it if it is the base directory */
+static void run_job(gpointer data, gpointer user_data)
+{
+	ProjectIndex *index = user_data;
+	gchar *locale_path = data;
+
+	if (g_atomic_int_get(&index->closed))
+	{
+		g_free(locale_path);
+		return;
+	}
+
+	if (strcmp(locale_path, index->base_dir) == 0)
+	{
+		GHashTable *paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+		index_load(index);
+		index_dir(index, index->base_dir, paths);
+
+		if (! g_atomic_int_get(&index->closed))
+		{
+			GHashTableIter iter;
+			gpointer key;
+
+			/* forget the removed files */
+			g_mutex_lock(&index->lock);
+			g_hash_table_iter_init(&iter, index->files);
+			while (g_hash_table_iter_next(&iter, &key, NULL))
+			{
+				if (! g_hash_table_contains(paths, key))
+				{
+					g_hash_table_iter_remove(&iter);
+					index->changed = TRUE;
+				}
+			}
+			g_mutex_unlock(&index->lock);
+			index_save(index);
+		}
+		g_hash_table_destroy(paths);
+	}
+	else
+		index_file(index, locale_path);
+
+	g_free(locale_path);
+}
+
+
+static void on_document_save(G_GNUC_UNUSED GObject *obj, GeanyDocument *doc,
+		G_GNUC_UNUSED gpointer user_data)
+{
+	ProjectIndex *index = current_index;
+
+	if (doc->real_path != NULL && is_below_base_dir(index, doc->real_path))
+	{
+		g_mutex_lock(&index->lock);
+		queue_path(index, doc->real_path);
+		g_mutex_unlock(&index->lock);
+	}
+}
+
+
+/* Starts indexing the files below locale_base_dir, using the index saved in
+ * locale_index_file */
+void project_index_open(const gchar *locale_base_dir, const gchar *locale_index_file)
+{
+	ProjectIndex *index;
+	gchar *base_dir;
+
+	g_return_if_fail(locale_base_dir != NULL);
+	g_return_if_fail(locale_index_file != NULL);
+
+	project_index_close();
+
+	/* build the paths from the real path so that they match the ones of Find in Files */
+	base_dir = utils_get_real_path(locale_base_dir);
+	if (base_dir == NULL)
+		return;
+
+	index = g_new0(ProjectIndex, 1);
+	index->ref_count = 1;
+	index->base_dir = base_dir;
+	index->index_file = g_strdup(locale_index_file);
+	index->pool = g_thread_pool_new(run_job, index, 1, FALSE, NULL);
+	g_mutex_init(&index->lock);
+	index->files = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, indexed_file_free);
+	index->queued = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	current_index = index;
+
+	save_handler = g_signal_connect(geany_object, "document-save", G_CALLBACK(on_document_save), NULL);
+
+	g_mutex_lock(&index->lock);
+	queue_path(index, index->base_dir);
+	g_mutex_unlock(&index->lock);
+}
+
+
+/* Stops indexing and saves the index */
+void project_index_close(void)
+{
+	ProjectIndex *index = current_index;
+
+	if (index == NULL)
+		return;
+	current_index = NULL;
+
+	g_signal_handler_disconnect(geany_object, save_handler);
+	save_handler = 0;
+
+	g_mutex_lock(&index->lock);
+	g_atomic_int_set(&index->closed, TRUE);
+	g_mutex_unlock(&index->lock);
+	/* the queued jobs return right away */
+	g_thread_pool_free(index->pool, FALSE, TRUE);
+	index->pool = NULL;
+
+	index_save(index);
+	index_unref(index);
+}
+
+
+/* Returns: a query for the files which can contain text, or NULL if there is no index or
+ * text is too short to use it. */
+ProjectIndexQuery *project_index_query_new(const gchar *text, gboolean case_sensitive)
+{
+	ProjectIndexQuery *query;
+	GArray *hashes;
+	const guchar *p;
+
+	if (current_index == NULL)
+		return NULL;
+
+	hashes = g_array_new(FALSE, FALSE, sizeof(TrigramHash));
+	for (p = (const guchar *) text; p[0] != 0 && p[1] != 0 && p[2] != 0; p++)
+	{
+		TrigramHash hash;
+
+		/* only ASCII letters are folded to lower case in the index */
+		if (! case_sensitive &&
+			(is_unfolded_char(p[0]) || is_unfolded_char(p[1]) || is_unfolded_char(p[2])))
+			continue;
+
+		trigram_hash(fold_case(p[0]) << 16 | fold_case(p[1]) << 8 | fold_case(p[2]), &hash);
+		g_array_append_val(hashes, hash);
+	}
+	if (hashes->len == 0)
+	{
+		g_array_free(hashes, TRUE);
+		return NULL;
+	}
+
+	query = g_new0(ProjectIndexQuery, 1);
+	query->index = current_index;
+	g_atomic_int_inc(&current_index->ref_count);
+	query->hashes = hashes;
+	return query;
+}
+
+
+/* Returns: whether locale_path, which must be a real path, can contain the text of
+ * query. Files which are not indexed or have changed since can contain anything.
+ * Can be used from any thread. */
+gboolean project_index_query_match(const gchar *locale_path, gpointer data)
+{
+	ProjectIndexQuery *query = data;
+	ProjectIndex *index = query->index;
+	const IndexedFile *file;
+	gboolean match = TRUE;
+	GStatBuf st;
+
+	if (! is_below_base_dir(index, locale_path) || g_stat(locale_path, &st) != 0)
+		return TRUE;
+
+	g_mutex_lock(&index->lock);
+	file = g_hash_table_lookup(index->files, locale_path);
+	if (is_indexed_file(file, &st))
+	{
+		guint i;
+
+		for (i = 0; i < query->hashes->len && match; i++)
+			match = file->n_bytes > 0 &&
+				file_has_trigram(file, &g_array_index(query->hashes, TrigramHash, i));
+	}
+	else
+		queue_path(index, locale_path);
+	g_mutex_unlock(&index->lock);
+	return match;
+}
+
+
+void project_index_query_free(gpointer data)
+{
+	ProjectIndexQuery *query = data;
+
+	g_array_free(query->hashes, TRUE);
+	index_unref(query->index);
+	g_free(query);
+}
@@ -35,6 +35,7 @@
 #endif
 
 #include "sciwrappers.h"
+#include "SciLexer.h" /* SCLEX_* */
 #include <Lexilla.h> /* ILexer5 */
 
 #include "editor.h"
@@ -710,6 +711,122 @@ void sci_set_lexer(ScintillaObject *sci, guint lexer_id)
 }
 
 
+/* Whether the lexer keeps all its state in the styles and line states of the document.
+ * The background lexer works on its own instance, so state kept in the instance (like the
+ * preprocessor definitions of the C lexer) would never reach the main one. These are the
+ * lexers made of a plain styling function. */
+static gboolean lexer_supports_background(guint lexer_id)
+{
+	switch (lexer_id)
+	{
+		case SCLEX_ABAQUS:
+		case SCLEX_ADA:
+		case SCLEX_ASCIIDOC:
+		case SCLEX_BATCH:
+		case SCLEX_CAML:
+		case SCLEX_CMAKE:
+		case SCLEX_COBOL:
+		case SCLEX_COFFEESCRIPT:
+		case SCLEX_CSS:
+		case SCLEX_DIFF:
+		case SCLEX_ERLANG:
+		case SCLEX_F77:
+		case SCLEX_FORTH:
+		case SCLEX_FORTRAN:
+		case SCLEX_LISP:
+		case SCLEX_LUA:
+		case SCLEX_MAKEFILE:
+		case SCLEX_MARKDOWN:
+		case SCLEX_MATLAB:
+		case SCLEX_NSIS:
+		case SCLEX_OCTAVE:
+		case SCLEX_PASCAL:
+		case SCLEX_PO:
+		case SCLEX_POWERSHELL:
+		case SCLEX_PROPERTIES:
+		case SCLEX_R:
+		case SCLEX_RUBY:
+		case SCLEX_SMALLTALK:
+		case SCLEX_TCL:
+		case SCLEX_TXT2TAGS:
+		case SCLEX_VHDL:
+		case SCLEX_YAML:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+
+/* Adds a second instance of the lexer which styles the document beyond the visible
+ * area on a worker thread, if the lexer supports it. Must be called right after
+ * sci_set_lexer() so the lexer settings made afterwards are passed on to it. */
+void sci_set_background_lexer(ScintillaObject *sci, guint lexer_id)
+{
+	ILexer5 *lexer;
+
+	if (!lexer_supports_background(lexer_id))
+		return;
+
+	lexer = CreateLexer(LexerNameFromID(lexer_id));
+	SSM(sci, SCI_SETBACKGROUNDLEXER, 0, (uintptr_t) lexer);
+}
+
+
+/* Creates a Scintilla document loader for text of about bytes, which can be filled from
+ * another thread with scintilla_loader_add_data(). options are SC_DOCUMENTOPTION_* flags.
+ * A scratch widget is used because SCI_CREATELOADER resets the fold state of the view it
+ * is sent to. */
+gpointer sci_create_loader(gsize bytes, gint options)
+{
+	ScintillaObject *sci = SCINTILLA(scintilla_new());
+	gpointer loader;
+
+	g_object_ref_sink(sci);
+	loader = (gpointer) SSM(sci, SCI_CREATELOADER, bytes, options);
+	gtk_widget_destroy(GTK_WIDGET(sci));
+	g_object_unref(sci);
+	return loader;
+}
+
+
+/* Makes the document built by a loader from sci_create_loader() the document of sci,
+ * consuming the loader. Settings stored in the document, such as the code page, the
+ * indentation and the lexer, have to be set again afterwards. */
+void sci_set_loaded_document(ScintillaObject *sci, gpointer loader)
+{
+	gpointer doc = scintilla_loader_convert_to_document(loader);
+
+	SSM(sci, SCI_SETDOCPOINTER, 0, (sptr_t) doc);
+	/* sci holds a reference now */
+	SSM(sci, SCI_RELEASEDOCUMENT, 0, (sptr_t) doc);
+}
+
+
+/* Gets the text without copying it, as the two parts stored before and after the gap of
+ * Scintilla's buffer. The pointers are only valid until the text is changed. */
+void sci_get_text_parts(ScintillaObject *sci, const gchar **part1, gsize *len1,
+		const gchar **part2, gsize *len2)
+{
+	gsize length = (gsize) SSM(sci, SCI_GETLENGTH, 0, 0);
+	gsize gap = (gsize) SSM(sci, SCI_GETGAPPOSITION, 0, 0);
+
+	/* a range on one side of the gap does not move it */
+	*len1 = gap;
+	*part1 = (const gchar *) SSM(sci, SCI_GETRANGEPOINTER, 0, gap);
+	*len2 = length - gap;
+	*part2 = (const gchar *) SSM(sci, SCI_GETRANGEPOINTER, gap, length - gap);
+}
+
+
+/* Reserves the line index for a text of lines lines about to be set, so that it is not
+ * grown repeatedly while the text is added. */
+void sci_allocate_lines(ScintillaObject *sci, gsize lines)
+{
+	SSM(sci, SCI_ALLOCATELINES, lines, 0);
+}
+
+
 /** Gets line length.
  * @param sci Scintilla widget.
  * @param line Line number.
@@ -1204,6 +1321,23 @@ gint sci_replace_target(ScintillaObject *sci, const gchar *text, gboolean regex)
 }
 
 
+/* Replaces all @a ranges (sorted, non-overlapping) as one undo action and sets the target
+ * to the span covering them.
+ * @return The length of that span after replacing or -1 on failure. */
+gint sci_replace_ranges(ScintillaObject *sci, const struct Sci_ReplaceRange *ranges, guint count)
+{
+	return (gint) SSM(sci, SCI_REPLACERANGES, (uptr_t) count, (sptr_t) ranges);
+}
+
+
+/* Finds all occurrences of the texts in @a ft in a single pass.
+ * @return The total number of matches, even if not all fit into ft->matches. */
+gint sci_find_multiple(ScintillaObject *sci, gint flags, struct Sci_TextToFindMultiple *ft)
+{
+	return (gint) SSM(sci, SCI_FINDMULTIPLE, (uptr_t) flags, (sptr_t) ft);
+}
+
+
 void sci_set_keywords(ScintillaObject *sci, guint k, const gchar *text)
 {
 	SSM(sci, SCI_SETKEYWORDS, k, (sptr_t) text);
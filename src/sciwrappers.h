@@ -183,8 +183,17 @@ void				sci_assign_cmdkey			(ScintillaObject *sci, gint key, gint command);
 void				sci_selection_duplicate		(ScintillaObject *sci);
 void				sci_line_duplicate			(ScintillaObject *sci);
 
+gint				sci_replace_ranges			(ScintillaObject *sci, const struct Sci_ReplaceRange *ranges, guint count);
+gint				sci_find_multiple			(ScintillaObject *sci, gint flags, struct Sci_TextToFindMultiple *ft);
+
 void				sci_set_keywords			(ScintillaObject *sci, guint k, const gchar *text);
 void				sci_set_lexer				(ScintillaObject *sci, guint lexer_id);
+void				sci_set_background_lexer	(ScintillaObject *sci, guint lexer_id);
+gpointer			sci_create_loader			(gsize bytes, gint options);
+void				sci_set_loaded_document		(ScintillaObject *sci, gpointer loader);
+void				sci_get_text_parts			(ScintillaObject *sci, const gchar **part1, gsize *len1,
+												 const gchar **part2, gsize *len2);
+void				sci_allocate_lines			(ScintillaObject *sci, gsize lines);
 void				sci_set_readonly			(ScintillaObject *sci, gboolean readonly);
 
 gint				sci_get_lines_selected		(ScintillaObject *sci);
@@ -32,11 +32,14 @@
 #include "app.h"
 #include "dialogs.h"
 #include "document.h"
+#include "documentprivate.h"
 #include "encodings.h"
 #include "encodingsprivate.h"
+#include "findinfiles.h"
 #include "keyfile.h"
 #include "msgwindow.h"
 #include "prefs.h"
+#include "projectindex.h"
 #include "sciwrappers.h"
 #include "spawn.h"
 #include "stash.h"
@@ -63,7 +66,8 @@ enum
 	GEANY_RESPONSE_REPLACE_AND_FIND,
 	GEANY_RESPONSE_REPLACE_IN_SESSION,
 	GEANY_RESPONSE_REPLACE_IN_FILE,
-	GEANY_RESPONSE_REPLACE_IN_SEL
+	GEANY_RESPONSE_REPLACE_IN_SEL,
+	GEANY_RESPONSE_REPLACE_IN_FILES
 };
 
 
@@ -112,6 +116,19 @@ static StashGroup *fif_prefs = NULL;
 static StashGroup *find_prefs = NULL;
 static StashGroup *replace_prefs = NULL;
 
+/* recently compiled regexes, most recently used first */
+#define REGEX_CACHE_SIZE 8
+
+typedef struct
+{
+	gchar *pattern;
+	GRegexCompileFlags flags;
+	GRegex *regex;
+}
+CachedRegex;
+
+static GQueue regex_cache = G_QUEUE_INIT;
+
 
 static struct
 {
@@ -140,11 +157,12 @@ static struct
 	GtkWidget	*dir_combo;
 	GtkWidget	*files_combo;
 	GtkWidget	*search_combo;
+	GtkWidget	*replace_combo;
 	GtkWidget	*encoding_combo;
 	GtkWidget	*files_mode_combo;
 	gint		position[2]; /* x, y */
 }
-fif_dlg = {NULL, NULL, NULL, NULL, NULL, NULL, {0, 0}};
+fif_dlg = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, {0, 0}};
 
 
 static void search_read_io(GString *string, GIOCondition condition, gpointer data);
@@ -156,6 +174,10 @@ static gchar **search_get_argv(const gchar **argv_prefix, const gchar *dir);
 
 static GRegex *compile_regex(const gchar *str, GeanyFindFlags sflags);
 
+static void clear_regex_cache(void);
+
+static gint geany_find_flags_to_sci_flags(GeanyFindFlags flags);
+
 
 static void
 on_find_replace_checkbutton_toggled(GtkToggleButton *togglebutton, gpointer user_data);
@@ -185,6 +207,9 @@ static gboolean
 search_find_in_files(const gchar *utf8_search_text, const gchar *dir, const gchar *opts,
 	const gchar *enc);
 
+static gboolean find_in_files_builtin(const gchar *utf8_search_text, const gchar *utf8_dir,
+	const gchar *enc, const gchar *utf8_replace_text);
+
 
 static void init_prefs(void)
 {
@@ -293,6 +318,8 @@ void search_finalize(void)
 	FREE_WIDGET(fif_dlg.dialog);
 	g_free(search_data.text);
 	g_free(search_data.original_text);
+	clear_regex_cache();
+	fif_finalize();
 }
 
 
@@ -867,9 +894,9 @@ static void update_fif_file_mode_combo(void)
 static void create_fif_dialog(void)
 {
 	GtkWidget *dir_combo, *combo, *fcombo, *e_combo, *entry;
-	GtkWidget *label, *label1, *label2, *label3, *checkbox1, *checkbox2, *check_wholeword,
+	GtkWidget *label, *label1, *label2, *label3, *label4, *checkbox1, *checkbox2, *check_wholeword,
 		*check_recursive, *check_extra, *entry_extra, *check_regexp, *combo_files_mode;
-	GtkWidget *dbox, *sbox, *lbox, *rbox, *hbox, *vbox, *ebox;
+	GtkWidget *dbox, *sbox, *lbox, *rbox, *hbox, *vbox, *ebox, *replace_box;
 	GtkSizeGroup *size_group;
 
 	fif_dlg.dialog = gtk_dialog_new_with_buttons(
@@ -879,6 +906,8 @@ static void create_fif_dialog(void)
 	gtk_box_set_spacing(GTK_BOX(vbox), 9);
 	gtk_widget_set_name(fif_dlg.dialog, "GeanyDialogSearch");
 
+	gtk_dialog_add_button(GTK_DIALOG(fif_dlg.dialog), _("Rep_lace"),
+		GEANY_RESPONSE_REPLACE_IN_FILES);
 	gtk_dialog_add_button(GTK_DIALOG(fif_dlg.dialog), GTK_STOCK_FIND, GTK_RESPONSE_ACCEPT);
 	gtk_dialog_set_default_response(GTK_DIALOG(fif_dlg.dialog),
 		GTK_RESPONSE_ACCEPT);
@@ -898,9 +927,26 @@ static void create_fif_dialog(void)
 	gtk_box_pack_start(GTK_BOX(sbox), label, FALSE, FALSE, 0);
 	gtk_box_pack_start(GTK_BOX(sbox), combo, TRUE, TRUE, 0);
 
+	label4 = gtk_label_new_with_mnemonic(_("R_eplace with:"));
+	gtk_misc_set_alignment(GTK_MISC(label4), 0, 0.5);
+
+	combo = gtk_combo_box_text_new_with_entry();
+	entry = gtk_bin_get_child(GTK_BIN(combo));
+	ui_entry_add_clear_icon(GTK_ENTRY(entry));
+	gtk_label_set_mnemonic_widget(GTK_LABEL(label4), entry);
+	gtk_entry_set_width_chars(GTK_ENTRY(entry), 50);
+	gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+	gtk_widget_set_tooltip_text(entry, _("Only used by the Replace button"));
+	fif_dlg.replace_combo = combo;
+
+	replace_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 6);
+	gtk_box_pack_start(GTK_BOX(replace_box), label4, FALSE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(replace_box), combo, TRUE, TRUE, 0);
+
 	/* make labels same width */
 	size_group = gtk_size_group_new(GTK_SIZE_GROUP_HORIZONTAL);
 	gtk_size_group_add_widget(size_group, label);
+	gtk_size_group_add_widget(size_group, label4);
 
 	label3 = gtk_label_new_with_mnemonic(_("File _patterns:"));
 	gtk_misc_set_alignment(GTK_MISC(label3), 0, 0.5);
@@ -963,6 +1009,7 @@ static void create_fif_dialog(void)
 	g_object_unref(G_OBJECT(size_group));	/* auto destroy the size group */
 
 	gtk_box_pack_start(GTK_BOX(vbox), sbox, TRUE, FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), replace_box, TRUE, FALSE, 0);
 	gtk_box_pack_start(GTK_BOX(vbox), hbox, TRUE, FALSE, 0);
 	gtk_box_pack_start(GTK_BOX(vbox), dbox, TRUE, FALSE, 0);
 	gtk_box_pack_start(GTK_BOX(vbox), ebox, TRUE, FALSE, 0);
@@ -970,7 +1017,8 @@ static void create_fif_dialog(void)
 	check_regexp = gtk_check_button_new_with_mnemonic(_("_Use regular expressions"));
 	ui_hookup_widget(fif_dlg.dialog, check_regexp, "check_regexp");
 	gtk_button_set_focus_on_click(GTK_BUTTON(check_regexp), FALSE);
-	gtk_widget_set_tooltip_text(check_regexp, _("See grep's manual page for more information"));
+	gtk_widget_set_tooltip_text(check_regexp, _("Use Perl-like regular expressions. "
+		"For detailed information about using regular expressions, please refer to the manual."));
 
 	check_recursive = gtk_check_button_new_with_mnemonic(_("_Recurse in subfolders"));
 	ui_hookup_widget(fif_dlg.dialog, check_recursive, "check_recursive");
@@ -1230,43 +1278,408 @@ static GSList *find_range(ScintillaObject *sci, GeanyFindFlags flags, struct Sci
 }
 
 
-/* Clears markers if text is null/empty.
- * @return Number of matches marked. */
-gint search_mark_all(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags)
+/* whether find_range_multiple() can be used instead of find_range() for each text.
+ * This is the case for plain text searches which match case or only contain ASCII, as
+ * Scintilla only folds ASCII letters when searching for several texts at once. 'k' and 's'
+ * are excluded too, since Unicode folding also matches them with U+212A KELVIN SIGN and
+ * U+017F LATIN SMALL LETTER LONG S. */
+static gboolean can_find_multiple(const gchar *const *texts, GeanyFindFlags flags)
+{
+	if (flags & (GEANY_FIND_REGEXP | GEANY_FIND_MULTILINE))
+		return FALSE;
+
+	if (! (flags & GEANY_FIND_MATCHCASE))
+	{
+		for (; *texts; texts++)
+		{
+			const gchar *c;
+
+			for (c = *texts; *c; c++)
+			{
+				if ((guchar) *c >= 0x80 || g_ascii_tolower(*c) == 'k' || g_ascii_tolower(*c) == 's')
+					return FALSE;
+			}
+		}
+	}
+	return TRUE;
+}
+
+
+/* size of the parts of the document searched by one SCI_FINDMULTIPLE call, so that a too
+ * small match buffer only requires to search the current part again */
+#define FIND_MULTIPLE_CHUNK (1024 * 1024)
+
+/* find all occurrences of any of texts between start and end in one pass.
+ * Matches don't overlap, at each position the longest text is preferred.
+ * Returns an array of struct Sci_CharacterRange, should be freed with g_array_free(). */
+static GArray *find_range_multiple(ScintillaObject *sci, GeanyFindFlags flags,
+		const gchar *const *texts, gint start, gint end)
+{
+	struct Sci_TextToFindMultiple ft;
+	GArray *matches = g_array_new(FALSE, FALSE, sizeof(struct Sci_CharacterRange));
+	Sci_Position prev_end = -1;
+	gint sci_flags = geany_find_flags_to_sci_flags(flags);
+	gint max_len = 1;
+	gint chunk_start, chunk_end, count, i;
+
+	ft.texts = texts;
+	ft.count = g_strv_length((gchar **) texts);
+	for (i = 0; i < ft.count; i++)
+		max_len = MAX(max_len, (gint) strlen(texts[i]));
+	ft.maxMatches = 256;
+	ft.matches = g_new(Sci_Position, ft.maxMatches * 2);
+
+	for (chunk_start = start; chunk_start < end; chunk_start = chunk_end)
+	{
+		chunk_end = chunk_start + MIN(end - chunk_start, FIND_MULTIPLE_CHUNK);
+		ft.cpMin = chunk_start;
+		/* let matches starting in this chunk end after it */
+		ft.cpMax = MIN(chunk_end + max_len - 1, end);
+
+		count = sci_find_multiple(sci, sci_flags, &ft);
+		if (count > ft.maxMatches)
+		{
+			/* the buffer is kept for the following chunks */
+			ft.maxMatches = count;
+			ft.matches = g_renew(Sci_Position, ft.matches, ft.maxMatches * 2);
+			sci_find_multiple(sci, sci_flags, &ft);
+		}
+
+		for (i = 0; i < count; i++)
+		{
+			struct Sci_CharacterRange range;
+
+			range.cpMin = (Sci_PositionCR) ft.matches[i * 2];
+			range.cpMax = (Sci_PositionCR) ft.matches[i * 2 + 1];
+			/* matches are sorted by start and then by decreasing length, the ones starting
+			 * after the chunk are found with the next one */
+			if (range.cpMin >= chunk_end)
+				break;
+			if (range.cpMin < prev_end)
+				continue;
+
+			g_array_append_val(matches, range);
+			prev_end = range.cpMax;
+		}
+	}
+	g_free(ft.matches);
+
+	return matches;
+}
+
+
+static gint mark_all_multiple(GeanyDocument *doc, gint indic, const gchar *const *texts,
+		GeanyFindFlags flags)
+{
+	GArray *matches = find_range_multiple(doc->editor->sci, flags, texts, 0,
+		sci_get_length(doc->editor->sci));
+	struct Sci_CharacterRange *range;
+	gint count = (gint) matches->len;
+
+	foreach_array(struct Sci_CharacterRange, range, matches)
+		editor_indicator_set_on_range(doc->editor, indic, range->cpMin, range->cpMax);
+
+	g_array_free(matches, TRUE);
+	return count;
+}
+
+
+/**
+ * Marks all occurrences of any of @a texts in @a doc with the indicator @a indic in a single
+ * pass over the document, e.g. to highlight a set of identifiers.
+ * Previous @a indic indicators are cleared first. Regular expressions are not supported.
+ *
+ * @param doc The document.
+ * @param indic The indicator number to use, this is a value of @ref GeanyIndicator.
+ * @param texts @nullable @array{zero-terminated=1} The texts to mark.
+ * @param flags The search flags, without @c GEANY_FIND_REGEXP or @c GEANY_FIND_MULTILINE.
+ * @return The number of matches marked.
+ *
+ * @since 1.39 (API 247)
+ */
+GEANY_API_SYMBOL
+gint search_mark_all_multiple(GeanyDocument *doc, gint indic, const gchar *const *texts,
+		GeanyFindFlags flags)
 {
 	gint count = 0;
-	struct Sci_TextToFind ttf;
-	GSList *match, *matches;
 
 	g_return_val_if_fail(DOC_VALID(doc), 0);
+	g_return_val_if_fail(! (flags & (GEANY_FIND_REGEXP | GEANY_FIND_MULTILINE)), 0);
 
-	/* clear previous search indicators */
-	editor_indicator_clear(doc->editor, GEANY_INDICATOR_SEARCH);
+	editor_indicator_clear(doc->editor, indic);
 
-	if (G_UNLIKELY(EMPTY(search_text)))
+	if (texts == NULL || *texts == NULL)
 		return 0;
 
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
-	ttf.lpstrText = (gchar *)search_text;
+	if (can_find_multiple(texts, flags))
+		return mark_all_multiple(doc, indic, texts, flags);
 
-	matches = find_range(doc->editor->sci, flags, &ttf);
-	foreach_slist (match, matches)
+	/* non-ASCII case insensitive search, use Scintilla's case folding for each text */
+	for (; *texts; texts++)
 	{
-		GeanyMatchInfo *info = match->data;
+		struct Sci_TextToFind ttf;
+		GSList *match, *matches;
 
-		if (info->end != info->start)
-			editor_indicator_set_on_range(doc->editor, GEANY_INDICATOR_SEARCH, info->start, info->end);
-		count++;
+		ttf.chrg.cpMin = 0;
+		ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
+		ttf.lpstrText = (gchar *) *texts;
 
-		geany_match_info_free(info);
+		matches = find_range(doc->editor->sci, flags, &ttf);
+		foreach_slist (match, matches)
+		{
+			GeanyMatchInfo *info = match->data;
+
+			editor_indicator_set_on_range(doc->editor, indic, info->start, info->end);
+			count++;
+			geany_match_info_free(info);
+		}
+		g_slist_free(matches);
 	}
-	g_slist_free(matches);
+	return count;
+}
+
+
+/* Finds the matches of text between start and end, which should be line starts, and marks
+ * them with the search indicator if mark is set.
+ * Returns: the number of matches. */
+static gint mark_range(GeanyDocument *doc, const gchar *text, GeanyFindFlags flags,
+		gint start, gint end, gboolean mark)
+{
+	ScintillaObject *sci = doc->editor->sci;
+	const gchar *texts[2] = { text, NULL };
+	gint count = 0;
+
+	if (can_find_multiple(texts, flags))
+	{
+		GArray *matches = find_range_multiple(sci, flags, texts, start, end);
+		struct Sci_CharacterRange *range;
 
+		count = (gint) matches->len;
+		if (mark)
+		{
+			foreach_array(struct Sci_CharacterRange, range, matches)
+				editor_indicator_set_on_range(doc->editor, GEANY_INDICATOR_SEARCH,
+					range->cpMin, range->cpMax);
+		}
+		g_array_free(matches, TRUE);
+	}
+	else
+	{
+		struct Sci_TextToFind ttf;
+		GSList *match, *matches;
+
+		ttf.chrg.cpMin = start;
+		ttf.chrg.cpMax = end;
+		ttf.lpstrText = (gchar *) text;
+
+		matches = find_range(sci, flags, &ttf);
+		foreach_slist (match, matches)
+		{
+			GeanyMatchInfo *info = match->data;
+
+			if (mark && info->end != info->start)
+				editor_indicator_set_on_range(doc->editor, GEANY_INDICATOR_SEARCH,
+					info->start, info->end);
+			count++;
+
+			geany_match_info_free(info);
+		}
+		g_slist_free(matches);
+	}
 	return count;
 }
 
 
+/* Lazy mark all, for documents of at least search_prefs.lazy_mark_all_size MiB: only the
+ * lines around the visible ones are marked, and the marked span grows while scrolling.
+ * The matches of the whole document are counted in idle chunks. */
+
+#define LAZY_MARK_ALL_KEY "search-lazy-mark-all"
+/* lines marked above and below the visible lines, in screens */
+#define LAZY_MARK_ALL_MARGIN 2
+/* bytes counted per idle call */
+#define LAZY_MARK_ALL_CHUNK (1024 * 1024)
+/* the marks outside of the visible lines are dropped once more matches are marked */
+#define LAZY_MARK_ALL_MAX_MARKS 10000
+
+typedef struct LazyMarkAll
+{
+	GeanyDocument	*doc;
+	gchar			*text;
+	GeanyFindFlags	 flags;
+	guint			 text_version;	/* of the document when it was marked */
+	gint			 start;			/* marked span */
+	gint			 end;
+	gint			 n_marked;
+	gint			 count;
+	gint			 count_pos;		/* where counting continues */
+	guint			 count_source;
+	gboolean		 report_count;	/* whether to show the count once known */
+}
+LazyMarkAll;
+
+
+static void lazy_mark_all_free(gpointer data)
+{
+	LazyMarkAll *lazy = data;
+
+	if (lazy->count_source != 0)
+		g_source_remove(lazy->count_source);
+	g_free(lazy->text);
+	g_free(lazy);
+}
+
+
+static gboolean lazy_mark_all_count(gpointer data)
+{
+	LazyMarkAll *lazy = data;
+	ScintillaObject *sci = lazy->doc->editor->sci;
+	gint len = sci_get_length(sci);
+	gint end = MIN(lazy->count_pos + LAZY_MARK_ALL_CHUNK, len);
+
+	/* end chunks at line starts so that no match is split */
+	if (end < len)
+		end = sci_get_position_from_line(sci, sci_get_line_from_position(sci, end) + 1);
+
+	lazy->count += mark_range(lazy->doc, lazy->text, lazy->flags, lazy->count_pos, end, FALSE);
+	lazy->count_pos = end;
+	if (end < len)
+		return TRUE;
+
+	lazy->count_source = 0;
+	if (lazy->report_count && lazy->doc == document_get_current())
+	{
+		if (lazy->count == 0)
+			ui_set_statusbar(FALSE, _("No matches found for \"%s\"."), lazy->text);
+		else
+			ui_set_statusbar(FALSE,
+				ngettext("Found %d match for \"%s\".",
+						 "Found %d matches for \"%s\".", lazy->count),
+				lazy->count, lazy->text);
+	}
+	lazy->report_count = FALSE;
+	return FALSE;
+}
+
+
+/* Gets the span of whole lines to mark around the visible lines */
+static void lazy_mark_all_get_window(ScintillaObject *sci, gint *start, gint *end)
+{
+	gint first = sci_get_first_visible_line(sci);
+	gint los = (gint) SSM(sci, SCI_LINESONSCREEN, 0, 0);
+	gint margin = los * LAZY_MARK_ALL_MARGIN;
+	gint first_line = (gint) SSM(sci, SCI_DOCLINEFROMVISIBLE, MAX(first - margin, 0), 0);
+	gint last_line = (gint) SSM(sci, SCI_DOCLINEFROMVISIBLE, first + los + margin, 0);
+
+	*start = sci_get_position_from_line(sci, first_line);
+	*end = sci_get_position_from_line(sci, MIN(last_line + 1, sci_get_line_count(sci)));
+}
+
+
+/* Marks only the given span, dropping all other marks */
+static void lazy_mark_all_reset(LazyMarkAll *lazy, gint start, gint end)
+{
+	editor_indicator_clear(lazy->doc->editor, GEANY_INDICATOR_SEARCH);
+	lazy->start = start;
+	lazy->end = end;
+	lazy->n_marked = mark_range(lazy->doc, lazy->text, lazy->flags, start, end, TRUE);
+}
+
+
+static void lazy_mark_all_restart_count(LazyMarkAll *lazy)
+{
+	lazy->count = 0;
+	lazy->count_pos = 0;
+	if (lazy->count_source == 0)
+		lazy->count_source = g_idle_add_full(G_PRIORITY_LOW, lazy_mark_all_count, lazy, NULL);
+}
+
+
+/* Updates the lazy mark all of doc, if any, after scrolling or text changes */
+void search_mark_all_update(GeanyDocument *doc)
+{
+	LazyMarkAll *lazy = document_get_data(doc, LAZY_MARK_ALL_KEY);
+	gint start, end;
+
+	if (lazy == NULL)
+		return;
+
+	lazy_mark_all_get_window(doc->editor->sci, &start, &end);
+
+	/* the marked span is stale once the text has changed */
+	if (lazy->text_version != doc->priv->text_version)
+	{
+		lazy->text_version = doc->priv->text_version;
+		lazy_mark_all_reset(lazy, start, end);
+		lazy_mark_all_restart_count(lazy);
+	}
+	else if (start > lazy->end || end < lazy->start || lazy->n_marked > LAZY_MARK_ALL_MAX_MARKS)
+		lazy_mark_all_reset(lazy, start, end);
+	else
+	{
+		if (start < lazy->start)
+		{
+			lazy->n_marked += mark_range(doc, lazy->text, lazy->flags, start, lazy->start, TRUE);
+			lazy->start = start;
+		}
+		if (end > lazy->end)
+		{
+			lazy->n_marked += mark_range(doc, lazy->text, lazy->flags, lazy->end, end, TRUE);
+			lazy->end = end;
+		}
+	}
+}
+
+
+static void lazy_mark_all_start(GeanyDocument *doc, const gchar *search_text,
+		GeanyFindFlags flags)
+{
+	LazyMarkAll *lazy = g_new0(LazyMarkAll, 1);
+	gint start, end;
+
+	lazy->doc = doc;
+	lazy->text = g_strdup(search_text);
+	lazy->flags = flags;
+	lazy->text_version = doc->priv->text_version;
+	lazy->report_count = TRUE;
+	document_set_data_full(doc, LAZY_MARK_ALL_KEY, lazy, lazy_mark_all_free);
+
+	lazy_mark_all_get_window(doc->editor->sci, &start, &end);
+	lazy_mark_all_reset(lazy, start, end);
+	lazy_mark_all_restart_count(lazy);
+}
+
+
+/* Clears markers if text is null/empty.
+ * Large documents are marked lazily, see search_mark_all_update().
+ * @return Number of matches marked, or -1 if they are counted in the background, in which
+ * case the count is shown in the statusbar once known. */
+gint search_mark_all(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags)
+{
+	gint len;
+
+	g_return_val_if_fail(DOC_VALID(doc), 0);
+
+	/* clear previous search indicators */
+	document_set_data(doc, LAZY_MARK_ALL_KEY, NULL);
+	editor_indicator_clear(doc->editor, GEANY_INDICATOR_SEARCH);
+
+	if (G_UNLIKELY(EMPTY(search_text)))
+		return 0;
+
+	/* matches of multiline regexes could span the edges of the marked lines */
+	len = sci_get_length(doc->editor->sci);
+	if (search_prefs.lazy_mark_all_size > 0 && ! (flags & GEANY_FIND_MULTILINE) &&
+		len / (1024 * 1024) >= search_prefs.lazy_mark_all_size)
+	{
+		lazy_mark_all_start(doc, search_text, flags);
+		return -1;
+	}
+
+	return mark_range(doc, search_text, flags, 0, len, TRUE);
+}
+
+
 static void
 on_find_entry_activate(GtkEntry *entry, gpointer user_data)
 {
@@ -1372,7 +1785,7 @@ on_find_dialog_response(GtkDialog *dialog, gint response, gpointer user_data)
 
 				if (count == 0)
 					ui_set_statusbar(FALSE, _("No matches found for \"%s\"."), search_data.original_text);
-				else
+				else if (count > 0)
 					ui_set_statusbar(FALSE,
 						ngettext("Found %d match for \"%s\".",
 								 "Found %d matches for \"%s\".", count),
@@ -1646,11 +2059,279 @@ on_find_in_files_dialog_response(GtkDialog *dialog, gint response,
 		else
 			ui_set_statusbar(FALSE, _("No text to find."));
 	}
+	else if (response == GEANY_RESPONSE_REPLACE_IN_FILES)
+	{
+		GtkWidget *search_combo = fif_dlg.search_combo;
+		const gchar *search_text =
+			gtk_entry_get_text(GTK_ENTRY(gtk_bin_get_child(GTK_BIN(search_combo))));
+		GtkWidget *replace_combo = fif_dlg.replace_combo;
+		const gchar *replace_text =
+			gtk_entry_get_text(GTK_ENTRY(gtk_bin_get_child(GTK_BIN(replace_combo))));
+		GtkWidget *dir_combo = fif_dlg.dir_combo;
+		const gchar *utf8_dir =
+			gtk_entry_get_text(GTK_ENTRY(gtk_bin_get_child(GTK_BIN(dir_combo))));
+		GeanyEncodingIndex enc_idx =
+			ui_encodings_combo_box_get_active_encoding(GTK_COMBO_BOX(fif_dlg.encoding_combo));
+		const gchar *enc = (enc_idx == GEANY_ENCODING_UTF_8) ? NULL :
+			encodings_get_charset_from_index(enc_idx);
+
+		if (G_UNLIKELY(EMPTY(utf8_dir)))
+			ui_set_statusbar(FALSE, _("Invalid directory for find in files."));
+		else if (EMPTY(search_text))
+			ui_set_statusbar(FALSE, _("No text to find."));
+		else if (settings.fif_use_extra_options || settings.fif_invert_results)
+			ui_set_statusbar(FALSE,
+				_("Replacing can not be used with extra options or inverted search results."));
+		else if (find_in_files_builtin(search_text, utf8_dir, enc, replace_text))
+		{
+			ui_combo_box_add_to_history(GTK_COMBO_BOX_TEXT(search_combo), search_text, 0);
+			ui_combo_box_add_to_history(GTK_COMBO_BOX_TEXT(replace_combo), replace_text, 0);
+			ui_combo_box_add_to_history(GTK_COMBO_BOX_TEXT(fif_dlg.files_combo), NULL, 0);
+			ui_combo_box_add_to_history(GTK_COMBO_BOX_TEXT(dir_combo), utf8_dir, 0);
+			gtk_widget_hide(fif_dlg.dialog);
+		}
+	}
 	else
 		gtk_widget_hide(fif_dlg.dialog);
 }
 
 
+/* Reports the end of a search, count is the number of matches or -1 if the search failed */
+static void find_in_files_finished(gint count)
+{
+	if (count > 0)
+	{
+		gchar *text = ngettext(
+					"Search completed with %d match.",
+					"Search completed with %d matches.", count);
+
+		msgwin_msg_add(COLOR_BLUE, -1, NULL, text, count);
+		ui_set_statusbar(FALSE, text, count);
+	}
+	else
+	{
+		const gchar *msg = (count == 0) ? _("No matches found.") : _("Search failed.");
+
+		msgwin_msg_add_string(COLOR_BLUE, -1, NULL, msg);
+		ui_set_statusbar(FALSE, "%s", msg);
+	}
+	utils_beep();
+	ui_progress_bar_stop();
+}
+
+
+static void on_fif_results(GPtrArray *lines, G_GNUC_UNUSED gpointer user_data)
+{
+	guint i;
+
+	for (i = 0; i < lines->len; i++)
+		msgwin_msg_queue_string(COLOR_BLACK, -1, NULL, lines->pdata[i]);
+}
+
+
+static void on_fif_done(guint n_matches, G_GNUC_UNUSED gpointer user_data)
+{
+	find_in_files_finished((gint) n_matches);
+}
+
+
+/* Applies the edits of an open document as one undo action, if it still has the text which
+ * was searched */
+static gboolean replace_in_document(const gchar *locale_filename, GBytes *buffer,
+		const FifEdit *edits, guint n_edits, G_GNUC_UNUSED gpointer user_data)
+{
+	GeanyDocument *doc = document_find_by_real_path(locale_filename);
+	struct Sci_ReplaceRange *ranges;
+	gsize len;
+	const gchar *data = g_bytes_get_data(buffer, &len);
+	gboolean replaced;
+	guint i;
+
+	if (doc == NULL || (gsize) sci_get_length(doc->editor->sci) != len ||
+		memcmp(data, (const gchar *) SSM(doc->editor->sci, SCI_GETCHARACTERPOINTER, 0, 0), len) != 0)
+	{
+		gchar *utf8_filename = utils_get_utf8_from_locale(locale_filename);
+
+		msgwin_msg_add(COLOR_RED, -1, NULL,
+			_("%s: The document has been closed or changed since it was searched."),
+			utf8_filename);
+		g_free(utf8_filename);
+		return FALSE;
+	}
+
+	ranges = g_new(struct Sci_ReplaceRange, n_edits);
+	for (i = 0; i < n_edits; i++)
+	{
+		ranges[i].cpMin = (Sci_Position) edits[i].start;
+		ranges[i].cpMax = (Sci_Position) edits[i].end;
+		ranges[i].text = edits[i].text;
+		ranges[i].length = (Sci_Position) strlen(edits[i].text);
+	}
+	replaced = sci_replace_ranges(doc->editor->sci, ranges, n_edits) >= 0;
+	g_free(ranges);
+
+	if (! replaced)
+	{
+		msgwin_msg_add(COLOR_RED, -1, doc, _("%s: The document could not be changed."),
+			DOC_FILENAME(doc));
+	}
+	return replaced;
+}
+
+
+static void on_fif_replace_applied(guint n_changed, GPtrArray *errors,
+		G_GNUC_UNUSED gpointer user_data)
+{
+	gchar *text;
+	guint i;
+
+	for (i = 0; i < errors->len; i++)
+		msgwin_msg_add_string(COLOR_RED, -1, NULL, errors->pdata[i]);
+
+	text = g_strdup_printf(ngettext("Replaced in %u file.", "Replaced in %u files.", n_changed),
+		n_changed);
+	msgwin_msg_add_string(COLOR_BLUE, -1, NULL, text);
+	ui_set_statusbar(FALSE, "%s", text);
+	g_free(text);
+	utils_beep();
+	ui_progress_bar_stop();
+}
+
+
+/* The results are a preview of the replacement, which is only applied once confirmed */
+static void on_fif_replace_done(guint n_matches, gpointer user_data)
+{
+	FifReplace *replace = user_data;
+	guint n_files;
+	gchar *text;
+
+	if (n_matches == 0)
+	{
+		find_in_files_finished(0);
+		return;
+	}
+
+	n_files = fif_replace_get_n_files(replace);
+	text = g_strdup_printf(ngettext("Found %u match to replace", "Found %u matches to replace",
+		n_matches), n_matches);
+	SETPTR(text, g_strdup_printf(ngettext("%s in %u file.", "%s in %u files.", n_files),
+		text, n_files));
+	msgwin_msg_add_string(COLOR_BLUE, -1, NULL, text);
+	ui_set_statusbar(FALSE, "%s", text);
+	ui_progress_bar_stop();
+
+	if (dialogs_show_question("%s\n%s", text, _("Do you want to replace them?")))
+	{
+		ui_progress_bar_start(_("Replacing..."));
+		fif_replace_apply(replace, replace_in_document, on_fif_replace_applied, NULL);
+	}
+	g_free(text);
+}
+
+
+/* Searches with the built-in engine, which also sees the unsaved changes of documents.
+ * If utf8_replace_text is set, the matches are replaced after a preview. */
+static gboolean find_in_files_builtin(const gchar *utf8_search_text, const gchar *utf8_dir,
+	const gchar *enc, const gchar *utf8_replace_text)
+{
+	FifQuery query;
+	FifSearch *search;
+	FifReplace *replace = NULL;
+	GError *error = NULL;
+	gchar *dir, *utf8_str;
+	guint i;
+
+	dir = utils_get_locale_from_utf8(utf8_dir);
+	if (! g_file_test(dir, G_FILE_TEST_IS_DIR))
+	{
+		ui_set_statusbar(FALSE, _("Invalid directory for find in files."));
+		g_free(dir);
+		return FALSE;
+	}
+
+	memset(&query, 0, sizeof query);
+	query.text = utf8_search_text;
+	query.enc = enc;
+	if (settings.fif_files_mode != FILES_MODE_ALL)
+		query.patterns = settings.fif_files;
+	query.regexp = settings.fif_regexp;
+	query.case_sensitive = settings.fif_case_sensitive;
+	query.whole_word = settings.fif_match_whole_word;
+	query.invert = settings.fif_invert_results;
+	query.recursive = settings.fif_recursive;
+
+	if (utf8_replace_text != NULL)
+	{
+		replace = fif_replace_new(&query, utf8_replace_text, &error);
+		if (replace == NULL)
+		{
+			ui_set_statusbar(FALSE, _("Bad replacement: %s"), error->message);
+			g_error_free(error);
+			g_free(dir);
+			return FALSE;
+		}
+	}
+
+	search = fif_search_new(&query, &error);
+	if (search == NULL)
+	{
+		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
+		g_error_free(error);
+		fif_replace_unref(replace);
+		g_free(dir);
+		return FALSE;
+	}
+
+	/* documents without unsaved changes are the same as their files, but open documents
+	 * are replaced in the editor to be able to undo it */
+	foreach_document(i)
+	{
+		GeanyDocument *doc = documents[i];
+
+		if ((doc->changed || replace != NULL) && doc->real_path != NULL)
+			fif_search_add_buffer(search, doc->real_path, sci_get_contents(doc->editor->sci, -1),
+				sci_get_length(doc->editor->sci));
+	}
+
+	/* the project index only knows the plain text of files in UTF-8 */
+	if (! query.regexp && ! query.invert && enc == NULL)
+	{
+		ProjectIndexQuery *index_query = project_index_query_new(utf8_search_text,
+			query.case_sensitive);
+
+		if (index_query != NULL)
+			fif_search_set_file_filter(search, project_index_query_match, index_query,
+				project_index_query_free);
+	}
+
+	if (replace != NULL)
+		fif_search_set_replace(search, replace);
+
+	if (fif_search_cancel())
+		ui_progress_bar_stop();
+	msgwin_clear_tab(MSG_MESSAGE);
+	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
+
+	ui_progress_bar_start(_("Searching..."));
+	msgwin_set_messages_dir(dir);
+	if (replace != NULL)
+		utf8_str = g_strdup_printf(_("Replace %s with %s (in directory: %s)"), utf8_search_text,
+			utf8_replace_text, utf8_dir);
+	else
+		utf8_str = g_strdup_printf(_("%s (in directory: %s)"), utf8_search_text, utf8_dir);
+	msgwin_msg_add_string(COLOR_BLUE, -1, NULL, utf8_str);
+	g_free(utf8_str);
+
+	/* the search owns replace, which stays alive until its done function has returned */
+	if (replace != NULL)
+		fif_search_start(search, dir, on_fif_results, on_fif_replace_done, replace);
+	else
+		fif_search_start(search, dir, on_fif_results, on_fif_done, NULL);
+	g_free(dir);
+	return TRUE;
+}
+
+
 static gboolean
 search_find_in_files(const gchar *utf8_search_text, const gchar *utf8_dir, const gchar *opts,
 	const gchar *enc)
@@ -1665,6 +2346,13 @@ search_find_in_files(const gchar *utf8_search_text, const gchar *utf8_dir, const
 
 	if (EMPTY(utf8_search_text) || ! utf8_dir) return TRUE;
 
+	/* the grep tool is only needed for extra options */
+	if (! settings.fif_use_extra_options || EMPTY(settings.fif_extra_options))
+		return find_in_files_builtin(utf8_search_text, utf8_dir, enc, NULL);
+
+	if (fif_search_cancel())
+		ui_progress_bar_stop();
+
 	command_grep = g_find_program_in_path(tool_prefs.grep_cmd);
 	if (command_grep == NULL)
 		command_line = g_strdup_printf("%s %s --", tool_prefs.grep_cmd, opts);
@@ -1709,13 +2397,13 @@ search_find_in_files(const gchar *utf8_search_text, const gchar *utf8_dir, const
 		}
 	}
 
-	gtk_list_store_clear(msgwindow.store_msg);
+	msgwin_clear_tab(MSG_MESSAGE);
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
 
 	/* we can pass 'enc' without strdup'ing it here because it's a global const string and
 	 * always exits longer than the lifetime of this function */
-	if (spawn_with_callbacks(dir, command_line, argv, NULL, 0, NULL, NULL, search_read_io,
-		(gpointer) enc, 0, search_read_io_stderr, (gpointer) enc, 0, search_finished, NULL,
+	if (spawn_with_callbacks(dir, command_line, argv, NULL, SPAWN_LINE_BATCHED, NULL, NULL,
+		search_read_io, (gpointer) enc, 0, search_read_io_stderr, (gpointer) enc, 0, search_finished, NULL,
 		NULL, &error))
  	{
 		gchar *utf8_str;
@@ -1846,21 +2534,35 @@ static void read_fif_io(gchar *msg, GIOCondition condition, gchar *enc, gint msg
 }
 
 
+static void read_fif_lines(GString *string, GIOCondition condition, gchar *enc, gint msg_color)
+{
+	gchar *line = string->str;
+	gchar *end;
+
+	/* the lines are batched, each ending with '\n' */
+	while ((end = strchr(line, '\n')) != NULL)
+	{
+		*end = '\0';
+		read_fif_io(line, condition, enc, msg_color);
+		line = end + 1;
+	}
+}
+
+
 static void search_read_io(GString *string, GIOCondition condition, gpointer data)
 {
-	read_fif_io(string->str, condition, data, COLOR_BLACK);
+	read_fif_lines(string, condition, data, COLOR_BLACK);
 }
 
 
 static void search_read_io_stderr(GString *string, GIOCondition condition, gpointer data)
 {
-	read_fif_io(string->str, condition, data, COLOR_DARK_RED);
+	read_fif_lines(string, condition, data, COLOR_DARK_RED);
 }
 
 
 static void search_finished(GPid child_pid, gint status, gpointer user_data)
 {
-	const gchar *msg = _("Search failed.");
 	gint exit_status;
 
 	if (SPAWN_WIFEXITED(status))
@@ -1880,35 +2582,79 @@ static void search_finished(GPid child_pid, gint status, gpointer user_data)
 	switch (exit_status)
 	{
 		case 0:
-		{
-			gint count = gtk_tree_model_iter_n_children(
-				GTK_TREE_MODEL(msgwindow.store_msg), NULL) - 1;
-			gchar *text = ngettext(
-						"Search completed with %d match.",
-						"Search completed with %d matches.", count);
-
-			msgwin_msg_add(COLOR_BLUE, -1, NULL, text, count);
-			ui_set_statusbar(FALSE, text, count);
+			find_in_files_finished((gint) msgwin_get_n_rows(MSG_MESSAGE) - 1);
 			break;
-		}
 		case 1:
-			msg = _("No matches found.");
-			/* fall through */
+			find_in_files_finished(0);
+			break;
 		default:
-			msgwin_msg_add_string(COLOR_BLUE, -1, NULL, msg);
-			ui_set_statusbar(FALSE, "%s", msg);
+			find_in_files_finished(-1);
 			break;
 	}
-	utils_beep();
-	ui_progress_bar_stop();
 }
 
 
+static void cached_regex_free(CachedRegex *cached)
+{
+	g_free(cached->pattern);
+	g_regex_unref(cached->regex);
+	g_slice_free(CachedRegex, cached);
+}
+
+
+static void clear_regex_cache(void)
+{
+	CachedRegex *cached;
+
+	while ((cached = g_queue_pop_head(&regex_cache)) != NULL)
+		cached_regex_free(cached);
+}
+
+
+/* returns a new reference to a regex compiled earlier with the same pattern and flags */
+static GRegex *lookup_regex_cache(const gchar *str, GRegexCompileFlags rflags)
+{
+	GList *node;
+
+	foreach_list(node, regex_cache.head)
+	{
+		CachedRegex *cached = node->data;
+
+		if (cached->flags == rflags && strcmp(cached->pattern, str) == 0)
+		{
+			/* move to front so the least recently used regex is dropped first */
+			g_queue_unlink(&regex_cache, node);
+			g_queue_push_head_link(&regex_cache, node);
+			return g_regex_ref(cached->regex);
+		}
+	}
+	return NULL;
+}
+
+
+static void add_regex_cache(const gchar *str, GRegexCompileFlags rflags, GRegex *regex)
+{
+	CachedRegex *cached = g_slice_new(CachedRegex);
+
+	cached->pattern = g_strdup(str);
+	cached->flags = rflags;
+	cached->regex = g_regex_ref(regex);
+	g_queue_push_head(&regex_cache, cached);
+
+	if (g_queue_get_length(&regex_cache) > REGEX_CACHE_SIZE)
+		cached_regex_free(g_queue_pop_tail(&regex_cache));
+}
+
+
+/* Regexes are cached, so searching repeatedly for the same pattern (Find Next,
+ * Mark All, Replace All) only compiles it once. As they are reused, they are compiled
+ * with G_REGEX_OPTIMIZE which lets PCRE use its JIT compiler where available.
+ * The returned regex should be freed with g_regex_unref(). */
 static GRegex *compile_regex(const gchar *str, GeanyFindFlags sflags)
 {
 	GRegex *regex;
 	GError *error = NULL;
-	gint rflags = 0;
+	GRegexCompileFlags rflags = G_REGEX_OPTIMIZE;
 
 	if (sflags & GEANY_FIND_MULTILINE)
 		rflags |= G_REGEX_MULTILINE;
@@ -1919,22 +2665,31 @@ static GRegex *compile_regex(const gchar *str, GeanyFindFlags sflags)
 		geany_debug("%s: Unsupported regex flags found!", G_STRFUNC);
 	}
 
+	regex = lookup_regex_cache(str, rflags);
+	if (regex)
+		return regex;
+
 	regex = g_regex_new(str, rflags, 0, &error);
 	if (!regex)
 	{
 		ui_set_statusbar(FALSE, _("Bad regex: %s"), error->message);
 		g_error_free(error);
 	}
+	else
+		add_regex_cache(str, rflags, regex);
 	return regex;
 }
 
 
-/* groups that don't exist are handled OK as len = end - start = (-1) - (-1) = 0 */
-static gchar *get_regex_match_string(const gchar *text, const GeanyMatchInfo *match, guint nth)
+/* appends the text matched by group nth, groups that don't exist are skipped */
+static void append_regex_match_string(GString *str, const GeanyMatchInfo *match, guint nth)
 {
 	const gint start = match->matches[nth].start;
 	const gint end = match->matches[nth].end;
-	return g_strndup(&text[start], end - start);
+
+	/* fix match offsets by subtracting index of whole match start from the string */
+	if (start >= 0 && end > start)
+		g_string_append_len(str, match->match_text + (start - match->matches[0].start), end - start);
 }
 
 
@@ -1954,9 +2709,11 @@ static gint find_regex(ScintillaObject *sci, guint pos, GRegex *regex, gboolean
 
 	if (multiline)
 	{
-		/* Warning: any SCI calls will invalidate 'text' after calling SCI_GETCHARACTERPOINTER */
-		text = (void*)SSM(sci, SCI_GETCHARACTERPOINTER, 0, 0);
-		g_regex_match_full(regex, text, -1, pos, 0, &minfo, NULL);
+		/* The subject has to be the whole document for lookbehind assertions and \A to see
+		 * the text before pos.
+		 * Warning: any SCI calls will invalidate 'text' after calling SCI_GETRANGEPOINTER */
+		text = (void*)SSM(sci, SCI_GETRANGEPOINTER, 0, document_length);
+		g_regex_match_full(regex, text, document_length, pos, 0, &minfo, NULL);
 	}
 	else /* single-line mode, manually match against each line */
 	{
@@ -2073,46 +2830,50 @@ gint search_find_next(ScintillaObject *sci, const gchar *str, GeanyFindFlags fla
 }
 
 
-gint search_replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text)
+/* appends replace_text to str, expanding \1 style group references for regex matches */
+static void append_replacement(GString *str, const GeanyMatchInfo *match, const gchar *replace_text)
 {
-	GString *str;
-	gint ret = 0;
-	gint i = 0;
-
-	sci_set_target_start(sci, match->start);
-	sci_set_target_end(sci, match->end);
+	const gchar *ptr;
 
 	if (! (match->flags & GEANY_FIND_REGEXP))
-		return sci_replace_target(sci, replace_text, FALSE);
-
-	str = g_string_new(replace_text);
-	while (str->str[i])
 	{
-		gchar *ptr = &str->str[i];
-		gchar *grp;
-		gchar c;
+		g_string_append(str, replace_text);
+		return;
+	}
 
+	for (ptr = replace_text; *ptr; ptr++)
+	{
 		if (ptr[0] != '\\')
+			g_string_append_c(str, ptr[0]);
+		else if (g_ascii_isdigit(ptr[1]))
 		{
-			i++;
-			continue;
+			/* digit escape */
+			append_regex_match_string(str, match, ptr[1] - '0');
+			ptr++;
 		}
-		c = ptr[1];
-		/* backslash or unnecessary escape */
-		if (c == '\\' || !isdigit(c))
+		else if (ptr[1])
 		{
-			g_string_erase(str, i, 1);
-			i++;
-			continue;
+			/* backslash or unnecessary escape */
+			g_string_append_c(str, ptr[1]);
+			ptr++;
 		}
-		/* digit escape */
-		g_string_erase(str, i, 2);
-		/* fix match offsets by subtracting index of whole match start from the string */
-		grp = get_regex_match_string(match->match_text - match->matches[0].start, match, c - '0');
-		g_string_insert(str, i, grp);
-		i += strlen(grp);
-		g_free(grp);
 	}
+}
+
+
+gint search_replace_match(ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text)
+{
+	GString *str;
+	gint ret;
+
+	sci_set_target_start(sci, match->start);
+	sci_set_target_end(sci, match->end);
+
+	if (! (match->flags & GEANY_FIND_REGEXP))
+		return sci_replace_target(sci, replace_text, FALSE);
+
+	str = g_string_new(NULL);
+	append_replacement(str, match, replace_text);
 	ret = sci_replace_target(sci, str->str, FALSE);
 	g_string_free(str, TRUE);
 	return ret;
@@ -2158,41 +2919,68 @@ gint search_find_text(ScintillaObject *sci, GeanyFindFlags flags, struct Sci_Tex
 }
 
 
+/* adds the line containing pos to the messages window unless it was the previous line */
+static void add_document_usage(GeanyDocument *doc, const gchar *short_file_name, gint pos,
+		gint *prev_line)
+{
+	gint line = sci_get_line_from_position(doc->editor->sci, pos);
+
+	if (line != *prev_line)
+	{
+		gchar *buffer = sci_get_line(doc->editor->sci, line);
+		gchar *text = g_strdup_printf("%s:%d: %s", short_file_name, line + 1, g_strstrip(buffer));
+
+		msgwin_msg_queue_string(COLOR_BLACK, line + 1, doc, text);
+		g_free(text);
+		g_free(buffer);
+		*prev_line = line;
+	}
+}
+
+
 static gint find_document_usage(GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags)
 {
-	gchar *buffer, *short_file_name;
-	struct Sci_TextToFind ttf;
+	gchar *short_file_name;
+	const gchar *texts[2] = { search_text, NULL };
 	gint count = 0;
 	gint prev_line = -1;
-	GSList *match, *matches;
 
 	g_return_val_if_fail(DOC_VALID(doc), 0);
 
 	short_file_name = g_path_get_basename(DOC_FILENAME(doc));
 
-	ttf.chrg.cpMin = 0;
-	ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
-	ttf.lpstrText = (gchar *)search_text;
+	if (can_find_multiple(texts, flags))
+	{
+		GArray *matches = find_range_multiple(doc->editor->sci, flags, texts, 0,
+			sci_get_length(doc->editor->sci));
+		struct Sci_CharacterRange *range;
 
-	matches = find_range(doc->editor->sci, flags, &ttf);
-	foreach_slist (match, matches)
+		foreach_array(struct Sci_CharacterRange, range, matches)
+			add_document_usage(doc, short_file_name, range->cpMin, &prev_line);
+		count = (gint) matches->len;
+		g_array_free(matches, TRUE);
+	}
+	else
 	{
-		GeanyMatchInfo *info = match->data;
-		gint line = sci_get_line_from_position(doc->editor->sci, info->start);
+		struct Sci_TextToFind ttf;
+		GSList *match, *matches;
+
+		ttf.chrg.cpMin = 0;
+		ttf.chrg.cpMax = sci_get_length(doc->editor->sci);
+		ttf.lpstrText = (gchar *)search_text;
 
-		if (line != prev_line)
+		matches = find_range(doc->editor->sci, flags, &ttf);
+		foreach_slist (match, matches)
 		{
-			buffer = sci_get_line(doc->editor->sci, line);
-			msgwin_msg_add(COLOR_BLACK, line + 1, doc,
-				"%s:%d: %s", short_file_name, line + 1, g_strstrip(buffer));
-			g_free(buffer);
-			prev_line = line;
-		}
-		count++;
+			GeanyMatchInfo *info = match->data;
 
-		geany_match_info_free(info);
+			add_document_usage(doc, short_file_name, info->start, &prev_line);
+			count++;
+
+			geany_match_info_free(info);
+		}
+		g_slist_free(matches);
 	}
-	g_slist_free(matches);
 	g_free(short_file_name);
 	return count;
 }
@@ -2214,7 +3002,7 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 	}
 
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(msgwindow.notebook), MSG_MESSAGE);
-	gtk_list_store_clear(msgwindow.store_msg);
+	msgwin_clear_tab(MSG_MESSAGE);
 
 	if (! in_session)
 	{	/* use current document */
@@ -2251,42 +3039,69 @@ void search_find_usage(const gchar *search_text, const gchar *original_search_te
 
 /* ttf is updated to include the last match position (ttf->chrg.cpMin) and
  * the new search range end (ttf->chrg.cpMax).
+ * All matches are replaced in a single Scintilla call, so there is only one buffer pass
+ * and one modification notification however many matches there are.
  * Note: Normally you would call sci_start/end_undo_action() around this call. */
 guint search_replace_range(ScintillaObject *sci, struct Sci_TextToFind *ttf,
 		GeanyFindFlags flags, const gchar *replace_text)
 {
-	gint count = 0;
+	guint count = 0;
 	gint offset = 0; /* difference between search pos and replace pos */
+	gsize text_pos = 0;
 	GSList *match, *matches;
+	GArray *ranges;
+	GString *text;
+	struct Sci_ReplaceRange *range;
 
 	g_return_val_if_fail(sci != NULL && ttf->lpstrText != NULL && replace_text != NULL, 0);
 	if (! *ttf->lpstrText)
 		return 0;
 
 	matches = find_range(sci, flags, ttf);
+	if (! matches)
+		return 0;
+
+	ranges = g_array_new(FALSE, FALSE, sizeof(struct Sci_ReplaceRange));
+	text = g_string_new(NULL);
 	foreach_slist (match, matches)
 	{
 		GeanyMatchInfo *info = match->data;
-		gint replace_len;
+		struct Sci_ReplaceRange new_range;
+		const gsize prev_len = text->len;
 
-		info->start += offset;
-		info->end += offset;
-
-		replace_len = search_replace_match(sci, info, replace_text);
-		offset += replace_len - (info->end - info->start);
-		count ++;
+		append_replacement(text, info, replace_text);
+		new_range.cpMin = info->start;
+		new_range.cpMax = info->end;
+		new_range.text = NULL;
+		new_range.length = (Sci_Position) (text->len - prev_len);
+		g_array_append_val(ranges, new_range);
 
 		/* on last match, update the last match/new range end */
 		if (! match->next)
-		{
-			ttf->chrg.cpMin = info->start;
-			ttf->chrg.cpMax += offset;
-		}
+			ttf->chrg.cpMin = info->start + offset;
+
+		offset += (gint) new_range.length - (info->end - info->start);
+		count++;
 
 		geany_match_info_free(info);
 	}
 	g_slist_free(matches);
 
+	/* the replacement strings are only stable once they are all appended */
+	foreach_array(struct Sci_ReplaceRange, range, ranges)
+	{
+		range->text = text->str + text_pos;
+		text_pos += range->length;
+	}
+
+	if (sci_replace_ranges(sci, (struct Sci_ReplaceRange *) ranges->data, ranges->len) < 0)
+		count = 0;
+	else
+		ttf->chrg.cpMax += offset;
+
+	g_array_free(ranges, TRUE);
+	g_string_free(text, TRUE);
+
 	return count;
 }
 
@@ -61,6 +61,7 @@ typedef struct GeanySearchPrefs
 	gboolean	hide_find_dialog;		/* hide the find dialog on next or previous */
 	gboolean	replace_and_find_by_default;	/* enter in replace window performs Replace & Find instead of Replace */
 	GeanyFindSelOptions find_selection_type;
+	gint		lazy_mark_all_size;		/* hidden pref, in MiB */
 }
 GeanySearchPrefs;
 
@@ -79,12 +80,16 @@ typedef struct GeanyMatchInfo
 }
 GeanyMatchInfo;
 
+struct GeanyDocument; /* document.h includes this header */
+
 void search_show_find_in_files_dialog(const gchar *dir);
 
+gint search_mark_all_multiple(struct GeanyDocument *doc, gint indic, const gchar *const *texts,
+		GeanyFindFlags flags);
+
 
 #ifdef GEANY_PRIVATE
 
-struct GeanyDocument; /* document.h includes this header */
 struct _ScintillaObject;
 struct Sci_TextToFind;
 
@@ -134,6 +139,8 @@ void search_find_selection(struct GeanyDocument *doc, gboolean search_backwards)
 
 gint search_mark_all(struct GeanyDocument *doc, const gchar *search_text, GeanyFindFlags flags);
 
+void search_mark_all_update(struct GeanyDocument *doc);
+
 gint search_replace_match(struct _ScintillaObject *sci, const GeanyMatchInfo *match, const gchar *replace_text);
 
 guint search_replace_range(struct _ScintillaObject *sci, struct Sci_TextToFind *ttf,
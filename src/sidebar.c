@@ -77,6 +77,7 @@ enum
 };
 
 static GtkTreeStore *store_openfiles;
+static guint openfiles_frozen = 0;	/* see sidebar_openfiles_freeze() */
 static GtkWidget *openfiles_popup_menu;
 static GtkWidget *tag_window;	/* scrolled window that holds the symbol list GtkTreeView */
 
@@ -884,6 +885,21 @@ static void expand_iter(GtkTreeIter *iter)
 }
 
 
+/* Marks iter and its parents as expanded while the view is detached, for
+ * sidebar_openfiles_thaw() to expand them */
+static void unfold_iter(GtkTreeIter *iter)
+{
+	GtkTreeIter child = *iter, parent;
+
+	gtk_tree_store_set(store_openfiles, &child, DOCUMENTS_FOLD, FALSE, -1);
+	while (gtk_tree_model_iter_parent(GTK_TREE_MODEL(store_openfiles), &parent, &child))
+	{
+		gtk_tree_store_set(store_openfiles, &parent, DOCUMENTS_FOLD, FALSE, -1);
+		child = parent;
+	}
+}
+
+
 /* Also sets doc->priv->iter.
  * This is called recursively in sidebar_openfiles_update_all(). */
 GEANY_EXPORT_SYMBOL
@@ -917,7 +933,58 @@ void sidebar_openfiles_add(GeanyDocument *doc)
 	/* Expand new parent if necessary. Beware: this is executed by unit tests
 	 * which don't create the tree view. */
 	if (expand && G_LIKELY(tv.tree_openfiles))
-		expand_iter(&parent);
+	{
+		if (openfiles_frozen > 0)
+			unfold_iter(&parent);
+		else
+			expand_iter(&parent);
+	}
+}
+
+
+/* Detaches the open files list from its view while adding many documents, so that the view
+ * is only updated once by sidebar_openfiles_thaw(). Calls can be nested. */
+void sidebar_openfiles_freeze(void)
+{
+	if (openfiles_frozen++ > 0 || tv.tree_openfiles == NULL)
+		return;
+
+	g_object_ref(store_openfiles);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(tv.tree_openfiles), NULL);
+}
+
+
+void sidebar_openfiles_thaw(void)
+{
+	GtkTreeModel *model = GTK_TREE_MODEL(store_openfiles);
+	GtkTreeIter iter;
+	gboolean valid;
+
+	g_return_if_fail(openfiles_frozen > 0);
+
+	if (--openfiles_frozen > 0 || tv.tree_openfiles == NULL)
+		return;
+
+	gtk_tree_view_set_model(GTK_TREE_VIEW(tv.tree_openfiles), model);
+	g_object_unref(store_openfiles);
+
+	/* restore the fold state, on_row_expanded() takes care of the children */
+	valid = gtk_tree_model_get_iter_first(model, &iter);
+	while (valid)
+	{
+		GeanyDocument *doc;
+		gboolean fold;
+
+		gtk_tree_model_get(model, &iter, DOCUMENTS_DOCUMENT, &doc, DOCUMENTS_FOLD, &fold, -1);
+		if (!doc && !fold)
+		{
+			GtkTreePath *path = gtk_tree_model_get_path(model, &iter);
+
+			gtk_tree_view_expand_row(GTK_TREE_VIEW(tv.tree_openfiles), path, FALSE);
+			gtk_tree_path_free(path);
+		}
+		valid = gtk_tree_model_iter_next(model, &iter);
+	}
 }
 
 
@@ -999,7 +1066,7 @@ void sidebar_openfiles_update(GeanyDocument *doc)
 		gboolean sel;
 
 		treesel = gtk_tree_view_get_selection(GTK_TREE_VIEW(tv.tree_openfiles));
-		sel = gtk_tree_selection_iter_is_selected(treesel, &doc->priv->iter);
+		sel = openfiles_frozen == 0 && gtk_tree_selection_iter_is_selected(treesel, &doc->priv->iter);
 		openfiles_remove(doc);
 
 		sidebar_openfiles_add(doc);
@@ -1281,6 +1348,10 @@ static gboolean tree_model_find_node(GtkTreeModel *model,
 
 void sidebar_select_openfiles_item(GeanyDocument *doc)
 {
+	/* there is no view to select in until sidebar_openfiles_thaw() */
+	if (openfiles_frozen > 0)
+		return;
+
 	gtk_tree_model_foreach(GTK_TREE_MODEL(store_openfiles), tree_model_find_node, doc);
 }
 
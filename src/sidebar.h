@@ -81,6 +81,10 @@ void sidebar_openfiles_update(GeanyDocument *doc);
 
 void sidebar_openfiles_update_all(void);
 
+void sidebar_openfiles_freeze(void);
+
+void sidebar_openfiles_thaw(void);
+
 void sidebar_select_openfiles_item(GeanyDocument *doc);
 
 void sidebar_remove_document(GeanyDocument *doc);
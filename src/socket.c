@@ -680,6 +680,7 @@ gboolean socket_lock_input_cb(GIOChannel *source, GIOCondition condition, gpoint
 		if (strncmp(buf, "open", 4) == 0)
 		{
 			cl_options.readonly = strncmp(buf+4, "ro", 2) == 0; /* open in readonly? */
+			document_open_batch_begin();
 			while (socket_fd_gets(sock, buf, sizeof(buf)) != -1 && *buf != '.')
 			{
 				gsize buf_len = strlen(buf);
@@ -690,6 +691,7 @@ gboolean socket_lock_input_cb(GIOChannel *source, GIOCondition condition, gpoint
 
 				handle_input_filename(buf);
 			}
+			document_open_batch_end();
 			popup = TRUE;
 		}
 		else if (strncmp(buf, "doclist", 7) == 0)
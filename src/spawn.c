@@ -843,6 +843,8 @@ typedef struct _SpawnChannelData
 	/* stdout/stderr only */
 	GString *buffer;       /* NULL if recursive */
 	GString *line_buffer;  /* NULL if char buffered */
+	gsize line_start;      /* length of the lines already passed to the callback */
+	gboolean line_batched;
 	gsize max_length;
 	/* stdout/stderr: fix continuous empty G_IO_IN-s for recursive channels */
 	guint empty_gio_ins;
@@ -906,6 +908,83 @@ static gboolean spawn_timeout_read_cb(gpointer data)
 	return spawn_read_cb(sc->channel, G_IO_IN, data);
 }
 
+/* Returns: the length of the first line of data, including its end, or 0 if data does not
+ * hold a complete line. A trailing '\r' is not a line end yet, it may be followed by '\n'. */
+static gsize spawn_line_length(const gchar *data, gsize len, gsize max_length)
+{
+	gsize scan_len = MIN(len, max_length);
+	const gchar *end = memchr(data, '\n', scan_len);
+	const gchar *p;
+
+	if (!end)
+		end = data + scan_len;
+	if ((p = memchr(data, '\r', end - data)) != NULL)
+		end = p;
+	if ((p = memchr(data, '\0', end - data)) != NULL)
+		end = p;
+
+	if (end == data + scan_len)
+		return len > max_length ? max_length : 0;
+
+	if (*end == '\r')
+	{
+		if (end + 1 == data + len)
+			return 0;
+		return end - data + 1 + (end[1] == '\n');
+	}
+
+	return end - data + 1;
+}
+
+
+/* Ends the last line of a batch with '\n', so the callback can split the lines easily */
+static void spawn_end_line(GString *buffer)
+{
+	gchar *last = buffer->str + buffer->len - 1;
+
+	if (*last == '\r' || *last == '\0')
+		*last = '\n';
+	else if (*last != '\n')
+		g_string_append_c(buffer, '\n');
+}
+
+
+/* Passes the complete lines of the line buffer to the read callback, one line per call or
+ * all lines at once if batched, and removes them from the line buffer. The line buffer is
+ * compacted once, after the lines are passed, so the work is linear in the input length. */
+static void spawn_read_lines(SpawnChannelData *sc, GString *buffer, GIOCondition input_cond)
+{
+	GString *line_buffer = sc->line_buffer;
+	gsize line_len;
+
+	/* sc->line_start is shared with the nested calls of recursive callbacks */
+	while ((line_len = spawn_line_length(line_buffer->str + sc->line_start,
+		line_buffer->len - sc->line_start, sc->max_length)) > 0)
+	{
+		g_string_append_len(buffer, line_buffer->str + sc->line_start, line_len);
+		sc->line_start += line_len;
+
+		if (sc->line_batched)
+			spawn_end_line(buffer);
+		else
+		{
+			/* input only, failures are reported separately */
+			sc->cb.read(buffer, input_cond, sc->cb_data);
+			g_string_truncate(buffer, 0);
+		}
+	}
+
+	g_string_erase(line_buffer, 0, sc->line_start);
+	sc->line_start = 0;
+
+	if (buffer->len)  /* batched */
+	{
+		sc->cb.read(buffer, input_cond, sc->cb_data);
+		g_string_truncate(buffer, 0);
+	}
+}
+
+
 static gboolean spawn_read_cb(GIOChannel *channel, GIOCondition condition, gpointer data)
 {
 	SpawnChannelData *sc = (SpawnChannelData *) data;
@@ -929,36 +1008,20 @@ static gboolean spawn_read_cb(GIOChannel *channel, GIOCondition condition, gpoin
 
 		if (line_buffer)
 		{
-			gsize n = line_buffer->len;
-
-			while ((status = g_io_channel_read_chars(channel, line_buffer->str + n,
-				DEFAULT_IO_LENGTH, &chars_read, NULL)) == G_IO_STATUS_NORMAL)
+			for (;;)
 			{
-				g_string_set_size(line_buffer, n + chars_read);
+				gsize n = line_buffer->len;
 
-				while (n < line_buffer->len)
-				{
-					gsize line_len = 0;
-
-					if (n == sc->max_length)
-						line_len = n;
-					else if (strchr("\n", line_buffer->str[n]))  /* '\n' or '\0' */
-						line_len = n + 1;
-					else if (n < line_buffer->len - 1 && line_buffer->str[n] == '\r')
-						line_len = n + 1 + (line_buffer->str[n + 1] == '\n');
-
-					if (!line_len)
-						n++;
-					else
-					{
-						g_string_append_len(buffer, line_buffer->str, line_len);
-						g_string_erase(line_buffer, 0, line_len);
-						/* input only, failures are reported separately below */
-						sc->cb.read(buffer, input_cond, sc->cb_data);
-						g_string_truncate(buffer, 0);
-						n = 0;
-					}
-				}
+				/* recursive callbacks may leave lines which are not passed yet */
+				g_string_set_size(line_buffer, n + DEFAULT_IO_LENGTH);
+				status = g_io_channel_read_chars(channel, line_buffer->str + n,
+					DEFAULT_IO_LENGTH, &chars_read, NULL);
+				g_string_set_size(line_buffer, n + (status == G_IO_STATUS_NORMAL ? chars_read : 0));
+
+				if (status != G_IO_STATUS_NORMAL)
+					break;
+
+				spawn_read_lines(sc, buffer, input_cond);
 
 				if (SPAWN_CHANNEL_GIO_WATCH(sc) && !failure_cond)
 					break;
@@ -992,6 +1055,8 @@ static gboolean spawn_read_cb(GIOChannel *channel, GIOCondition condition, gpoin
 		if (line_buffer && line_buffer->len)  /* flush the line buffer */
 		{
 			g_string_append_len(buffer, line_buffer->str, line_buffer->len);
+			if (sc->line_batched)
+				spawn_end_line(buffer);
 			/* all data may be from a previous call */
 			if (!input_cond)
 				input_cond = G_IO_IN;
@@ -1110,6 +1175,8 @@ static void spawn_watch_cb(GPid pid, gint status, gpointer data)
  *  The synchronous execution may not be combined with recursive callbacks.
  *
  *  In line buffered mode, the child input is broken on `\n`, `\r\n`, `\r`, `\0` and max length.
+ *  In line batched mode, all complete lines read at once are passed in a single call, each
+ *  line ending with `\n` or `\r\n`.
  *
  *  All I/O callbacks are guaranteed to be invoked at least once with @c G_IO_ERR, @c G_IO_HUP
  *  or @c G_IO_NVAL set (except for a @a stdin_cb which returns @c FALSE before that). For the
@@ -1232,6 +1299,8 @@ gboolean spawn_with_callbacks(const gchar *working_directory, const gchar *comma
 				{
 					sc->line_buffer = g_string_sized_new(sc->max_length +
 						DEFAULT_IO_LENGTH);
+					sc->line_batched = (spawn_flags &
+						((SPAWN_STDOUT_LINE_BATCHED >> 1) << i)) != 0;
 				}
 
 				sc->empty_gio_ins = 0;
@@ -59,7 +59,17 @@ typedef enum
 	SPAWN_STDIN_RECURSIVE      = 0x08,  /**< The stdin callback is recursive. */
 	SPAWN_STDOUT_RECURSIVE     = 0x10,  /**< The stdout callback is recursive. */
 	SPAWN_STDERR_RECURSIVE     = 0x20,  /**< The stderr callback is recursive. */
-	SPAWN_RECURSIVE            = 0x38   /**< All callbacks are recursive. */
+	SPAWN_RECURSIVE            = 0x38,  /**< All callbacks are recursive. */
+	/* line batched modes */
+	/** All complete lines of stdout read at once are passed in a single call.
+	 *  @since 1.39 (API 248) */
+	SPAWN_STDOUT_LINE_BATCHED  = 0x40,
+	/** All complete lines of stderr read at once are passed in a single call.
+	 *  @since 1.39 (API 248) */
+	SPAWN_STDERR_LINE_BATCHED  = 0x80,
+	/** stdout/stderr lines are passed in batches.
+	 *  @since 1.39 (API 248) */
+	SPAWN_LINE_BATCHED         = 0xC0
 } SpawnFlags;
 
 /**
@@ -71,6 +81,9 @@ typedef enum
  *  cases, the @a string will be terminated with a nul character that is not part of the data
  *  at @a string->len.
  *
+ *  In line batched mode, the @a string contains one or more lines, each of them ending with
+ *  `\n` or `\r\n`, and no nuls.
+ *
  *  If @c G_IO_IN or @c G_IO_PRI are set, the @a string will contain at least one character.
  *
  *  @param string contains the child data if @c G_IO_IN or @c G_IO_PRI are set.
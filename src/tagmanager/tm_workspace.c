@@ -333,6 +333,29 @@ void tm_workspace_add_source_files(GPtrArray *source_files)
 }
 
 
+/* Like tm_workspace_update_source_file_buffer() for several source files, but the workspace
+ tag arrays are recreated once after parsing all of them instead of merging the tags of
+ each file, which is much faster for many files.
+ @param source_files The source files to update, which must be part of the workspace.
+ @param text_bufs The text buffers to parse, in the order of source_files.
+ @param buf_sizes The sizes of text_bufs.
+*/
+void tm_workspace_update_source_file_buffers(GPtrArray *source_files, guchar **text_bufs,
+	gsize *buf_sizes)
+{
+	guint i;
+
+	g_return_if_fail(source_files != NULL);
+
+	/* the workspace arrays may point to the tags deleted by parsing, but they are not used
+	 * until they are recreated */
+	for (i = 0; i < source_files->len; i++)
+		update_source_file(source_files->pdata[i], text_bufs[i], buf_sizes[i], TRUE, FALSE);
+
+	tm_workspace_update();
+}
+
+
 /** Removes multiple source files from the workspace and updates the workspace tag
  arrays. This is more efficient than calling tm_workspace_remove_source_file()
  separately for each of the files. To completely free the TMSourceFile pointers
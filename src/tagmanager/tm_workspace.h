@@ -70,6 +70,9 @@ void tm_workspace_add_source_file_noupdate(TMSourceFile *source_file);
 void tm_workspace_update_source_file_buffer(TMSourceFile *source_file, guchar* text_buf,
 	gsize buf_size);
 
+void tm_workspace_update_source_file_buffers(GPtrArray *source_files, guchar **text_bufs,
+	gsize *buf_sizes);
+
 void tm_workspace_free(void);
 
 gboolean tm_workspace_is_autocomplete_tag(TMTag *tag, TMSourceFile *current_file,
@@ -1077,9 +1077,10 @@ void ui_document_show_hide(GeanyDocument *doc)
 		g_free(name);
 	}
 
-	gtk_check_menu_item_set_active(
-			GTK_CHECK_MENU_ITEM(ui_lookup_widget(main_widgets.window, "set_file_readonly1")),
-			doc->readonly);
+	item = ui_lookup_widget(main_widgets.window, "set_file_readonly1");
+	gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(item), doc->readonly);
+	/* a viewer document is never edited */
+	ui_widget_set_sensitive(item, ! doc->priv->viewer);
 
 	item = ui_lookup_widget(main_widgets.window, "menu_write_unicode_bom1");
 	gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(item), doc->has_bom);
@@ -2390,6 +2391,8 @@ void ui_init_prefs(void)
 		"statusbar_template", _(DEFAULT_STATUSBAR_TEMPLATE));
 	stash_group_add_boolean(group, &ui_prefs.new_document_after_close,
 		"new_document_after_close", FALSE);
+	stash_group_add_integer(group, &ui_prefs.msgwin_max_rows,
+		"msgwin_max_rows", 10000);
 	stash_group_add_boolean(group, &interface_prefs.msgwin_status_visible,
 		"msgwin_status_visible", TRUE);
 	stash_group_add_boolean(group, &interface_prefs.msgwin_compiler_visible,
@@ -170,6 +170,7 @@ typedef struct UIPrefs
 	gboolean	allow_always_save; /* if set, files can always be saved, even if unchanged */
 	gchar		*statusbar_template;
 	gboolean	new_document_after_close;
+	gint		msgwin_max_rows;
 	gboolean	symbols_group_by_type;
 
 	/* Menu-item related data */
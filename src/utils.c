@@ -98,64 +98,147 @@ void utils_open_browser(const gchar *uri)
 }
 
 
-/* taken from anjuta, to determine the EOL mode of the file */
-gint utils_get_line_endings(const gchar* buffer, gsize size)
+#define HIGH_BITS G_GUINT64_CONSTANT(0x8080808080808080)
+#define LOW_BITS G_GUINT64_CONSTANT(0x0101010101010101)
+
+/* Returns a word with the high bit set in each byte of word that equals byte. Unlike the
+ * usual test for a null byte, this is exact for every byte. */
+static inline guint64 word_match_byte(guint64 word, guchar byte)
 {
-	gsize i;
-	guint cr, lf, crlf, max_mode;
-	gint mode;
+	guint64 x = word ^ (LOW_BITS * byte);
+
+	return ~(((x & ~HIGH_BITS) + ~HIGH_BITS) | x | ~HIGH_BITS);
+}
 
-	cr = lf = crlf = 0;
 
-	for (i = 0; i < size ; i++)
+/* Returns the number of bytes marked by word_match_byte() */
+static inline guint count_matches(guint64 matches)
+{
+	return (guint) (((matches >> 7) * LOW_BITS) >> 56);
+}
+
+
+/* Counts the line endings of buffer, which may be one piece of a larger text.
+ * counts must be zeroed before the first piece.
+ * The buffer is scanned eight bytes at a time, pairing a CR with an LF in the next byte
+ * by shifting the LF matches. */
+GEANY_EXPORT_SYMBOL
+void utils_count_line_endings(GeanyLineEndingCounts *counts, const gchar *buffer, gsize size)
+{
+	gsize i = 0;
+
+	for (; size - i >= 8; i += 8)
 	{
-		if (buffer[i] == 0x0a)
-		{
-			/* LF */
-			lf++;
-		}
-		else if (buffer[i] == 0x0d)
+		guint64 word, lf, cr, crlf;
+
+		memcpy(&word, buffer + i, sizeof word);
+		word = GUINT64_FROM_LE(word);
+		lf = word_match_byte(word, 0x0a);
+		cr = word_match_byte(word, 0x0d);
+
+		if (counts->cr_pending)
 		{
-			if (i >= (size - 1))
+			/* CR ending the previous word or piece */
+			if (lf & 0x80)
 			{
-				/* Last char, CR */
-				cr++;
+				counts->crlf++;
+				lf &= ~G_GUINT64_CONSTANT(0x80);
 			}
 			else
+				counts->cr++;
+			counts->cr_pending = FALSE;
+		}
+		if ((lf | cr) == 0)
+			continue;
+
+		crlf = cr & (lf >> 8);
+		lf &= ~(crlf << 8);
+		cr &= ~crlf;
+		counts->crlf += count_matches(crlf);
+		counts->lf += count_matches(lf);
+		/* a CR in the last byte is CR or CRLF depending on the next byte */
+		counts->cr_pending = (cr >> 63) != 0;
+		counts->cr += count_matches(cr & ~(HIGH_BITS << 56));
+	}
+
+	for (; i < size; i++)
+	{
+		if (counts->cr_pending)
+		{
+			counts->cr_pending = FALSE;
+			if (buffer[i] == 0x0a)
 			{
-				if (buffer[i + 1] != 0x0a)
-				{
-					/* CR */
-					cr++;
-				}
-				else
-				{
-					/* CRLF */
-					crlf++;
-				}
-				i++;
+				counts->crlf++;
+				continue;
 			}
+			counts->cr++;
 		}
+		if (buffer[i] == 0x0a)
+			counts->lf++;
+		else if (buffer[i] == 0x0d)
+			counts->cr_pending = TRUE;
+	}
+}
+
+
+/* Returns the EOL mode most used in the text counted, which must be complete */
+GEANY_EXPORT_SYMBOL
+gint utils_get_line_endings_from_counts(GeanyLineEndingCounts *counts)
+{
+	gsize max_mode;
+	gint mode;
+
+	if (counts->cr_pending)
+	{
+		/* Last char, CR */
+		counts->cr++;
+		counts->cr_pending = FALSE;
 	}
 
 	/* Vote for the maximum */
 	mode = SC_EOL_LF;
-	max_mode = lf;
-	if (crlf > max_mode)
+	max_mode = counts->lf;
+	if (counts->crlf > max_mode)
 	{
 		mode = SC_EOL_CRLF;
-		max_mode = crlf;
+		max_mode = counts->crlf;
 	}
-	if (cr > max_mode)
+	if (counts->cr > max_mode)
 	{
 		mode = SC_EOL_CR;
-		max_mode = cr;
+		max_mode = counts->cr;
 	}
 
 	return mode;
 }
 
 
+/* Returns whether the text counted, which must be complete, has no line endings other
+ * than those of eol_mode */
+gboolean utils_line_endings_match(const GeanyLineEndingCounts *counts, gint eol_mode)
+{
+	gsize cr = counts->cr + (counts->cr_pending ? 1 : 0);
+
+	switch (eol_mode)
+	{
+		case SC_EOL_CRLF: return cr == 0 && counts->lf == 0;
+		case SC_EOL_CR: return counts->crlf == 0 && counts->lf == 0;
+		default: return counts->crlf == 0 && cr == 0;
+	}
+}
+
+
+/* taken from anjuta, to determine the EOL mode of the file */
+GEANY_EXPORT_SYMBOL
+gint utils_get_line_endings(const gchar* buffer, gsize size)
+{
+	GeanyLineEndingCounts counts = { 0 };
+
+	utils_count_line_endings(&counts, buffer, size);
+	return utils_get_line_endings_from_counts(&counts);
+}
+
+
 gboolean utils_isbrace(gchar c, gboolean include_angles)
 {
 	switch (c)
@@ -401,20 +484,42 @@ const gchar *utils_get_eol_char(gint eol_mode)
 }
 
 
-/* Converts line endings to @a target_eol_mode. */
+/* Converts line endings to @a target_eol_mode in a single pass. */
+GEANY_EXPORT_SYMBOL
 void utils_ensure_same_eol_characters(GString *string, gint target_eol_mode)
 {
 	const gchar *eol_str = utils_get_eol_char(target_eol_mode);
+	GeanyLineEndingCounts counts = { 0 };
+	GString *result;
+	gchar *old_str;
+	gsize i, start = 0;
 
-	/* first convert data to LF only */
-	utils_string_replace_all(string, "\r\n", "\n");
-	utils_string_replace_all(string, "\r", "\n");
-
-	if (target_eol_mode == SC_EOL_LF)
+	utils_count_line_endings(&counts, string->str, string->len);
+	if (utils_line_endings_match(&counts, target_eol_mode))
 		return;
 
-	/* now convert to desired line endings */
-	utils_string_replace_all(string, "\n", eol_str);
+	result = g_string_sized_new(string->len + counts.cr + counts.lf + 1);
+	for (i = 0; i < string->len; i++)
+	{
+		gchar c = string->str[i];
+
+		if (c != '\r' && c != '\n')
+			continue;
+		g_string_append_len(result, string->str + start, i - start);
+		g_string_append(result, eol_str);
+		if (c == '\r' && i + 1 < string->len && string->str[i + 1] == '\n')
+			i++;
+		start = i + 1;
+	}
+	g_string_append_len(result, string->str + start, string->len - start);
+
+	/* swap the buffers to keep string itself */
+	old_str = string->str;
+	string->str = result->str;
+	string->len = result->len;
+	string->allocated_len = result->allocated_len;
+	result->str = old_str;
+	g_string_free(result, TRUE);
 }
 
 
@@ -232,9 +232,22 @@ typedef enum
 	RESOURCE_DIR_COUNT
 } GeanyResourceDirType;
 
+/* Line ending counts of text scanned in pieces with utils_count_line_endings() */
+typedef struct
+{
+	gsize cr, lf, crlf;
+	gboolean cr_pending;	/* the last piece ended with a CR */
+} GeanyLineEndingCounts;
+
 
 gint utils_get_line_endings(const gchar* buffer, gsize size);
 
+void utils_count_line_endings(GeanyLineEndingCounts *counts, const gchar *buffer, gsize size);
+
+gint utils_get_line_endings_from_counts(GeanyLineEndingCounts *counts);
+
+gboolean utils_line_endings_match(const GeanyLineEndingCounts *counts, gint eol_mode);
+
 gboolean utils_isbrace(gchar c, gboolean include_angles);
 
 gboolean utils_is_opening_brace(gchar c, gboolean include_angles);
@@ -0,0 +1,189 @@
+#ifdef HAVE_CONFIG_H
+# include "config.h"
+#endif
+
+#include "document.h"
+#include "documentprivate.h"
+
+#define DOCUMENT_TEST_ADD(path, func) g_test_add_func("/document/" path, func);
+
+
+/* A document without an editor, enough for the diagnostics */
+static GeanyDocument *document_new_fake(void)
+{
+	GeanyDocument *doc = g_new0(GeanyDocument, 1);
+
+	doc->priv = g_new0(GeanyDocumentPrivate, 1);
+	doc->is_valid = TRUE;
+	return doc;
+}
+
+
+static void document_free_fake(GeanyDocument *doc)
+{
+	document_clear_diagnostics(doc, NULL);
+	if (doc->priv->diagnostics)
+		g_array_free(doc->priv->diagnostics, TRUE);
+	if (doc->priv->unmarked_diagnostic_lines)
+		g_array_free(doc->priv->unmarked_diagnostic_lines, TRUE);
+	g_free(doc->priv);
+	g_free(doc);
+}
+
+
+static void assert_diagnostic(GPtrArray *diagnostics, guint i, gint line, const gchar *source,
+		const gchar *message)
+{
+	const GeanyDiagnostic *diag;
+
+	g_assert_cmpuint(i, <, diagnostics->len);
+	diag = g_ptr_array_index(diagnostics, i);
+	g_assert_cmpint(diag->line, ==, line);
+	g_assert_cmpstr(diag->source, ==, source);
+	g_assert_cmpstr(diag->message, ==, message);
+}
+
+
+static void test_document_diagnostics_sorted(void)
+{
+	GeanyDocument *doc = document_new_fake();
+	GPtrArray *diagnostics;
+
+	document_add_diagnostic(doc, "b", 5, "late");
+	document_add_diagnostic(doc, "b", 1, "early");
+	document_add_diagnostic(doc, "a", 5, NULL);
+	document_add_diagnostic(doc, "b", 5, "early");
+
+	diagnostics = document_get_diagnostics(doc, 0, -1);
+	g_assert_cmpuint(diagnostics->len, ==, 4);
+	assert_diagnostic(diagnostics, 0, 1, "b", "early");
+	assert_diagnostic(diagnostics, 1, 5, "a", NULL);
+	assert_diagnostic(diagnostics, 2, 5, "b", "early");
+	assert_diagnostic(diagnostics, 3, 5, "b", "late");
+	g_ptr_array_free(diagnostics, TRUE);
+
+	/* added after the others were sorted */
+	document_add_diagnostic(doc, "a", 3, "middle");
+	document_add_diagnostic(doc, "a", 0, "first");
+
+	diagnostics = document_get_diagnostics(doc, 0, -1);
+	g_assert_cmpuint(diagnostics->len, ==, 6);
+	assert_diagnostic(diagnostics, 0, 0, "a", "first");
+	assert_diagnostic(diagnostics, 1, 1, "b", "early");
+	assert_diagnostic(diagnostics, 2, 3, "a", "middle");
+	assert_diagnostic(diagnostics, 3, 5, "a", NULL);
+	g_ptr_array_free(diagnostics, TRUE);
+
+	diagnostics = document_get_diagnostics(doc, 2, 4);
+	g_assert_cmpuint(diagnostics->len, ==, 1);
+	assert_diagnostic(diagnostics, 0, 3, "a", "middle");
+	g_ptr_array_free(diagnostics, TRUE);
+
+	diagnostics = document_get_diagnostics(doc, 6, -1);
+	g_assert_cmpuint(diagnostics->len, ==, 0);
+	g_ptr_array_free(diagnostics, TRUE);
+
+	document_free_fake(doc);
+}
+
+
+static void test_document_diagnostics_duplicates(void)
+{
+	GeanyDocument *doc = document_new_fake();
+	GPtrArray *diagnostics;
+
+	document_add_diagnostic(doc, "build", 2, "error");
+	document_add_diagnostic(doc, "build", 2, "error");
+	document_add_diagnostic(doc, "build", 2, NULL);
+	document_add_diagnostic(doc, "build", 2, NULL);
+	document_add_diagnostic(doc, "lint", 2, "error");
+
+	diagnostics = document_get_diagnostics(doc, 0, -1);
+	g_assert_cmpuint(diagnostics->len, ==, 3);
+	assert_diagnostic(diagnostics, 0, 2, "build", NULL);
+	assert_diagnostic(diagnostics, 1, 2, "build", "error");
+	assert_diagnostic(diagnostics, 2, 2, "lint", "error");
+	g_ptr_array_free(diagnostics, TRUE);
+
+	/* the same as one already sorted */
+	document_add_diagnostic(doc, "lint", 2, "error");
+	diagnostics = document_get_diagnostics(doc, 0, -1);
+	g_assert_cmpuint(diagnostics->len, ==, 3);
+	g_ptr_array_free(diagnostics, TRUE);
+
+	document_free_fake(doc);
+}
+
+
+static void test_document_diagnostics_clear(void)
+{
+	GeanyDocument *doc = document_new_fake();
+	GPtrArray *diagnostics;
+
+	document_add_diagnostic(doc, "build", 1, "error");
+	document_add_diagnostic(doc, "lint", 2, "warning");
+	document_add_diagnostic(doc, "build", 3, "error");
+
+	document_clear_diagnostics(doc, "build");
+	diagnostics = document_get_diagnostics(doc, 0, -1);
+	g_assert_cmpuint(diagnostics->len, ==, 1);
+	assert_diagnostic(diagnostics, 0, 2, "lint", "warning");
+	g_ptr_array_free(diagnostics, TRUE);
+
+	document_clear_diagnostics(doc, NULL);
+	diagnostics = document_get_diagnostics(doc, 0, -1);
+	g_assert_cmpuint(diagnostics->len, ==, 0);
+	g_ptr_array_free(diagnostics, TRUE);
+
+	document_free_fake(doc);
+}
+
+
+static void test_document_diagnostics_shift(void)
+{
+	GeanyDocument *doc = document_new_fake();
+	GPtrArray *diagnostics;
+
+	document_add_diagnostic(doc, "build", 1, "a");
+	document_add_diagnostic(doc, "build", 4, "b");
+	document_add_diagnostic(doc, "build", 6, "c");
+
+	/* two lines inserted before line 4 */
+	document_shift_diagnostics(doc, 4, 2);
+	diagnostics = document_get_diagnostics(doc, 0, -1);
+	g_assert_cmpuint(diagnostics->len, ==, 3);
+	assert_diagnostic(diagnostics, 0, 1, "build", "a");
+	assert_diagnostic(diagnostics, 1, 6, "build", "b");
+	assert_diagnostic(diagnostics, 2, 8, "build", "c");
+	g_ptr_array_free(diagnostics, TRUE);
+
+	/* lines 5 and 6 removed, with the diagnostic of line 6 */
+	document_add_diagnostic(doc, "lint", 9, "d");
+	document_shift_diagnostics(doc, 5, -2);
+	diagnostics = document_get_diagnostics(doc, 0, -1);
+	g_assert_cmpuint(diagnostics->len, ==, 3);
+	assert_diagnostic(diagnostics, 0, 1, "build", "a");
+	assert_diagnostic(diagnostics, 1, 6, "build", "c");
+	assert_diagnostic(diagnostics, 2, 7, "lint", "d");
+	g_ptr_array_free(diagnostics, TRUE);
+
+	/* the lines of diagnostics not marked yet follow too */
+	g_assert_nonnull(doc->priv->unmarked_diagnostic_lines);
+	g_assert_cmpuint(doc->priv->unmarked_diagnostic_lines->len, ==, 3);
+	g_assert_cmpint(g_array_index(doc->priv->unmarked_diagnostic_lines, gint, 2), ==, 7);
+
+	document_free_fake(doc);
+}
+
+
+int main(int argc, char **argv)
+{
+	g_test_init(&argc, &argv, NULL);
+
+	DOCUMENT_TEST_ADD("diagnostics_sorted", test_document_diagnostics_sorted);
+	DOCUMENT_TEST_ADD("diagnostics_duplicates", test_document_diagnostics_duplicates);
+	DOCUMENT_TEST_ADD("diagnostics_clear", test_document_diagnostics_clear);
+	DOCUMENT_TEST_ADD("diagnostics_shift", test_document_diagnostics_shift);
+
+	return g_test_run();
+}
@@ -2,6 +2,9 @@
 #include "utils.h"
 
 #include "gtkcompat.h"
+#include "Scintilla.h"
+
+#include <string.h>
 
 #define UTIL_TEST_ADD(path, func) g_test_add_func("/utils/" path, func);
 
@@ -408,6 +411,64 @@ void test_utils_strv_shorten_file_list(void)
 	g_strfreev(data);
 }
 
+static void test_utils_count_line_endings(void)
+{
+	const gchar *texts[] = {
+		"a\nb\nc\r\n",
+		"a\r\nb\r\nc\n",
+		"a\rb\r\rc\r\n",
+		"\r\r\n\r",
+		"\r\n\r\n\n\n\n",
+		"no line ending",
+		"counted eight\r\nbytes at\ra time\r\n\r\n\n, across\r\nwords\r",
+	};
+	GeanyLineEndingCounts counts = { 0 };
+	guint i;
+
+	g_assert_cmpint(utils_get_line_endings(texts[0], strlen(texts[0])), ==, SC_EOL_LF);
+	g_assert_cmpint(utils_get_line_endings(texts[1], strlen(texts[1])), ==, SC_EOL_CRLF);
+	g_assert_cmpint(utils_get_line_endings(texts[2], strlen(texts[2])), ==, SC_EOL_CR);
+
+	utils_count_line_endings(&counts, texts[3], strlen(texts[3]));
+	g_assert_cmpint(utils_get_line_endings_from_counts(&counts), ==, SC_EOL_CR);
+	g_assert_cmpuint(counts.cr, ==, 2);
+	g_assert_cmpuint(counts.lf, ==, 0);
+	g_assert_cmpuint(counts.crlf, ==, 1);
+
+	/* counting in two pieces gives the same result at any split */
+	for (i = 0; i < G_N_ELEMENTS(texts); i++)
+	{
+		gsize len = strlen(texts[i]);
+		gint expected = utils_get_line_endings(texts[i], len);
+		gsize split;
+
+		for (split = 0; split <= len; split++)
+		{
+			GeanyLineEndingCounts counts = { 0 };
+
+			utils_count_line_endings(&counts, texts[i], split);
+			utils_count_line_endings(&counts, texts[i] + split, len - split);
+			g_assert_cmpint(utils_get_line_endings_from_counts(&counts), ==, expected);
+		}
+	}
+}
+
+static void test_utils_ensure_same_eol_characters(void)
+{
+	GString *str = g_string_new("a\r\nb\rc\nd\r");
+
+	utils_ensure_same_eol_characters(str, SC_EOL_CRLF);
+	g_assert_cmpstr(str->str, ==, "a\r\nb\r\nc\r\nd\r\n");
+	utils_ensure_same_eol_characters(str, SC_EOL_CRLF);
+	g_assert_cmpstr(str->str, ==, "a\r\nb\r\nc\r\nd\r\n");
+	utils_ensure_same_eol_characters(str, SC_EOL_LF);
+	g_assert_cmpstr(str->str, ==, "a\nb\nc\nd\n");
+	utils_ensure_same_eol_characters(str, SC_EOL_CR);
+	g_assert_cmpstr(str->str, ==, "a\rb\rc\rd\r");
+	g_assert_cmpuint(str->len, ==, 8);
+	g_string_free(str, TRUE);
+}
+
 int main(int argc, char **argv)
 {
 	g_test_init(&argc, &argv, NULL);
@@ -416,6 +477,8 @@ int main(int argc, char **argv)
 	UTIL_TEST_ADD("strv_find_common_prefix", test_utils_strv_find_common_prefix);
 	UTIL_TEST_ADD("strv_find_lcs", test_utils_strv_find_lcs);
 	UTIL_TEST_ADD("strv_shorten_file_list", test_utils_strv_shorten_file_list);
+	UTIL_TEST_ADD("count_line_endings", test_utils_count_line_endings);
+	UTIL_TEST_ADD("ensure_same_eol_characters", test_utils_ensure_same_eol_characters);
 
 	return g_test_run();
 }